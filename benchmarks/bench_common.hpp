@@ -0,0 +1,42 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Keeps the compiler from discarding or hoisting a computed value.
+template <typename T> inline void do_not_optimize(T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : "+m"(value) : : "memory");
+#else
+    static volatile auto sink = value;
+    sink = value;
+#endif
+}
+
+// Returns the best wall-clock time over `repeats` runs of f(), in seconds.
+template <typename F> double best_seconds(F &&f, int repeats = 5) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const auto stop = std::chrono::steady_clock::now();
+        best = std::min(best,
+                        std::chrono::duration<double>(stop - start).count());
+    }
+    return best;
+}
+
+inline void report(const std::string &name, double seconds,
+                   std::size_t operations, const char *unit = "op") {
+    std::printf("%-48s %12.3f ms %12.2f ns/%s %14.2f M%s/s\n", name.c_str(),
+                seconds * 1e3, seconds * 1e9 / double(operations), unit,
+                double(operations) / seconds * 1e-6, unit);
+}
+
+// Problem size from argv[1] (if given), otherwise `fallback`.
+inline std::size_t size_arg(int argc, char **argv, std::size_t fallback) {
+    return argc > 1 ? std::strtoull(argv[1], nullptr, 10) : fallback;
+}
@@ -0,0 +1,127 @@
+#include "aabb.hpp"
+#include "bench_common.hpp"
+#include "bvh.hpp"
+#include "random.hpp"
+#include "vector.hpp"
+#include <array>
+#include <optional>
+#include <vector>
+
+// Builds a BVH over a synthetic scene of small random triangles and measures
+// build time and ray, overlap and closest-point query throughput.
+
+namespace {
+
+using Triangle = std::array<cml::Vec3f, 3>;
+
+std::optional<float> intersect(const Triangle &tri, const cml::Vec3f &origin,
+                               const cml::Vec3f &dir, float t_max) {
+    const auto e1 = tri[1] - tri[0];
+    const auto e2 = tri[2] - tri[0];
+    const auto p = dir.cross(e2);
+    const auto det = e1.dot(p);
+    if (det > -1e-12f && det < 1e-12f) {
+        return std::nullopt;
+    }
+    const auto inv_det = 1.f / det;
+    const auto s = origin - tri[0];
+    const auto u = s.dot(p) * inv_det;
+    if (u < 0.f || u > 1.f) {
+        return std::nullopt;
+    }
+    const auto q = s.cross(e1);
+    const auto v = dir.dot(q) * inv_det;
+    if (v < 0.f || u + v > 1.f) {
+        return std::nullopt;
+    }
+    const auto t = e2.dot(q) * inv_det;
+    if (t < 0.f || t > t_max) {
+        return std::nullopt;
+    }
+    return t;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 10'000'000);
+    const cml::Vec3f lo(0.f, 0.f, 0.f);
+    const cml::Vec3f hi(1000.f, 1000.f, 1000.f);
+
+    std::vector<cml::Vec3f> centers(n);
+    std::vector<cml::Vec3f> offsets(3 * n);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(centers), lo, hi, 1);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(offsets),
+                          cml::Vec3f(-1.f, -1.f, -1.f),
+                          cml::Vec3f(1.f, 1.f, 1.f), 2);
+    std::vector<Triangle> triangles(n);
+    std::vector<cml::Aabbf> boxes(n);
+    for (auto i = 0u; i < n; i++) {
+        for (auto k = 0u; k < 3; k++) {
+            triangles[i][k] = centers[i] + offsets[3 * i + k];
+            boxes[i].expand(triangles[i][k]);
+        }
+    }
+
+    cml::Bvh<float> bvh;
+    report("build (binned SAH)", best_seconds([&] {
+               bvh.build(std::span<const cml::Aabbf>(boxes));
+           }, 3),
+           n, "prim");
+    std::printf("nodes: %zu (%zu MB)\n", bvh.nodes().size(),
+                bvh.nodes().size_bytes() >> 20);
+
+    const std::size_t queries = 1 << 18;
+    std::vector<cml::Vec3f> origins(queries);
+    std::vector<cml::Vec3f> dirs(queries);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(origins), lo, hi, 3);
+    cml::fill_uniform_sphere(std::span<cml::Vec3f>(dirs), 4);
+
+    std::size_t hits = 0;
+    report("raycast closest hit (pool)", best_seconds([&] {
+               std::vector<unsigned char> hit(queries);
+               cml::ThreadPool::global().parallel_for_each(
+                   0, queries, 1024, [&](std::size_t r) {
+                       const auto h = bvh.raycast(
+                           origins[r], dirs[r], 1e30f,
+                           [&](std::uint32_t prim, float t_max) {
+                               return intersect(triangles[prim], origins[r],
+                                                dirs[r], t_max);
+                           });
+                       hit[r] = h.has_value();
+                   });
+               hits = 0;
+               for (const auto h : hit) {
+                   hits += h;
+               }
+           }),
+           queries, "ray");
+    std::printf("hit rate: %.3f\n", double(hits) / double(queries));
+
+    std::size_t overlaps = 0;
+    report("AABB overlap query (1 thread)", best_seconds([&] {
+               overlaps = 0;
+               for (auto q = 0u; q < queries; q++) {
+                   const cml::Aabbf box(origins[q] - cml::Vec3f(5.f, 5.f, 5.f),
+                                        origins[q] + cml::Vec3f(5.f, 5.f, 5.f));
+                   bvh.query_overlap(box, [&](std::uint32_t prim) {
+                       overlaps += boxes[prim].overlaps(box);
+                   });
+               }
+           }),
+           queries, "query");
+
+    float total = 0;
+    report("closest point query (1 thread)", best_seconds([&] {
+               for (auto q = 0u; q < queries; q++) {
+                   const auto nearest =
+                       bvh.closest(origins[q], [&](std::uint32_t prim) {
+                           return boxes[prim].distance_sq(origins[q]);
+                       });
+                   total += nearest ? nearest->distance_sq : 0.f;
+               }
+               do_not_optimize(total);
+           }),
+           queries, "query");
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "bench_common.hpp"
+#include "convex_hull.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Hulls of Gaussian Vec2d and Vec3d clouds: a plain std::sort plus
+// monotone chain, and quickhull over all points, against convex_hull()
+// with the extreme-point prefilter, on one thread and on the global pool.
+
+using namespace cml;
+
+namespace {
+
+std::vector<std::uint32_t> sorted_chain(const std::vector<Vec2d> &points) {
+    std::vector<std::uint32_t> order(points.size());
+    std::iota(order.begin(), order.end(), std::uint32_t(0));
+    std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+        return points[a][0] < points[b][0] ||
+               (points[a][0] == points[b][0] && points[a][1] < points[b][1]);
+    });
+    std::vector<std::uint32_t> lower, upper;
+    for (const auto p : order) {
+        detail::extend_chain(std::span<const Vec2d>(points), lower, p, 1.0);
+        detail::extend_chain(std::span<const Vec2d>(points), upper, p, -1.0);
+    }
+    lower.insert(lower.end(), upper.rbegin() + 1, upper.rend() - 1);
+    return lower;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 4'000'000);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    cml::ThreadPool single(1);
+
+    std::vector<Vec2d> points2(count);
+    for (auto &p : points2) {
+        p = Vec2d{normal(rng), normal(rng)};
+    }
+    report("2D sort + monotone chain", best_seconds([&] {
+               auto hull = sorted_chain(points2);
+               do_not_optimize(hull);
+           }),
+           count, "point");
+    report("2D convex_hull", best_seconds([&] {
+               auto hull = convex_hull(points2, single);
+               do_not_optimize(hull);
+           }),
+           count, "point");
+    report("2D convex_hull, global pool", best_seconds([&] {
+               auto hull = convex_hull(points2);
+               do_not_optimize(hull);
+           }),
+           count, "point");
+
+    std::vector<Vec3d> points3(count);
+    for (auto &p : points3) {
+        p = Vec3d{normal(rng), normal(rng), normal(rng)};
+    }
+    std::vector<std::uint32_t> all(count);
+    std::iota(all.begin(), all.end(), std::uint32_t(0));
+    report("3D quickhull, no prefilter", best_seconds([&] {
+               auto faces = detail::quickhull(std::span<const Vec3d>(points3),
+                                              all, single);
+               do_not_optimize(faces);
+           }),
+           count, "point");
+    report("3D convex_hull", best_seconds([&] {
+               auto hull = convex_hull(points3, single);
+               do_not_optimize(hull);
+           }),
+           count, "point");
+    report("3D convex_hull, global pool", best_seconds([&] {
+               auto hull = convex_hull(points3);
+               do_not_optimize(hull);
+           }),
+           count, "point");
+}
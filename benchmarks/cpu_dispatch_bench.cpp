@@ -0,0 +1,72 @@
+#include "bench_common.hpp"
+#include "cpu_dispatch.hpp"
+#include "frustum.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vec_batch_ops.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Runs the dispatched batch kernels once per instruction set this CPU
+// supports, on one thread, to show what each level buys over the baseline
+// build.
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 2'000'000);
+    std::printf("supported: %s, active: %s\n",
+                std::string(cml::isa_name(cml::supported_isa())).c_str(),
+                std::string(cml::isa_name(cml::active_isa())).c_str());
+
+    cml::VecBatch<float, 3> points(n);
+    cml::fill_uniform_box(points, cml::Vec3f(-100.f, -10.f, -100.f),
+                          cml::Vec3f(100.f, 10.f, 100.f), 1);
+    std::vector<float> radii(n, 1.f);
+    cml::VecBatch<float, 3> out(n);
+    std::vector<float> lengths(n);
+    std::vector<std::uint64_t> mask(cml::visibility_words(n));
+
+    const auto m = cml::translate(
+        cml::rotate(cml::Mat4f::identity(), 0.3f, cml::Vec3f(0.f, 1.f, 0.f)),
+        cml::Vec3f(1.f, 2.f, 3.f));
+    const cml::Frustum<float> frustum(
+        cml::lookAt(cml::Vec3f(0.f, 0.f, 0.f), cml::Vec3f(1.f, 0.f, -1.f),
+                    cml::Vec3f(0.f, 1.f, 0.f)) *
+        cml::perspective(static_cast<float>(M_PI / 3), 16.f / 9.f, 0.1f,
+                         200.f));
+
+    cml::ThreadPool single(1);
+    for (const auto isa : cml::all_isas) {
+        if (isa > cml::supported_isa()) {
+            continue;
+        }
+        cml::set_active_isa(isa);
+        const auto name = std::string(cml::isa_name(isa));
+        report("transform_points, " + name, best_seconds([&] {
+                   cml::transform_points(m, points, out, single);
+                   do_not_optimize(out);
+               }),
+               n, "point");
+        report("multiply_add, " + name, best_seconds([&] {
+                   cml::multiply_add(points, 0.5f, out, out, single);
+                   do_not_optimize(out);
+               }),
+               n, "point");
+        report("length, " + name, best_seconds([&] {
+                   cml::length(points, std::span<float>(lengths), single);
+                   do_not_optimize(lengths);
+               }),
+               n, "point");
+        report("cull_spheres, " + name, best_seconds([&] {
+                   cml::cull_spheres(frustum, points,
+                                     std::span<const float>(radii),
+                                     std::span<std::uint64_t>(mask), single);
+               }),
+               n, "object");
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "bench_common.hpp"
+#include "cpu_dispatch.hpp"
+#include "curves.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// Catmull-Rom samples of one Vec3f segment: a loop over the scalar
+// evaluator, batched evaluation at arbitrary parameters per ISA, and
+// forward differencing at uniform parameters, on one thread.
+
+using namespace cml;
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 1'000'000);
+    const CubicCurve<float, 3> curve(
+        CubicBasis::catmull_rom, Vec3f{0, 0, 0}, Vec3f{1, 2, 0.5f},
+        Vec3f{3, 2, -1}, Vec3f{4, 0, 2});
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> t(count);
+    for (auto &v : t) {
+        v = dist(rng);
+    }
+    std::vector<Vec3f> aos(count);
+    VecBatch<float, 3> soa(count);
+    cml::ThreadPool single(1);
+
+    report("scalar catmull_rom", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   aos[i] = curve(t[i]);
+               }
+               do_not_optimize(aos);
+           }),
+           count, "sample");
+
+    const auto initial = active_isa();
+    for (const auto isa : all_isas) {
+        if (isa > supported_isa()) {
+            continue;
+        }
+        set_active_isa(isa);
+        const auto name = std::string(isa_name(isa));
+        report("evaluate SoA " + name, best_seconds([&] {
+                   curve.evaluate(t, soa, single);
+                   do_not_optimize(soa);
+               }),
+               count, "sample");
+        report("evaluate AoS " + name, best_seconds([&] {
+                   curve.evaluate(t, std::span(aos), single);
+                   do_not_optimize(aos);
+               }),
+               count, "sample");
+        report("evaluate_uniform SoA " + name, best_seconds([&] {
+                   curve.evaluate_uniform(0.0f, 1.0f, count, soa, single);
+                   do_not_optimize(soa);
+               }),
+               count, "sample");
+        report("evaluate_uniform AoS " + name, best_seconds([&] {
+                   curve.evaluate_uniform(0.0f, 1.0f, std::span(aos),
+                                          single);
+                   do_not_optimize(aos);
+               }),
+               count, "sample");
+    }
+    set_active_isa(initial);
+}
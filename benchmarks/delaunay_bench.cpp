@@ -0,0 +1,45 @@
+#include "bench_common.hpp"
+#include "delaunay.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// Delaunay triangulations of uniform Vec2d points, on one thread and
+// partitioned into one strip per thread of the global pool, and the
+// Voronoi diagram.
+
+using namespace cml;
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 1'000'000);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    cml::ThreadPool single(1);
+
+    std::vector<Vec2d> points(count);
+    for (auto &p : points) {
+        p = Vec2d{uniform(rng), uniform(rng)};
+    }
+    report("DelaunayTriangulation", best_seconds([&] {
+               DelaunayTriangulation dt(points, {}, single);
+               do_not_optimize(dt);
+           }),
+           count, "point");
+    const auto partitions = ThreadPool::global().size();
+    report("DelaunayTriangulation, " + std::to_string(partitions) +
+               " strips, global pool",
+           best_seconds([&] {
+               DelaunayTriangulation dt(points, {partitions});
+               do_not_optimize(dt);
+           }),
+           count, "point");
+
+    const DelaunayTriangulation dt(points, {}, single);
+    report("voronoi_diagram", best_seconds([&] {
+               auto voronoi = voronoi_diagram(points, dt, single);
+               do_not_optimize(voronoi);
+           }),
+           count, "point");
+}
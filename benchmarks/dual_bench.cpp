@@ -0,0 +1,99 @@
+#include "bench_common.hpp"
+#include "dual.hpp"
+#include "matrix.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <random>
+#include <vector>
+
+// Jacobians of a camera projection with respect to the eye position (3
+// variables) and of a rotated point with respect to the angle and axis (4
+// variables): forward differences, which evaluate the double pipeline N + 1
+// times, against one evaluation with Dual<double, N>.
+
+using namespace cml;
+
+namespace {
+
+template <typename T> Vec3<T> project(const Vec3<T> &eye) {
+    const auto view =
+        lookAt(eye, Vec3<T>{T(0), T(0.5), T(0)}, Vec3<T>{T(0), T(1), T(0)});
+    const auto projection = perspective(T(1.0), T(1.5), T(0.1), T(100.0));
+    const auto clip = projection * view.transposed() *
+                      Vec<T, 4>{T(0.3), T(-0.2), T(1.1), T(1)};
+    return Vec3<T>{clip[0] / clip[3], clip[1] / clip[3], clip[2] / clip[3]};
+}
+
+template <typename T> Vec<T, 4> turn(const Vec<T, 4> &q) {
+    return rotate(Mat4<T>::identity(), q[0], Vec3<T>{q[1], q[2], q[3]}) *
+           Vec<T, 4>{T(0.5), T(-1), T(2), T(1)};
+}
+
+template <unsigned int M, unsigned int N, typename F>
+Matrix<M, N, double> forward_differences(F f, const Vec<double, N> &x) {
+    const double h = 1e-7;
+    const auto y = f(x);
+    Matrix<M, N, double> j;
+    for (auto k = 0u; k < N; k++) {
+        auto shifted = x;
+        shifted[k] += h;
+        const auto dy = f(shifted) - y;
+        for (auto i = 0u; i < M; i++) {
+            j.get(i, k) = dy[i] / h;
+        }
+    }
+    return j;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 200'000);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<Vec3d> eyes(count);
+    std::vector<Vec<double, 4>> turns(count);
+    for (std::size_t i = 0; i < count; i++) {
+        eyes[i] = Vec3d{uniform(rng), uniform(rng) + 2, uniform(rng) + 4};
+        const auto axis =
+            Vec3d{uniform(rng), uniform(rng), uniform(rng) + 2}.normalized();
+        turns[i] = Vec<double, 4>{uniform(rng), axis[0], axis[1], axis[2]};
+    }
+
+    std::vector<Mat3d> projected(count);
+    report("projection, forward differences", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   projected[i] = forward_differences<3>(
+                       [](const Vec3d &e) { return project(e); }, eyes[i]);
+               }
+               do_not_optimize(projected);
+           }),
+           count, "jacobian");
+    report("projection, Dual<double, 3>", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   projected[i] = jacobian(
+                       [](const auto &e) { return project(e); }, eyes[i]);
+               }
+               do_not_optimize(projected);
+           }),
+           count, "jacobian");
+
+    std::vector<Mat4d> turned(count);
+    report("rotation, forward differences", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   turned[i] = forward_differences<4>(
+                       [](const Vec<double, 4> &q) { return turn(q); },
+                       turns[i]);
+               }
+               do_not_optimize(turned);
+           }),
+           count, "jacobian");
+    report("rotation, Dual<double, 4>", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   turned[i] = jacobian(
+                       [](const auto &q) { return turn(q); }, turns[i]);
+               }
+               do_not_optimize(turned);
+           }),
+           count, "jacobian");
+}
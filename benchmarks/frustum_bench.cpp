@@ -0,0 +1,82 @@
+#include "bench_common.hpp"
+#include "frustum.hpp"
+#include "random.hpp"
+#include "vec_batch.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <vector>
+
+// Culls bounding spheres and boxes scattered around a camera, comparing the
+// scalar per-object tests with the batched kernels.
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 4'000'000);
+    const auto view = cml::lookAt(cml::Vec3f(0.f, 0.f, 0.f),
+                                  cml::Vec3f(1.f, 0.2f, -1.f),
+                                  cml::Vec3f(0.f, 1.f, 0.f));
+    const auto projection =
+        cml::perspective(static_cast<float>(M_PI / 3), 16.f / 9.f, 0.1f,
+                         500.f);
+    const cml::Frustum<float> frustum(view * projection);
+
+    std::vector<cml::Vec3f> centers(n);
+    std::vector<cml::Vec3f> sizes(n);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(centers),
+                          cml::Vec3f(-500.f, -50.f, -500.f),
+                          cml::Vec3f(500.f, 50.f, 500.f), 1);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(sizes),
+                          cml::Vec3f(0.5f, 0.5f, 0.5f),
+                          cml::Vec3f(4.f, 4.f, 4.f), 2);
+    std::vector<float> radii(n);
+    cml::VecBatch<float, 3> mins(n);
+    cml::VecBatch<float, 3> maxs(n);
+    for (auto i = 0u; i < n; i++) {
+        radii[i] = static_cast<float>(sizes[i].length());
+        mins.set(i, centers[i] - sizes[i]);
+        maxs.set(i, centers[i] + sizes[i]);
+    }
+    const cml::VecBatch<float, 3> center_batch(centers);
+
+    std::vector<std::uint64_t> mask(cml::visibility_words(n));
+    report("spheres, scalar", best_seconds([&] {
+               for (auto i = 0u; i < n; i += 64) {
+                   std::uint64_t word = 0;
+                   for (auto l = 0u; l < 64 && i + l < n; l++) {
+                       word |= std::uint64_t(frustum.intersects_sphere(
+                                   centers[i + l], radii[i + l]))
+                               << l;
+                   }
+                   mask[i / 64] = word;
+               }
+               do_not_optimize(mask);
+           }),
+           n, "object");
+    cml::ThreadPool single(1);
+    report("spheres, batched (1 thread)", best_seconds([&] {
+               cml::cull_spheres(frustum, center_batch,
+                                 std::span<const float>(radii),
+                                 std::span<std::uint64_t>(mask), single);
+           }),
+           n, "object");
+    report("spheres, batched (pool)", best_seconds([&] {
+               cml::cull_spheres(frustum, center_batch,
+                                 std::span<const float>(radii),
+                                 std::span<std::uint64_t>(mask));
+           }),
+           n, "object");
+    report("aabbs, batched (pool)", best_seconds([&] {
+               cml::cull_aabbs(frustum, mins, maxs,
+                               std::span<std::uint64_t>(mask));
+           }),
+           n, "object");
+
+    std::vector<std::uint32_t> visible;
+    report("compact visible indices (pool)", best_seconds([&] {
+               cml::compact_visible(std::span<const std::uint64_t>(mask), n,
+                                    visible);
+           }),
+           n, "object");
+    std::printf("visible: %zu of %zu\n", visible.size(), n);
+    return 0;
+}
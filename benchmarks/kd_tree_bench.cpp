@@ -0,0 +1,63 @@
+#include "bench_common.hpp"
+#include "kd_tree.hpp"
+#include "random.hpp"
+#include "vector.hpp"
+#include <string>
+#include <vector>
+
+// Builds a k-d tree over uniformly distributed 3D points and measures build
+// time and exact, approximate and batched query throughput.
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 10'000'000);
+    const cml::Vec3f lo(0.f, 0.f, 0.f);
+    const cml::Vec3f hi(1000.f, 1000.f, 1000.f);
+
+    std::vector<cml::Vec3f> points(n);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(points), lo, hi, 1);
+
+    cml::KdTree<float, 3> tree;
+    report("build (median split)", best_seconds([&] {
+               tree.build(std::span<const cml::Vec3f>(points));
+           }, 3),
+           n, "point");
+
+    const std::size_t queries = 1 << 16;
+    std::vector<cml::Vec3f> targets(queries);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(targets), lo, hi, 2);
+
+    const std::size_t k = 8;
+    std::vector<cml::KdNeighbor<float>> found;
+    float total = 0;
+    for (const float epsilon : {0.f, 0.5f, 2.f}) {
+        const std::string name =
+            "knn k=8 eps=" + std::to_string(epsilon).substr(0, 3) +
+            " (1 thread)";
+        report(name, best_seconds([&] {
+                   for (const auto &q : targets) {
+                       tree.knn(q, k, found, epsilon);
+                       total += found.back().distance_sq;
+                   }
+                   do_not_optimize(total);
+               }),
+               queries, "query");
+    }
+
+    std::vector<cml::KdNeighbor<float>> batch(queries * k);
+    report("knn k=8 batched (pool)", best_seconds([&] {
+               tree.knn_batch(std::span<const cml::Vec3f>(targets), k,
+                              std::span<cml::KdNeighbor<float>>(batch));
+           }),
+           queries, "query");
+
+    std::size_t neighbors = 0;
+    report("radius search r=10 batched (pool)", best_seconds([&] {
+               const auto lists = tree.radius_search_batch(
+                   std::span<const cml::Vec3f>(targets), 10.f);
+               neighbors = lists.neighbors.size();
+           }),
+           queries, "query");
+    std::printf("mean neighbors within r: %.2f\n",
+                double(neighbors) / double(queries));
+    return 0;
+}
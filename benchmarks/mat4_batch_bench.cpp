@@ -0,0 +1,103 @@
+#include "bench_common.hpp"
+#include "cpu_dispatch.hpp"
+#include "mat4_batch_ops.hpp"
+#include "matrix.hpp"
+#include "matrix_batch.hpp"
+#include "matrix_batch_ops.hpp"
+#include "skinning.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Mat4 products: the operator* loop, multiply_batch on arrays of Matrix per
+// ISA, the interleaved MatrixBatch form, and linear blend skinning, on one
+// thread.
+
+using namespace cml;
+
+namespace {
+
+std::vector<Mat4f> random_matrices(std::size_t count, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<Mat4f> matrices(count);
+    for (auto &m : matrices) {
+        for (auto &v : m) {
+            v = dist(rng);
+        }
+    }
+    return matrices;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 100'000);
+    const auto a = random_matrices(count, 1);
+    const auto b = random_matrices(count, 2);
+    std::vector<Mat4f> out(count);
+    cml::ThreadPool single(1);
+
+    report("operator* loop", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   out[i] = a[i] * b[i];
+               }
+               do_not_optimize(out);
+           }),
+           count, "product");
+
+    const auto initial = active_isa();
+    for (const auto isa : all_isas) {
+        if (isa > supported_isa()) {
+            continue;
+        }
+        set_active_isa(isa);
+        const auto name = std::string(isa_name(isa));
+        report("multiply_batch " + name, best_seconds([&] {
+                   multiply_batch<float>(a, b, out, single);
+                   do_not_optimize(out);
+               }),
+               count, "product");
+        report("multiply_batch broadcast " + name, best_seconds([&] {
+                   multiply_batch<float>(a[0], b, out, single);
+                   do_not_optimize(out);
+               }),
+               count, "product");
+    }
+    set_active_isa(initial);
+    std::printf("active: %s\n", std::string(isa_name(active_isa())).c_str());
+
+    const MatrixBatch<4, 4, float> batch_a(a);
+    const MatrixBatch<4, 4, float> batch_b(b);
+    MatrixBatch<4, 4, float> batch_out(count);
+    report("MatrixBatch multiply", best_seconds([&] {
+               multiply(batch_a, batch_b, batch_out, single);
+               do_not_optimize(batch_out);
+           }),
+           count, "product");
+
+    // 64 bones, 4 influences per vertex.
+    constexpr std::uint32_t bones = 64;
+    std::vector<Mat4f> palette(bones, Mat4f::identity());
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<std::uint32_t> bone(0, bones - 1);
+    SkinInfluences<float> influences(count);
+    VecBatch<float, 3> positions(count), skinned;
+    for (std::size_t i = 0; i < count; i++) {
+        for (auto k = 0u; k < 4; k++) {
+            influences.bones.get(k, i) = bone(rng);
+            influences.weights.get(k, i) = 0.25f;
+        }
+        positions.get(0, i) = float(i % 100);
+    }
+    report("linear_blend_skin 4 influences", best_seconds([&] {
+               linear_blend_skin<float>(palette, influences, positions,
+                                        skinned, single);
+               do_not_optimize(skinned);
+           }),
+           count, "vertex");
+}
@@ -0,0 +1,144 @@
+#include "bench_common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "matrix_batch.hpp"
+#include "matrix_batch_ops.hpp"
+#include "thread_pool.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Batched solves against the loop over std::vector<Matrix> they replace,
+// the scalar side using the same algorithms (partial pivoting LU and
+// Cholesky), on one thread.
+
+using namespace cml;
+
+namespace {
+
+template <unsigned int N, typename T>
+void scalar_solve(Matrix<N, N, T> a, Matrix<N, 1, T> &b) {
+    for (auto k = 0u; k < N; k++) {
+        auto p = k;
+        for (auto r = k + 1; r < N; r++) {
+            if (std::abs(a.get(r, k)) > std::abs(a.get(p, k))) {
+                p = r;
+            }
+        }
+        for (auto c = 0u; c < N; c++) {
+            std::swap(a.get(k, c), a.get(p, c));
+        }
+        std::swap(b.get(k, 0), b.get(p, 0));
+        for (auto r = k + 1; r < N; r++) {
+            const auto f = a.get(r, k) / a.get(k, k);
+            for (auto c = k + 1; c < N; c++) {
+                a.get(r, c) -= f * a.get(k, c);
+            }
+            b.get(r, 0) -= f * b.get(k, 0);
+        }
+    }
+    for (auto r = N; r-- > 0;) {
+        auto x = b.get(r, 0);
+        for (auto c = r + 1; c < N; c++) {
+            x -= a.get(r, c) * b.get(c, 0);
+        }
+        b.get(r, 0) = x / a.get(r, r);
+    }
+}
+
+template <unsigned int N, typename T> void scalar_cholesky(Matrix<N, N, T> &a) {
+    for (auto j = 0u; j < N; j++) {
+        auto d = a.get(j, j);
+        for (auto k = 0u; k < j; k++) {
+            d -= a.get(j, k) * a.get(j, k);
+        }
+        a.get(j, j) = std::sqrt(d);
+        for (auto i = j + 1; i < N; i++) {
+            auto s = a.get(i, j);
+            for (auto k = 0u; k < j; k++) {
+                s -= a.get(i, k) * a.get(j, k);
+            }
+            a.get(i, j) = s / a.get(j, j);
+            a.get(j, i) = 0;
+        }
+    }
+}
+
+template <unsigned int N, typename T>
+void run(std::size_t count, const char *type) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+    std::vector<Matrix<N, N, T>> a(count);
+    std::vector<Matrix<N, 1, T>> b(count);
+    for (std::size_t i = 0; i < count; i++) {
+        for (auto &v : a[i]) {
+            v = dist(rng);
+        }
+        a[i] = a[i] * a[i].transposed() + Matrix<N, N, T>::identity() * T(N);
+        for (auto &v : b[i]) {
+            v = dist(rng);
+        }
+    }
+    const auto suffix = std::to_string(N) + "x" + std::to_string(N) + " " +
+                        type;
+    cml::ThreadPool single(1);
+
+    auto x = b;
+    report("scalar solve " + suffix, best_seconds([&] {
+               x = b;
+               for (std::size_t i = 0; i < count; i++) {
+                   scalar_solve(a[i], x[i]);
+               }
+               do_not_optimize(x);
+           }),
+           count, "system");
+    const MatrixBatch<N, N, T> batch_a(a);
+    const MatrixBatch<N, 1, T> batch_b(b);
+    MatrixBatch<N, 1, T> batch_x(count);
+    report("batched solve " + suffix, best_seconds([&] {
+               solve(batch_a, batch_b, batch_x, single);
+               do_not_optimize(batch_x);
+           }),
+           count, "system");
+
+    MatrixBatch<N, N, T> batch_inv(count);
+    report("batched inverse " + suffix, best_seconds([&] {
+               inverse(batch_a, batch_inv, single);
+               do_not_optimize(batch_inv);
+           }),
+           count, "matrix");
+
+    auto chol = a;
+    report("scalar cholesky " + suffix, best_seconds([&] {
+               chol = a;
+               for (auto &m : chol) {
+                   scalar_cholesky(m);
+               }
+               do_not_optimize(chol);
+           }),
+           count, "matrix");
+    MatrixBatch<N, N, T> batch_chol(count);
+    report("batched cholesky " + suffix, best_seconds([&] {
+               batch_chol = batch_a;
+               cholesky_factor(batch_chol, single);
+               do_not_optimize(batch_chol);
+           }),
+           count, "matrix");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 200'000);
+    std::printf("active: %s\n",
+                std::string(cml::isa_name(cml::active_isa())).c_str());
+    run<3, double>(count, "double");
+    run<4, double>(count, "double");
+    run<6, double>(count, "double");
+    run<3, float>(count, "float");
+    run<4, float>(count, "float");
+    run<6, float>(count, "float");
+}
@@ -0,0 +1,47 @@
+#include "bench_common.hpp"
+#include "matrix.hpp"
+#include "matrix_chain.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+
+// A * B * C * v with A 64x128, B 128x4, C 4x256: left to right with
+// operator* against chain(), which evaluates A * (B * (C * v)).
+
+int main() {
+    cml::Matrix<64, 128, float> a;
+    cml::Matrix<128, 4, float> b;
+    cml::Matrix<4, 256, float> c;
+    cml::Vec<float, 256> v;
+    for (auto i = 0u; i < 256; i++) {
+        v[i] = float(i % 7) * 0.25f;
+        for (auto r = 0u; r < 4; r++) {
+            c.get(r, i) = float((r + i) % 5) * 0.5f;
+        }
+    }
+    for (auto r = 0u; r < 128; r++) {
+        for (auto k = 0u; k < 4; k++) {
+            b.get(r, k) = float((r * k) % 3);
+        }
+        for (auto k = 0u; k < 64; k++) {
+            a.get(k, r) = float((k + r) % 4) * 0.125f;
+        }
+    }
+
+    const int products = 1000;
+    cml::Vec<float, 64> result;
+    report("left to right operator*", best_seconds([&] {
+               for (int i = 0; i < products; i++) {
+                   result = a * b * c * v;
+                   do_not_optimize(result);
+               }
+           }),
+           products, "product");
+    report("chain()", best_seconds([&] {
+               for (int i = 0; i < products; i++) {
+                   result = cml::chain(a, b, c, v);
+                   do_not_optimize(result);
+               }
+           }),
+           products, "product");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "bench_common.hpp"
+#include "dynamic_matrix.hpp"
+#include "matrix.hpp"
+#include "matrix_functions.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Compares pow() with the loop of operator* calls it replaces, and times
+// expm() and propagate().
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 1'000'000);
+
+    cml::Matrix<8, 8, double> m;
+    for (auto i = 0u; i < 8; i++) {
+        for (auto j = 0u; j < 8; j++) {
+            m.get(i, j) = (i == j ? 0.9 : 0.1 / 7);
+        }
+    }
+    for (const std::uint64_t k : {16u, 1000u, 100'000u}) {
+        const auto name = std::to_string(k);
+        report("Mat8 operator* loop, k=" + name, best_seconds([&] {
+                   auto r = m;
+                   for (std::uint64_t i = 1; i < k; i++) {
+                       r = r * m;
+                   }
+                   do_not_optimize(r);
+               }),
+               1, "call");
+        report("Mat8 pow, k=" + name, best_seconds([&] {
+                   auto r = cml::pow(m, k);
+                   do_not_optimize(r);
+               }),
+               1, "call");
+    }
+
+    const cml::Matrix<2, 2, std::int64_t> fib{1, 1, 1, 0};
+    report("pow_mod fibonacci, k=1e18", best_seconds([&] {
+               auto r = cml::pow_mod(fib, 1'000'000'000'000'000'000ull,
+                                     std::int64_t(1'000'000'007));
+               do_not_optimize(r);
+           }),
+           1, "call");
+
+    for (const std::size_t order : {8u, 64u, 256u}) {
+        cml::DynamicMatrixd a(order, order);
+        for (std::size_t i = 0; i < order; i++) {
+            for (std::size_t j = 0; j < order; j++) {
+                a.get(i, j) = double((i * 7 + j * 3) % 11) / 11.0 - 0.5;
+            }
+        }
+        report("expm, n=" + std::to_string(order), best_seconds([&] {
+                   auto e = cml::expm(a);
+                   do_not_optimize(e);
+               }),
+               1, "call");
+    }
+
+    cml::VecBatch<double, 8> states(n);
+    for (auto d = 0u; d < 8; d++) {
+        for (std::size_t i = 0; i < n; i++) {
+            states.get(d, i) = double(i % 13) + d;
+        }
+    }
+    cml::VecBatch<double, 8> out(n);
+    cml::ThreadPool single(1);
+    report("propagate Mat8, 1 thread", best_seconds([&] {
+               cml::propagate(m, states, out, single);
+               do_not_optimize(out);
+           }),
+           n, "state");
+    report("propagate Mat8, pool", best_seconds([&] {
+               cml::propagate(m, states, out);
+               do_not_optimize(out);
+           }),
+           n, "state");
+}
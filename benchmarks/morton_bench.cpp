@@ -0,0 +1,105 @@
+#include "bench_common.hpp"
+#include "kd_tree.hpp"
+#include "morton.hpp"
+#include "random.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Measures Morton and Hilbert key encoding, the radix sort of key/index
+// pairs against std::sort, and what reordering the queries of a k-d tree
+// along a curve does to their throughput.
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 4'000'000);
+    const cml::Vec3f lo(0.f, 0.f, 0.f);
+    const cml::Vec3f hi(1000.f, 1000.f, 1000.f);
+#if defined(__BMI2__)
+    std::printf("Morton keys via BMI2 pdep/pext\n");
+#else
+    std::printf("Morton keys via portable bit spreading\n");
+#endif
+
+    std::vector<cml::Vec3f> points(n);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(points), lo, hi, 1);
+    const cml::Aabb<float> bounds(lo, hi);
+
+    std::vector<cml::Vec3u> cells(n);
+    for (auto i = 0u; i < n; i++) {
+        cells[i] = cml::quantize(points[i], bounds);
+    }
+    std::vector<std::uint64_t> keys(n);
+    report("morton encode", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   keys[i] = cml::morton_encode(cells[i]);
+               }
+               do_not_optimize(keys);
+           }),
+           n, "point");
+    std::uint64_t sum = 0;
+    report("morton decode", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   sum += cml::morton_decode_3d(keys[i]).x();
+               }
+               do_not_optimize(sum);
+           }),
+           n, "key");
+    report("hilbert encode", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   keys[i] = cml::hilbert_encode(cells[i]);
+               }
+               do_not_optimize(keys);
+           }),
+           n, "point");
+
+    std::vector<std::uint64_t> sorted_keys(n);
+    std::vector<std::uint32_t> values(n);
+    report("radix_sort_pairs", best_seconds([&] {
+               std::copy(keys.begin(), keys.end(), sorted_keys.begin());
+               std::iota(values.begin(), values.end(), 0u);
+               cml::radix_sort_pairs(sorted_keys, values);
+           }, 3),
+           n, "key");
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> pairs(n);
+    report("std::sort of pairs", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   pairs[i] = {keys[i], i};
+               }
+               std::sort(pairs.begin(), pairs.end());
+           }, 3),
+           n, "key");
+
+    std::vector<std::uint32_t> order;
+    report("morton_order (bounds, keys, sort)", best_seconds([&] {
+               order = cml::morton_order(std::span<const cml::Vec3f>(points));
+           }, 3),
+           n, "point");
+    report("hilbert_order (bounds, keys, sort)", best_seconds([&] {
+               order = cml::hilbert_order(std::span<const cml::Vec3f>(points));
+           }, 3),
+           n, "point");
+
+    // The same queries against the same tree, in input and in curve order.
+    const cml::KdTree<float, 3> tree{std::span<const cml::Vec3f>(points)};
+    auto queries = points;
+    queries.resize(std::min<std::size_t>(n, 1 << 20));
+    std::vector<cml::KdNeighbor<float>> found;
+    float total = 0;
+    const auto run_queries = [&] {
+        for (const auto &q : queries) {
+            tree.knn(q, 8, found);
+            total += found.back().distance_sq;
+        }
+        do_not_optimize(total);
+    };
+    report("knn k=8, queries in random order", best_seconds(run_queries, 3),
+           queries.size(), "query");
+    const auto query_order =
+        cml::morton_order(std::span<const cml::Vec3f>(queries));
+    cml::reorder(std::span<cml::Vec3f>(queries), query_order);
+    report("knn k=8, queries in Morton order", best_seconds(run_queries, 3),
+           queries.size(), "query");
+    return 0;
+}
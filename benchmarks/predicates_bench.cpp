@@ -0,0 +1,92 @@
+#include "bench_common.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+// orient2d and incircle on random points, where the filter settles almost
+// everything, and on a small integer grid, where most tests are degenerate
+// and take the exact path: naive floating point against the scalar and
+// batched predicates.
+
+using namespace cml;
+
+namespace {
+
+template <typename Value>
+std::array<VecBatch<double, 2>, 4> make_points(std::size_t count,
+                                              Value &&value) {
+    std::array<VecBatch<double, 2>, 4> p;
+    for (auto &b : p) {
+        b.resize(count);
+        for (std::size_t i = 0; i < count; i++) {
+            b.get(0, i) = value();
+            b.get(1, i) = value();
+        }
+    }
+    return p;
+}
+
+Vec2d at(const VecBatch<double, 2> &b, std::size_t i) {
+    return Vec2d{b.get(0, i), b.get(1, i)};
+}
+
+void run(const char *name, const std::array<VecBatch<double, 2>, 4> &p,
+         std::size_t count) {
+    cml::ThreadPool single(1);
+    std::vector<double> out(count);
+    const std::string prefix = name;
+
+    report(prefix + " naive orient2d", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   out[i] = detail::orient2d_filter(
+                                p[0].get(0, i), p[0].get(1, i), p[1].get(0, i),
+                                p[1].get(1, i), p[2].get(0, i), p[2].get(1, i))
+                                .det;
+               }
+               do_not_optimize(out);
+           }),
+           count, "test");
+    report(prefix + " orient2d", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   out[i] = orient2d(at(p[0], i), at(p[1], i), at(p[2], i));
+               }
+               do_not_optimize(out);
+           }),
+           count, "test");
+    report(prefix + " batched orient2d", best_seconds([&] {
+               auto exact = orient2d(p[0], p[1], p[2], out, single);
+               do_not_optimize(exact);
+           }),
+           count, "test");
+    report(prefix + " incircle", best_seconds([&] {
+               for (std::size_t i = 0; i < count; i++) {
+                   out[i] = incircle(at(p[0], i), at(p[1], i), at(p[2], i),
+                                     at(p[3], i));
+               }
+               do_not_optimize(out);
+           }),
+           count, "test");
+    report(prefix + " batched incircle", best_seconds([&] {
+               auto exact = incircle(p[0], p[1], p[2], p[3], out, single);
+               do_not_optimize(exact);
+           }),
+           count, "test");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 1'000'000);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::uniform_int_distribution<int> grid(0, 3);
+
+    run("random:", make_points(count, [&] { return dist(rng); }), count);
+    run("grid:", make_points(count, [&] { return 0.5 * grid(rng); }), count);
+}
@@ -0,0 +1,53 @@
+#include "bench_common.hpp"
+#include "random.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <random>
+#include <vector>
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 1 << 24);
+    std::vector<cml::Vec3f> out(n);
+    const std::span<cml::Vec3f> span(out);
+
+    report("mt19937 per component (1 thread)", best_seconds([&] {
+               std::mt19937 rng(1);
+               std::uniform_real_distribution<float> dist(0.f, 1.f);
+               for (auto &v : out) {
+                   v = cml::Vec3f(dist(rng), dist(rng), dist(rng));
+               }
+               do_not_optimize(out[0]);
+           }),
+           n, "vec");
+
+    const cml::Vec3f lo(0.f, 0.f, 0.f);
+    const cml::Vec3f hi(1.f, 1.f, 1.f);
+    cml::ThreadPool single(1);
+    report("fill_uniform_box (1 thread)", best_seconds([&] {
+               cml::fill_uniform_box(span, lo, hi, 1, 0, single);
+           }),
+           n, "vec");
+    report("fill_uniform_box (pool)", best_seconds([&] {
+               cml::fill_uniform_box(span, lo, hi, 1);
+           }),
+           n, "vec");
+    report("fill_uniform_sphere (pool)", best_seconds([&] {
+               cml::fill_uniform_sphere(span, 1);
+           }),
+           n, "vec");
+    report("fill_cosine_hemisphere (pool)", best_seconds([&] {
+               cml::fill_cosine_hemisphere(span, 1);
+           }),
+           n, "vec");
+    report("fill_gaussian (pool)", best_seconds([&] {
+               cml::fill_gaussian(span, lo, 1.f, 1);
+           }),
+           n, "vec");
+
+    cml::VecBatch<float, 3> batch(n);
+    report("fill_uniform_box SoA (pool)", best_seconds([&] {
+               cml::fill_uniform_box(batch, lo, hi, 1);
+           }),
+           n, "vec");
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "bench_common.hpp"
+#include "random.hpp"
+#include "ray.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Intersects coherent rays with a small set of triangles, as a BVH leaf
+// loop would, comparing scalar tests with ray and triangle packets.
+
+namespace {
+
+using Triangle = std::array<cml::Vec3f, 3>;
+
+template <unsigned int W>
+void bench_width(const std::vector<cml::Ray<float>> &rays,
+                 const std::vector<Triangle> &triangles) {
+    const auto tests = rays.size() * triangles.size();
+    const auto name = [](const char *what) {
+        return std::string(what) + " W=" + std::to_string(W);
+    };
+
+    std::vector<cml::RayPacket<float, W>> packets(rays.size() / W);
+    for (auto i = 0u; i < packets.size() * W; i++) {
+        packets[i / W].set(i % W, rays[i]);
+    }
+    std::uint32_t hits = 0;
+    report(name("ray packet, Moller-Trumbore"), best_seconds([&] {
+               for (const auto &packet : packets) {
+                   cml::PacketHits<float, W> found(packet);
+                   for (auto t = 0u; t < triangles.size(); t++) {
+                       const auto &tri = triangles[t];
+                       hits += cml::intersect_moller_trumbore(
+                           packet, tri[0], tri[1], tri[2], t, found);
+                   }
+               }
+               do_not_optimize(hits);
+           }),
+           tests, "test");
+    report(name("ray packet, watertight"), best_seconds([&] {
+               for (const auto &packet : packets) {
+                   const cml::WatertightRayPacket<float, W> watertight(packet);
+                   cml::PacketHits<float, W> found(packet);
+                   for (auto t = 0u; t < triangles.size(); t++) {
+                       const auto &tri = triangles[t];
+                       hits += cml::intersect_watertight(
+                           watertight, tri[0], tri[1], tri[2], t, found);
+                   }
+               }
+               do_not_optimize(hits);
+           }),
+           tests, "test");
+
+    std::vector<cml::TrianglePacket<float, W>> tri_packets(triangles.size() /
+                                                           W);
+    for (auto i = 0u; i < tri_packets.size() * W; i++) {
+        const auto &tri = triangles[i];
+        tri_packets[i / W].set(i % W, tri[0], tri[1], tri[2]);
+    }
+    float total = 0;
+    report(name("triangle packet, Moller-Trumbore"), best_seconds([&] {
+               for (const auto &ray : rays) {
+                   for (const auto &packet : tri_packets) {
+                       const auto hit =
+                           cml::intersect_moller_trumbore(ray, packet);
+                       total += hit ? hit->hit.t : 0.f;
+                   }
+               }
+               do_not_optimize(total);
+           }),
+           tests, "test");
+    report(name("triangle packet, watertight"), best_seconds([&] {
+               for (const auto &ray : rays) {
+                   const cml::WatertightRay<float> watertight(ray);
+                   for (const auto &packet : tri_packets) {
+                       const auto hit =
+                           cml::intersect_watertight(watertight, packet);
+                       total += hit ? hit->hit.t : 0.f;
+                   }
+               }
+               do_not_optimize(total);
+           }),
+           tests, "test");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto ray_count = size_arg(argc, argv, 1 << 16);
+    const std::size_t triangle_count = 64;
+
+    std::vector<cml::Vec3f> centers(triangle_count);
+    std::vector<cml::Vec3f> offsets(3 * triangle_count);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(centers),
+                          cml::Vec3f(-1.f, -1.f, -1.f),
+                          cml::Vec3f(1.f, 1.f, 1.f), 1);
+    cml::fill_uniform_box(std::span<cml::Vec3f>(offsets),
+                          cml::Vec3f(-.3f, -.3f, -.3f),
+                          cml::Vec3f(.3f, .3f, .3f), 2);
+    std::vector<Triangle> triangles(triangle_count);
+    for (auto i = 0u; i < triangle_count; i++) {
+        for (auto k = 0u; k < 3; k++) {
+            triangles[i][k] = centers[i] + offsets[3 * i + k];
+        }
+    }
+    // A pinhole camera's rays, in scanline order.
+    std::vector<cml::Ray<float>> rays(ray_count);
+    const auto side = static_cast<std::size_t>(std::sqrt(double(ray_count)));
+    for (auto i = 0u; i < ray_count; i++) {
+        const auto x = float(i % side) / float(side) * 2.f - 1.f;
+        const auto y = float(i / side) / float(side) * 2.f - 1.f;
+        rays[i] = cml::Ray<float>(cml::Vec3f(0.f, 0.f, 4.f),
+                                  cml::Vec3f(x * .4f, y * .4f, -1.f));
+    }
+
+    const auto tests = ray_count * triangle_count;
+    float total = 0;
+    report("scalar Moller-Trumbore (Vec cross/dot)", best_seconds([&] {
+               for (const auto &ray : rays) {
+                   for (const auto &tri : triangles) {
+                       const auto hit = cml::intersect_moller_trumbore(
+                           ray, tri[0], tri[1], tri[2]);
+                       total += hit ? hit->t : 0.f;
+                   }
+               }
+               do_not_optimize(total);
+           }),
+           tests, "test");
+    report("scalar watertight", best_seconds([&] {
+               for (const auto &ray : rays) {
+                   const cml::WatertightRay<float> watertight(ray);
+                   for (const auto &tri : triangles) {
+                       const auto hit = cml::intersect_watertight(
+                           watertight, tri[0], tri[1], tri[2]);
+                       total += hit ? hit->t : 0.f;
+                   }
+               }
+               do_not_optimize(total);
+           }),
+           tests, "test");
+    bench_width<4>(rays, triangles);
+    bench_width<8>(rays, triangles);
+    bench_width<16>(rays, triangles);
+    return 0;
+}
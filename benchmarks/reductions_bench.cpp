@@ -0,0 +1,84 @@
+#include "bench_common.hpp"
+#include "reductions.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Bounds, centroid, covariance and squared lengths of a Vec3f cloud: one
+// scalar pass per statistic (two for the covariance) against the fused
+// reduce_points(), on one thread and on the global pool.
+
+using namespace cml;
+
+namespace {
+
+struct Separate {
+    Vec3f min, max, mean;
+    Matrix<3, 3, float> covariance;
+    float length_sq = 0;
+};
+
+Separate separate_passes(const std::vector<Vec3f> &points) {
+    Separate r;
+    r.min = r.max = points[0];
+    for (const auto &p : points) {
+        for (auto d = 0u; d < 3; d++) {
+            r.min[d] = std::min(r.min[d], p[d]);
+            r.max[d] = std::max(r.max[d], p[d]);
+        }
+    }
+    Vec3f sum;
+    for (const auto &p : points) {
+        sum += p;
+    }
+    r.mean = sum / float(points.size());
+    for (const auto &p : points) {
+        const auto q = p - r.mean;
+        for (auto d = 0u; d < 3; d++) {
+            for (auto e = 0u; e < 3; e++) {
+                r.covariance.get(d, e) += q[d] * q[e];
+            }
+        }
+    }
+    for (const auto &p : points) {
+        r.length_sq += float(p.length_sq());
+    }
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto count = size_arg(argc, argv, 10'000'000);
+    std::mt19937 rng(1);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<Vec3f> points(count);
+    for (auto &p : points) {
+        p = Vec3f{dist(rng), dist(rng) + 5.0f, dist(rng) * 2.0f};
+    }
+    cml::ThreadPool single(1);
+
+    report("separate scalar passes", best_seconds([&] {
+               auto r = separate_passes(points);
+               do_not_optimize(r);
+           }),
+           count, "point");
+    report("reduce_points bounds", best_seconds([&] {
+               auto r = reduce_points(points, {.min = true, .max = true},
+                                      single);
+               do_not_optimize(r);
+           }),
+           count, "point");
+    report("reduce_points all", best_seconds([&] {
+               auto r = reduce_points(points, PointReduction::all(), single);
+               do_not_optimize(r);
+           }),
+           count, "point");
+    report("reduce_points all, global pool", best_seconds([&] {
+               auto r = reduce_points(points, PointReduction::all());
+               do_not_optimize(r);
+           }),
+           count, "point");
+}
@@ -0,0 +1,87 @@
+#include "bench_common.hpp"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "random.hpp"
+#include "strassen.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Crossover of Strassen-Winograd against the blocked gemm() for square
+// products, for several cutoffs, and the error of both against a long
+// double classical product (relative to |A| |B|, the quantity Strassen's
+// normwise bound is stated in).
+
+namespace {
+
+cml::DynamicMatrixd random_matrix(std::size_t n, std::uint64_t seed) {
+    cml::DynamicMatrixd m(n, n);
+    std::vector<cml::Vec<double, 1>> values(n * n);
+    cml::fill_uniform_box(std::span<cml::Vec<double, 1>>(values),
+                          cml::Vec<double, 1>{-1.}, cml::Vec<double, 1>{1.},
+                          seed);
+    for (std::size_t i = 0; i < n * n; i++) {
+        m.data()[i] = values[i][0];
+    }
+    return m;
+}
+
+// max |C - AB| / max (|A| |B|) over sampled rows, with AB in long double.
+double relative_error(const cml::DynamicMatrixd &a,
+                      const cml::DynamicMatrixd &b,
+                      const cml::DynamicMatrixd &c) {
+    const auto n = a.rows();
+    double error = 0;
+    double scale = 0;
+    for (std::size_t i = 0; i < n; i += std::max<std::size_t>(1, n / 16)) {
+        for (std::size_t j = 0; j < n; j++) {
+            long double exact = 0;
+            long double magnitude = 0;
+            for (std::size_t k = 0; k < n; k++) {
+                exact += (long double)a.get(i, k) * b.get(k, j);
+                magnitude += std::abs((long double)a.get(i, k) * b.get(k, j));
+            }
+            error = std::max(error, double(std::abs(c.get(i, j) - exact)));
+            scale = std::max(scale, double(magnitude));
+        }
+    }
+    return error / scale;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto max_n = size_arg(argc, argv, 2048);
+    for (std::size_t n = 256; n <= max_n; n *= 2) {
+        const auto a = random_matrix(n, 2 * n);
+        const auto b = random_matrix(n, 2 * n + 1);
+        cml::DynamicMatrixd c(n, n);
+        const auto flops = 2 * n * n * n;
+        const auto repeats = n >= 2048 ? 2 : 3;
+
+        const auto classical = best_seconds(
+            [&] { cml::gemm(a.view(), b.view(), c.view()); }, repeats);
+        report("gemm n=" + std::to_string(n), classical, flops, "flop");
+        std::printf("  error %.2e\n", relative_error(a, b, c));
+
+        cml::StrassenWorkspace<double> workspace;
+        for (std::size_t cutoff = 128; cutoff < n; cutoff *= 2) {
+            const auto seconds = best_seconds(
+                [&] {
+                    cml::strassen_multiply(a.view(), b.view(), c.view(),
+                                           workspace,
+                                           cml::ThreadPool::global(), cutoff);
+                },
+                repeats);
+            report("strassen n=" + std::to_string(n) +
+                       " cutoff=" + std::to_string(cutoff),
+                   seconds, flops, "flop");
+            std::printf("  error %.2e, %.2fx gemm\n", relative_error(a, b, c),
+                        classical / seconds);
+        }
+    }
+    return 0;
+}
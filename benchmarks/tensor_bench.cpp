@@ -0,0 +1,78 @@
+#include "bench_common.hpp"
+#include "tensor.hpp"
+#include <random>
+#include <vector>
+
+// A [C] bias added to an [N, H, W, C] tensor, through the broadcasting
+// kernel and through an index loop over the four dimensions; then 64 small
+// matrix products, one gemm() per batch against the same products folded
+// into one gemm() because the right operand is shared.
+
+using namespace cml;
+
+namespace {
+
+Tensor<float> random_tensor(const TensorShape &shape, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    Tensor<float> t(shape);
+    for (std::size_t i = 0; i < t.size(); i++) {
+        t.data()[i] = dist(rng);
+    }
+    return t;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 16);
+    const TensorShape shape{n, 32, 32, 64};
+    const auto x = random_tensor(shape, 1);
+    const auto bias = random_tensor({64}, 2);
+    Tensor<float> out(shape);
+
+    report("bias add, index loop", best_seconds([&] {
+               auto *o = out.data();
+               for (std::size_t i = 0; i < shape[0]; i++) {
+                   for (std::size_t h = 0; h < shape[1]; h++) {
+                       for (std::size_t w = 0; w < shape[2]; w++) {
+                           for (std::size_t c = 0; c < shape[3]; c++) {
+                               *o++ = x(i, h, w, c) + bias(c);
+                           }
+                       }
+                   }
+               }
+               do_not_optimize(out);
+           }),
+           shape.size(), "element");
+    report("bias add, add()", best_seconds([&] {
+               add<float>(x, bias, out);
+               do_not_optimize(out);
+           }),
+           shape.size(), "element");
+    // Every other channel: strided, so only the outer dimensions collapse.
+    Tensor<float> half({n, 32, 32, 32});
+    report("bias add, add() on a strided view", best_seconds([&] {
+               add<float>(x.slice(3, 0, 64, 2), bias.slice(0, 0, 64, 2), half);
+               do_not_optimize(half);
+           }),
+           half.size(), "element");
+
+    const auto a = random_tensor({n * 4, 24, 32}, 3);
+    const auto w = random_tensor({32, 48}, 4);
+    Tensor<float> products({n * 4, 24, 48});
+    const auto flops = 2 * products.size() * 32;
+    report("matmul, one gemm per batch", best_seconds([&] {
+               for (std::size_t i = 0; i < n * 4; i++) {
+                   gemm(a.select(0, i).matrix(), w.view().matrix(),
+                        products.select(0, i).matrix());
+               }
+               do_not_optimize(products);
+           }),
+           flops, "flop");
+    report("matmul, batched", best_seconds([&] {
+               matmul<float>(a, w, products);
+               do_not_optimize(products);
+           }),
+           flops, "flop");
+}
@@ -0,0 +1,114 @@
+#include "bench_common.hpp"
+#include "matrix.hpp"
+#include "transform_hierarchy.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Builds a scene hierarchy of translate/rotate transforms and compares a
+// recursive walk with Matrix::operator* against TransformHierarchy updates
+// with every node, 1% of the nodes and a single node changed.
+
+namespace {
+
+struct Scene {
+    std::vector<std::uint32_t> parents;
+    std::vector<cml::Mat4f> locals;
+    std::vector<std::vector<std::uint32_t>> children;
+};
+
+// Nodes get 0 to 6 children, breadth first, until there are n of them.
+Scene make_scene(std::size_t n) {
+    Scene scene;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> u(-1.f, 1.f);
+    std::uniform_int_distribution<int> fanout(0, 6);
+    scene.children.resize(n);
+    for (auto i = 0u; i < n; i++) {
+        scene.locals.push_back(cml::translate(
+            cml::rotate(cml::Mat4f::identity(), u(rng),
+                        cml::Vec3f(0.f, 0.f, 1.f)),
+            cml::Vec3f(u(rng), u(rng), u(rng))));
+    }
+    scene.parents.push_back(cml::TransformHierarchy<float>::no_parent);
+    for (std::uint32_t next = 0; scene.parents.size() < n; next++) {
+        const auto count = next == 0 ? 64 : fanout(rng);
+        for (auto c = 0; c < count && scene.parents.size() < n; c++) {
+            scene.children[next].push_back(
+                static_cast<std::uint32_t>(scene.parents.size()));
+            scene.parents.push_back(next);
+        }
+    }
+    return scene;
+}
+
+void walk(const Scene &scene, std::uint32_t node, const cml::Mat4f &parent,
+          std::vector<cml::Mat4f> &world) {
+    world[node] = parent * scene.locals[node];
+    for (const auto child : scene.children[node]) {
+        walk(scene, child, world[node], world);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 500'000);
+    const auto scene = make_scene(n);
+
+    std::vector<cml::Mat4f> world(n);
+    report("recursive walk, Matrix::operator*", best_seconds([&] {
+               walk(scene, 0, cml::Mat4f::identity(), world);
+               do_not_optimize(world);
+           }),
+           n, "node");
+
+    cml::TransformHierarchy<float> hierarchy;
+    for (auto i = 0u; i < n; i++) {
+        hierarchy.add(scene.parents[i], scene.locals[i]);
+    }
+    hierarchy.update();
+
+    report("set_local on every node", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   hierarchy.set_local(i, scene.locals[i]);
+               }
+           }),
+           n, "node");
+    report("hierarchy update, all nodes dirty", best_seconds([&] {
+               for (auto i = 0u; i < n; i++) {
+                   hierarchy.set_local(i, scene.locals[i]);
+               }
+               hierarchy.update();
+           }),
+           n, "node");
+
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<std::uint32_t> pick(
+        0, static_cast<std::uint32_t>(n - 1));
+    std::vector<std::uint32_t> moved(n / 100);
+    for (auto &id : moved) {
+        id = pick(rng);
+    }
+    report("hierarchy, 1% of nodes dirty", best_seconds([&] {
+               for (const auto id : moved) {
+                   hierarchy.set_local(id, scene.locals[id]);
+               }
+               hierarchy.update();
+           }),
+           n, "node");
+    std::printf("recomputed %zu of %zu nodes over %u levels\n",
+                hierarchy.last_update_stats().recomputed, n,
+                hierarchy.last_update_stats().levels);
+
+    report("hierarchy, one node below the root dirty", best_seconds([&] {
+               hierarchy.set_local(1, scene.locals[1]);
+               hierarchy.update();
+           }),
+           n, "node");
+    std::printf("recomputed %zu of %zu nodes\n",
+                hierarchy.last_update_stats().recomputed, n);
+    return 0;
+}
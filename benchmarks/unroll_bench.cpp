@@ -0,0 +1,128 @@
+#include "bench_common.hpp"
+#include "matrix.hpp"
+#include "vector.hpp"
+#include <vector>
+
+// Compares the static_for based Vec/Matrix kernels with the equivalent
+// runtime loops. Meant to be built without optimizations (see
+// CMakeLists.txt), where the loops are not unrolled by the compiler.
+
+namespace loops {
+
+cml::Vec3f add(cml::Vec3f lhs, const cml::Vec3f &rhs) {
+    for (unsigned int i = 0; i < 3; i++) {
+        lhs[i] += rhs[i];
+    }
+    return lhs;
+}
+
+float dot(const cml::Vec3f &lhs, const cml::Vec3f &rhs) {
+    float sum = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        sum += lhs[i] * rhs[i];
+    }
+    return sum;
+}
+
+template <unsigned int N>
+cml::Matrix<N, N, float> multiply(const cml::Matrix<N, N, float> &a,
+                                  const cml::Matrix<N, N, float> &b) {
+    cml::Matrix<N, N, float> r;
+    for (unsigned int col = 0; col < N; col++) {
+        for (unsigned int row = 0; row < N; row++) {
+            float sum = 0;
+            for (unsigned int k = 0; k < N; k++) {
+                sum += a.get(row, k) * b.get(k, col);
+            }
+            r.get(row, col) = sum;
+        }
+    }
+    return r;
+}
+
+} // namespace loops
+
+int main(int argc, char **argv) {
+    const auto n = size_arg(argc, argv, 1 << 20);
+
+    std::vector<cml::Vec3f> vecs(n);
+    for (auto i = 0u; i < n; i++) {
+        vecs[i] = cml::Vec3f(float(i % 7), float(i % 11), float(i % 13));
+    }
+
+    cml::Vec3f acc;
+    report("Vec3f add (loop)", best_seconds([&] {
+               for (const auto &v : vecs) {
+                   acc = loops::add(acc, v);
+               }
+               do_not_optimize(acc);
+           }),
+           n);
+    report("Vec3f add (static_for)", best_seconds([&] {
+               for (const auto &v : vecs) {
+                   acc = acc + v;
+               }
+               do_not_optimize(acc);
+           }),
+           n);
+
+    float sum = 0;
+    report("Vec3f dot (loop)", best_seconds([&] {
+               for (const auto &v : vecs) {
+                   sum += loops::dot(v, v);
+               }
+               do_not_optimize(sum);
+           }),
+           n);
+    report("Vec3f dot (static_for)", best_seconds([&] {
+               for (const auto &v : vecs) {
+                   sum += v.dot(v);
+               }
+               do_not_optimize(sum);
+           }),
+           n);
+    report("Vec3f cross", best_seconds([&] {
+               for (const auto &v : vecs) {
+                   acc = acc.cross(v);
+               }
+               do_not_optimize(acc);
+           }),
+           n);
+
+    const auto mats = n / 16;
+    cml::Mat3f m3 = cml::Mat3f::identity();
+    const cml::Mat3f r3 = {0.f, -1.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+    report("Mat3f * Mat3f (loop)", best_seconds([&] {
+               for (auto i = 0u; i < mats; i++) {
+                   m3 = loops::multiply(m3, r3);
+               }
+               do_not_optimize(m3);
+           }),
+           mats);
+    report("Mat3f * Mat3f (static_for)", best_seconds([&] {
+               for (auto i = 0u; i < mats; i++) {
+                   m3 = m3 * r3;
+               }
+               do_not_optimize(m3);
+           }),
+           mats);
+
+    cml::Mat4f m4 = cml::Mat4f::identity();
+    const cml::Mat4f r4 = {0.f, -1.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f,
+                           0.f, 0.f,  1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+    report("Mat4f * Mat4f (loop)", best_seconds([&] {
+               for (auto i = 0u; i < mats; i++) {
+                   m4 = loops::multiply(m4, r4);
+               }
+               do_not_optimize(m4);
+           }),
+           mats);
+    report("Mat4f * Mat4f (static_for)", best_seconds([&] {
+               for (auto i = 0u; i < mats; i++) {
+                   m4 = m4 * r4;
+               }
+               do_not_optimize(m4);
+           }),
+           mats);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "common.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace cml {
+
+// Axis-aligned bounding box. A default constructed box is empty (min is
+// +max, max is lowest), so expanding it by anything yields that thing.
+template <arithmetic T> struct Aabb {
+    Vec3<T> min;
+    Vec3<T> max;
+
+    constexpr Aabb()
+        : min(std::numeric_limits<T>::max(), std::numeric_limits<T>::max(),
+              std::numeric_limits<T>::max()),
+          max(std::numeric_limits<T>::lowest(),
+              std::numeric_limits<T>::lowest(),
+              std::numeric_limits<T>::lowest()) {}
+    constexpr Aabb(const Vec3<T> &min, const Vec3<T> &max)
+        : min(min), max(max) {}
+
+    constexpr bool empty() const {
+        return min.x() > max.x() || min.y() > max.y() || min.z() > max.z();
+    }
+
+    constexpr void expand(const Vec3<T> &p) {
+        static_for<3>([&](unsigned int i) CML_ALWAYS_INLINE {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        });
+    }
+
+    constexpr void expand(const Aabb &box) {
+        static_for<3>([&](unsigned int i) CML_ALWAYS_INLINE {
+            min[i] = std::min(min[i], box.min[i]);
+            max[i] = std::max(max[i], box.max[i]);
+        });
+    }
+
+    constexpr Vec3<T> center() const { return (min + max) / T(2); }
+    constexpr Vec3<T> extent() const { return max - min; }
+
+    constexpr T surface_area() const {
+        if (empty()) {
+            return T(0);
+        }
+        const auto e = extent();
+        return 2 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+    }
+
+    constexpr unsigned int longest_axis() const {
+        const auto e = extent();
+        return e.x() >= e.y() ? (e.x() >= e.z() ? 0 : 2)
+                              : (e.y() >= e.z() ? 1 : 2);
+    }
+
+    constexpr bool contains(const Vec3<T> &p) const {
+        return p.x() >= min.x() && p.x() <= max.x() && p.y() >= min.y() &&
+               p.y() <= max.y() && p.z() >= min.z() && p.z() <= max.z();
+    }
+
+    constexpr bool overlaps(const Aabb &box) const {
+        return min.x() <= box.max.x() && max.x() >= box.min.x() &&
+               min.y() <= box.max.y() && max.y() >= box.min.y() &&
+               min.z() <= box.max.z() && max.z() >= box.min.z();
+    }
+
+    constexpr Vec3<T> closest_point(const Vec3<T> &p) const {
+        return {std::clamp(p.x(), min.x(), max.x()),
+                std::clamp(p.y(), min.y(), max.y()),
+                std::clamp(p.z(), min.z(), max.z())};
+    }
+
+    constexpr T distance_sq(const Vec3<T> &p) const {
+        const auto d = closest_point(p) - p;
+        return d.dot(d);
+    }
+
+    // Slab test against the ray origin + t * dir for t in [t_min, t_max],
+    // given inv_dir = 1 / dir. On a hit t_min is set to the entry distance.
+    constexpr bool intersect_ray(const Vec3<T> &origin, const Vec3<T> &inv_dir,
+                                 T &t_min, T t_max) const {
+        static_for<3>([&](unsigned int i) CML_ALWAYS_INLINE {
+            auto t0 = (min[i] - origin[i]) * inv_dir[i];
+            auto t1 = (max[i] - origin[i]) * inv_dir[i];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+        });
+        return t_min <= t_max;
+    }
+};
+
+template <arithmetic T>
+constexpr bool operator==(const Aabb<T> &lhs, const Aabb<T> &rhs) {
+    return lhs.min == rhs.min && lhs.max == rhs.max;
+}
+
+using Aabbf = Aabb<float>;
+using Aabbd = Aabb<double>;
+
+} // namespace cml
@@ -0,0 +1,296 @@
+#pragma once
+#include "common.hpp"
+#include "mapped_file.hpp"
+#include "matrix.hpp"
+#include "vector.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Binary container (.cmlb) for large arrays of Vec and Matrix.
+//
+// Layout: a fixed 64 byte BinaryHeader followed by padding up to
+// `data_offset` (a multiple of the recorded alignment) and then `count`
+// tightly packed elements in native layout. The reader maps the file and
+// hands out spans straight into the mapping, so nothing is copied and pages
+// are only faulted in once they are touched.
+
+namespace cml {
+
+class BinaryFormatError : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+enum class BinaryScalar : std::uint8_t {
+    signed_int = 1,
+    unsigned_int = 2,
+    floating = 3,
+};
+
+enum class BinaryKind : std::uint8_t {
+    vec = 1,
+    matrix = 2,
+};
+
+struct BinaryHeader {
+    static constexpr std::array<char, 4> expected_magic{'C', 'M', 'L', 'B'};
+    static constexpr std::uint16_t current_version = 1;
+    static constexpr std::uint16_t endian_tag = 0x0102;
+
+    std::array<char, 4> magic;
+    std::uint16_t version;
+    std::uint16_t endianness;
+    BinaryScalar scalar;
+    std::uint8_t scalar_size;
+    BinaryKind kind;
+    std::uint8_t reserved0;
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint32_t alignment;
+    std::uint64_t count;
+    std::uint64_t element_size;
+    std::uint64_t data_offset;
+    std::array<std::uint8_t, 16> reserved1;
+};
+static_assert(sizeof(BinaryHeader) == 64);
+static_assert(std::is_trivially_copyable_v<BinaryHeader>);
+
+template <typename E> struct binary_element_traits;
+
+template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+struct binary_element_traits<Vec<T, Dim, LenT>> {
+    using scalar_type = T;
+    static constexpr BinaryKind kind = BinaryKind::vec;
+    static constexpr std::uint32_t rows = Dim;
+    static constexpr std::uint32_t cols = 1;
+};
+
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+struct binary_element_traits<Matrix<Rows, Cols, T>> {
+    using scalar_type = T;
+    static constexpr BinaryKind kind = BinaryKind::matrix;
+    static constexpr std::uint32_t rows = Rows;
+    static constexpr std::uint32_t cols = Cols;
+};
+
+template <typename E>
+concept binary_element = requires {
+    typename binary_element_traits<E>::scalar_type;
+    requires std::is_trivially_copyable_v<E>;
+    requires sizeof(E) ==
+                 sizeof(typename binary_element_traits<E>::scalar_type) *
+                     binary_element_traits<E>::rows *
+                     binary_element_traits<E>::cols;
+};
+
+template <arithmetic T> constexpr BinaryScalar binary_scalar_of() {
+    if constexpr (std::is_floating_point_v<T>) {
+        return BinaryScalar::floating;
+    } else if constexpr (std::is_signed_v<T>) {
+        return BinaryScalar::signed_int;
+    } else {
+        return BinaryScalar::unsigned_int;
+    }
+}
+
+template <binary_element E>
+BinaryHeader make_binary_header(std::uint64_t count,
+                                std::uint32_t alignment = 64) {
+    using traits = binary_element_traits<E>;
+    if (alignment < alignof(E) || !std::has_single_bit(alignment)) {
+        throw BinaryFormatError(
+            "cmlb: alignment must be a power of two >= alignof(element)");
+    }
+    BinaryHeader header{};
+    header.magic = BinaryHeader::expected_magic;
+    header.version = BinaryHeader::current_version;
+    header.endianness = BinaryHeader::endian_tag;
+    header.scalar = binary_scalar_of<typename traits::scalar_type>();
+    header.scalar_size = sizeof(typename traits::scalar_type);
+    header.kind = traits::kind;
+    header.rows = traits::rows;
+    header.cols = traits::cols;
+    header.alignment = alignment;
+    header.count = count;
+    header.element_size = sizeof(E);
+    header.data_offset =
+        (sizeof(BinaryHeader) + alignment - 1) / alignment * alignment;
+    return header;
+}
+
+inline void validate_binary_header(const BinaryHeader &header) {
+    if (header.magic != BinaryHeader::expected_magic) {
+        throw BinaryFormatError("cmlb: bad magic");
+    }
+    if (header.endianness != BinaryHeader::endian_tag) {
+        throw BinaryFormatError("cmlb: file was written with the opposite "
+                                "byte order");
+    }
+    if (header.version != BinaryHeader::current_version) {
+        throw BinaryFormatError("cmlb: unsupported version " +
+                                std::to_string(header.version));
+    }
+    if (header.data_offset < sizeof(BinaryHeader) ||
+        !std::has_single_bit(header.alignment) ||
+        header.data_offset % header.alignment != 0) {
+        throw BinaryFormatError("cmlb: corrupt data offset or alignment");
+    }
+}
+
+template <binary_element E>
+void check_binary_header_matches(const BinaryHeader &header) {
+    const auto expected = make_binary_header<E>(0, alignof(E));
+    if (header.scalar != expected.scalar ||
+        header.scalar_size != expected.scalar_size ||
+        header.kind != expected.kind || header.rows != expected.rows ||
+        header.cols != expected.cols ||
+        header.element_size != expected.element_size) {
+        throw BinaryFormatError("cmlb: element type does not match file");
+    }
+}
+
+// Streams elements to a .cmlb file in chunks so that arrays larger than
+// memory can be written. The element count in the header is patched in
+// finish() (or the destructor).
+template <binary_element E> class BinaryWriter {
+  public:
+    explicit BinaryWriter(const std::filesystem::path &path,
+                          std::uint32_t alignment = 64)
+        : m_out(path, std::ios::binary | std::ios::trunc),
+          m_header(make_binary_header<E>(0, alignment)) {
+        if (!m_out) {
+            throw BinaryFormatError("cmlb: cannot open " + path.string() +
+                                    " for writing");
+        }
+        write_header();
+        const std::string padding(m_header.data_offset - sizeof(BinaryHeader),
+                                  '\0');
+        m_out.write(padding.data(),
+                    static_cast<std::streamsize>(padding.size()));
+    }
+
+    BinaryWriter(const BinaryWriter &) = delete;
+    BinaryWriter &operator=(const BinaryWriter &) = delete;
+
+    ~BinaryWriter() {
+        if (!m_finished) {
+            try {
+                finish();
+            } catch (...) {
+            }
+        }
+    }
+
+    void append(std::span<const E> elements) {
+        m_out.write(reinterpret_cast<const char *>(elements.data()),
+                    static_cast<std::streamsize>(elements.size_bytes()));
+        if (!m_out) {
+            throw BinaryFormatError("cmlb: write failed");
+        }
+        m_header.count += elements.size();
+    }
+
+    void append(const E &element) { append(std::span<const E>(&element, 1)); }
+
+    std::uint64_t count() const { return m_header.count; }
+
+    void finish() {
+        m_finished = true;
+        m_out.seekp(0);
+        write_header();
+        m_out.close();
+        if (!m_out) {
+            throw BinaryFormatError("cmlb: failed to finalize file");
+        }
+    }
+
+  private:
+    void write_header() {
+        m_out.write(reinterpret_cast<const char *>(&m_header),
+                    sizeof(BinaryHeader));
+    }
+
+    std::ofstream m_out;
+    BinaryHeader m_header;
+    bool m_finished = false;
+};
+
+template <binary_element E>
+void write_binary(const std::filesystem::path &path,
+                  std::span<const E> elements, std::uint32_t alignment = 64) {
+    BinaryWriter<E> writer(path, alignment);
+    writer.append(elements);
+    writer.finish();
+}
+
+inline BinaryHeader read_binary_header(std::span<const std::byte> bytes) {
+    if (bytes.size() < sizeof(BinaryHeader)) {
+        throw BinaryFormatError("cmlb: file too small for header");
+    }
+    BinaryHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(BinaryHeader));
+    validate_binary_header(header);
+    return header;
+}
+
+inline BinaryHeader read_binary_header(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::array<std::byte, sizeof(BinaryHeader)> buffer{};
+    in.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    return read_binary_header(
+        std::span<const std::byte>(buffer.data(),
+                                   static_cast<std::size_t>(in.gcount())));
+}
+
+// Zero-copy view over the elements of a mapped .cmlb file.
+template <binary_element E> class MappedArray {
+  public:
+    explicit MappedArray(const std::filesystem::path &path)
+        : MappedArray(MappedFile(path)) {}
+
+    explicit MappedArray(MappedFile file) : m_file(std::move(file)) {
+        m_header = read_binary_header(m_file.bytes());
+        check_binary_header_matches<E>(m_header);
+        if (m_header.alignment < alignof(E)) {
+            throw BinaryFormatError("cmlb: data is under-aligned");
+        }
+        const auto available = m_file.size() - m_header.data_offset;
+        if (m_header.data_offset > m_file.size() ||
+            m_header.count > available / sizeof(E)) {
+            throw BinaryFormatError("cmlb: file is truncated");
+        }
+        m_elements = std::span<const E>(
+            reinterpret_cast<const E *>(m_file.bytes().data() +
+                                        m_header.data_offset),
+            static_cast<std::size_t>(m_header.count));
+    }
+
+    std::span<const E> elements() const { return m_elements; }
+    operator std::span<const E>() const { return m_elements; }
+
+    const BinaryHeader &header() const { return m_header; }
+    std::size_t size() const { return m_elements.size(); }
+    bool empty() const { return m_elements.empty(); }
+    const E &operator[](std::size_t i) const { return m_elements[i]; }
+    auto begin() const { return m_elements.begin(); }
+    auto end() const { return m_elements.end(); }
+
+    void advise(MappedFile::Access access) const { m_file.advise(access); }
+
+  private:
+    MappedFile m_file;
+    BinaryHeader m_header{};
+    std::span<const E> m_elements;
+};
+
+} // namespace cml
@@ -0,0 +1,621 @@
+#pragma once
+#include "aabb.hpp"
+#include "common.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace cml {
+
+template <std::floating_point T> struct BvhHit {
+    std::uint32_t primitive;
+    T t;
+};
+
+template <std::floating_point T> struct BvhNearest {
+    std::uint32_t primitive;
+    T distance_sq;
+};
+
+// Bounding volume hierarchy over axis-aligned boxes, built with binned SAH.
+//
+// Nodes are stored depth first: the left child of an interior node directly
+// follows it and `offset` holds the index of the right child. For leaves,
+// `count` > 0 primitives are referenced by indices()[offset, offset + count).
+// With T = float a node is 32 bytes, two per cache line.
+template <std::floating_point T = float> class Bvh {
+  public:
+    struct Node {
+        Vec3<T> min;
+        std::uint32_t offset;
+        Vec3<T> max;
+        std::uint32_t count;
+
+        bool is_leaf() const { return count > 0; }
+        Aabb<T> bounds() const { return {min, max}; }
+    };
+    static_assert(!std::is_same_v<T, float> || sizeof(Node) == 32);
+
+    static constexpr unsigned int max_bins = 32;
+
+    struct BuildOptions {
+        // Clamped to [2, max_bins].
+        unsigned int bins = 16;
+        unsigned int max_leaf_size = 4;
+        T traversal_cost = T(1);
+        T intersection_cost = T(1);
+        // Ranges with at least this many primitives bin in parallel.
+        std::size_t parallel_binning_threshold = std::size_t(1) << 16;
+    };
+
+    Bvh() = default;
+    explicit Bvh(std::span<const Aabb<T>> boxes,
+                 const BuildOptions &options = {},
+                 ThreadPool &pool = ThreadPool::global()) {
+        build(boxes, options, pool);
+    }
+
+    void build(std::span<const Aabb<T>> boxes,
+               const BuildOptions &options = {},
+               ThreadPool &pool = ThreadPool::global());
+
+    std::span<const Node> nodes() const { return m_nodes; }
+    std::span<const std::uint32_t> indices() const { return m_indices; }
+    bool empty() const { return m_nodes.empty(); }
+    Aabb<T> bounds() const {
+        return m_nodes.empty() ? Aabb<T>() : m_nodes[0].bounds();
+    }
+
+    // Closest hit along origin + t * dir for t in [0, t_max].
+    // intersect(primitive, t_max) returns the hit distance of the primitive
+    // (std::optional<T>), only hits closer than t_max are accepted.
+    template <typename F>
+    std::optional<BvhHit<T>> raycast(const Vec3<T> &origin,
+                                     const Vec3<T> &dir, T t_max,
+                                     F &&intersect) const;
+
+    // Calls fn(primitive) for every primitive whose leaf box overlaps `box`.
+    // Overlap with the primitive itself is for fn to check.
+    template <typename F>
+    void query_overlap(const Aabb<T> &box, F &&fn) const;
+
+    // Nearest primitive to p. distance_sq(primitive) returns the squared
+    // distance from p to that primitive; only primitives closer than
+    // max_distance_sq are considered.
+    template <typename F>
+    std::optional<BvhNearest<T>>
+    closest(const Vec3<T> &p, F &&distance_sq,
+            T max_distance_sq = std::numeric_limits<T>::infinity()) const;
+
+  private:
+    static constexpr unsigned int max_stack = 64;
+    // From this depth on, ranges are split at the centroid median instead of
+    // by SAH, which bounds the depth (and traversal stack) by
+    // max_sah_depth + 32 for up to 2^32 primitives.
+    static constexpr unsigned int max_sah_depth = 32;
+
+    struct Range {
+        std::uint32_t begin;
+        std::uint32_t end;
+        Aabb<T> bounds;
+        Aabb<T> centroid_bounds;
+        unsigned int depth = 0;
+    };
+
+    std::pair<Range, Range> split_median(const Range &range);
+
+    // Build-time copy of a primitive box. The builder partitions these
+    // in place, so binning and partitioning stream through memory instead
+    // of chasing indices.
+    struct Primitive {
+        Vec3<T> min;
+        std::uint32_t index;
+        Vec3<T> max;
+
+        Vec3<T> centroid() const { return (min + max) * T(0.5); }
+        Aabb<T> bounds() const { return {min, max}; }
+    };
+
+    struct Split {
+        unsigned int axis = 0;
+        unsigned int bin = 0;
+        T cost = std::numeric_limits<T>::infinity();
+        Aabb<T> left_bounds;
+        Aabb<T> right_bounds;
+    };
+
+    // Trivially constructible so that only the bins in use get initialized.
+    struct Bin {
+        std::array<T, 3> min;
+        std::array<T, 3> max;
+        std::uint32_t count;
+
+        void reset() {
+            min.fill(std::numeric_limits<T>::max());
+            max.fill(std::numeric_limits<T>::lowest());
+            count = 0;
+        }
+        void expand(const Vec3<T> &lo, const Vec3<T> &hi) {
+            static_for<3>([&](unsigned int i) CML_ALWAYS_INLINE {
+                min[i] = std::min(min[i], lo[i]);
+                max[i] = std::max(max[i], hi[i]);
+            });
+        }
+        Aabb<T> bounds() const {
+            return {Vec3<T>(min[0], min[1], min[2]),
+                    Vec3<T>(max[0], max[1], max[2])};
+        }
+    };
+
+    // Node of the top of the tree, built before the subtrees are handed out
+    // to the pool. Either both children or `task` are set.
+    struct TopNode {
+        Aabb<T> bounds;
+        int left = -1;
+        int right = -1;
+        int task = -1;
+    };
+
+    std::optional<Split> find_split(const Range &range,
+                                    const BuildOptions &options,
+                                    ThreadPool *pool) const;
+    std::pair<Range, Range> split_range(const Range &range,
+                                        const BuildOptions &options,
+                                        ThreadPool *pool);
+    void build_subtree(const Range &range, const BuildOptions &options,
+                       std::vector<Node> &out);
+    int build_top(const Range &range, std::size_t task_size,
+                  const BuildOptions &options, ThreadPool &pool,
+                  std::vector<TopNode> &top, std::vector<Range> &tasks);
+    void flatten_top(const std::vector<TopNode> &top, int index,
+                     const std::vector<std::vector<Node>> &subtrees);
+
+    std::vector<Node> m_nodes;
+    std::vector<std::uint32_t> m_indices;
+    std::vector<Primitive> m_prims;
+};
+
+template <std::floating_point T>
+std::optional<typename Bvh<T>::Split>
+Bvh<T>::find_split(const Range &range, const BuildOptions &options,
+                   ThreadPool *pool) const {
+    const auto count = range.end - range.begin;
+    const auto bins = std::clamp(std::min(options.bins, count), 2u, max_bins);
+    const auto extent = range.centroid_bounds.extent();
+    std::array<T, 3> scale{};
+    for (auto a = 0u; a < 3; a++) {
+        scale[a] = extent[a] > 0 ? T(bins) / extent[a] : T(0);
+    }
+
+    using BinSet = std::array<Bin, 3 * max_bins>;
+    const auto bin_range = [&](std::uint32_t first, std::uint32_t last,
+                               BinSet &out) {
+        for (auto i = first; i < last; i++) {
+            const auto &prim = m_prims[i];
+            const auto c = prim.centroid();
+            for (auto a = 0u; a < 3; a++) {
+                const auto b = std::min(
+                    bins - 1, static_cast<unsigned int>(
+                                  (c[a] - range.centroid_bounds.min[a]) *
+                                  scale[a]));
+                auto &bin = out[a * bins + b];
+                bin.expand(prim.min, prim.max);
+                bin.count++;
+            }
+        }
+    };
+
+    const auto reset = [&](BinSet &set) {
+        for (auto b = 0u; b < 3 * bins; b++) {
+            set[b].reset();
+        }
+    };
+
+    BinSet binned;
+    reset(binned);
+    if (pool != nullptr && count >= options.parallel_binning_threshold) {
+        constexpr std::size_t grain = 1 << 14;
+        const auto chunks = (count + grain - 1) / grain;
+        std::vector<BinSet> partial(chunks);
+        pool->parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+            const auto first = range.begin + c * grain;
+            const auto last = std::min<std::size_t>(first + grain, range.end);
+            reset(partial[c]);
+            bin_range(static_cast<std::uint32_t>(first),
+                      static_cast<std::uint32_t>(last), partial[c]);
+        });
+        for (const auto &part : partial) {
+            for (auto b = 0u; b < 3 * bins; b++) {
+                binned[b].expand(Vec3<T>(part[b].min[0], part[b].min[1],
+                                         part[b].min[2]),
+                                 Vec3<T>(part[b].max[0], part[b].max[1],
+                                         part[b].max[2]));
+                binned[b].count += part[b].count;
+            }
+        }
+    } else {
+        bin_range(range.begin, range.end, binned);
+    }
+
+    std::optional<Split> best;
+    const auto parent_area = range.bounds.surface_area();
+    std::array<T, max_bins> right_cost{};
+    for (auto a = 0u; a < 3; a++) {
+        if (scale[a] == T(0)) {
+            continue;
+        }
+        const auto *axis_bins = &binned[a * bins];
+        Aabb<T> right;
+        std::uint32_t right_count = 0;
+        for (auto b = bins - 1; b > 0; b--) {
+            right.expand(axis_bins[b].bounds());
+            right_count += axis_bins[b].count;
+            right_cost[b] = right.surface_area() * T(right_count);
+        }
+        Aabb<T> left;
+        std::uint32_t left_count = 0;
+        for (auto b = 1u; b < bins; b++) {
+            left.expand(axis_bins[b - 1].bounds());
+            left_count += axis_bins[b - 1].count;
+            if (left_count == 0 || left_count == count) {
+                continue;
+            }
+            const auto cost =
+                options.traversal_cost +
+                options.intersection_cost *
+                    (left.surface_area() * T(left_count) + right_cost[b]) /
+                    std::max(parent_area, std::numeric_limits<T>::min());
+            if (!best || cost < best->cost) {
+                best = Split{a, b, cost, {}, {}};
+            }
+        }
+    }
+    if (best) {
+        const auto *axis_bins = &binned[best->axis * bins];
+        for (auto b = 0u; b < bins; b++) {
+            auto &bounds =
+                b < best->bin ? best->left_bounds : best->right_bounds;
+            bounds.expand(axis_bins[b].bounds());
+        }
+    }
+    return best;
+}
+
+// Splits a range in two. Returns an empty right range when the range should
+// become a leaf.
+template <std::floating_point T>
+std::pair<typename Bvh<T>::Range, typename Bvh<T>::Range>
+Bvh<T>::split_range(const Range &range, const BuildOptions &options,
+                    ThreadPool *pool) {
+    const auto count = range.end - range.begin;
+    if (count <= 1) {
+        return {range, Range{range.end, range.end, {}, {}}};
+    }
+    const auto split = find_split(range, options, pool);
+    const auto leaf_cost = options.intersection_cost * T(count);
+    if (count <= options.max_leaf_size &&
+        (!split || leaf_cost <= split->cost)) {
+        return {range, Range{range.end, range.end, {}, {}}};
+    }
+
+    if (!split || range.depth >= max_sah_depth) {
+        return split_median(range);
+    }
+
+    const auto bins = std::clamp(std::min(options.bins, count), 2u, max_bins);
+    const auto axis = split->axis;
+    const auto lo = range.centroid_bounds.min[axis];
+    const auto scale = T(bins) / range.centroid_bounds.extent()[axis];
+    auto *first = m_prims.data() + range.begin;
+    auto *last = m_prims.data() + range.end;
+    auto *mid = std::partition(first, last, [&](const Primitive &prim) {
+        const auto c = (prim.min[axis] + prim.max[axis]) * T(0.5);
+        const auto b =
+            std::min(bins - 1, static_cast<unsigned int>((c - lo) * scale));
+        return b < split->bin;
+    });
+    const auto mid_index = static_cast<std::uint32_t>(mid - m_prims.data());
+    Range left{range.begin, mid_index, split->left_bounds, {}, range.depth + 1};
+    Range right{mid_index, range.end, split->right_bounds, {}, range.depth + 1};
+    for (auto *r : {&left, &right}) {
+        for (auto i = r->begin; i < r->end; i++) {
+            r->centroid_bounds.expand(m_prims[i].centroid());
+        }
+    }
+    return {left, right};
+}
+
+// Object median split along the longest centroid axis. Also used when all
+// centroids coincide, where it degenerates to splitting by index order.
+template <std::floating_point T>
+std::pair<typename Bvh<T>::Range, typename Bvh<T>::Range>
+Bvh<T>::split_median(const Range &range) {
+    const auto axis = range.centroid_bounds.longest_axis();
+    const auto mid = range.begin + (range.end - range.begin) / 2;
+    std::nth_element(m_prims.data() + range.begin, m_prims.data() + mid,
+                     m_prims.data() + range.end,
+                     [&](const Primitive &a, const Primitive &b) {
+                         return a.min[axis] + a.max[axis] <
+                                b.min[axis] + b.max[axis];
+                     });
+    Range left{range.begin, mid, {}, {}, range.depth + 1};
+    Range right{mid, range.end, {}, {}, range.depth + 1};
+    for (auto *r : {&left, &right}) {
+        for (auto i = r->begin; i < r->end; i++) {
+            r->bounds.expand(m_prims[i].bounds());
+            r->centroid_bounds.expand(m_prims[i].centroid());
+        }
+    }
+    return {left, right};
+}
+
+template <std::floating_point T>
+void Bvh<T>::build_subtree(const Range &root, const BuildOptions &options,
+                           std::vector<Node> &out) {
+    struct Pending {
+        Range range;
+        std::size_t parent;
+    };
+    std::vector<Pending> stack{{root, std::numeric_limits<std::size_t>::max()}};
+    while (!stack.empty()) {
+        const auto [range, parent] = stack.back();
+        stack.pop_back();
+        if (parent != std::numeric_limits<std::size_t>::max()) {
+            out[parent].offset = static_cast<std::uint32_t>(out.size());
+        }
+        const auto index = out.size();
+        out.push_back(Node{range.bounds.min, range.begin, range.bounds.max,
+                           range.end - range.begin});
+        const auto [left, right] = split_range(range, options, nullptr);
+        if (right.begin == right.end) {
+            continue;
+        }
+        out[index].count = 0;
+        // The right child is pushed first so that the left child is emitted
+        // directly after its parent.
+        stack.push_back({right, index});
+        stack.push_back({left, std::numeric_limits<std::size_t>::max()});
+    }
+}
+
+template <std::floating_point T>
+int Bvh<T>::build_top(const Range &range, std::size_t task_size,
+                      const BuildOptions &options, ThreadPool &pool,
+                      std::vector<TopNode> &top, std::vector<Range> &tasks) {
+    const auto index = static_cast<int>(top.size());
+    top.push_back(TopNode{range.bounds});
+    const auto count = range.end - range.begin;
+    std::pair<Range, Range> children;
+    if (count > task_size) {
+        children = split_range(range, options, &pool);
+    }
+    if (count <= task_size || children.second.begin == children.second.end) {
+        top[index].task = static_cast<int>(tasks.size());
+        tasks.push_back(range);
+        return index;
+    }
+    const auto left =
+        build_top(children.first, task_size, options, pool, top, tasks);
+    const auto right =
+        build_top(children.second, task_size, options, pool, top, tasks);
+    top[index].left = left;
+    top[index].right = right;
+    return index;
+}
+
+template <std::floating_point T>
+void Bvh<T>::flatten_top(const std::vector<TopNode> &top, int index,
+                         const std::vector<std::vector<Node>> &subtrees) {
+    const auto &node = top[index];
+    if (node.task >= 0) {
+        const auto base = static_cast<std::uint32_t>(m_nodes.size());
+        for (auto sub : subtrees[node.task]) {
+            if (!sub.is_leaf()) {
+                sub.offset += base;
+            }
+            m_nodes.push_back(sub);
+        }
+        return;
+    }
+    const auto self = m_nodes.size();
+    m_nodes.push_back(Node{node.bounds.min, 0, node.bounds.max, 0});
+    flatten_top(top, node.left, subtrees);
+    m_nodes[self].offset = static_cast<std::uint32_t>(m_nodes.size());
+    flatten_top(top, node.right, subtrees);
+}
+
+template <std::floating_point T>
+void Bvh<T>::build(std::span<const Aabb<T>> boxes, const BuildOptions &options,
+                   ThreadPool &pool) {
+    m_nodes.clear();
+    m_indices.resize(boxes.size());
+    m_prims.resize(boxes.size());
+    if (boxes.empty()) {
+        return;
+    }
+
+    constexpr std::size_t grain = 1 << 14;
+    const auto chunks = (boxes.size() + grain - 1) / grain;
+    std::vector<Range> partial(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        const auto first = c * grain;
+        const auto last = std::min(first + grain, boxes.size());
+        for (auto i = first; i < last; i++) {
+            m_prims[i] = Primitive{boxes[i].min, static_cast<std::uint32_t>(i),
+                                   boxes[i].max};
+            partial[c].bounds.expand(boxes[i]);
+            partial[c].centroid_bounds.expand(m_prims[i].centroid());
+        }
+    });
+    Range root{0, static_cast<std::uint32_t>(boxes.size()), {}, {}};
+    for (const auto &part : partial) {
+        root.bounds.expand(part.bounds);
+        root.centroid_bounds.expand(part.centroid_bounds);
+    }
+
+    // The top of the tree is split serially (with parallel binning) until
+    // there are enough independent subtrees to keep the pool busy.
+    const auto task_size =
+        std::max<std::size_t>(boxes.size() / (8 * pool.size()), 1 << 12);
+    std::vector<TopNode> top;
+    std::vector<Range> tasks;
+    build_top(root, task_size, options, pool, top, tasks);
+
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    pool.parallel_for_each(0, tasks.size(), 1, [&](std::size_t t) {
+        build_subtree(tasks[t], options, subtrees[t]);
+    });
+
+    std::size_t total = top.size();
+    for (const auto &subtree : subtrees) {
+        total += subtree.size();
+    }
+    m_nodes.reserve(total);
+    flatten_top(top, 0, subtrees);
+
+    pool.parallel_for(0, m_prims.size(), grain,
+                      [&](std::size_t first, std::size_t last) {
+                          for (auto i = first; i < last; i++) {
+                              m_indices[i] = m_prims[i].index;
+                          }
+                      });
+    m_prims.clear();
+    m_prims.shrink_to_fit();
+}
+
+template <std::floating_point T>
+template <typename F>
+std::optional<BvhHit<T>> Bvh<T>::raycast(const Vec3<T> &origin,
+                                         const Vec3<T> &dir, T t_max,
+                                         F &&intersect) const {
+    std::optional<BvhHit<T>> hit;
+    if (m_nodes.empty()) {
+        return hit;
+    }
+    const Vec3<T> inv_dir(T(1) / dir.x(), T(1) / dir.y(), T(1) / dir.z());
+    std::uint32_t stack[max_stack];
+    unsigned int top = 0;
+    std::uint32_t node = 0;
+    T t_entry = 0;
+    if (!m_nodes[0].bounds().intersect_ray(origin, inv_dir, t_entry, t_max)) {
+        return hit;
+    }
+    while (true) {
+        const auto &n = m_nodes[node];
+        if (n.is_leaf()) {
+            for (auto i = n.offset; i < n.offset + n.count; i++) {
+                const std::optional<T> t = intersect(m_indices[i], t_max);
+                if (t && *t <= t_max) {
+                    t_max = *t;
+                    hit = BvhHit<T>{m_indices[i], *t};
+                }
+            }
+        } else {
+            auto near = node + 1;
+            auto far = n.offset;
+            T t_near = 0;
+            T t_far = 0;
+            bool hit_near =
+                m_nodes[near].bounds().intersect_ray(origin, inv_dir, t_near,
+                                                     t_max);
+            bool hit_far = m_nodes[far].bounds().intersect_ray(origin, inv_dir,
+                                                               t_far, t_max);
+            if (hit_near && hit_far) {
+                if (t_far < t_near) {
+                    std::swap(near, far);
+                }
+                stack[top++] = far;
+                node = near;
+                continue;
+            }
+            if (hit_near || hit_far) {
+                node = hit_near ? near : far;
+                continue;
+            }
+        }
+        if (top == 0) {
+            break;
+        }
+        node = stack[--top];
+    }
+    return hit;
+}
+
+template <std::floating_point T>
+template <typename F>
+void Bvh<T>::query_overlap(const Aabb<T> &box, F &&fn) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+    std::uint32_t stack[max_stack];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const auto &n = m_nodes[stack[--top]];
+        if (!n.bounds().overlaps(box)) {
+            continue;
+        }
+        if (n.is_leaf()) {
+            for (auto i = n.offset; i < n.offset + n.count; i++) {
+                fn(m_indices[i]);
+            }
+        } else {
+            stack[top++] = n.offset;
+            stack[top++] = static_cast<std::uint32_t>(&n - m_nodes.data()) + 1;
+        }
+    }
+}
+
+template <std::floating_point T>
+template <typename F>
+std::optional<BvhNearest<T>> Bvh<T>::closest(const Vec3<T> &p,
+                                             F &&distance_sq,
+                                             T max_distance_sq) const {
+    std::optional<BvhNearest<T>> nearest;
+    if (m_nodes.empty()) {
+        return nearest;
+    }
+    struct Entry {
+        std::uint32_t node;
+        T distance_sq;
+    };
+    Entry stack[max_stack];
+    unsigned int top = 0;
+    stack[top++] = {0, m_nodes[0].bounds().distance_sq(p)};
+    while (top > 0) {
+        const auto entry = stack[--top];
+        if (entry.distance_sq > max_distance_sq) {
+            continue;
+        }
+        const auto &n = m_nodes[entry.node];
+        if (n.is_leaf()) {
+            for (auto i = n.offset; i < n.offset + n.count; i++) {
+                const T d = distance_sq(m_indices[i]);
+                if (d <= max_distance_sq) {
+                    max_distance_sq = d;
+                    nearest = BvhNearest<T>{m_indices[i], d};
+                }
+            }
+            continue;
+        }
+        Entry near{entry.node + 1,
+                   m_nodes[entry.node + 1].bounds().distance_sq(p)};
+        Entry far{n.offset, m_nodes[n.offset].bounds().distance_sq(p)};
+        if (far.distance_sq < near.distance_sq) {
+            std::swap(near, far);
+        }
+        stack[top++] = far;
+        stack[top++] = near;
+    }
+    return nearest;
+}
+
+} // namespace cml
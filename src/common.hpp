@@ -7,6 +7,21 @@ namespace cml {
 template <typename T>
 concept arithmetic = std::is_arithmetic_v<T>;
 
+// Element types of Vec and Matrix: the arithmetic types, and number-like
+// classes (such as Dual) with the field operators, comparison, and an
+// implicit conversion from the arithmetic types.
+template <typename T>
+concept scalar = arithmetic<T> || (std::is_class_v<T> &&
+                                   std::is_convertible_v<int, T> &&
+                                   requires(T a, T b) {
+                                       { -a } -> std::convertible_to<T>;
+                                       { a + b } -> std::convertible_to<T>;
+                                       { a - b } -> std::convertible_to<T>;
+                                       { a * b } -> std::convertible_to<T>;
+                                       { a / b } -> std::convertible_to<T>;
+                                       { a == b } -> std::convertible_to<bool>;
+                                   });
+
 using default_type = double;
 
 } // namespace cml
@@ -0,0 +1,804 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "morton.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch_ops.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Convex hulls of Vec2d and Vec3d point sets, returned as indices into the
+// input (which must hold fewer than 2^32 points). All decisions go through
+// the exact predicates of predicates.hpp, so the hull is exact for any
+// input: collinear and coplanar points, duplicates and grids included.
+//
+// Both hulls start with Akl and Toussaint's prefilter: the points extreme
+// in a few fixed directions (8 in 2D, the octagon; the 6 axes and 8
+// diagonals in 3D), taken over a sample of the input, span a polygon
+// (polytope) inside the hull, and the points certainly strictly inside it
+// are dropped, SIMD across points on the pool: first by an axis-aligned box
+// inside the polygon, then by its edges (faces). For uniformly spread
+// clouds this leaves a small fraction of the input.
+
+namespace cml {
+
+// A 3D hull as triangles, counterclockwise seen from outside: orient3d(a, b,
+// c, p) >= 0 for every face (a, b, c) and input point p. Faces of coplanar
+// hull points are triangulated arbitrarily.
+struct ConvexHull3 {
+    // The points the faces use, ascending: the hull vertices, and in
+    // degenerate input possibly points on hull edges or faces.
+    std::vector<std::uint32_t> vertices;
+    std::vector<std::array<std::uint32_t, 3>> faces;
+};
+
+namespace detail {
+
+inline constexpr std::size_t hull_grain = 1 << 14;
+inline constexpr std::size_t hull_assign_grain = 1 << 12;
+inline constexpr std::size_t hull_sample_size = 1 << 16;
+inline constexpr std::uint32_t hull_none =
+    std::numeric_limits<std::uint32_t>::max();
+
+// Counterclockwise, starting at -x.
+inline constexpr std::array<std::array<double, 2>, 8> octagon_directions{
+    {{-1, 0}, {-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}}};
+
+inline constexpr std::array<std::array<double, 3>, 14> polytope_directions{
+    {{-1, 0, 0},
+     {1, 0, 0},
+     {0, -1, 0},
+     {0, 1, 0},
+     {0, 0, -1},
+     {0, 0, 1},
+     {-1, -1, -1},
+     {-1, -1, 1},
+     {-1, 1, -1},
+     {-1, 1, 1},
+     {1, -1, -1},
+     {1, -1, 1},
+     {1, 1, -1},
+     {1, 1, 1}}};
+
+// x[d][l] = points[l][d], repeating the first point past lanes.
+template <unsigned int Dim, typename LenT>
+CML_ALWAYS_INLINE inline void
+load_points(const Vec<double, Dim, LenT> *points, std::size_t lanes,
+            std::array<Lanes<double>, std::size_t{Dim}> &x) {
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        if (lanes == batch_lanes) {
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                x[d][l] = points[l][d];
+            }
+        } else {
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                x[d][l] = points[l < lanes ? l : 0][d];
+            }
+        }
+    });
+}
+
+// For each direction, the smallest index of a point maximizing its dot
+// product with the direction. Every lane keeps its own maximum, so the
+// blocks vectorize; indices are carried as doubles alongside.
+template <unsigned int Dim, std::size_t Count, typename LenT>
+std::array<std::uint32_t, Count> extreme_points(
+    std::span<const Vec<double, Dim, LenT>> points,
+    const std::array<std::array<double, std::size_t{Dim}>, Count> &directions,
+    ThreadPool &pool) {
+    struct Extremes {
+        std::array<double, Count> value;
+        std::array<double, Count> index;
+    };
+    const auto merge = [](Extremes &a, double value, double index,
+                          std::size_t k) {
+        if (value > a.value[k] || (value == a.value[k] && index < a.index[k])) {
+            a.value[k] = value;
+            a.index[k] = index;
+        }
+    };
+    const auto chunks = (points.size() + hull_grain - 1) / hull_grain;
+    std::vector<Extremes> partial(chunks);
+    const auto isa = active_isa();
+    pool.parallel_for(0, points.size(), hull_grain, [&](std::size_t first,
+                                                        std::size_t last) {
+        run_with_isa(isa, [&] {
+            std::array<Lanes<double>, Count> value, index;
+            for (auto &v : value) {
+                v.fill(std::numeric_limits<double>::lowest());
+            }
+            for (auto &v : index) {
+                v.fill(0.0);
+            }
+            for (auto base = first; base < last; base += batch_lanes) {
+                const auto lanes = std::min(batch_lanes, last - base);
+                std::array<Lanes<double>, Dim> x;
+                load_points(points.data() + base, lanes, x);
+                Lanes<double> at;
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    at[l] = static_cast<double>(base + l);
+                }
+                static_for<Count>([&](unsigned int k) CML_ALWAYS_INLINE {
+                    for (std::size_t l = 0; l < batch_lanes; l++) {
+                        double s = 0;
+                        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                            s += directions[k][d] * x[d][l];
+                        });
+                        const auto best = value[k][l];
+                        const auto i = index[k][l];
+                        value[k][l] = s > best ? s : best;
+                        index[k][l] = s > best ? at[l] : i;
+                    }
+                });
+            }
+            auto &result = partial[first / hull_grain];
+            result.value.fill(std::numeric_limits<double>::lowest());
+            result.index.fill(0.0);
+            for (std::size_t k = 0; k < Count; k++) {
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    merge(result, value[k][l], index[k][l], k);
+                }
+            }
+        });
+    });
+    std::array<std::uint32_t, Count> extremes{};
+    if (chunks == 0) {
+        return extremes;
+    }
+    auto total = partial[0];
+    for (std::size_t c = 1; c < chunks; c++) {
+        for (std::size_t k = 0; k < Count; k++) {
+            merge(total, partial[c].value[k], partial[c].index[k], k);
+        }
+    }
+    for (std::size_t k = 0; k < Count; k++) {
+        extremes[k] = static_cast<std::uint32_t>(total.index[k]);
+    }
+    return extremes;
+}
+
+// extreme_points() over every stride-th point, about hull_sample_size of
+// them. Any input points span a region inside the hull, so sampling only
+// costs some filtering power, and saves a pass over the input.
+template <unsigned int Dim, std::size_t Count, typename LenT>
+std::array<std::uint32_t, Count> sampled_extreme_points(
+    std::span<const Vec<double, Dim, LenT>> points,
+    const std::array<std::array<double, std::size_t{Dim}>, Count> &directions,
+    ThreadPool &pool) {
+    const auto stride =
+        std::max<std::size_t>(points.size() / hull_sample_size, 1);
+    if (stride == 1) {
+        return extreme_points(points, directions, pool);
+    }
+    std::vector<Vec<double, Dim, LenT>> sample(points.size() / stride);
+    for (std::size_t j = 0; j < sample.size(); j++) {
+        sample[j] = points[j * stride];
+    }
+    auto extremes = extreme_points(
+        std::span<const Vec<double, Dim, LenT>>(sample), directions, pool);
+    for (auto &i : extremes) {
+        i = static_cast<std::uint32_t>(i * stride);
+    }
+    return extremes;
+}
+
+// An axis-aligned box, open on all sides; empty by default.
+template <unsigned int Dim> struct InnerBox {
+    std::array<double, Dim> lo{};
+    std::array<double, Dim> hi{};
+};
+
+// A box strictly inside the convex hull of corners: centered at their mean
+// and shrunk until strictly_inside() holds for all of its corners, which
+// by convexity puts all of it inside. Empty if that takes too long.
+template <unsigned int Dim, typename LenT, typename StrictlyInside>
+InnerBox<Dim> inner_box(const std::vector<Vec<double, Dim, LenT>> &corners,
+                        StrictlyInside &&strictly_inside) {
+    std::array<double, Dim> center{}, lo, hi;
+    lo.fill(std::numeric_limits<double>::max());
+    hi.fill(std::numeric_limits<double>::lowest());
+    for (const auto &c : corners) {
+        for (auto d = 0u; d < Dim; d++) {
+            center[d] += c[d] / static_cast<double>(corners.size());
+            lo[d] = std::min(lo[d], c[d]);
+            hi[d] = std::max(hi[d], c[d]);
+        }
+    }
+    for (auto scale = 1.0; scale > 0.05; scale *= 0.9) {
+        InnerBox<Dim> box;
+        for (auto d = 0u; d < Dim; d++) {
+            box.lo[d] = center[d] - (center[d] - lo[d]) * scale;
+            box.hi[d] = center[d] + (hi[d] - center[d]) * scale;
+        }
+        bool inside = true;
+        for (auto mask = 0u; mask < (1u << Dim) && inside; mask++) {
+            Vec<double, Dim, LenT> corner;
+            for (auto d = 0u; d < Dim; d++) {
+                corner[d] = (mask >> d & 1) != 0 ? box.hi[d] : box.lo[d];
+            }
+            inside = strictly_inside(corner);
+        }
+        if (inside) {
+            return box;
+        }
+    }
+    return {};
+}
+
+// Indices of the points that are not certainly strictly inside a convex
+// region, in input order. A block of points is first tested against box
+// (inside the region), and the points outside it against inside(x, in),
+// which sets in[l] to 0 unless the point with coordinates x[.][l] is
+// certainly strictly inside.
+template <unsigned int Dim, typename LenT, typename Inside>
+std::vector<std::uint32_t>
+hull_candidates(std::span<const Vec<double, Dim, LenT>> points,
+                const InnerBox<Dim> &box, ThreadPool &pool, Inside &&inside) {
+    const auto chunks = (points.size() + hull_grain - 1) / hull_grain;
+    std::vector<std::vector<std::uint32_t>> partial(chunks);
+    const auto isa = active_isa();
+    pool.parallel_for(0, points.size(), hull_grain, [&](std::size_t first,
+                                                        std::size_t last) {
+        run_with_isa(isa, [&] {
+            std::vector<std::uint32_t> uncertain;
+            for (auto base = first; base < last; base += batch_lanes) {
+                const auto lanes = std::min(batch_lanes, last - base);
+                std::array<Lanes<double>, Dim> x;
+                load_points(points.data() + base, lanes, x);
+                Lanes<double> in;
+                in.fill(1.0);
+                static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                    for (std::size_t l = 0; l < batch_lanes; l++) {
+                        const auto v = x[d][l];
+                        const auto was = in[l];
+                        in[l] = v > box.lo[d] && v < box.hi[d] ? was : 0.0;
+                    }
+                });
+                for (std::size_t l = 0; l < lanes; l++) {
+                    if (in[l] == 0.0) {
+                        uncertain.push_back(
+                            static_cast<std::uint32_t>(base + l));
+                    }
+                }
+            }
+            auto &kept = partial[first / hull_grain];
+            for (std::size_t b = 0; b < uncertain.size(); b += batch_lanes) {
+                const auto lanes = std::min(batch_lanes, uncertain.size() - b);
+                std::array<Lanes<double>, Dim> x;
+                static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                    for (std::size_t l = 0; l < batch_lanes; l++) {
+                        x[d][l] = points[uncertain[b + (l < lanes ? l : 0)]][d];
+                    }
+                });
+                Lanes<double> in;
+                in.fill(1.0);
+                inside(x, in);
+                for (std::size_t l = 0; l < lanes; l++) {
+                    if (in[l] == 0.0) {
+                        kept.push_back(uncertain[b + l]);
+                    }
+                }
+            }
+        });
+    });
+    std::vector<std::uint32_t> candidates;
+    for (const auto &kept : partial) {
+        candidates.insert(candidates.end(), kept.begin(), kept.end());
+    }
+    return candidates;
+}
+
+// Maps doubles to unsigned keys of the same order (-0 and 0 alike).
+inline std::uint64_t order_key(double x) {
+    const auto bits = std::bit_cast<std::uint64_t>(x + 0.0);
+    return bits >> 63 != 0 ? ~bits : bits | (std::uint64_t(1) << 63);
+}
+
+// Sorts indices by (x, y) of their points: two stable radix sorts on the
+// pool, by y and then by x.
+template <typename LenT>
+void sort_lexicographic(std::span<const Vec<double, 2, LenT>> points,
+                        std::vector<std::uint32_t> &indices,
+                        ThreadPool &pool) {
+    std::vector<std::uint64_t> keys(indices.size());
+    for (const auto d : {1u, 0u}) {
+        pool.parallel_for(0, indices.size(), hull_grain,
+                          [&](std::size_t first, std::size_t last) {
+                              for (auto i = first; i < last; i++) {
+                                  keys[i] = order_key(points[indices[i]][d]);
+                              }
+                          });
+        radix_sort_pairs(keys, indices, pool);
+    }
+}
+
+// Appends p to a monotone chain after popping the points it leaves without
+// a strict turn: left turns for turn = 1 (the lower hull, left to right),
+// right turns for turn = -1 (the upper hull).
+template <typename LenT>
+void extend_chain(std::span<const Vec<double, 2, LenT>> points,
+                  std::vector<std::uint32_t> &chain, std::uint32_t p,
+                  double turn) {
+    while (chain.size() >= 2 &&
+           orient2d(points[chain[chain.size() - 2]], points[chain.back()],
+                    points[p]) *
+                   turn <=
+               0) {
+        chain.pop_back();
+    }
+    chain.push_back(p);
+}
+
+struct HullFace {
+    std::array<std::uint32_t, 3> v;
+    // neighbor[k] shares the edge from v[k] to v[(k + 1) % 3].
+    std::array<std::uint32_t, 3> neighbor;
+    // The points strictly outside, and the farthest of them.
+    std::vector<std::uint32_t> outside;
+    std::uint32_t farthest = 0;
+    double farthest_distance = 0;
+    std::uint32_t visited = 0;
+    bool visible = false;
+    bool alive = true;
+};
+
+template <typename LenT>
+double orient_face(std::span<const Vec<double, 3, LenT>> points,
+                   const HullFace &face, std::uint32_t p) {
+    return orient3d(points[face.v[0]], points[face.v[1]], points[face.v[2]],
+                    points[p]);
+}
+
+// Moves each of pending to the outside list of the first of targets it is
+// strictly outside of, testing on the pool; the others are inside the hull
+// and dropped. The farthest point is tracked by the magnitude of orient3d,
+// which is proportional to the distance to the face's plane.
+template <typename LenT>
+void assign_outside(std::span<const Vec<double, 3, LenT>> points,
+                    std::vector<HullFace> &faces,
+                    std::span<const std::uint32_t> targets,
+                    std::span<const std::uint32_t> pending,
+                    ThreadPool &pool) {
+    std::vector<std::uint32_t> slot(pending.size(), hull_none);
+    std::vector<double> distance(pending.size());
+    pool.parallel_for(0, pending.size(), hull_assign_grain,
+                      [&](std::size_t first, std::size_t last) {
+                          for (auto i = first; i < last; i++) {
+                              for (const auto t : targets) {
+                                  const auto o =
+                                      orient_face(points, faces[t], pending[i]);
+                                  if (o < 0) {
+                                      slot[i] = t;
+                                      distance[i] = -o;
+                                      break;
+                                  }
+                              }
+                          }
+                      });
+    for (std::size_t i = 0; i < pending.size(); i++) {
+        if (slot[i] == hull_none) {
+            continue;
+        }
+        auto &face = faces[slot[i]];
+        face.outside.push_back(pending[i]);
+        if (distance[i] > face.farthest_distance) {
+            face.farthest = pending[i];
+            face.farthest_distance = distance[i];
+        }
+    }
+}
+
+template <typename LenT>
+bool collinear(const Vec<double, 3, LenT> &a, const Vec<double, 3, LenT> &b,
+               const Vec<double, 3, LenT> &c) {
+    // All three axis-aligned projections degenerate.
+    for (auto d = 0u; d < 3; d++) {
+        const auto e = (d + 1) % 3;
+        if (orient2d(Vec2d{a[d], a[e]}, Vec2d{b[d], b[e]},
+                     Vec2d{c[d], c[e]}) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Four affinely independent candidates with orient3d(s0, s1, s2, s3) > 0,
+// spread far apart, or nothing if the candidates are coplanar.
+template <typename LenT>
+std::optional<std::array<std::uint32_t, 4>>
+initial_simplex(std::span<const Vec<double, 3, LenT>> points,
+                std::span<const std::uint32_t> candidates) {
+    if (candidates.empty()) {
+        return std::nullopt;
+    }
+    // The two extremes of the widest axis.
+    std::array<std::uint32_t, 4> s{};
+    double widest = -1;
+    for (auto d = 0u; d < 3; d++) {
+        auto lo = candidates[0], hi = candidates[0];
+        for (const auto i : candidates) {
+            lo = points[i][d] < points[lo][d] ? i : lo;
+            hi = points[i][d] > points[hi][d] ? i : hi;
+        }
+        if (points[hi][d] - points[lo][d] > widest) {
+            widest = points[hi][d] - points[lo][d];
+            s[0] = lo;
+            s[1] = hi;
+        }
+    }
+    if (widest == 0) {
+        return std::nullopt;
+    }
+    const auto &a = points[s[0]];
+    const auto &b = points[s[1]];
+
+    // The candidate farthest from the line through them, checked exactly.
+    double best = -1;
+    for (const auto i : candidates) {
+        const auto &p = points[i];
+        const auto u = Vec3d{b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const auto v = Vec3d{p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+        const auto area = u.cross(v).length_sq();
+        if (area > best) {
+            best = area;
+            s[2] = i;
+        }
+    }
+    if (collinear(a, b, points[s[2]])) {
+        const auto found =
+            std::find_if(candidates.begin(), candidates.end(), [&](auto i) {
+                return !collinear(a, b, points[i]);
+            });
+        if (found == candidates.end()) {
+            return std::nullopt;
+        }
+        s[2] = *found;
+    }
+    const auto &c = points[s[2]];
+
+    // The candidate farthest from their plane.
+    best = -1;
+    for (const auto i : candidates) {
+        const auto &p = points[i];
+        const auto volume = std::abs(
+            orient3d_filter(a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1],
+                            c[2], p[0], p[1], p[2])
+                .det);
+        if (volume > best) {
+            best = volume;
+            s[3] = i;
+        }
+    }
+    if (orient3d(a, b, c, points[s[3]]) == 0) {
+        const auto found =
+            std::find_if(candidates.begin(), candidates.end(), [&](auto i) {
+                return orient3d(a, b, c, points[i]) != 0;
+            });
+        if (found == candidates.end()) {
+            return std::nullopt;
+        }
+        s[3] = *found;
+    }
+    if (orient3d(a, b, c, points[s[3]]) < 0) {
+        std::swap(s[1], s[2]);
+    }
+    return s;
+}
+
+// Quickhull (Barber, Dobkin and Huhdanpaa) over the candidates: every face
+// keeps the points strictly outside it; the farthest one of a face becomes
+// a hull vertex, the faces it sees are replaced by a cone from it to their
+// horizon, and their outside points are redistributed over the cone.
+template <typename LenT>
+std::vector<std::array<std::uint32_t, 3>>
+quickhull(std::span<const Vec<double, 3, LenT>> points,
+          std::span<const std::uint32_t> candidates, ThreadPool &pool) {
+    const auto simplex = initial_simplex(points, candidates);
+    if (!simplex) {
+        return {};
+    }
+    const auto [s0, s1, s2, s3] = *simplex;
+    std::vector<HullFace> faces(4);
+    faces[0].v = {s0, s1, s2};
+    faces[1].v = {s1, s0, s3};
+    faces[2].v = {s2, s1, s3};
+    faces[3].v = {s0, s2, s3};
+    for (auto &f : faces) {
+        for (auto k = 0u; k < 3; k++) {
+            const auto a = f.v[k], b = f.v[(k + 1) % 3];
+            for (std::uint32_t g = 0; g < 4; g++) {
+                for (auto j = 0u; j < 3; j++) {
+                    if (faces[g].v[j] == b && faces[g].v[(j + 1) % 3] == a) {
+                        f.neighbor[k] = g;
+                    }
+                }
+            }
+        }
+    }
+    std::vector<std::uint32_t> stack{0, 1, 2, 3};
+    assign_outside(points, faces, stack, candidates, pool);
+
+    struct HorizonEdge {
+        std::uint32_t a, b, outer;
+    };
+    std::vector<std::uint32_t> visible;
+    std::vector<HorizonEdge> horizon;
+    std::vector<std::uint32_t> created;
+    std::vector<std::uint32_t> pending;
+    std::vector<std::uint32_t> starting_at;
+    std::uint32_t stamp = 0;
+    while (!stack.empty()) {
+        const auto top = stack.back();
+        stack.pop_back();
+        if (!faces[top].alive || faces[top].outside.empty()) {
+            continue;
+        }
+        const auto eye = faces[top].farthest;
+
+        // The faces the eye sees strictly, from the one it was found for.
+        stamp++;
+        visible.assign(1, top);
+        faces[top].visited = stamp;
+        faces[top].visible = true;
+        horizon.clear();
+        for (std::size_t k = 0; k < visible.size(); k++) {
+            const auto f = visible[k];
+            for (auto e = 0u; e < 3; e++) {
+                const auto n = faces[f].neighbor[e];
+                auto &neighbor = faces[n];
+                if (neighbor.visited != stamp) {
+                    neighbor.visited = stamp;
+                    neighbor.visible = orient_face(points, neighbor, eye) < 0;
+                    if (neighbor.visible) {
+                        visible.push_back(n);
+                    }
+                }
+                if (!neighbor.visible) {
+                    horizon.push_back(
+                        {faces[f].v[e], faces[f].v[(e + 1) % 3], n});
+                }
+            }
+        }
+
+        // A cone of faces (a, b, eye) over the horizon edges (a, b).
+        pending.clear();
+        for (const auto f : visible) {
+            auto &face = faces[f];
+            face.alive = false;
+            for (const auto p : face.outside) {
+                if (p != eye) {
+                    pending.push_back(p);
+                }
+            }
+            std::vector<std::uint32_t>().swap(face.outside);
+        }
+        created.clear();
+        for (const auto &edge : horizon) {
+            const auto id = static_cast<std::uint32_t>(faces.size());
+            HullFace face;
+            face.v = {edge.a, edge.b, eye};
+            face.neighbor = {edge.outer, hull_none, hull_none};
+            auto &outer = faces[edge.outer];
+            for (auto j = 0u; j < 3; j++) {
+                if (outer.v[j] == edge.b && outer.v[(j + 1) % 3] == edge.a) {
+                    outer.neighbor[j] = id;
+                }
+            }
+            if (starting_at.size() < points.size()) {
+                starting_at.resize(points.size(), hull_none);
+            }
+            starting_at[edge.a] = id;
+            faces.push_back(std::move(face));
+            created.push_back(id);
+        }
+        // The horizon is a simple cycle: (a, b, eye) continues with the cone
+        // face starting at b.
+        for (const auto id : created) {
+            const auto next = starting_at[faces[id].v[1]];
+            faces[id].neighbor[1] = next;
+            faces[next].neighbor[2] = id;
+        }
+        assign_outside(points, faces, created, pending, pool);
+        for (const auto id : created) {
+            if (!faces[id].outside.empty()) {
+                stack.push_back(id);
+            }
+        }
+    }
+
+    std::vector<std::array<std::uint32_t, 3>> result;
+    for (const auto &face : faces) {
+        if (face.alive) {
+            result.push_back(face.v);
+        }
+    }
+    return result;
+}
+
+} // namespace detail
+
+// The convex hull of points as indices into points, counterclockwise from
+// the smallest point in (x, y) order. Hull vertices only: collinear points
+// on edges and duplicates are left out. Fewer than three distinct input
+// points give the distinct points in that order; collinear input gives
+// the two endpoints.
+//
+// After the octagon prefilter, the candidates are radix sorted by (x, y)
+// on the pool; chunks of them are reduced to their lower and upper chains
+// (Andrew's monotone chain) in parallel, and the concatenated chains are
+// reduced once more, since the hull vertices of the whole are hull
+// vertices of every subset holding them.
+template <std::floating_point LenT>
+std::vector<std::uint32_t>
+convex_hull(std::span<const Vec<double, 2, LenT>> points,
+            ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    if (points.empty()) {
+        return {};
+    }
+    const auto extremes = sampled_extreme_points(points, octagon_directions, pool);
+    std::vector<Vec<double, 2, LenT>> octagon;
+    for (const auto i : extremes) {
+        if (octagon.empty() || !(points[i] == octagon.back())) {
+            octagon.push_back(points[i]);
+        }
+    }
+    while (octagon.size() > 1 && octagon.back() == octagon.front()) {
+        octagon.pop_back();
+    }
+
+    std::vector<std::uint32_t> candidates;
+    if (octagon.size() >= 3) {
+        const auto box = inner_box(octagon, [&](const auto &p) {
+            for (std::size_t e = 0; e < octagon.size(); e++) {
+                if (orient2d(octagon[e], octagon[(e + 1) % octagon.size()],
+                             p) <= 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        candidates = hull_candidates(
+            points, box, pool, [&](const auto &x, Lanes<double> &in) {
+                for (std::size_t e = 0; e < octagon.size(); e++) {
+                    const auto &a = octagon[e];
+                    const auto &b = octagon[(e + 1) % octagon.size()];
+                    for (std::size_t l = 0; l < batch_lanes; l++) {
+                        const auto f = orient2d_filter(a[0], a[1], b[0], b[1],
+                                                       x[0][l], x[1][l]);
+                        const auto was = in[l];
+                        in[l] = f.det > f.bound ? was : 0.0;
+                    }
+                }
+            });
+    } else {
+        candidates.resize(points.size());
+        std::iota(candidates.begin(), candidates.end(), std::uint32_t(0));
+    }
+    sort_lexicographic(points, candidates, pool);
+
+    const auto chunks = (candidates.size() + hull_grain - 1) / hull_grain;
+    std::vector<std::vector<std::uint32_t>> lower(chunks), upper(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        const auto last = std::min(candidates.size(), (c + 1) * hull_grain);
+        for (auto i = c * hull_grain; i < last; i++) {
+            const auto p = candidates[i];
+            if (i > 0 && points[candidates[i - 1]] == points[p]) {
+                continue;
+            }
+            extend_chain(points, lower[c], p, 1.0);
+            extend_chain(points, upper[c], p, -1.0);
+        }
+    });
+    std::vector<std::uint32_t> hull, top;
+    for (std::size_t c = 0; c < chunks; c++) {
+        for (const auto p : lower[c]) {
+            extend_chain(points, hull, p, 1.0);
+        }
+        for (const auto p : upper[c]) {
+            extend_chain(points, top, p, -1.0);
+        }
+    }
+    if (hull.size() <= 1) {
+        return hull;
+    }
+    // Both chains run from the smallest to the largest point.
+    hull.pop_back();
+    for (auto i = top.size() - 1; i > 0; i--) {
+        hull.push_back(top[i]);
+    }
+    return hull;
+}
+
+template <std::floating_point LenT>
+std::vector<std::uint32_t>
+convex_hull(const std::vector<Vec<double, 2, LenT>> &points,
+            ThreadPool &pool = ThreadPool::global()) {
+    return convex_hull(std::span<const Vec<double, 2, LenT>>(points), pool);
+}
+
+// The convex hull of points by quickhull, after the prefilter with the
+// hull of the 14 extreme points. The outside points of new faces are
+// assigned on the pool. Coplanar input (including fewer than four points)
+// gives an empty hull.
+template <std::floating_point LenT>
+ConvexHull3 convex_hull(std::span<const Vec<double, 3, LenT>> points,
+                        ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    if (points.empty()) {
+        return {};
+    }
+    const auto extremes = sampled_extreme_points(points, polytope_directions, pool);
+    std::vector<std::uint32_t> corners(extremes.begin(), extremes.end());
+    std::sort(corners.begin(), corners.end());
+    corners.erase(std::unique(corners.begin(), corners.end()), corners.end());
+    const auto polytope = corners.size() >= 4
+                              ? quickhull(points, corners, pool)
+                              : std::vector<std::array<std::uint32_t, 3>>{};
+
+    std::vector<std::uint32_t> candidates;
+    if (!polytope.empty()) {
+        std::vector<Vec<double, 3, LenT>> corner_points;
+        for (const auto i : corners) {
+            corner_points.push_back(points[i]);
+        }
+        const auto box = inner_box(corner_points, [&](const auto &p) {
+            for (const auto &face : polytope) {
+                if (orient3d(points[face[0]], points[face[1]],
+                             points[face[2]], p) <= 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        candidates = hull_candidates(
+            points, box, pool, [&](const auto &x, Lanes<double> &in) {
+                for (const auto &face : polytope) {
+                    const auto &a = points[face[0]];
+                    const auto &b = points[face[1]];
+                    const auto &c = points[face[2]];
+                    for (std::size_t l = 0; l < batch_lanes; l++) {
+                        const auto f = orient3d_filter(
+                            a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1],
+                            c[2], x[0][l], x[1][l], x[2][l]);
+                        const auto was = in[l];
+                        in[l] = f.det > f.bound ? was : 0.0;
+                    }
+                }
+            });
+    } else {
+        candidates.resize(points.size());
+        std::iota(candidates.begin(), candidates.end(), std::uint32_t(0));
+    }
+
+    ConvexHull3 hull;
+    hull.faces = quickhull(points, candidates, pool);
+    for (const auto &face : hull.faces) {
+        hull.vertices.insert(hull.vertices.end(), face.begin(), face.end());
+    }
+    std::sort(hull.vertices.begin(), hull.vertices.end());
+    hull.vertices.erase(std::unique(hull.vertices.begin(), hull.vertices.end()),
+                        hull.vertices.end());
+    return hull;
+}
+
+template <std::floating_point LenT>
+ConvexHull3 convex_hull(const std::vector<Vec<double, 3, LenT>> &points,
+                        ThreadPool &pool = ThreadPool::global()) {
+    return convex_hull(std::span<const Vec<double, 3, LenT>>(points), pool);
+}
+
+} // namespace cml
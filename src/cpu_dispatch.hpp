@@ -0,0 +1,217 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CML_X86_DISPATCH 1
+#endif
+
+// Runtime selection of the instruction set used by the batch kernels.
+//
+// The library is header-only and built with whatever flags the user picks,
+// usually a baseline that runs everywhere. Kernels that benefit from wider
+// vectors run their inner loops through run_with_isa(): the loop is inlined
+// (GCC/Clang `flatten`) into a trampoline compiled with `target` attributes
+// for one ISA level, and the level is chosen once at startup from cpuid.
+// Setting CML_FORCE_ISA to one of the isa_name()s selects a lower level, e.g.
+// to test every path on one machine.
+
+namespace cml {
+
+// Instruction set levels, in increasing order. `baseline` is whatever the
+// translation unit was compiled for; the others match x86-64-v2, v3 and v4.
+enum class Isa : std::uint8_t { baseline, sse42, avx2, avx512 };
+
+inline constexpr std::array<Isa, 4> all_isas{Isa::baseline, Isa::sse42,
+                                             Isa::avx2, Isa::avx512};
+
+// Width of the widest vector registers of each level.
+template <Isa isa>
+inline constexpr std::size_t isa_vector_bytes = isa == Isa::avx512 ? 64
+                                                : isa == Isa::avx2 ? 32
+                                                                   : 16;
+
+constexpr std::string_view isa_name(Isa isa) {
+    constexpr std::array<std::string_view, 4> names{"baseline", "sse4.2",
+                                                    "avx2", "avx512"};
+    return names[static_cast<std::size_t>(isa)];
+}
+
+constexpr std::optional<Isa> parse_isa(std::string_view name) {
+    for (const auto isa : all_isas) {
+        if (isa_name(isa) == name) {
+            return isa;
+        }
+    }
+    return std::nullopt;
+}
+
+// Features relevant to the ISA levels; the AVX ones also require the OS to
+// save the wider registers.
+struct CpuFeatures {
+    bool sse42 = false;
+    bool popcnt = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+    bool bmi2 = false;
+    bool avx512f = false;
+    bool avx512dq = false;
+    bool avx512bw = false;
+    bool avx512vl = false;
+};
+
+inline CpuFeatures detect_cpu_features() {
+    CpuFeatures f;
+#if defined(CML_X86_DISPATCH)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return f;
+    }
+    const auto bit = [](unsigned int reg, unsigned int b) {
+        return ((reg >> b) & 1) != 0;
+    };
+    f.sse42 = bit(ecx, 20);
+    f.popcnt = bit(ecx, 23);
+    const bool osxsave = bit(ecx, 27);
+    const bool cpu_avx = bit(ecx, 28);
+    const bool cpu_fma = bit(ecx, 12);
+
+    // XCR0: SSE and AVX state (bits 1, 2); opmask and upper ZMM state
+    // (bits 5 to 7).
+    std::uint64_t xcr0 = 0;
+    if (osxsave) {
+        unsigned int lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (std::uint64_t(hi) << 32) | lo;
+    }
+    const bool os_avx = (xcr0 & 0x6) == 0x6;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+    f.avx = cpu_avx && os_avx;
+    f.fma = cpu_fma && os_avx;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) != 0) {
+        f.avx2 = bit(ebx, 5) && os_avx;
+        f.bmi2 = bit(ebx, 8);
+        f.avx512f = bit(ebx, 16) && os_avx512;
+        f.avx512dq = bit(ebx, 17) && os_avx512;
+        f.avx512bw = bit(ebx, 30) && os_avx512;
+        f.avx512vl = bit(ebx, 31) && os_avx512;
+    }
+#endif
+    return f;
+}
+
+// Highest level whose features are all present.
+constexpr Isa best_isa(const CpuFeatures &f) {
+    if (!(f.sse42 && f.popcnt)) {
+        return Isa::baseline;
+    }
+    if (!(f.avx && f.avx2 && f.fma && f.bmi2)) {
+        return Isa::sse42;
+    }
+    if (!(f.avx512f && f.avx512dq && f.avx512bw && f.avx512vl)) {
+        return Isa::avx2;
+    }
+    return Isa::avx512;
+}
+
+// Highest level this CPU runs; detected on first use.
+inline Isa supported_isa() {
+#if defined(CML_X86_DISPATCH)
+    static const auto isa = best_isa(detect_cpu_features());
+    return isa;
+#else
+    return Isa::baseline;
+#endif
+}
+
+namespace detail {
+
+inline std::atomic<Isa> &active_isa_slot() {
+    static std::atomic<Isa> isa = [] {
+        auto chosen = supported_isa();
+        if (const char *forced = std::getenv("CML_FORCE_ISA")) {
+            if (const auto parsed = parse_isa(forced)) {
+                chosen = std::min(*parsed, chosen);
+            }
+        }
+        return chosen;
+    }();
+    return isa;
+}
+
+} // namespace detail
+
+// Level the batch kernels use: supported_isa(), lowered by CML_FORCE_ISA.
+inline Isa active_isa() {
+    return detail::active_isa_slot().load(std::memory_order_relaxed);
+}
+
+// Changes the level for subsequent kernel calls, capped at supported_isa().
+// Returns the level now active.
+inline Isa set_active_isa(Isa isa) {
+    isa = std::min(isa, supported_isa());
+    detail::active_isa_slot().store(isa, std::memory_order_relaxed);
+    return isa;
+}
+
+#if defined(CML_X86_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define CML_ISA_TRAMPOLINE(features) __attribute__((target(features), flatten))
+
+namespace detail {
+
+template <typename F>
+CML_ISA_TRAMPOLINE("sse4.2,popcnt")
+void run_sse42(F &f) {
+    f();
+}
+
+template <typename F>
+CML_ISA_TRAMPOLINE("sse4.2,popcnt,avx,avx2,fma,bmi,bmi2")
+void run_avx2(F &f) {
+    f();
+}
+
+template <typename F>
+CML_ISA_TRAMPOLINE("sse4.2,popcnt,avx,avx2,fma,bmi,bmi2,avx512f,avx512dq,"
+                   "avx512bw,avx512vl")
+void run_avx512(F &f) {
+    f();
+}
+
+} // namespace detail
+
+#undef CML_ISA_TRAMPOLINE
+
+// Calls f() with f and everything it calls inlined into code generated for
+// `isa`, which must not exceed supported_isa(). Calls that cannot be inlined
+// (e.g. into the standard library) run baseline code.
+template <typename F> void run_with_isa(Isa isa, F &&f) {
+    switch (isa) {
+    case Isa::avx512:
+        detail::run_avx512(f);
+        break;
+    case Isa::avx2:
+        detail::run_avx2(f);
+        break;
+    case Isa::sse42:
+        detail::run_sse42(f);
+        break;
+    case Isa::baseline:
+        f();
+        break;
+    }
+}
+#else
+template <typename F> void run_with_isa(Isa, F &&f) { f(); }
+#endif
+
+} // namespace cml
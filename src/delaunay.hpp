@@ -0,0 +1,881 @@
+#pragma once
+#include "common.hpp"
+#include "convex_hull.hpp"
+#include "morton.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Delaunay triangulations of Vec2d point sets, and their Voronoi diagrams,
+// as indices into the input (which must hold fewer than 2^32 points).
+//
+// Points are inserted one at a time (Bowyer-Watson): locate the triangle
+// containing the point by a visibility walk, grow the cavity of triangles
+// whose circumcircle contains it, and connect its boundary to the point.
+// The insertion order is a biased randomized insertion order (BRIO, Amenta,
+// Choi and Rote): rounds of geometrically growing size, each sorted along a
+// Hilbert curve, so walks are short and the working set stays in cache.
+// Triangles and their adjacency live in two flat arrays of half-edges, and
+// "ghost" triangles joining each hull edge to a vertex at infinity make
+// points outside the hull an ordinary case.
+//
+// All decisions go through the exact predicates of predicates.hpp, and
+// cocircular points are resolved by symbolic perturbation (Devillers and
+// Teillaud), which keeps the lexicographically larger points outside. The
+// triangulation is therefore unique: it does not depend on the insertion
+// order, the pool or the partitioning, and grids and other degenerate
+// input are handled exactly.
+
+namespace cml {
+
+struct DelaunayOptions {
+    // Splits the points into this many vertical strips, triangulated
+    // concurrently on the pool. The triangles whose circumcircles stay
+    // inside their strip are final; the rest is retriangulated from their
+    // vertices and stitched in. The result is the same as with one.
+    unsigned int partitions = 1;
+};
+
+namespace detail {
+
+inline constexpr std::uint32_t delaunay_none =
+    std::numeric_limits<std::uint32_t>::max();
+inline constexpr std::size_t delaunay_grain = std::size_t(1) << 14;
+// Strips of partitioned triangulations hold at least this many points.
+inline constexpr std::size_t delaunay_min_strip = std::size_t(1) << 8;
+// BRIO rounds: the first round holds about this many points.
+inline constexpr unsigned int brio_first_round_bits = 4;
+// Hilbert cells per axis: about 4 sqrt(n), up to 2^brio_curve_bits; finer
+// cells only cost encoding and sorting time.
+inline constexpr unsigned int brio_curve_bits = 16;
+
+CML_ALWAYS_INLINE inline std::uint32_t next_halfedge(std::uint32_t e) {
+    return e % 3 == 2 ? e - 2 : e + 1;
+}
+
+CML_ALWAYS_INLINE inline std::uint32_t prev_halfedge(std::uint32_t e) {
+    return e % 3 == 0 ? e + 2 : e - 1;
+}
+
+CML_ALWAYS_INLINE inline std::uint64_t edge_key(std::uint32_t from,
+                                                std::uint32_t to) {
+    return std::uint64_t(from) << 32 | to;
+}
+
+// orient2d() and incircle() with the filters inlined into the hot loops;
+// only the exact fallbacks are calls.
+template <typename LenT>
+CML_ALWAYS_INLINE inline double orient(const Vec<double, 2, LenT> &a,
+                                       const Vec<double, 2, LenT> &b,
+                                       const Vec<double, 2, LenT> &c) {
+    const auto f = orient2d_filter(a[0], a[1], b[0], b[1], c[0], c[1]);
+    return settled(f) ? f.det
+                      : orient2d_exact(a[0], a[1], b[0], b[1], c[0], c[1]);
+}
+
+template <typename LenT>
+CML_ALWAYS_INLINE inline double in_circle(const Vec<double, 2, LenT> &a,
+                                          const Vec<double, 2, LenT> &b,
+                                          const Vec<double, 2, LenT> &c,
+                                          const Vec<double, 2, LenT> &d) {
+    const auto f =
+        incircle_filter(a[0], a[1], b[0], b[1], c[0], c[1], d[0], d[1]);
+    return settled(f) ? f.det
+                      : incircle_exact(a[0], a[1], b[0], b[1], c[0], c[1],
+                                       d[0], d[1]);
+}
+
+template <typename LenT>
+bool lexicographic_less(const Vec<double, 2, LenT> &a,
+                        const Vec<double, 2, LenT> &b) {
+    return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+}
+
+// Breaks a tie of incircle(a, b, c, d) = 0 by symbolic perturbation: each
+// point is lifted by an amount infinitely larger than the lift of every
+// lexicographically smaller point, so the largest of the four points whose
+// lift changes the determinant decides. A lifted d falls outside, hence -1
+// when d itself is the largest.
+template <typename LenT>
+int incircle_tie_break(const Vec<double, 2, LenT> &a,
+                       const Vec<double, 2, LenT> &b,
+                       const Vec<double, 2, LenT> &c,
+                       const Vec<double, 2, LenT> &d) {
+    std::array<const Vec<double, 2, LenT> *, 4> sorted{&a, &b, &c, &d};
+    std::sort(sorted.begin(), sorted.end(), [](auto p, auto q) {
+        return lexicographic_less(*p, *q);
+    });
+    for (auto i = 3; i > 0; i--) {
+        if (sorted[i] == &d) {
+            return -1;
+        }
+        const auto o = sorted[i] == &c   ? orient2d(a, b, d)
+                       : sorted[i] == &b ? orient2d(a, d, c)
+                                         : orient2d(d, b, c);
+        if (o != 0) {
+            return o > 0 ? 1 : -1;
+        }
+    }
+    return -1;
+}
+
+// The sign of incircle(a, b, c, d) for counterclockwise a, b, c, with ties
+// broken by the perturbation; never 0 for distinct points.
+template <typename LenT>
+CML_ALWAYS_INLINE inline int
+perturbed_incircle(const Vec<double, 2, LenT> &a, const Vec<double, 2, LenT> &b,
+                   const Vec<double, 2, LenT> &c,
+                   const Vec<double, 2, LenT> &d) {
+    const auto det = in_circle(a, b, c, d);
+    if (det != 0) {
+        return det > 0 ? 1 : -1;
+    }
+    return incircle_tie_break(a, b, c, d);
+}
+
+// The BRIO: point i joins round cap - k with probability about 2^-(k+1)
+// (k trailing zeros of a hash of its coordinates, so duplicates share a
+// round), rounds are sorted along a Hilbert curve over the bounding box,
+// and the sort is stable, so duplicate points keep their order.
+template <typename LenT>
+void brio_order(std::span<const Vec<double, 2, LenT>> points,
+                std::vector<std::uint32_t> &indices, ThreadPool &pool) {
+    if (indices.empty()) {
+        return;
+    }
+    auto lo = points[indices[0]], hi = lo;
+    for (const auto i : indices) {
+        for (auto d = 0u; d < 2; d++) {
+            lo[d] = std::min(lo[d], points[i][d]);
+            hi[d] = std::max(hi[d], points[i][d]);
+        }
+    }
+    const auto bits =
+        static_cast<unsigned int>(std::bit_width(indices.size()));
+    const auto cap =
+        bits > brio_first_round_bits ? bits - brio_first_round_bits : 1u;
+    const auto curve_bits = std::min(bits / 2 + 2, brio_curve_bits);
+    const auto cells = double((1u << curve_bits) - 1);
+    std::array<double, 2> scale;
+    for (auto d = 0u; d < 2; d++) {
+        scale[d] = hi[d] > lo[d] ? cells / (hi[d] - lo[d]) : 0.0;
+    }
+
+    std::vector<std::uint64_t> keys(indices.size());
+    pool.parallel_for(
+        0, indices.size(), delaunay_grain,
+        [&](std::size_t first, std::size_t last) {
+            for (auto i = first; i < last; i++) {
+                const auto &p = points[indices[i]];
+                auto h = std::bit_cast<std::uint64_t>(p[0] + 0.0) ^
+                         std::rotl(std::bit_cast<std::uint64_t>(p[1] + 0.0),
+                                   29);
+                // The splitmix64 finalizer.
+                h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+                h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+                h ^= h >> 31;
+                const auto round = cap - std::min<unsigned int>(
+                                             std::countr_zero(h), cap);
+                Vec2u cell;
+                for (auto d = 0u; d < 2; d++) {
+                    cell[d] = static_cast<unsigned int>(
+                        (p[d] - lo[d]) * scale[d]);
+                }
+                keys[i] = std::uint64_t(round) << (2 * curve_bits) |
+                          hilbert_encode<2>(cell, curve_bits);
+            }
+        });
+    radix_sort_pairs(keys, indices, pool);
+}
+
+// A triangle of a triangulation under construction: its vertices,
+// counterclockwise, and the half-edges opposite its own, in one record so
+// that visiting it touches one cache line. Half-edge 3t + k of triangle t
+// runs from v[k] to v[(k + 1) % 3].
+struct alignas(32) DelaunayFace {
+    std::array<std::uint32_t, 3> v;
+    std::array<std::uint32_t, 3> opposite;
+};
+
+// Inserts points in their order. Each hull edge u -> v has a ghost triangle
+// (v, u, delaunay_none) on its outside, in any rotation, so that the ghosts
+// close the triangulation into a sphere.
+template <typename LenT> struct DelaunayBuilder {
+    using Point = Vec<double, 2, LenT>;
+
+    std::span<const Point> points;
+    std::vector<DelaunayFace> faces;
+    // A real triangle near the last inserted point, where walks start.
+    std::uint32_t last = 0;
+    std::vector<std::uint32_t> cavity;
+    std::vector<std::uint32_t> boundary;
+    std::vector<std::uint32_t> pending;
+
+    explicit DelaunayBuilder(std::span<const Point> points)
+        : points(points) {}
+
+    std::uint32_t vertex(std::uint32_t e) const {
+        return faces[e / 3].v[e % 3];
+    }
+    std::uint32_t &opposite(std::uint32_t e) {
+        return faces[e / 3].opposite[e % 3];
+    }
+
+    bool is_ghost(std::uint32_t t) const {
+        const auto &v = faces[t].v;
+        return v[0] == delaunay_none || v[1] == delaunay_none ||
+               v[2] == delaunay_none;
+    }
+
+    // Whether p lies in the circumcircle of triangle t. For a ghost, the
+    // circle is the open half-plane beyond its hull edge, plus the edge's
+    // interior.
+    bool conflicts(std::uint32_t t, const Point &p) const {
+        const auto &v = faces[t].v;
+        if (v[0] != delaunay_none && v[1] != delaunay_none &&
+            v[2] != delaunay_none) {
+            return perturbed_incircle(points[v[0]], points[v[1]],
+                                      points[v[2]], p) > 0;
+        }
+        const auto k = v[0] == delaunay_none   ? 0u
+                       : v[1] == delaunay_none ? 1u
+                                               : 2u;
+        const auto &a = points[v[(k + 1) % 3]];
+        const auto &b = points[v[(k + 2) % 3]];
+        const auto o = orient(a, b, p);
+        if (o != 0) {
+            return o > 0;
+        }
+        return p != a && p != b &&
+               lexicographic_less(a, p) == lexicographic_less(p, b);
+    }
+
+    // The triangle containing p, or the ghost beyond the hull edge that
+    // p is strictly outside of.
+    std::uint32_t locate(const Point &p) const {
+        auto t = last;
+        auto entered = delaunay_none;
+        for (;;) {
+            auto moved = false;
+            for (auto k = 0u; k < 3; k++) {
+                if (3 * t + k == entered) {
+                    continue;
+                }
+                const auto &a = points[faces[t].v[k]];
+                const auto &b = points[faces[t].v[(k + 1) % 3]];
+                if (orient(a, b, p) < 0) {
+                    entered = faces[t].opposite[k];
+                    t = entered / 3;
+                    moved = true;
+                    break;
+                }
+            }
+            if (!moved || is_ghost(t)) {
+                return t;
+            }
+        }
+    }
+
+    // The triangle of point 0, the next point that differs from it and the
+    // next one not collinear with both, with the three ghosts. Returns the
+    // latter two, or nothing if all points are collinear.
+    std::optional<std::array<std::uint32_t, 2>> start() {
+        const auto n = static_cast<std::uint32_t>(points.size());
+        std::uint32_t j = 1, k = 0;
+        while (j < n && points[j] == points[0]) {
+            j++;
+        }
+        for (k = j + 1; k < n; k++) {
+            if (orient2d(points[0], points[j], points[k]) != 0) {
+                break;
+            }
+        }
+        if (k >= n) {
+            return std::nullopt;
+        }
+        std::array<std::uint32_t, 3> v{0, j, k};
+        if (orient2d(points[0], points[j], points[k]) < 0) {
+            std::swap(v[1], v[2]);
+        }
+        faces.push_back({v, {3, 6, 9}});
+        for (auto g = 0u; g < 3; g++) {
+            faces.push_back({{v[(g + 1) % 3], v[g], delaunay_none},
+                             {g, 3 * ((g + 2) % 3 + 1) + 2,
+                              3 * ((g + 1) % 3 + 1) + 1}});
+        }
+        last = 0;
+        return std::array<std::uint32_t, 2>{j, k};
+    }
+
+    void insert(std::uint32_t i) {
+        const auto &p = points[i];
+        const auto t = locate(p);
+        if (!is_ghost(t)) {
+            for (const auto v : faces[t].v) {
+                if (points[v] == p) {
+                    return;
+                }
+            }
+        }
+
+        // The cavity has no vertices inside, so its triangles form a tree
+        // across their shared edges: search it depth first from t, taking
+        // the edges of each triangle in order, which lists the boundary
+        // counterclockwise as (from, to, outer half-edge).
+        cavity.assign(1, t);
+        boundary.clear();
+        pending.assign({3 * t + 2, 3 * t + 1, 3 * t});
+        while (!pending.empty()) {
+            const auto e = pending.back();
+            pending.pop_back();
+            const auto o = opposite(e);
+            if (conflicts(o / 3, p)) {
+                cavity.push_back(o / 3);
+                pending.insert(pending.end(),
+                               {prev_halfedge(o), next_halfedge(o)});
+            } else {
+                boundary.insert(boundary.end(),
+                                {vertex(e), vertex(next_halfedge(e)), o});
+            }
+        }
+
+        // One triangle (from, to, p) per boundary edge, in the cavity's
+        // slots and then new ones.
+        const auto edges = boundary.size() / 3;
+        while (cavity.size() < edges) {
+            cavity.push_back(static_cast<std::uint32_t>(faces.size()));
+            faces.emplace_back();
+        }
+        for (std::size_t b = 0; b < edges; b++) {
+            const auto s = cavity[b];
+            const auto s_next = cavity[(b + 1) % edges];
+            const auto outer = boundary[3 * b + 2];
+            faces[s].v = {boundary[3 * b], boundary[3 * b + 1], i};
+            faces[s].opposite = {outer, 3 * s_next + 2,
+                                 faces[s].opposite[2]};
+            opposite(outer) = 3 * s;
+            faces[s_next].opposite[2] = 3 * s + 1;
+            if (boundary[3 * b] != delaunay_none &&
+                boundary[3 * b + 1] != delaunay_none) {
+                last = s;
+            }
+        }
+    }
+
+    void build() {
+        const auto initial = start();
+        if (!initial) {
+            return;
+        }
+        // 2n triangles with the ghosts.
+        faces.reserve(2 * points.size());
+        for (std::uint32_t i = 1; i < points.size(); i++) {
+            if (i != (*initial)[0] && i != (*initial)[1]) {
+                insert(i);
+            }
+        }
+    }
+};
+
+// Triangulates points[indices], with ghosts. The points are inserted in
+// BRIO order from a copy in that order, so that the points a walk or a
+// cavity touches are close in memory too; the vertices are mapped back to
+// indices into points after.
+template <typename LenT>
+void triangulate(std::span<const Vec<double, 2, LenT>> points,
+                 std::vector<std::uint32_t> indices, ThreadPool &pool,
+                 std::vector<std::uint32_t> &triangles,
+                 std::vector<std::uint32_t> &halfedges) {
+    brio_order(points, indices, pool);
+    std::vector<Vec<double, 2, LenT>> ordered(indices.size());
+    pool.parallel_for_each(0, indices.size(), delaunay_grain,
+                           [&](std::size_t i) {
+                               ordered[i] = points[indices[i]];
+                           });
+    DelaunayBuilder<LenT> builder(ordered);
+    builder.build();
+    const auto &faces = builder.faces;
+    triangles.resize(3 * faces.size());
+    halfedges.resize(3 * faces.size());
+    pool.parallel_for_each(0, faces.size(), delaunay_grain,
+                           [&](std::size_t t) {
+                               for (auto k = 0u; k < 3; k++) {
+                                   const auto v = faces[t].v[k];
+                                   triangles[3 * t + k] =
+                                       v == delaunay_none ? v : indices[v];
+                                   halfedges[3 * t + k] =
+                                       faces[t].opposite[k];
+                               }
+                           });
+}
+
+// Drops the ghosts of a finished triangulation: the hull is read off them
+// counterclockwise, starting at its lexicographically smallest point, and
+// the half-edges they were opposite become delaunay_none.
+template <typename LenT>
+void compact_triangulation(std::span<const Vec<double, 2, LenT>> points,
+                           const std::vector<std::uint32_t> &triangles,
+                           const std::vector<std::uint32_t> &halfedges,
+                           std::vector<std::uint32_t> &out_triangles,
+                           std::vector<std::uint32_t> &out_halfedges,
+                           std::vector<std::uint32_t> &hull) {
+    const auto count = triangles.size() / 3;
+    std::vector<std::uint32_t> index(count, delaunay_none);
+    std::uint32_t real = 0;
+    auto ghost = delaunay_none;
+    for (std::size_t t = 0; t < count; t++) {
+        if (std::find(&triangles[3 * t], &triangles[3 * t] + 3,
+                      delaunay_none) == &triangles[3 * t] + 3) {
+            index[t] = real++;
+        } else {
+            ghost = static_cast<std::uint32_t>(t);
+        }
+    }
+    out_triangles.resize(3 * std::size_t(real));
+    out_halfedges.resize(3 * std::size_t(real));
+    for (std::size_t t = 0; t < count; t++) {
+        if (index[t] == delaunay_none) {
+            continue;
+        }
+        for (auto k = 0u; k < 3; k++) {
+            const auto e = 3 * std::size_t(index[t]) + k;
+            const auto o = halfedges[3 * t + k];
+            out_triangles[e] = triangles[3 * t + k];
+            out_halfedges[e] = index[o / 3] == delaunay_none
+                                   ? delaunay_none
+                                   : 3 * index[o / 3] + o % 3;
+        }
+    }
+
+    hull.clear();
+    if (ghost == delaunay_none) {
+        return;
+    }
+    // Ghost (b, a, none) sits on hull edge a -> b; the next ghost around
+    // the hull is across its half-edge none -> b.
+    auto g = ghost;
+    do {
+        auto k = 0u;
+        while (triangles[3 * g + k] != delaunay_none) {
+            k++;
+        }
+        hull.push_back(triangles[3 * g + (k + 2) % 3]);
+        g = halfedges[3 * g + k] / 3;
+    } while (g != ghost);
+    std::rotate(hull.begin(),
+                std::min_element(hull.begin(), hull.end(),
+                                 [&](auto a, auto b) {
+                                     return lexicographic_less(points[a],
+                                                               points[b]);
+                                 }),
+                hull.end());
+}
+
+// Whether the circumcircle of a, b, c certainly lies strictly between the
+// lines x = lo and x = hi. The circumcenter is computed in floating point
+// and the margin exceeds its rounding error many times over; nearly
+// degenerate triangles are never certain.
+template <typename LenT>
+bool circle_within(const Vec<double, 2, LenT> &a,
+                   const Vec<double, 2, LenT> &b,
+                   const Vec<double, 2, LenT> &c, double lo, double hi) {
+    const auto bx = b[0] - a[0], by = b[1] - a[1];
+    const auto cx = c[0] - a[0], cy = c[1] - a[1];
+    const auto det = bx * cy - by * cx;
+    if (!(det > 0x1p-20 * (std::abs(bx * cy) + std::abs(by * cx)))) {
+        return false;
+    }
+    const auto b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+    const auto ux = (cy * b2 - by * c2) / (2 * det);
+    const auto uy = (bx * c2 - cx * b2) / (2 * det);
+    const auto r = std::sqrt(ux * ux + uy * uy);
+    const auto margin =
+        0x1p-20 * (std::abs(cy * b2) + std::abs(by * c2) +
+                   std::abs(bx * c2) + std::abs(cx * b2)) /
+            (2 * det) +
+        0x1p-40 * std::abs(a[0]);
+    const auto x = a[0] + ux;
+    return x - r - margin > lo && x + r + margin < hi;
+}
+
+// A triangulation with ghosts, and which of its triangles are final.
+struct DelaunayStrip {
+    std::vector<std::uint32_t> triangles;
+    std::vector<std::uint32_t> halfedges;
+    std::vector<std::uint8_t> final;
+    // The index of each final triangle among all final triangles.
+    std::vector<std::uint32_t> rank;
+};
+
+// Triangulates strips of the points sorted by x concurrently and keeps the
+// triangles whose circumcircles stay inside their strip: no other point
+// can be in them, so they are Delaunay triangles of all points. Every
+// other Delaunay triangle has all its vertices among the vertices of the
+// non-final triangles, B, so it is a triangle of DT(B), and together they
+// fill the region the final triangles leave: flood it in DT(B) from the
+// edges where the final triangles end. Returns the triangulation with its
+// ghosts, or false if the stitching does not close up (which would take a
+// misjudged circumcircle), and the caller triangulates sequentially.
+template <typename LenT>
+bool triangulate_partitioned(std::span<const Vec<double, 2, LenT>> points,
+                             unsigned int partitions, ThreadPool &pool,
+                             std::vector<std::uint32_t> &triangles,
+                             std::vector<std::uint32_t> &halfedges) {
+    const auto n = points.size();
+    std::vector<std::uint32_t> sorted(n);
+    std::iota(sorted.begin(), sorted.end(), std::uint32_t(0));
+    sort_lexicographic(points, sorted, pool);
+    const auto x = [&](std::size_t i) { return points[sorted[i]][0]; };
+
+    // Strips split between distinct x, so that each strip's points are
+    // strictly left of the next strip's.
+    std::vector<std::size_t> splits{0};
+    for (auto s = 1u; s < partitions; s++) {
+        auto i = std::max(splits.back() + 1, n * s / partitions);
+        while (i < n && x(i) == x(i - 1)) {
+            i++;
+        }
+        if (i < n) {
+            splits.push_back(i);
+        }
+    }
+    splits.push_back(n);
+    const auto strips = splits.size() - 1;
+    if (strips < 2) {
+        return false;
+    }
+
+    std::vector<DelaunayStrip> strip(strips);
+    std::vector<std::uint8_t> in_b(n, 0);
+    std::vector<std::uint8_t> used(n, 0);
+    pool.parallel_for_each(0, strips, 1, [&](std::size_t s) {
+        auto &st = strip[s];
+        triangulate(points,
+                    std::vector<std::uint32_t>(sorted.begin() + splits[s],
+                                               sorted.begin() + splits[s + 1]),
+                    pool, st.triangles, st.halfedges);
+        const auto lo = s == 0 ? -std::numeric_limits<double>::infinity()
+                               : x(splits[s] - 1);
+        const auto hi = s + 1 == strips
+                            ? std::numeric_limits<double>::infinity()
+                            : x(splits[s + 1]);
+        st.final.assign(st.triangles.size() / 3, 0);
+        for (std::size_t t = 0; t < st.final.size(); t++) {
+            const auto *v = &st.triangles[3 * t];
+            if (v[0] != delaunay_none && v[1] != delaunay_none &&
+                v[2] != delaunay_none &&
+                circle_within(points[v[0]], points[v[1]], points[v[2]], lo,
+                              hi)) {
+                st.final[t] = 1;
+                continue;
+            }
+            for (auto k = 0u; k < 3; k++) {
+                if (v[k] != delaunay_none) {
+                    in_b[v[k]] = 1;
+                }
+            }
+        }
+        // A strip of collinear points has no triangles to put its points
+        // in B through: all of a strip goes to B if any point is unused.
+        for (const auto v : st.triangles) {
+            if (v != delaunay_none) {
+                used[v] = 1;
+            }
+        }
+        const auto first = sorted.begin() + splits[s];
+        const auto last = sorted.begin() + splits[s + 1];
+        if (!std::all_of(first, last, [&](auto i) { return used[i]; })) {
+            std::for_each(first, last, [&](auto i) { in_b[i] = 1; });
+        }
+    });
+
+    std::vector<std::uint32_t> b;
+    for (std::uint32_t i = 0; i < n; i++) {
+        if (in_b[i]) {
+            b.push_back(i);
+        }
+    }
+    std::vector<std::uint32_t> btri, bopp;
+    triangulate(points, std::move(b), pool, btri, bopp);
+    if (btri.empty()) {
+        return false;
+    }
+
+    // The final triangles come first, numbered strip by strip; frontier
+    // maps the edges they end at to their half-edges.
+    std::uint32_t finals = 0;
+    std::unordered_map<std::uint64_t, std::uint32_t> frontier;
+    for (auto &st : strip) {
+        st.rank.assign(st.final.size(), delaunay_none);
+        for (std::size_t t = 0; t < st.final.size(); t++) {
+            if (!st.final[t]) {
+                continue;
+            }
+            st.rank[t] = finals++;
+            for (auto k = 0u; k < 3; k++) {
+                const auto e = static_cast<std::uint32_t>(3 * t + k);
+                if (!st.final[st.halfedges[e] / 3]) {
+                    frontier.emplace(edge_key(st.triangles[e],
+                                              st.triangles[next_halfedge(e)]),
+                                     3 * st.rank[t] + k);
+                }
+            }
+        }
+    }
+
+    // Flood DT(B) from the frontier without crossing it.
+    std::unordered_map<std::uint64_t, std::uint32_t> bedges;
+    bedges.reserve(btri.size());
+    for (std::uint32_t e = 0; e < btri.size(); e++) {
+        bedges.emplace(edge_key(btri[e], btri[next_halfedge(e)]), e);
+    }
+    const auto crosses_frontier = [&](std::uint32_t e) {
+        return frontier.count(edge_key(btri[next_halfedge(e)], btri[e])) != 0;
+    };
+    std::vector<std::uint32_t> rank(btri.size() / 3, delaunay_none);
+    std::vector<std::uint32_t> queue;
+    auto filled = finals;
+    for (const auto &[key, e] : frontier) {
+        const auto it =
+            bedges.find(edge_key(static_cast<std::uint32_t>(key),
+                                 static_cast<std::uint32_t>(key >> 32)));
+        if (it == bedges.end()) {
+            return false;
+        }
+        if (rank[it->second / 3] == delaunay_none) {
+            rank[it->second / 3] = filled++;
+            queue.push_back(it->second / 3);
+        }
+    }
+    for (std::size_t q = 0; q < queue.size(); q++) {
+        for (auto k = 0u; k < 3; k++) {
+            const auto e = 3 * queue[q] + k;
+            const auto t = bopp[e] / 3;
+            if (!crosses_frontier(e) && rank[t] == delaunay_none) {
+                rank[t] = filled++;
+                queue.push_back(t);
+            }
+        }
+    }
+
+    triangles.assign(3 * std::size_t(filled), delaunay_none);
+    halfedges.assign(3 * std::size_t(filled), delaunay_none);
+    for (const auto &st : strip) {
+        for (std::size_t t = 0; t < st.final.size(); t++) {
+            if (!st.final[t]) {
+                continue;
+            }
+            for (auto k = 0u; k < 3; k++) {
+                const auto e = 3 * std::size_t(st.rank[t]) + k;
+                const auto o = st.halfedges[3 * t + k];
+                triangles[e] = st.triangles[3 * t + k];
+                if (st.final[o / 3]) {
+                    halfedges[e] = 3 * st.rank[o / 3] + o % 3;
+                } else {
+                    const auto h =
+                        bedges.at(edge_key(st.triangles[o],
+                                           st.triangles[next_halfedge(o)]));
+                    halfedges[e] = 3 * rank[h / 3] + h % 3;
+                }
+            }
+        }
+    }
+    for (const auto t : queue) {
+        for (auto k = 0u; k < 3; k++) {
+            const auto e = 3 * std::size_t(rank[t]) + k;
+            const auto h = 3 * t + k;
+            triangles[e] = btri[h];
+            if (crosses_frontier(h)) {
+                halfedges[e] =
+                    frontier.at(edge_key(btri[next_halfedge(h)], btri[h]));
+            } else {
+                halfedges[e] = 3 * rank[bopp[h] / 3] + bopp[h] % 3;
+            }
+        }
+    }
+    // Closed up: every half-edge is its opposite's opposite.
+    for (std::uint32_t e = 0; e < halfedges.size(); e++) {
+        if (halfedges[halfedges[e]] != e ||
+            triangles[halfedges[e]] != triangles[next_halfedge(e)]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+// The Delaunay triangulation of a point set: triangles()[3t + k], k < 3,
+// are the vertices of triangle t, counterclockwise, and no point lies in
+// the circumcircle of any triangle (for cocircular points, the
+// triangulation the perturbation selects). Half-edge e runs from
+// triangles()[e] to triangles()[next_halfedge(e)], and halfedges()[e] is
+// the opposite half-edge of the neighboring triangle, or none on the hull.
+// Of duplicate points only the first index is used; if all points are
+// collinear there are no triangles.
+class DelaunayTriangulation {
+  public:
+    static constexpr std::uint32_t none = detail::delaunay_none;
+
+    DelaunayTriangulation() = default;
+
+    template <std::floating_point LenT>
+    explicit DelaunayTriangulation(
+        std::span<const Vec<double, 2, LenT>> points,
+        const DelaunayOptions &options = {},
+        ThreadPool &pool = ThreadPool::global()) {
+        using namespace detail;
+        std::vector<std::uint32_t> triangles, halfedges;
+        const auto strips = std::min<std::size_t>(
+            options.partitions, points.size() / delaunay_min_strip);
+        if (strips < 2 ||
+            !triangulate_partitioned(points, static_cast<unsigned int>(strips),
+                                     pool, triangles, halfedges)) {
+            std::vector<std::uint32_t> all(points.size());
+            std::iota(all.begin(), all.end(), std::uint32_t(0));
+            triangulate(points, std::move(all), pool, triangles, halfedges);
+        }
+        compact_triangulation(points, triangles, halfedges, m_triangles,
+                              m_halfedges, m_hull);
+    }
+
+    template <std::floating_point LenT>
+    explicit DelaunayTriangulation(
+        const std::vector<Vec<double, 2, LenT>> &points,
+        const DelaunayOptions &options = {},
+        ThreadPool &pool = ThreadPool::global())
+        : DelaunayTriangulation(std::span<const Vec<double, 2, LenT>>(points),
+                                options, pool) {}
+
+    static std::uint32_t next_halfedge(std::uint32_t e) {
+        return detail::next_halfedge(e);
+    }
+    static std::uint32_t prev_halfedge(std::uint32_t e) {
+        return detail::prev_halfedge(e);
+    }
+
+    std::size_t size() const { return m_triangles.size() / 3; }
+    std::span<const std::uint32_t> triangles() const { return m_triangles; }
+    std::span<const std::uint32_t> halfedges() const { return m_halfedges; }
+    // The hull vertices counterclockwise from the lexicographically
+    // smallest point, including points in the interior of hull edges.
+    std::span<const std::uint32_t> hull() const { return m_hull; }
+
+  private:
+    std::vector<std::uint32_t> m_triangles;
+    std::vector<std::uint32_t> m_halfedges;
+    std::vector<std::uint32_t> m_hull;
+};
+
+// The Voronoi diagram dual to a Delaunay triangulation. The cell of point
+// i is the polygon cells[offsets[i] .. offsets[i + 1]) of vertices,
+// counterclockwise, and is empty for points the triangulation does not use.
+// The cells of hull points are unbounded: they start and end at the
+// circumcenters of the triangles on the two hull edges at the point, and
+// continue from there along the outward normals of those edges.
+template <std::floating_point LenT = default_len_type> struct VoronoiDiagram {
+    // The circumcenter of each triangle.
+    std::vector<Vec<double, 2, LenT>> vertices;
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> cells;
+    std::vector<std::uint8_t> unbounded;
+};
+
+template <std::floating_point LenT>
+VoronoiDiagram<LenT>
+voronoi_diagram(std::span<const Vec<double, 2, LenT>> points,
+                const DelaunayTriangulation &delaunay,
+                ThreadPool &pool = ThreadPool::global()) {
+    using detail::delaunay_grain;
+    using detail::delaunay_none;
+    using detail::next_halfedge;
+    using detail::prev_halfedge;
+    const auto triangles = delaunay.triangles();
+    const auto halfedges = delaunay.halfedges();
+    VoronoiDiagram<LenT> voronoi;
+    voronoi.vertices.resize(delaunay.size());
+    pool.parallel_for(
+        0, delaunay.size(), delaunay_grain,
+        [&](std::size_t first, std::size_t last) {
+            for (auto t = first; t < last; t++) {
+                const auto &a = points[triangles[3 * t]];
+                const auto b = points[triangles[3 * t + 1]] - a;
+                const auto c = points[triangles[3 * t + 2]] - a;
+                const auto det = 2 * (b[0] * c[1] - b[1] * c[0]);
+                const auto b2 = b.length_sq(), c2 = c.length_sq();
+                voronoi.vertices[t] =
+                    a + Vec<double, 2, LenT>{(c[1] * b2 - b[1] * c2) / det,
+                                             (b[0] * c2 - c[0] * b2) / det};
+            }
+        });
+
+    // For each point a half-edge into it; on the hull the one that starts
+    // the counterclockwise rotation around it, whose next has no opposite.
+    std::vector<std::uint32_t> into(points.size(), delaunay_none);
+    voronoi.offsets.assign(points.size() + 1, 0);
+    for (std::uint32_t e = 0; e < triangles.size(); e++) {
+        const auto v = triangles[next_halfedge(e)];
+        if (into[v] == delaunay_none ||
+            halfedges[next_halfedge(e)] == delaunay_none) {
+            into[v] = e;
+        }
+        voronoi.offsets[v + 1]++;
+    }
+    std::partial_sum(voronoi.offsets.begin(), voronoi.offsets.end(),
+                     voronoi.offsets.begin());
+    voronoi.unbounded.assign(points.size(), 0);
+    for (const auto v : delaunay.hull()) {
+        voronoi.unbounded[v] = 1;
+    }
+
+    // Around each point counterclockwise: from the triangle of half-edge e
+    // into it to that of prev(opposite(e)). Starting the rotations in
+    // half-edge order, rather than point order, keeps them close in memory.
+    voronoi.cells.resize(voronoi.offsets.back());
+    pool.parallel_for(
+        0, triangles.size(), delaunay_grain,
+        [&](std::size_t first, std::size_t last) {
+            for (auto start = static_cast<std::uint32_t>(first); start < last;
+                 start++) {
+                const auto v = triangles[next_halfedge(start)];
+                if (into[v] != start) {
+                    continue;
+                }
+                auto *out = voronoi.cells.data() + voronoi.offsets[v];
+                auto e = start;
+                do {
+                    *out++ = e / 3;
+                    if (halfedges[e] == delaunay_none) {
+                        break;
+                    }
+                    e = prev_halfedge(halfedges[e]);
+                } while (e != start);
+            }
+        });
+    return voronoi;
+}
+
+template <std::floating_point LenT>
+VoronoiDiagram<LenT>
+voronoi_diagram(const std::vector<Vec<double, 2, LenT>> &points,
+                const DelaunayTriangulation &delaunay,
+                ThreadPool &pool = ThreadPool::global()) {
+    return voronoi_diagram(std::span<const Vec<double, 2, LenT>>(points),
+                           delaunay, pool);
+}
+
+} // namespace cml
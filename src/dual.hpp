@@ -0,0 +1,360 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include "unroll.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cmath>
+#include <compare>
+#include <concepts>
+#include <ostream>
+
+namespace cml {
+
+namespace detail {
+
+// Dual keeps its derivative lanes in 16-byte vectors (GCC and Clang vector
+// extensions), so each operation handles two doubles or four floats per
+// instruction however the code around it is unrolled. The width is the
+// baseline one on purpose: the layout must not depend on the -m flags of
+// the translation unit. Other compilers and long double use one lane per
+// element.
+template <typename T> struct DualPack {
+    using type = T;
+    static constexpr unsigned int lanes = 1;
+};
+#if defined(__GNUC__) || defined(__clang__)
+template <typename T>
+    requires(std::same_as<T, float> || std::same_as<T, double>)
+struct DualPack<T> {
+    typedef T type __attribute__((vector_size(16)));
+    static constexpr unsigned int lanes = 16 / sizeof(T);
+};
+#endif
+
+} // namespace detail
+
+// Forward-mode automatic differentiation: a value and its derivatives with
+// respect to N independent variables, one lane each. Every operation
+// updates all lanes with vector instructions (see detail::DualPack), so a
+// single evaluation of a function of N inputs yields its whole Jacobian
+// (see jacobian()) instead of the N + 1 evaluations of finite differences.
+//
+// Dual satisfies scalar and works as the element of Vec and Matrix and with
+// the transform builders. Comparisons look at the value only, so branches
+// follow the ones the function takes at that point. The math functions are
+// found by argument-dependent lookup, as in `using std::sin; sin(x)`.
+template <std::floating_point T, unsigned int N> class Dual {
+  public:
+    using ValueType = T;
+    static constexpr auto Lanes = N;
+
+    constexpr Dual() : m_packs{}, m_value(0) {}
+    constexpr Dual(T value) : m_packs{}, m_value(value) {}
+    constexpr Dual(T value, const std::array<T, N> &gradient) : Dual(value) {
+        for (auto i = 0u; i < N; i++) {
+            at(i) = gradient[i];
+        }
+    }
+
+    // Independent variable `lane`: derivative 1 there and 0 elsewhere.
+    static constexpr Dual variable(T value, unsigned int lane) {
+        Dual x(value);
+        x.at(lane) = 1;
+        return x;
+    }
+
+    constexpr T value() const { return m_value; }
+    constexpr T derivative(unsigned int lane) const {
+        if constexpr (PackLanes == 1) {
+            return m_packs[lane];
+        } else {
+            return m_packs[lane / PackLanes][lane % PackLanes];
+        }
+    }
+    constexpr std::array<T, N> gradient() const {
+        std::array<T, N> g;
+        for (auto i = 0u; i < N; i++) {
+            g[i] = derivative(i);
+        }
+        return g;
+    }
+
+    friend CML_ALWAYS_INLINE constexpr Dual operator+(const Dual &lhs,
+                                                      const Dual &rhs) {
+        Dual r(lhs.m_value + rhs.m_value);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] = lhs.m_packs[i] + rhs.m_packs[i];
+        });
+        return r;
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator-(const Dual &lhs,
+                                                      const Dual &rhs) {
+        Dual r(lhs.m_value - rhs.m_value);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] = lhs.m_packs[i] - rhs.m_packs[i];
+        });
+        return r;
+    }
+    // (a b)' = a' b + a b'
+    friend CML_ALWAYS_INLINE constexpr Dual operator*(const Dual &lhs,
+                                                      const Dual &rhs) {
+        Dual r(lhs.m_value * rhs.m_value);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] =
+                lhs.m_packs[i] * rhs.m_value + lhs.m_value * rhs.m_packs[i];
+        });
+        return r;
+    }
+    // (a / b)' = (a' - (a / b) b') / b
+    friend CML_ALWAYS_INLINE constexpr Dual operator/(const Dual &lhs,
+                                                      const Dual &rhs) {
+        const auto inverse = 1 / rhs.m_value;
+        Dual r(lhs.m_value / rhs.m_value);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] =
+                (lhs.m_packs[i] - r.m_value * rhs.m_packs[i]) * inverse;
+        });
+        return r;
+    }
+
+    // Constants leave the lanes alone or scale them.
+    friend CML_ALWAYS_INLINE constexpr Dual operator+(Dual lhs, T rhs) {
+        lhs.m_value += rhs;
+        return lhs;
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator+(T lhs, Dual rhs) {
+        rhs.m_value = lhs + rhs.m_value;
+        return rhs;
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator-(Dual lhs, T rhs) {
+        lhs.m_value -= rhs;
+        return lhs;
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator-(T lhs, const Dual &rhs) {
+        return chain(lhs - rhs.value(), T(-1), rhs);
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator*(const Dual &lhs, T rhs) {
+        return chain(lhs.value() * rhs, rhs, lhs);
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator*(T lhs, const Dual &rhs) {
+        return chain(lhs * rhs.value(), lhs, rhs);
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator/(const Dual &lhs, T rhs) {
+        return chain(lhs.value() / rhs, 1 / rhs, lhs);
+    }
+    // (c / b)' = -(c / b) b' / b
+    friend CML_ALWAYS_INLINE constexpr Dual operator/(T lhs, const Dual &rhs) {
+        const auto q = lhs / rhs.value();
+        return chain(q, -q / rhs.value(), rhs);
+    }
+
+    friend CML_ALWAYS_INLINE constexpr Dual operator+(const Dual &x) {
+        return x;
+    }
+    friend CML_ALWAYS_INLINE constexpr Dual operator-(const Dual &x) {
+        Dual r(-x.m_value);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] = -x.m_packs[i];
+        });
+        return r;
+    }
+
+    CML_ALWAYS_INLINE constexpr Dual &operator+=(const Dual &rhs) {
+        return *this = *this + rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator-=(const Dual &rhs) {
+        return *this = *this - rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator*=(const Dual &rhs) {
+        return *this = *this * rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator/=(const Dual &rhs) {
+        return *this = *this / rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator+=(T rhs) {
+        return *this = *this + rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator-=(T rhs) {
+        return *this = *this - rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator*=(T rhs) {
+        return *this = *this * rhs;
+    }
+    CML_ALWAYS_INLINE constexpr Dual &operator/=(T rhs) {
+        return *this = *this / rhs;
+    }
+
+    friend constexpr bool operator==(const Dual &lhs, const Dual &rhs) {
+        return lhs.value() == rhs.value();
+    }
+    friend constexpr auto operator<=>(const Dual &lhs, const Dual &rhs) {
+        return lhs.value() <=> rhs.value();
+    }
+
+    friend Dual abs(const Dual &x) { return x.value() < 0 ? -x : x; }
+    friend Dual sqrt(const Dual &x) {
+        const auto r = std::sqrt(x.value());
+        return chain(r, T(0.5) / r, x);
+    }
+    friend Dual exp(const Dual &x) {
+        const auto r = std::exp(x.value());
+        return chain(r, r, x);
+    }
+    friend Dual log(const Dual &x) {
+        return chain(std::log(x.value()), 1 / x.value(), x);
+    }
+    friend Dual pow(const Dual &x, T exponent) {
+        return chain(std::pow(x.value(), exponent),
+                     exponent * std::pow(x.value(), exponent - 1), x);
+    }
+    friend Dual sin(const Dual &x) {
+        return chain(std::sin(x.value()), std::cos(x.value()), x);
+    }
+    friend Dual cos(const Dual &x) {
+        return chain(std::cos(x.value()), -std::sin(x.value()), x);
+    }
+    friend Dual tan(const Dual &x) {
+        const auto r = std::tan(x.value());
+        return chain(r, 1 + r * r, x);
+    }
+    friend Dual asin(const Dual &x) {
+        return chain(std::asin(x.value()),
+                     1 / std::sqrt(1 - x.value() * x.value()), x);
+    }
+    friend Dual acos(const Dual &x) {
+        return chain(std::acos(x.value()),
+                     -1 / std::sqrt(1 - x.value() * x.value()), x);
+    }
+    friend Dual atan(const Dual &x) {
+        return chain(std::atan(x.value()), 1 / (1 + x.value() * x.value()),
+                     x);
+    }
+    // d atan2(y, x) = (x dy - y dx) / (x^2 + y^2)
+    friend Dual atan2(const Dual &y, const Dual &x) {
+        const auto inverse =
+            1 / (x.m_value * x.m_value + y.m_value * y.m_value);
+        Dual r(std::atan2(y.m_value, x.m_value));
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] =
+                (x.m_value * y.m_packs[i] - y.m_value * x.m_packs[i]) *
+                inverse;
+        });
+        return r;
+    }
+
+    // The value, then the lanes in braces: 2{1 0 3}.
+    friend std::ostream &operator<<(std::ostream &out, const Dual &x) {
+        out << x.value() << "{";
+        for (auto i = 0u; i < N; i++) {
+            out << (i ? " " : "") << x.derivative(i);
+        }
+        return out << "}";
+    }
+
+  private:
+    using Pack = typename detail::DualPack<T>::type;
+    static constexpr auto PackLanes = detail::DualPack<T>::lanes;
+    static constexpr auto Packs = (N + PackLanes - 1) / PackLanes;
+
+    constexpr T &at(unsigned int lane) {
+        if constexpr (PackLanes == 1) {
+            return m_packs[lane];
+        } else {
+            return m_packs[lane / PackLanes][lane % PackLanes];
+        }
+    }
+
+    // f(x), given f(x.value()) and f'(x.value()).
+    CML_ALWAYS_INLINE static constexpr Dual chain(T f, T derivative,
+                                                  const Dual &x) {
+        Dual r(f);
+        static_for<Packs>([&](unsigned int i) CML_ALWAYS_INLINE {
+            r.m_packs[i] = derivative * x.m_packs[i];
+        });
+        return r;
+    }
+
+    // Lanes past N fill the last pack and are never read.
+    std::array<Pack, Packs> m_packs;
+    T m_value;
+};
+
+// x as the N independent variables: element i varies in lane i.
+template <std::floating_point T, unsigned int N, std::floating_point LenT>
+constexpr Vec<Dual<T, N>, N, LenT> variables(const Vec<T, N, LenT> &x) {
+    Vec<Dual<T, N>, N, LenT> r;
+    static_for<N>([&](unsigned int i) CML_ALWAYS_INLINE {
+        r[i] = Dual<T, N>::variable(x[i], i);
+    });
+    return r;
+}
+
+template <std::floating_point T, unsigned int N, unsigned int Dim,
+          std::floating_point LenT>
+constexpr Vec<T, Dim, LenT> values(const Vec<Dual<T, N>, Dim, LenT> &v) {
+    Vec<T, Dim, LenT> r;
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { r[i] = v[i].value(); });
+    return r;
+}
+
+template <std::floating_point T, unsigned int N, unsigned int Rows,
+          unsigned int Cols>
+Matrix<Rows, Cols, T> values(const Matrix<Rows, Cols, Dual<T, N>> &m) {
+    Matrix<Rows, Cols, T> r;
+    for (auto row = 0u; row < Rows; row++) {
+        for (auto col = 0u; col < Cols; col++) {
+            r.get(row, col) = m.get(row, col).value();
+        }
+    }
+    return r;
+}
+
+// The derivatives of the elements of v with respect to variable `lane`.
+template <std::floating_point T, unsigned int N, unsigned int Dim,
+          std::floating_point LenT>
+constexpr Vec<T, Dim, LenT> derivatives(const Vec<Dual<T, N>, Dim, LenT> &v,
+                                        unsigned int lane) {
+    Vec<T, Dim, LenT> r;
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
+        r[i] = v[i].derivative(lane);
+    });
+    return r;
+}
+
+template <std::floating_point T, unsigned int N, unsigned int Rows,
+          unsigned int Cols>
+Matrix<Rows, Cols, T> derivatives(const Matrix<Rows, Cols, Dual<T, N>> &m,
+                                  unsigned int lane) {
+    Matrix<Rows, Cols, T> r;
+    for (auto row = 0u; row < Rows; row++) {
+        for (auto col = 0u; col < Cols; col++) {
+            r.get(row, col) = m.get(row, col).derivative(lane);
+        }
+    }
+    return r;
+}
+
+// Row i holds the derivatives of y[i] with respect to the N variables.
+template <std::floating_point T, unsigned int N, unsigned int M,
+          std::floating_point LenT>
+Matrix<M, N, T> jacobian(const Vec<Dual<T, N>, M, LenT> &y) {
+    Matrix<M, N, T> r;
+    for (auto i = 0u; i < M; i++) {
+        static_for<N>([&](unsigned int j) CML_ALWAYS_INLINE {
+            r.get(i, j) = y[i].derivative(j);
+        });
+    }
+    return r;
+}
+
+// The Jacobian at x of f, a function from Vec<Dual<T, N>, N, LenT> to a Vec
+// of Dual<T, N>, from a single evaluation.
+template <std::floating_point T, unsigned int N, std::floating_point LenT,
+          typename F>
+auto jacobian(F &&f, const Vec<T, N, LenT> &x) {
+    return jacobian(f(variables(x)));
+}
+
+} // namespace cml
@@ -0,0 +1,218 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace cml {
+
+// Non-owning row-major view of a rows x cols block whose rows are `stride`
+// elements apart. T may be const.
+template <typename T> class MatrixView {
+  public:
+    MatrixView() = default;
+    MatrixView(T *data, std::size_t rows, std::size_t cols, std::size_t stride)
+        : m_data(data), m_rows(rows), m_cols(cols), m_stride(stride) {}
+    MatrixView(T *data, std::size_t rows, std::size_t cols)
+        : MatrixView(data, rows, cols, cols) {}
+
+    // A view of mutable elements converts to a view of const ones.
+    template <typename U>
+        requires(std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+    MatrixView(const MatrixView<U> &other)
+        : MatrixView(other.data(), other.rows(), other.cols(),
+                     other.stride()) {}
+
+    T *data() const { return m_data; }
+    std::size_t rows() const { return m_rows; }
+    std::size_t cols() const { return m_cols; }
+    std::size_t stride() const { return m_stride; }
+    bool empty() const { return m_rows == 0 || m_cols == 0; }
+
+    T &get(std::size_t row, std::size_t col) const {
+        return m_data[row * m_stride + col];
+    }
+    std::span<T> operator[](std::size_t row) const {
+        return {m_data + row * m_stride, m_cols};
+    }
+
+    // The rows x cols block whose top left element is (row, col).
+    MatrixView block(std::size_t row, std::size_t col, std::size_t rows,
+                     std::size_t cols) const {
+        return {m_data + row * m_stride + col, rows, cols, m_stride};
+    }
+
+  private:
+    T *m_data = nullptr;
+    std::size_t m_rows = 0;
+    std::size_t m_cols = 0;
+    std::size_t m_stride = 0;
+};
+
+template <typename T> using ConstMatrixView = MatrixView<const T>;
+
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+MatrixView<T> view(Matrix<Rows, Cols, T> &m) {
+    return {&m.get(0, 0), Rows, Cols};
+}
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+ConstMatrixView<T> view(const Matrix<Rows, Cols, T> &m) {
+    return {&m.get(0, 0), Rows, Cols};
+}
+
+// Heap-allocated row-major matrix whose shape is chosen at run time, for
+// sizes where Matrix's inline storage and unrolled loops don't fit. The
+// product operator is in gemm.hpp.
+template <arithmetic T = default_type> class DynamicMatrix {
+  public:
+    using value_type = T;
+
+    DynamicMatrix() = default;
+    DynamicMatrix(std::size_t rows, std::size_t cols)
+        : m_rows(rows), m_cols(cols), m_data(rows * cols, T()) {}
+    DynamicMatrix(std::size_t rows, std::size_t cols,
+                  std::initializer_list<T> list)
+        : DynamicMatrix(rows, cols) {
+        std::copy_n(list.begin(), std::min(list.size(), m_data.size()),
+                    m_data.begin());
+    }
+    template <unsigned int Rows, unsigned int Cols>
+    explicit DynamicMatrix(const Matrix<Rows, Cols, T> &m)
+        : DynamicMatrix(Rows, Cols) {
+        std::copy_n(&m.get(0, 0), m_data.size(), m_data.begin());
+    }
+    explicit DynamicMatrix(ConstMatrixView<T> view)
+        : DynamicMatrix(view.rows(), view.cols()) {
+        for (std::size_t r = 0; r < m_rows; r++) {
+            std::copy_n(view[r].data(), m_cols, (*this)[r].data());
+        }
+    }
+
+    static DynamicMatrix identity(std::size_t n) {
+        DynamicMatrix id(n, n);
+        for (std::size_t i = 0; i < n; i++) {
+            id.get(i, i) = T(1);
+        }
+        return id;
+    }
+
+    std::size_t rows() const { return m_rows; }
+    std::size_t cols() const { return m_cols; }
+    std::size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+    bool is_square() const { return m_rows == m_cols; }
+
+    T *data() { return m_data.data(); }
+    const T *data() const { return m_data.data(); }
+
+    T &get(std::size_t row, std::size_t col) {
+        return m_data[row * m_cols + col];
+    }
+    const T &get(std::size_t row, std::size_t col) const {
+        return m_data[row * m_cols + col];
+    }
+
+    std::span<T> operator[](std::size_t row) {
+        return {m_data.data() + row * m_cols, m_cols};
+    }
+    std::span<const T> operator[](std::size_t row) const {
+        return {m_data.data() + row * m_cols, m_cols};
+    }
+
+    MatrixView<T> view() { return {m_data.data(), m_rows, m_cols}; }
+    ConstMatrixView<T> view() const { return {m_data.data(), m_rows, m_cols}; }
+    operator MatrixView<T>() { return view(); }
+    operator ConstMatrixView<T>() const { return view(); }
+
+    template <unsigned int Rows, unsigned int Cols>
+    Matrix<Rows, Cols, T> to_matrix() const {
+        if (m_rows != Rows || m_cols != Cols) {
+            throw std::invalid_argument("DynamicMatrix: shape mismatch");
+        }
+        Matrix<Rows, Cols, T> m;
+        std::copy_n(m_data.begin(), m_data.size(), &m.get(0, 0));
+        return m;
+    }
+
+    DynamicMatrix transposed() const {
+        DynamicMatrix t(m_cols, m_rows);
+        for (std::size_t r = 0; r < m_rows; r++) {
+            for (std::size_t c = 0; c < m_cols; c++) {
+                t.get(c, r) = get(r, c);
+            }
+        }
+        return t;
+    }
+
+    DynamicMatrix &operator+=(const DynamicMatrix &rhs) {
+        check_same_shape(rhs);
+        for (std::size_t i = 0; i < m_data.size(); i++) {
+            m_data[i] += rhs.m_data[i];
+        }
+        return *this;
+    }
+    DynamicMatrix &operator-=(const DynamicMatrix &rhs) {
+        check_same_shape(rhs);
+        for (std::size_t i = 0; i < m_data.size(); i++) {
+            m_data[i] -= rhs.m_data[i];
+        }
+        return *this;
+    }
+    DynamicMatrix &operator*=(T scalar) {
+        for (auto &v : m_data) {
+            v *= scalar;
+        }
+        return *this;
+    }
+
+    friend DynamicMatrix operator+(DynamicMatrix lhs,
+                                   const DynamicMatrix &rhs) {
+        return lhs += rhs;
+    }
+    friend DynamicMatrix operator-(DynamicMatrix lhs,
+                                   const DynamicMatrix &rhs) {
+        return lhs -= rhs;
+    }
+    friend DynamicMatrix operator*(DynamicMatrix lhs, T scalar) {
+        return lhs *= scalar;
+    }
+
+    friend bool operator==(const DynamicMatrix &,
+                           const DynamicMatrix &) = default;
+
+  private:
+    void check_same_shape(const DynamicMatrix &rhs) const {
+        if (m_rows != rhs.m_rows || m_cols != rhs.m_cols) {
+            throw std::invalid_argument("DynamicMatrix: shape mismatch");
+        }
+    }
+
+    std::size_t m_rows = 0;
+    std::size_t m_cols = 0;
+    std::vector<T> m_data;
+};
+
+template <arithmetic T>
+std::ostream &operator<<(std::ostream &os, const DynamicMatrix<T> &m) {
+    for (std::size_t i = 0; i < m.rows(); i++) {
+        os << "[";
+        for (std::size_t j = 0; j < m.cols(); j++) {
+            os << m.get(i, j);
+            if (j != m.cols() - 1)
+                os << " ";
+        }
+        os << "]\n";
+    }
+    return os;
+}
+
+using DynamicMatrixd = DynamicMatrix<double>;
+using DynamicMatrixf = DynamicMatrix<float>;
+
+} // namespace cml
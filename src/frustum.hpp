@@ -0,0 +1,277 @@
+#pragma once
+#include "aabb.hpp"
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace cml {
+
+// The plane normal.dot(p) + offset = 0; points with a positive distance are
+// on the side the normal points to.
+template <std::floating_point T> struct Plane {
+    Vec3<T> normal;
+    T offset;
+
+    constexpr T distance(const Vec3<T> &p) const {
+        return normal.dot(p) + offset;
+    }
+};
+
+// View frustum as six inward-facing, normalized planes.
+//
+// The planes are extracted (Gribb and Hartmann) from a combined
+// view-projection matrix laid out like lookAt() and perspective(), which
+// map points as row vectors: clip = (x, y, z, 1) * view_projection, with
+// view_projection = lookAt(...) * perspective(...). Clip space is the
+// OpenGL one, -w <= x, y, z <= w.
+template <std::floating_point T> class Frustum {
+  public:
+    enum Side : unsigned int { left, right, bottom, top, near, far };
+
+    explicit Frustum(const Matrix<4, 4, T> &view_projection) {
+        const auto &m = view_projection;
+        const auto column = [&](unsigned int c) {
+            return std::array<T, 4>{m.get(0, c), m.get(1, c), m.get(2, c),
+                                    m.get(3, c)};
+        };
+        const auto w = column(3);
+        for (auto axis = 0u; axis < 3; axis++) {
+            const auto c = column(axis);
+            set_plane(2 * axis, w, c, T(1));
+            set_plane(2 * axis + 1, w, c, T(-1));
+        }
+    }
+
+    const std::array<Plane<T>, 6> &planes() const { return m_planes; }
+    const Plane<T> &plane(Side side) const { return m_planes[side]; }
+
+    bool contains(const Vec3<T> &p) const {
+        return std::all_of(m_planes.begin(), m_planes.end(),
+                           [&](const Plane<T> &plane) {
+                               return plane.distance(p) >= 0;
+                           });
+    }
+
+    // Conservative: true unless the sphere is fully outside some plane.
+    bool intersects_sphere(const Vec3<T> &center, T radius) const {
+        return std::all_of(m_planes.begin(), m_planes.end(),
+                           [&](const Plane<T> &plane) {
+                               return plane.distance(center) >= -radius;
+                           });
+    }
+
+    // Conservative: true unless the box is fully outside some plane.
+    bool intersects(const Aabb<T> &box) const {
+        const auto center = box.center();
+        const auto half = box.extent() / T(2);
+        return std::all_of(m_planes.begin(), m_planes.end(),
+                           [&](const Plane<T> &plane) {
+                               const auto reach =
+                                   std::abs(plane.normal.x()) * half.x() +
+                                   std::abs(plane.normal.y()) * half.y() +
+                                   std::abs(plane.normal.z()) * half.z();
+                               return plane.distance(center) >= -reach;
+                           });
+    }
+
+  private:
+    void set_plane(unsigned int i, const std::array<T, 4> &w,
+                   const std::array<T, 4> &c, T sign) {
+        const Vec3<T> normal(w[0] + sign * c[0], w[1] + sign * c[1],
+                             w[2] + sign * c[2]);
+        const auto inv_length = T(1) / static_cast<T>(normal.length());
+        m_planes[i] = {normal * inv_length,
+                       (w[3] + sign * c[3]) * inv_length};
+    }
+
+    std::array<Plane<T>, 6> m_planes;
+};
+
+namespace detail {
+
+// Objects are tested in blocks of this many lanes; each block is a fixed
+// trip count, branch-free loop that the compiler turns into SIMD compares.
+inline constexpr std::size_t cull_lanes = 16;
+// Each task covers a whole number of 64-bit mask words.
+inline constexpr std::size_t cull_grain = 1 << 14;
+
+// Visibility bits of objects [first, first + count), count <= 64. Object i
+// is visible if margin(a, b, c, d, i) >= 0 for every plane (a, b, c, d),
+// where the margin is the signed distance of the bounding volume's far side
+// along the plane normal.
+template <std::floating_point T, typename Margin>
+std::uint64_t cull_word(const Frustum<T> &frustum, std::size_t first,
+                        std::size_t count, Margin &&margin) {
+    std::array<T, 6> a, b, c, d;
+    for (auto p = 0u; p < 6; p++) {
+        const auto &plane = frustum.planes()[p];
+        a[p] = plane.normal.x();
+        b[p] = plane.normal.y();
+        c[p] = plane.normal.z();
+        d[p] = plane.offset;
+    }
+    const auto lane = [&](std::size_t i) CML_ALWAYS_INLINE {
+        std::uint32_t inside = 1;
+        static_for<6>([&](unsigned int p) CML_ALWAYS_INLINE {
+            inside &= margin(a[p], b[p], c[p], d[p], i) >= 0;
+        });
+        return inside;
+    };
+
+    std::uint64_t word = 0;
+    for (std::size_t block = 0; block < count; block += cull_lanes) {
+        const auto base = first + block;
+        const auto lanes = std::min(cull_lanes, count - block);
+        std::array<std::uint32_t, cull_lanes> inside;
+        if (lanes == cull_lanes) {
+            for (std::size_t l = 0; l < cull_lanes; l++) {
+                inside[l] = lane(base + l);
+            }
+        } else {
+            for (std::size_t l = 0; l < lanes; l++) {
+                inside[l] = lane(base + l);
+            }
+        }
+        for (std::size_t l = 0; l < lanes; l++) {
+            word |= std::uint64_t(inside[l]) << (block + l);
+        }
+    }
+    return word;
+}
+
+template <std::floating_point T, typename Margin>
+void cull(const Frustum<T> &frustum, std::size_t count,
+          std::span<std::uint64_t> visible, ThreadPool &pool,
+          Margin &&margin) {
+    const auto isa = active_isa();
+    pool.parallel_for(0, count, cull_grain, [&](std::size_t first,
+                                                std::size_t last) {
+        run_with_isa(isa, [&] {
+            for (auto i = first; i < last; i += 64) {
+                const auto lanes = std::min<std::size_t>(64, last - i);
+                visible[i / 64] = cull_word(frustum, i, lanes, margin);
+            }
+        });
+    });
+}
+
+} // namespace detail
+
+// Number of 64-bit words in a visibility mask for `count` objects.
+constexpr std::size_t visibility_words(std::size_t count) {
+    return (count + 63) / 64;
+}
+
+namespace detail {
+
+inline void check_visibility_words(std::span<const std::uint64_t> visible,
+                                   std::size_t count) {
+    if (visible.size() < visibility_words(count)) {
+        throw std::invalid_argument("cull: visibility mask too small");
+    }
+}
+
+} // namespace detail
+
+// Sets bit i of `visible` (bit i % 64 of word i / 64) if sphere i intersects
+// the frustum. `visible` must hold visibility_words(centers.size()) words
+// and radii one radius per center; throws std::invalid_argument otherwise.
+template <std::floating_point T>
+void cull_spheres(const Frustum<T> &frustum, const VecBatch<T, 3> &centers,
+                  std::span<const T> radii, std::span<std::uint64_t> visible,
+                  ThreadPool &pool = ThreadPool::global()) {
+    if (radii.size() != centers.size()) {
+        throw std::invalid_argument("cull_spheres: size mismatch");
+    }
+    detail::check_visibility_words(visible, centers.size());
+    const auto *x = centers.component(0).data();
+    const auto *y = centers.component(1).data();
+    const auto *z = centers.component(2).data();
+    const auto *r = radii.data();
+    detail::cull(frustum, centers.size(), visible, pool,
+                 [=](T a, T b, T c, T d, std::size_t i) {
+                     return a * x[i] + b * y[i] + c * z[i] + d + r[i];
+                 });
+}
+
+// Sets bit i of `visible` if the box [mins[i], maxs[i]] intersects the
+// frustum. Throws std::invalid_argument as cull_spheres().
+template <std::floating_point T>
+void cull_aabbs(const Frustum<T> &frustum, const VecBatch<T, 3> &mins,
+                const VecBatch<T, 3> &maxs, std::span<std::uint64_t> visible,
+                ThreadPool &pool = ThreadPool::global()) {
+    if (maxs.size() != mins.size()) {
+        throw std::invalid_argument("cull_aabbs: size mismatch");
+    }
+    detail::check_visibility_words(visible, mins.size());
+    const auto *x0 = mins.component(0).data();
+    const auto *y0 = mins.component(1).data();
+    const auto *z0 = mins.component(2).data();
+    const auto *x1 = maxs.component(0).data();
+    const auto *y1 = maxs.component(1).data();
+    const auto *z1 = maxs.component(2).data();
+    // Twice the distance of the center plus the box's reach along the
+    // normal; branch-free so the lanes vectorize.
+    detail::cull(frustum, mins.size(), visible, pool,
+                 [=](T a, T b, T c, T d, std::size_t i) {
+                     return a * (x0[i] + x1[i]) +
+                            std::abs(a) * (x1[i] - x0[i]) +
+                            b * (y0[i] + y1[i]) +
+                            std::abs(b) * (y1[i] - y0[i]) +
+                            c * (z0[i] + z1[i]) +
+                            std::abs(c) * (z1[i] - z0[i]) + 2 * d;
+                 });
+}
+
+// Writes the indices of the set bits of the first `count` bits of `visible`
+// to `out` in increasing order.
+inline void compact_visible(std::span<const std::uint64_t> visible,
+                            std::size_t count, std::vector<std::uint32_t> &out,
+                            ThreadPool &pool = ThreadPool::global()) {
+    detail::check_visibility_words(visible, count);
+    const auto words = visibility_words(count);
+    const auto word_mask = [&](std::size_t w) {
+        const auto bits = count - 64 * w;
+        return bits >= 64 ? visible[w]
+                          : visible[w] & ((std::uint64_t(1) << bits) - 1);
+    };
+    constexpr std::size_t grain = detail::cull_grain / 64;
+    const auto chunks = (words + grain - 1) / grain;
+    std::vector<std::size_t> offsets(chunks + 1, 0);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        std::size_t total = 0;
+        for (auto w = c * grain; w < std::min(words, (c + 1) * grain); w++) {
+            total += static_cast<std::size_t>(std::popcount(word_mask(w)));
+        }
+        offsets[c + 1] = total;
+    });
+    for (auto c = 0u; c < chunks; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+    out.resize(offsets[chunks]);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        auto next = offsets[c];
+        for (auto w = c * grain; w < std::min(words, (c + 1) * grain); w++) {
+            for (auto bits = word_mask(w); bits != 0; bits &= bits - 1) {
+                out[next++] = static_cast<std::uint32_t>(
+                    64 * w + static_cast<std::size_t>(std::countr_zero(bits)));
+            }
+        }
+    });
+}
+
+} // namespace cml
@@ -0,0 +1,218 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace cml {
+
+namespace detail {
+
+// Cache blocking of the operands (the usual Goto/BLIS loop nest): a
+// gemm_kc x gemm_nc panel of B is packed once and shared by all tasks, each
+// task packs a gemm_mc x gemm_kc block of A and sweeps it over the B panel
+// one register tile at a time.
+inline constexpr std::size_t gemm_kc = 256;
+inline constexpr std::size_t gemm_mc = 96;
+inline constexpr std::size_t gemm_nc = 2048;
+
+// Register tile: Mr x Nr accumulators, Nr being two vectors of the ISA, and
+// Mr rows so that they fill about half of its vector registers.
+template <typename T, Isa isa> struct GemmTile {
+    static constexpr std::size_t nr = 2 * isa_vector_bytes<isa> / sizeof(T);
+    static constexpr std::size_t mr = isa == Isa::avx512 ? 8
+                                      : isa == Isa::avx2 ? 6
+                                                         : 4;
+};
+
+// Grow-only packing buffers; one for B panels (used by the thread calling
+// gemm) and one for A blocks (used by every thread running a task).
+template <typename T> T *gemm_buffer(unsigned int slot, std::size_t size) {
+    thread_local std::array<std::vector<T>, 2> buffers;
+    if (buffers[slot].size() < size) {
+        buffers[slot].resize(size);
+    }
+    return buffers[slot].data();
+}
+
+// Copy blocks into panels of Mr rows of A (stored column by column) or Nr
+// columns of B (stored row by row), zero-padding the last panel.
+template <std::size_t Mr, typename T>
+void pack_a(ConstMatrixView<T> a, T *out) {
+    for (std::size_t i0 = 0; i0 < a.rows(); i0 += Mr) {
+        const auto rows = std::min(Mr, a.rows() - i0);
+        for (std::size_t p = 0; p < a.cols(); p++) {
+            for (std::size_t i = 0; i < Mr; i++) {
+                *out++ = i < rows ? a.get(i0 + i, p) : T(0);
+            }
+        }
+    }
+}
+
+template <std::size_t Nr, typename T>
+void pack_b(ConstMatrixView<T> b, std::size_t first_panel,
+            std::size_t last_panel, T *out) {
+    for (auto panel = first_panel; panel < last_panel; panel++) {
+        const auto j0 = panel * Nr;
+        const auto cols = std::min(Nr, b.cols() - j0);
+        auto *dst = out + panel * Nr * b.rows();
+        for (std::size_t p = 0; p < b.rows(); p++) {
+            const auto *src = &b.get(p, j0);
+            for (std::size_t j = 0; j < Nr; j++) {
+                dst[j] = j < cols ? src[j] : T(0);
+            }
+            dst += Nr;
+        }
+    }
+}
+
+// acc = sum over p of column p of the A panel times row p of the B panel.
+// The fixed trip count inner loop becomes Nr / lanes vector FMAs.
+template <std::size_t Mr, std::size_t Nr, typename T>
+CML_ALWAYS_INLINE inline void
+gemm_micro_kernel(std::size_t kc, const T *a, const T *b,
+                  std::array<std::array<T, Nr>, Mr> &acc) {
+    for (auto &row : acc) {
+        row.fill(T(0));
+    }
+    for (std::size_t p = 0; p < kc; p++) {
+        static_for<Mr>([&](unsigned int i) CML_ALWAYS_INLINE {
+            const auto ai = a[i];
+            for (std::size_t j = 0; j < Nr; j++) {
+                acc[i][j] += ai * b[j];
+            }
+        });
+        a += Mr;
+        b += Nr;
+    }
+}
+
+// C block = alpha * packed A block * packed B panel + beta * C block.
+template <std::size_t Mr, std::size_t Nr, typename T>
+void gemm_macro_kernel(std::size_t kc, const T *a, const T *b, T alpha,
+                       T beta, MatrixView<T> c) {
+    std::array<std::array<T, Nr>, Mr> acc;
+    for (std::size_t j0 = 0; j0 < c.cols(); j0 += Nr) {
+        const auto cols = std::min(Nr, c.cols() - j0);
+        for (std::size_t i0 = 0; i0 < c.rows(); i0 += Mr) {
+            const auto rows = std::min(Mr, c.rows() - i0);
+            gemm_micro_kernel<Mr, Nr>(kc, a + i0 * kc, b + j0 * kc, acc);
+            for (std::size_t i = 0; i < rows; i++) {
+                auto *dst = &c.get(i0 + i, j0);
+                for (std::size_t j = 0; j < cols; j++) {
+                    dst[j] = beta == T(0)
+                                 ? alpha * acc[i][j]
+                                 : alpha * acc[i][j] + beta * dst[j];
+                }
+            }
+        }
+    }
+}
+
+template <Isa isa, typename T>
+void gemm_blocked(T alpha, ConstMatrixView<T> a, ConstMatrixView<T> b,
+                  T beta, MatrixView<T> c, ThreadPool &pool) {
+    constexpr auto mr = GemmTile<T, isa>::mr;
+    constexpr auto nr = GemmTile<T, isa>::nr;
+    const auto m = c.rows();
+    const auto n = c.cols();
+    const auto k = a.cols();
+    for (std::size_t jc = 0; jc < n; jc += gemm_nc) {
+        const auto nc = std::min(gemm_nc, n - jc);
+        const auto panels = (nc + nr - 1) / nr;
+        for (std::size_t pc = 0; pc < k; pc += gemm_kc) {
+            const auto kc = std::min(gemm_kc, k - pc);
+            auto *packed_b = gemm_buffer<T>(0, panels * nr * kc);
+            pool.parallel_for(0, panels, gemm_mc / nr + 1,
+                              [&](std::size_t first, std::size_t last) {
+                                  pack_b<nr>(b.block(pc, jc, kc, nc), first,
+                                             last, packed_b);
+                              });
+            // Later slices of k accumulate onto the first one.
+            const auto block_beta = pc == 0 ? beta : T(1);
+            pool.parallel_for(
+                0, m, gemm_mc, [&](std::size_t first, std::size_t last) {
+                    const auto rows = last - first;
+                    auto *packed_a =
+                        gemm_buffer<T>(1, (rows + mr - 1) / mr * mr * kc);
+                    pack_a<mr>(a.block(first, pc, rows, kc), packed_a);
+                    run_with_isa(isa, [&] {
+                        gemm_macro_kernel<mr, nr>(
+                            kc, packed_a, packed_b, alpha, block_beta,
+                            c.block(first, jc, rows, nc));
+                    });
+                });
+        }
+    }
+}
+
+template <typename T> void scale_in_place(T beta, MatrixView<T> c) {
+    for (std::size_t r = 0; r < c.rows(); r++) {
+        for (auto &v : c[r]) {
+            v = beta == T(0) ? T(0) : beta * v;
+        }
+    }
+}
+
+} // namespace detail
+
+// C = alpha * A * B + beta * C, with A m x k, B k x n and C m x n. C must
+// not overlap A or B. With beta == 0, C is only written. Tasks cover
+// detail::gemm_mc rows of C; the register tile and the kernels follow
+// active_isa().
+template <std::floating_point T>
+void gemm(T alpha, std::type_identity_t<ConstMatrixView<T>> a,
+          std::type_identity_t<ConstMatrixView<T>> b, T beta, MatrixView<T> c,
+          ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    if (a.cols() != b.rows() || a.rows() != c.rows() ||
+        b.cols() != c.cols()) {
+        throw std::invalid_argument("gemm: shape mismatch");
+    }
+    if (c.empty()) {
+        return;
+    }
+    if (a.cols() == 0 || alpha == T(0)) {
+        scale_in_place(beta, c);
+        return;
+    }
+    switch (active_isa()) {
+    case Isa::avx512:
+        gemm_blocked<Isa::avx512>(alpha, a, b, beta, c, pool);
+        break;
+    case Isa::avx2:
+        gemm_blocked<Isa::avx2>(alpha, a, b, beta, c, pool);
+        break;
+    case Isa::sse42:
+        gemm_blocked<Isa::sse42>(alpha, a, b, beta, c, pool);
+        break;
+    case Isa::baseline:
+        gemm_blocked<Isa::baseline>(alpha, a, b, beta, c, pool);
+        break;
+    }
+}
+
+// C = A * B.
+template <std::floating_point T>
+void gemm(std::type_identity_t<ConstMatrixView<T>> a,
+          std::type_identity_t<ConstMatrixView<T>> b, MatrixView<T> c,
+          ThreadPool &pool = ThreadPool::global()) {
+    gemm(T(1), a, b, T(0), c, pool);
+}
+
+template <std::floating_point T>
+DynamicMatrix<T> operator*(const DynamicMatrix<T> &lhs,
+                           const DynamicMatrix<T> &rhs) {
+    DynamicMatrix<T> result(lhs.rows(), rhs.cols());
+    gemm(lhs.view(), rhs.view(), result.view());
+    return result;
+}
+
+} // namespace cml
@@ -0,0 +1,413 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Opt-in counters of Matrix and Vec operations.
+//
+// Compiled with CML_ENABLE_INSTRUMENTATION defined, every hooked operation
+// adds one call, its arithmetic operations (a multiply-add counts as two)
+// and the bytes of its operands and result to a counter of the calling
+// thread, keyed by (operation, rows, cols, element type). Vecs count as
+// Dim x 1, products as the shape of their left operand. Counts are
+// exclusive: an operation built from other hooked operations (e.g. lookAt()
+// from Vec::cross()) only counts its own arithmetic.
+//
+// Without the define the hooks expand to nothing; the snapshot API below
+// still compiles and reports nothing.
+
+namespace cml::instrumentation {
+
+inline constexpr bool enabled =
+#if defined(CML_ENABLE_INSTRUMENTATION)
+    true;
+#else
+    false;
+#endif
+
+enum class Op : std::uint8_t {
+    matrix_multiply,
+    matrix_scale,
+    matrix_add,
+    matrix_subtract,
+    matrix_negate,
+    matrix_transpose,
+    matrix_vector_multiply,
+    affine_multiply,
+    vec_add,
+    vec_subtract,
+    vec_negate,
+    vec_scale,
+    vec_divide,
+    vec_dot,
+    vec_cross,
+    vec_length_sq,
+    vec_length,
+    vec_normalize,
+    vec_lerp,
+    rotate,
+    translate,
+    look_at,
+    perspective,
+};
+
+constexpr std::string_view op_name(Op op) {
+    constexpr std::array<std::string_view, 23> names{
+        "matrix_multiply",
+        "matrix_scale",
+        "matrix_add",
+        "matrix_subtract",
+        "matrix_negate",
+        "matrix_transpose",
+        "matrix_vector_multiply",
+        "affine_multiply",
+        "vec_add",
+        "vec_subtract",
+        "vec_negate",
+        "vec_scale",
+        "vec_divide",
+        "vec_dot",
+        "vec_cross",
+        "vec_length_sq",
+        "vec_length",
+        "vec_normalize",
+        "vec_lerp",
+        "rotate",
+        "translate",
+        "look_at",
+        "perspective",
+    };
+    return names[static_cast<std::size_t>(op)];
+}
+
+template <typename T> constexpr std::string_view type_name() {
+    if constexpr (std::is_same_v<T, float>) {
+        return "float";
+    } else if constexpr (std::is_same_v<T, double>) {
+        return "double";
+    } else if constexpr (std::is_same_v<T, long double>) {
+        return "long double";
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        return std::array<std::string_view, 9>{
+            "", "int8", "int16", "", "int32", "", "", "", "int64"}[sizeof(T)];
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::array<std::string_view, 9>{
+            "", "uint8", "uint16", "", "uint32", "", "", "",
+            "uint64"}[sizeof(T)];
+    } else {
+        return "other";
+    }
+}
+
+struct OpKey {
+    Op op;
+    unsigned int rows;
+    unsigned int cols;
+    std::string_view type;
+
+    friend bool operator==(const OpKey &, const OpKey &) = default;
+    friend bool operator<(const OpKey &a, const OpKey &b) {
+        return std::tie(a.op, a.type, a.rows, a.cols) <
+               std::tie(b.op, b.type, b.rows, b.cols);
+    }
+};
+
+struct OpCounters {
+    std::uint64_t calls = 0;
+    std::uint64_t flops = 0;
+    std::uint64_t bytes = 0;
+
+    OpCounters &operator+=(const OpCounters &rhs) {
+        calls += rhs.calls;
+        flops += rhs.flops;
+        bytes += rhs.bytes;
+        return *this;
+    }
+    friend bool operator==(const OpCounters &, const OpCounters &) = default;
+};
+
+struct OpRecord {
+    OpKey key;
+    OpCounters counters;
+};
+
+// Counters of some set of threads, one record per key, sorted by key.
+class Snapshot {
+  public:
+    const std::vector<OpRecord> &records() const { return m_records; }
+    bool empty() const { return m_records.empty(); }
+
+    void add(const OpKey &key, const OpCounters &counters) {
+        const auto it = std::lower_bound(
+            m_records.begin(), m_records.end(), key,
+            [](const OpRecord &r, const OpKey &k) { return r.key < k; });
+        if (it != m_records.end() && it->key == key) {
+            it->counters += counters;
+        } else {
+            m_records.insert(it, {key, counters});
+        }
+    }
+
+    void merge(const Snapshot &other) {
+        for (const auto &record : other.m_records) {
+            add(record.key, record.counters);
+        }
+    }
+
+    // Counters of the key, zero if it was never hit.
+    OpCounters find(const OpKey &key) const {
+        for (const auto &record : m_records) {
+            if (record.key == key) {
+                return record.counters;
+            }
+        }
+        return {};
+    }
+
+    OpCounters total() const {
+        OpCounters sum;
+        for (const auto &record : m_records) {
+            sum += record.counters;
+        }
+        return sum;
+    }
+
+    // {"operations": [{"op", "rows", "cols", "type", "calls", "flops",
+    // "bytes"}, ...], "total": {"calls", "flops", "bytes"}}
+    void write_json(std::ostream &out) const {
+        const auto counters = [&](const OpCounters &c) {
+            out << "\"calls\": " << c.calls << ", \"flops\": " << c.flops
+                << ", \"bytes\": " << c.bytes;
+        };
+        out << "{\"operations\": [";
+        for (auto i = 0u; i < m_records.size(); i++) {
+            const auto &r = m_records[i];
+            out << (i == 0 ? "\n" : ",\n") << "  {\"op\": \""
+                << op_name(r.key.op) << "\", \"rows\": " << r.key.rows
+                << ", \"cols\": " << r.key.cols << ", \"type\": \""
+                << r.key.type << "\", ";
+            counters(r.counters);
+            out << "}";
+        }
+        out << "\n], \"total\": {";
+        counters(total());
+        out << "}}\n";
+    }
+
+    std::string to_json() const {
+        std::ostringstream out;
+        write_json(out);
+        return out.str();
+    }
+
+  private:
+    std::vector<OpRecord> m_records;
+};
+
+namespace detail {
+
+// Counters of one thread. Only the owning thread writes them, with relaxed
+// atomics so that snapshots may read them concurrently. Blocks are
+// allocated on first use and never move.
+class ThreadCounters {
+  public:
+    static constexpr std::size_t block_size = 256;
+    static constexpr std::size_t max_blocks = 256;
+    static constexpr std::size_t max_sites = block_size * max_blocks;
+
+    struct Counter {
+        std::atomic<std::uint64_t> calls{0};
+        std::atomic<std::uint64_t> flops{0};
+        std::atomic<std::uint64_t> bytes{0};
+    };
+    using Block = std::array<Counter, block_size>;
+
+    ThreadCounters();
+    ~ThreadCounters();
+
+    void add(std::uint32_t site, std::uint64_t flops, std::uint64_t bytes) {
+        auto *block =
+            m_blocks[site / block_size].load(std::memory_order_acquire);
+        if (block == nullptr) {
+            block = new Block;
+            m_blocks[site / block_size].store(block,
+                                              std::memory_order_release);
+        }
+        auto &counter = (*block)[site % block_size];
+        const auto bump = [](std::atomic<std::uint64_t> &c, std::uint64_t v) {
+            c.store(c.load(std::memory_order_relaxed) + v,
+                    std::memory_order_relaxed);
+        };
+        bump(counter.calls, 1);
+        bump(counter.flops, flops);
+        bump(counter.bytes, bytes);
+    }
+
+    OpCounters get(std::uint32_t site) const {
+        const auto *block =
+            m_blocks[site / block_size].load(std::memory_order_acquire);
+        if (block == nullptr) {
+            return {};
+        }
+        const auto &counter = (*block)[site % block_size];
+        return {counter.calls.load(std::memory_order_relaxed),
+                counter.flops.load(std::memory_order_relaxed),
+                counter.bytes.load(std::memory_order_relaxed)};
+    }
+
+    void clear() {
+        for (auto &slot : m_blocks) {
+            if (auto *block = slot.load(std::memory_order_acquire)) {
+                for (auto &counter : *block) {
+                    counter.calls.store(0, std::memory_order_relaxed);
+                    counter.flops.store(0, std::memory_order_relaxed);
+                    counter.bytes.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+  private:
+    std::array<std::atomic<Block *>, max_blocks> m_blocks{};
+};
+
+// Every (op, rows, cols, type) that was hit gets a site number, below
+// ThreadCounters::max_sites (registering more throws std::length_error);
+// live threads register their counters here and fold them into `retired`
+// when they exit.
+struct Registry {
+    std::mutex mutex;
+    std::vector<OpKey> sites;
+    std::vector<ThreadCounters *> threads;
+    std::vector<OpCounters> retired;
+
+    static Registry &get() {
+        static Registry registry;
+        return registry;
+    }
+
+    std::uint32_t register_site(const OpKey &key) {
+        std::lock_guard lock(mutex);
+        const auto it = std::find(sites.begin(), sites.end(), key);
+        if (it != sites.end()) {
+            return static_cast<std::uint32_t>(it - sites.begin());
+        }
+        if (sites.size() == ThreadCounters::max_sites) {
+            throw std::length_error("cml: too many instrumentation sites");
+        }
+        sites.push_back(key);
+        retired.emplace_back();
+        return static_cast<std::uint32_t>(sites.size() - 1);
+    }
+};
+
+inline ThreadCounters::ThreadCounters() {
+    auto &registry = Registry::get();
+    std::lock_guard lock(registry.mutex);
+    registry.threads.push_back(this);
+}
+
+inline ThreadCounters::~ThreadCounters() {
+    auto &registry = Registry::get();
+    {
+        std::lock_guard lock(registry.mutex);
+        for (auto site = 0u; site < registry.sites.size(); site++) {
+            registry.retired[site] += get(site);
+        }
+        std::erase(registry.threads, this);
+    }
+    for (auto &slot : m_blocks) {
+        delete slot.load(std::memory_order_relaxed);
+    }
+}
+
+inline ThreadCounters &thread_counters() {
+    thread_local ThreadCounters counters;
+    return counters;
+}
+
+template <typename Counters>
+Snapshot collect(const Registry &registry, Counters &&counters_of) {
+    Snapshot snapshot;
+    for (auto site = 0u; site < registry.sites.size(); site++) {
+        const auto counters = counters_of(static_cast<std::uint32_t>(site));
+        if (counters.calls != 0) {
+            snapshot.add(registry.sites[site], counters);
+        }
+    }
+    return snapshot;
+}
+
+} // namespace detail
+
+// Adds one call of the operation to the calling thread's counters. Used
+// through CML_INSTRUMENT.
+template <Op op, unsigned int Rows, unsigned int Cols, typename T>
+void record(std::uint64_t flops, std::uint64_t bytes) {
+    static const auto site = detail::Registry::get().register_site(
+        {op, Rows, Cols, type_name<T>()});
+    detail::thread_counters().add(site, flops, bytes);
+}
+
+// Counters of all threads, including the ones that have exited.
+inline Snapshot snapshot() {
+    auto &registry = detail::Registry::get();
+    std::lock_guard lock(registry.mutex);
+    return detail::collect(registry, [&](std::uint32_t site) {
+        auto counters = registry.retired[site];
+        for (const auto *thread : registry.threads) {
+            counters += thread->get(site);
+        }
+        return counters;
+    });
+}
+
+// Counters of the calling thread.
+inline Snapshot thread_snapshot() {
+    auto &registry = detail::Registry::get();
+    const auto &counters = detail::thread_counters();
+    std::lock_guard lock(registry.mutex);
+    return detail::collect(registry, [&](std::uint32_t site) {
+        return counters.get(site);
+    });
+}
+
+// Zeroes all counters. Counts made concurrently by other threads may be
+// lost, so call it while no instrumented code runs.
+inline void reset() {
+    auto &registry = detail::Registry::get();
+    std::lock_guard lock(registry.mutex);
+    for (auto *thread : registry.threads) {
+        thread->clear();
+    }
+    std::fill(registry.retired.begin(), registry.retired.end(),
+              OpCounters{});
+}
+
+} // namespace cml::instrumentation
+
+#if defined(CML_ENABLE_INSTRUMENTATION)
+#define CML_INSTRUMENT(op, rows, cols, T, flops, bytes)                       \
+    do {                                                                       \
+        if (!std::is_constant_evaluated()) {                                   \
+            ::cml::instrumentation::record<::cml::instrumentation::Op::op,     \
+                                           rows, cols, T>(flops, bytes);       \
+        }                                                                      \
+    } while (false)
+#else
+#define CML_INSTRUMENT(op, rows, cols, T, flops, bytes)                       \
+    do {                                                                       \
+    } while (false)
+#endif
@@ -0,0 +1,529 @@
+#pragma once
+#include "common.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace cml {
+
+template <std::floating_point T> struct KdNeighbor {
+    std::uint32_t index;
+    T distance_sq;
+
+    friend bool operator<(const KdNeighbor &a, const KdNeighbor &b) {
+        return a.distance_sq < b.distance_sq ||
+               (a.distance_sq == b.distance_sq && a.index < b.index);
+    }
+};
+
+// Variable length neighbor lists of a batched query, stored back to back:
+// the neighbors of query q are neighbors[offsets[q], offsets[q + 1]).
+template <std::floating_point T> struct KdNeighborLists {
+    std::vector<std::size_t> offsets;
+    std::vector<KdNeighbor<T>> neighbors;
+
+    std::span<const KdNeighbor<T>> operator[](std::size_t query) const {
+        return std::span<const KdNeighbor<T>>(neighbors)
+            .subspan(offsets[query], offsets[query + 1] - offsets[query]);
+    }
+    std::size_t size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+};
+
+// k-d tree over a point set with an implicit, pointer-free layout.
+//
+// The points are permuted so that the subtree over positions [lo, hi) has
+// its splitting point at mid = lo + (hi - lo) / 2, the left subtree in
+// [lo, mid) and the right subtree in [mid + 1, hi). Only the split
+// dimension of each splitting point is stored; ranges of at most
+// leaf_size points are scanned linearly.
+//
+// Approximate queries take an epsilon >= 0: a subtree is skipped unless it
+// may contain a point closer than (current k-th distance) / (1 + epsilon),
+// so every reported neighbor is within a factor (1 + epsilon) of the
+// true one.
+template <std::floating_point T, unsigned int Dim> class KdTree {
+  public:
+    using Point = Vec<T, Dim>;
+    using Neighbor = KdNeighbor<T>;
+    // A point in tree order together with its index in the build input.
+    struct Node {
+        Point point;
+        std::uint32_t index;
+    };
+    static constexpr std::size_t leaf_size = 8;
+
+    KdTree() = default;
+
+    template <std::floating_point LenT>
+    explicit KdTree(std::span<const Vec<T, Dim, LenT>> points,
+                    ThreadPool &pool = ThreadPool::global()) {
+        build(points, pool);
+    }
+
+    template <std::floating_point LenT>
+    void build(std::span<const Vec<T, Dim, LenT>> points,
+               ThreadPool &pool = ThreadPool::global());
+
+    std::size_t size() const { return m_nodes.size(); }
+    bool empty() const { return m_nodes.empty(); }
+    std::span<const Node> nodes() const { return m_nodes; }
+
+    // The (up to) k nearest points to q, sorted by distance. `out` is
+    // cleared first; reusing it across calls avoids allocations.
+    void knn(const Point &q, std::size_t k, std::vector<Neighbor> &out,
+             T epsilon = T(0)) const;
+    std::vector<Neighbor> knn(const Point &q, std::size_t k,
+                              T epsilon = T(0)) const {
+        std::vector<Neighbor> out;
+        knn(q, k, out, epsilon);
+        return out;
+    }
+
+    // All points within `radius` of q (inclusive), in no particular order.
+    void radius_search(const Point &q, T radius,
+                       std::vector<Neighbor> &out) const;
+    std::vector<Neighbor> radius_search(const Point &q, T radius) const {
+        std::vector<Neighbor> out;
+        radius_search(q, radius, out);
+        return out;
+    }
+
+    // k nearest neighbors of every query, written to out[q * k, q * k + k);
+    // Throws std::invalid_argument if out holds fewer than queries.size() * k
+    // neighbors.
+    // When the tree has fewer than k points the remaining slots hold
+    // index = UINT32_MAX and an infinite distance.
+    template <std::floating_point LenT>
+    void knn_batch(std::span<const Vec<T, Dim, LenT>> queries, std::size_t k,
+                   std::span<Neighbor> out, T epsilon = T(0),
+                   ThreadPool &pool = ThreadPool::global()) const;
+
+    // Neighbors within `radius` of every query, each list sorted by
+    // distance.
+    template <std::floating_point LenT>
+    KdNeighborLists<T>
+    radius_search_batch(std::span<const Vec<T, Dim, LenT>> queries, T radius,
+                        ThreadPool &pool = ThreadPool::global()) const;
+
+  private:
+    struct Task {
+        std::size_t lo;
+        std::size_t hi;
+    };
+
+    // Ranges at least this large are split by split_range_parallel(),
+    // smaller ones by std::nth_element. The choice only depends on the
+    // range, so the layout does not depend on the pool size.
+    static constexpr std::size_t parallel_split_size = 1 << 16;
+
+    // A subtree still to be searched, with the per-axis offsets from the
+    // query to the subtree's cell and their squared length.
+    struct Pending {
+        std::size_t lo;
+        std::size_t hi;
+        std::array<T, Dim> offsets;
+        T bound;
+    };
+
+    static T distance_sq(const Point &a, const Point &b) {
+        T sum = 0;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            const auto diff = a[d] - b[d];
+            sum += diff * diff;
+        });
+        return sum;
+    }
+
+    // Orders nodes by their coordinate along dim, then by input index.
+    static auto less_along(unsigned int dim) {
+        return [dim](const Node &a, const Node &b) {
+            return a.point[dim] < b.point[dim] ||
+                   (a.point[dim] == b.point[dim] && a.index < b.index);
+        };
+    }
+    static unsigned int widest_dim(const Point &min, const Point &max) {
+        unsigned int dim = 0;
+        for (auto d = 1u; d < Dim; d++) {
+            if (max[d] - min[d] > max[dim] - min[dim]) {
+                dim = d;
+            }
+        }
+        return dim;
+    }
+    void bounds(std::size_t lo, std::size_t hi, Point &min, Point &max) const;
+
+    void split_range(std::size_t lo, std::size_t hi);
+    void split_range_parallel(std::size_t lo, std::size_t hi,
+                              std::vector<Node> &scratch, ThreadPool &pool);
+    void build_range(std::size_t lo, std::size_t hi);
+    void collect_tasks(std::size_t lo, std::size_t hi, std::size_t task_size,
+                       std::vector<Task> &tasks, std::vector<Node> &scratch,
+                       ThreadPool &pool);
+
+    template <typename Visit, typename Bound>
+    void search(const Point &q, Visit &&visit, Bound &&bound) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<std::uint8_t> m_split_dims;
+};
+
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::bounds(std::size_t lo, std::size_t hi, Point &min,
+                            Point &max) const {
+    min = m_nodes[lo].point;
+    max = m_nodes[lo].point;
+    for (auto i = lo + 1; i < hi; i++) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            min[d] = std::min(min[d], m_nodes[i].point[d]);
+            max[d] = std::max(max[d], m_nodes[i].point[d]);
+        });
+    }
+}
+
+// Partitions [lo, hi) around its median along the dimension of largest
+// spread.
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::split_range(std::size_t lo, std::size_t hi) {
+    Point min, max;
+    bounds(lo, hi, min, max);
+    const auto dim = widest_dim(min, max);
+    const auto mid = lo + (hi - lo) / 2;
+    const auto first = m_nodes.begin();
+    std::nth_element(first + static_cast<std::ptrdiff_t>(lo),
+                     first + static_cast<std::ptrdiff_t>(mid),
+                     first + static_cast<std::ptrdiff_t>(hi),
+                     less_along(dim));
+    m_split_dims[mid] = static_cast<std::uint8_t>(dim);
+}
+
+// split_range() for large ranges, spread over the pool: the bounding box
+// is reduced per chunk, two pivots taken from an even sample bracket the
+// median, and the points are moved below, between and above the pivots
+// through `scratch` by per-chunk counts and offsets, keeping their order
+// within each group. Only the points between the pivots, a few percent of
+// the range, are left for std::nth_element. If the sample misses the
+// median, the whole range goes to std::nth_element instead.
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::split_range_parallel(std::size_t lo, std::size_t hi,
+                                          std::vector<Node> &scratch,
+                                          ThreadPool &pool) {
+    constexpr std::size_t grain = 1 << 14;
+    const auto chunks = (hi - lo + grain - 1) / grain;
+    const auto chunk_lo = [&](std::size_t c) { return lo + c * grain; };
+    const auto chunk_hi = [&](std::size_t c) {
+        return std::min(hi, lo + (c + 1) * grain);
+    };
+
+    std::vector<std::array<Point, 2>> boxes(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        bounds(chunk_lo(c), chunk_hi(c), boxes[c][0], boxes[c][1]);
+    });
+    auto min = boxes[0][0], max = boxes[0][1];
+    for (const auto &box : boxes) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            min[d] = std::min(min[d], box[0][d]);
+            max[d] = std::max(max[d], box[1][d]);
+        });
+    }
+    const auto dim = widest_dim(min, max);
+    const auto less = less_along(dim);
+    const auto mid = lo + (hi - lo) / 2;
+    const auto first = m_nodes.begin();
+    m_split_dims[mid] = static_cast<std::uint8_t>(dim);
+
+    constexpr std::size_t samples = 1024, margin = 48;
+    std::vector<Node> sample(samples);
+    for (std::size_t i = 0; i < samples; i++) {
+        sample[i] = m_nodes[lo + i * (hi - lo) / samples];
+    }
+    std::sort(sample.begin(), sample.end(), less);
+    const auto rank = (mid - lo) * samples / (hi - lo);
+    const auto low = sample[rank > margin ? rank - margin : 0];
+    const auto high = sample[std::min(rank + margin, samples - 1)];
+    // less_along() without branches: the comparisons are unpredictable.
+    const auto group = [&](const Node &node) {
+        const auto x = node.point[dim];
+        const bool above_low =
+            (x > low.point[dim]) |
+            ((x == low.point[dim]) & (node.index >= low.index));
+        const bool above_high =
+            (x > high.point[dim]) |
+            ((x == high.point[dim]) & (node.index > high.index));
+        return static_cast<std::size_t>(above_low) +
+               static_cast<std::size_t>(above_high);
+    };
+
+    std::vector<std::array<std::size_t, 3>> offsets(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        offsets[c] = {};
+        for (auto i = chunk_lo(c); i < chunk_hi(c); i++) {
+            offsets[c][group(m_nodes[i])]++;
+        }
+    });
+    std::array<std::size_t, 3> totals{};
+    for (const auto &counts : offsets) {
+        for (auto g = 0u; g < 3; g++) {
+            totals[g] += counts[g];
+        }
+    }
+    const auto middle_lo = lo + totals[0];
+    const auto middle_hi = middle_lo + totals[1];
+    if (mid < middle_lo || mid >= middle_hi) {
+        std::nth_element(first + static_cast<std::ptrdiff_t>(lo),
+                         first + static_cast<std::ptrdiff_t>(mid),
+                         first + static_cast<std::ptrdiff_t>(hi), less);
+        return;
+    }
+    std::array<std::size_t, 3> next{lo, middle_lo, middle_hi};
+    for (auto &counts : offsets) {
+        for (auto g = 0u; g < 3; g++) {
+            const auto count = counts[g];
+            counts[g] = next[g];
+            next[g] += count;
+        }
+    }
+
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        auto at = offsets[c];
+        for (auto i = chunk_lo(c); i < chunk_hi(c); i++) {
+            scratch[at[group(m_nodes[i])]++] = m_nodes[i];
+        }
+    });
+    pool.parallel_for(lo, hi, grain, [&](std::size_t a, std::size_t b) {
+        std::copy(scratch.begin() + static_cast<std::ptrdiff_t>(a),
+                  scratch.begin() + static_cast<std::ptrdiff_t>(b),
+                  first + static_cast<std::ptrdiff_t>(a));
+    });
+    std::nth_element(first + static_cast<std::ptrdiff_t>(middle_lo),
+                     first + static_cast<std::ptrdiff_t>(mid),
+                     first + static_cast<std::ptrdiff_t>(middle_hi), less);
+}
+
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::build_range(std::size_t lo, std::size_t hi) {
+    if (hi - lo <= leaf_size) {
+        return;
+    }
+    split_range(lo, hi);
+    const auto mid = lo + (hi - lo) / 2;
+    build_range(lo, mid);
+    build_range(mid + 1, hi);
+}
+
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::collect_tasks(std::size_t lo, std::size_t hi,
+                                   std::size_t task_size,
+                                   std::vector<Task> &tasks,
+                                   std::vector<Node> &scratch,
+                                   ThreadPool &pool) {
+    if (hi - lo < parallel_split_size &&
+        (hi - lo <= task_size || hi - lo <= leaf_size)) {
+        tasks.push_back({lo, hi});
+        return;
+    }
+    if (hi - lo >= parallel_split_size) {
+        split_range_parallel(lo, hi, scratch, pool);
+    } else {
+        split_range(lo, hi);
+    }
+    const auto mid = lo + (hi - lo) / 2;
+    collect_tasks(lo, mid, task_size, tasks, scratch, pool);
+    collect_tasks(mid + 1, hi, task_size, tasks, scratch, pool);
+}
+
+template <std::floating_point T, unsigned int Dim>
+template <std::floating_point LenT>
+void KdTree<T, Dim>::build(std::span<const Vec<T, Dim, LenT>> points,
+                           ThreadPool &pool) {
+    m_nodes.resize(points.size());
+    m_split_dims.assign(points.size(), 0);
+    for (auto i = 0u; i < points.size(); i++) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            m_nodes[i].point[d] = points[i][d];
+        });
+        m_nodes[i].index = static_cast<std::uint32_t>(i);
+    }
+
+    // The upper levels are partitioned up front, the large ranges among
+    // them each by a partition spread over the pool; the subtrees below
+    // them are independent and built in parallel. Ties in the median are
+    // broken by input index, so the tree does not depend on the pool size.
+    const auto task_size =
+        std::max<std::size_t>(points.size() / (8 * pool.size()), 1 << 12);
+    std::vector<Node> scratch(
+        points.size() >= parallel_split_size ? points.size() : 0);
+    std::vector<Task> tasks;
+    collect_tasks(0, m_nodes.size(), task_size, tasks, scratch, pool);
+    pool.parallel_for_each(0, tasks.size(), 1, [&](std::size_t t) {
+        build_range(tasks[t].lo, tasks[t].hi);
+    });
+}
+
+// Depth-first search visiting the nearer child first. visit(position,
+// distance_sq) is called for candidate points; bound() returns the current
+// pruning distance (squared), already divided by (1 + epsilon)^2. Cells are
+// pruned by their incrementally updated distance to the query (Arya and
+// Mount), which is tighter than the distance to the last splitting plane.
+template <std::floating_point T, unsigned int Dim>
+template <typename Visit, typename Bound>
+void KdTree<T, Dim>::search(const Point &q, Visit &&visit,
+                            Bound &&bound) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+    Pending stack[64];
+    unsigned int top = 0;
+    stack[top++] = {0, m_nodes.size(), {}, T(0)};
+    while (top > 0) {
+        auto [lo, hi, offsets, lower] = stack[--top];
+        if (lower > bound()) {
+            continue;
+        }
+        while (hi - lo > leaf_size) {
+            const auto mid = lo + (hi - lo) / 2;
+            const auto dim = m_split_dims[mid];
+            const auto diff = q[dim] - m_nodes[mid].point[dim];
+            visit(mid, distance_sq(q, m_nodes[mid].point));
+            const auto far_lower =
+                lower - offsets[dim] * offsets[dim] + diff * diff;
+            if (far_lower <= bound()) {
+                auto &far = stack[top++];
+                far = diff < 0 ? Pending{mid + 1, hi, offsets, far_lower}
+                               : Pending{lo, mid, offsets, far_lower};
+                far.offsets[dim] = diff;
+            }
+            if (diff < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        for (auto i = lo; i < hi; i++) {
+            visit(i, distance_sq(q, m_nodes[i].point));
+        }
+    }
+}
+
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::knn(const Point &q, std::size_t k,
+                         std::vector<Neighbor> &out, T epsilon) const {
+    out.clear();
+    if (k == 0) {
+        return;
+    }
+    const auto scale = T(1) / ((T(1) + epsilon) * (T(1) + epsilon));
+    auto worst = std::numeric_limits<T>::infinity();
+    // `out` is a max-heap on distance while searching.
+    search(
+        q,
+        [&](std::size_t i, T d) {
+            if (out.size() < k) {
+                out.push_back({m_nodes[i].index, d});
+                std::push_heap(out.begin(), out.end());
+                if (out.size() == k) {
+                    worst = out.front().distance_sq;
+                }
+            } else if (d < worst) {
+                std::pop_heap(out.begin(), out.end());
+                out.back() = {m_nodes[i].index, d};
+                std::push_heap(out.begin(), out.end());
+                worst = out.front().distance_sq;
+            }
+        },
+        [&] { return worst * scale; });
+    std::sort_heap(out.begin(), out.end());
+}
+
+template <std::floating_point T, unsigned int Dim>
+void KdTree<T, Dim>::radius_search(const Point &q, T radius,
+                                   std::vector<Neighbor> &out) const {
+    out.clear();
+    const auto radius_sq = radius * radius;
+    search(
+        q,
+        [&](std::size_t i, T d) {
+            if (d <= radius_sq) {
+                out.push_back({m_nodes[i].index, d});
+            }
+        },
+        [&] { return radius_sq; });
+}
+
+template <std::floating_point T, unsigned int Dim>
+template <std::floating_point LenT>
+void KdTree<T, Dim>::knn_batch(std::span<const Vec<T, Dim, LenT>> queries,
+                               std::size_t k, std::span<Neighbor> out,
+                               T epsilon, ThreadPool &pool) const {
+    if (out.size() < queries.size() * k) {
+        throw std::invalid_argument("KdTree::knn_batch: output too small");
+    }
+    const Neighbor missing{std::numeric_limits<std::uint32_t>::max(),
+                           std::numeric_limits<T>::infinity()};
+    pool.parallel_for(0, queries.size(), 256, [&](std::size_t first,
+                                                  std::size_t last) {
+        std::vector<Neighbor> found;
+        found.reserve(k);
+        for (auto q = first; q < last; q++) {
+            Point p;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                p[d] = queries[q][d];
+            });
+            knn(p, k, found, epsilon);
+            auto slot = out.subspan(q * k, k);
+            std::copy(found.begin(), found.end(), slot.begin());
+            std::fill(slot.begin() + static_cast<std::ptrdiff_t>(found.size()),
+                      slot.end(), missing);
+        }
+    });
+}
+
+template <std::floating_point T, unsigned int Dim>
+template <std::floating_point LenT>
+KdNeighborLists<T>
+KdTree<T, Dim>::radius_search_batch(std::span<const Vec<T, Dim, LenT>> queries,
+                                    T radius, ThreadPool &pool) const {
+    constexpr std::size_t grain = 256;
+    const auto chunks = (queries.size() + grain - 1) / grain;
+    std::vector<std::vector<Neighbor>> found(chunks);
+    std::vector<std::size_t> counts(queries.size());
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        std::vector<Neighbor> local;
+        const auto last = std::min(queries.size(), (c + 1) * grain);
+        for (auto q = c * grain; q < last; q++) {
+            Point p;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                p[d] = queries[q][d];
+            });
+            radius_search(p, radius, local);
+            std::sort(local.begin(), local.end());
+            counts[q] = local.size();
+            found[c].insert(found[c].end(), local.begin(), local.end());
+        }
+    });
+
+    KdNeighborLists<T> lists;
+    lists.offsets.resize(queries.size() + 1, 0);
+    for (auto q = 0u; q < queries.size(); q++) {
+        lists.offsets[q + 1] = lists.offsets[q] + counts[q];
+    }
+    lists.neighbors.resize(lists.offsets.back());
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        std::copy(found[c].begin(), found[c].end(),
+                  lists.neighbors.begin() +
+                      static_cast<std::ptrdiff_t>(lists.offsets[c * grain]));
+    });
+    return lists;
+}
+
+} // namespace cml
@@ -0,0 +1,108 @@
+#pragma once
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <system_error>
+#include <utility>
+
+// Memory mapping goes through mmap(), so this header (and binary_io.hpp and
+// text_io.hpp, which include it) is POSIX only.
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "mapped_file.hpp requires a POSIX system"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cml {
+
+// Read-only, private memory mapping of a whole file.
+class MappedFile {
+  public:
+    enum class Access { normal, sequential, random, will_need };
+
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "cannot open " + path.string());
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(),
+                                    "cannot stat " + path.string());
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size > 0) {
+            void *addr = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(),
+                                        "cannot map " + path.string());
+            }
+            m_data = static_cast<const std::byte *>(addr);
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)) {}
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+    ~MappedFile() { unmap(); }
+
+    std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+    std::size_t size() const { return m_size; }
+
+    void advise(Access access) const {
+        if (m_data == nullptr) {
+            return;
+        }
+        int advice = MADV_NORMAL;
+        switch (access) {
+        case Access::normal:
+            advice = MADV_NORMAL;
+            break;
+        case Access::sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case Access::random:
+            advice = MADV_RANDOM;
+            break;
+        case Access::will_need:
+            advice = MADV_WILLNEED;
+            break;
+        }
+        ::madvise(const_cast<std::byte *>(m_data), m_size, advice);
+    }
+
+  private:
+    void unmap() {
+        if (m_data != nullptr) {
+            ::munmap(const_cast<std::byte *>(m_data), m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+
+    const std::byte *m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+} // namespace cml
@@ -0,0 +1,141 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+// Products of many independent Mat4s stored as plain arrays of Matrix (for
+// instance bone palettes times bind-pose inverses). For data that already
+// lives in a MatrixBatch, multiply() in matrix_batch_ops.hpp works on the
+// interleaved layout directly.
+//
+// The output may be the same span as an input, but must not partially
+// overlap one.
+
+namespace cml {
+
+namespace detail {
+
+inline constexpr std::size_t mat4_batch_grain = 4096;
+
+// r = a * b for row-major 4x4 arrays. The row form is four dot products
+// per element and suits 128-bit vectors; the broadcast form accumulates
+// (column k of a, spread over rows) * (row k of b, repeated) as two
+// 16-element vectors per k, which maps onto one or two 256/512-bit
+// registers plus permutes.
+template <typename T>
+CML_ALWAYS_INLINE inline void mat4_product_rows(const T *a, const T *b,
+                                                T *out) {
+    std::array<T, 16> r;
+    for (auto i = 0u; i < 4; i++) {
+        for (auto j = 0u; j < 4; j++) {
+            r[i * 4 + j] = a[i * 4] * b[j] + a[i * 4 + 1] * b[4 + j] +
+                           a[i * 4 + 2] * b[8 + j] + a[i * 4 + 3] * b[12 + j];
+        }
+    }
+    for (auto e = 0u; e < 16; e++) {
+        out[e] = r[e];
+    }
+}
+
+template <typename T>
+CML_ALWAYS_INLINE inline void mat4_product_broadcast(const T *a, const T *b,
+                                                     T *out) {
+    std::array<T, 16> r{};
+    static_for<4>([&](unsigned int k) CML_ALWAYS_INLINE {
+        std::array<T, 16> av;
+        std::array<T, 16> bv;
+        static_for<16>([&](unsigned int e) CML_ALWAYS_INLINE {
+            av[e] = a[e / 4 * 4 + k];
+            bv[e] = b[k * 4 + e % 4];
+        });
+        for (auto e = 0u; e < 16; e++) {
+            r[e] += av[e] * bv[e];
+        }
+    });
+    for (auto e = 0u; e < 16; e++) {
+        out[e] = r[e];
+    }
+}
+
+// out[i] = a(i) * b(i) for i in [0, size), a and b returning pointers to
+// the matrices' elements.
+template <typename T, typename A, typename B>
+void mat4_products(std::size_t size, A &&a, B &&b,
+                   std::span<Matrix<4, 4, T>> out, ThreadPool &pool) {
+    static_assert(sizeof(Matrix<4, 4, T>) == 16 * sizeof(T));
+    const auto isa = active_isa();
+    const auto wide = isa >= Isa::avx2;
+    pool.parallel_for(
+        0, size, mat4_batch_grain, [&](std::size_t first, std::size_t last) {
+            run_with_isa(isa, [&] {
+                if (wide) {
+                    for (auto i = first; i < last; i++) {
+                        mat4_product_broadcast(a(i), b(i), &out[i].get(0, 0));
+                    }
+                } else {
+                    for (auto i = first; i < last; i++) {
+                        mat4_product_rows(a(i), b(i), &out[i].get(0, 0));
+                    }
+                }
+            });
+        });
+}
+
+} // namespace detail
+
+// out[i] = a[i] * b[i]. Throws std::invalid_argument unless the three spans
+// have the same size.
+template <std::floating_point T>
+void multiply_batch(std::type_identity_t<std::span<const Matrix<4, 4, T>>> a,
+                    std::type_identity_t<std::span<const Matrix<4, 4, T>>> b,
+                    std::span<Matrix<4, 4, T>> out,
+                    ThreadPool &pool = ThreadPool::global()) {
+    if (a.size() != b.size() || a.size() != out.size()) {
+        throw std::invalid_argument("multiply_batch: size mismatch");
+    }
+    detail::mat4_products<T>(
+        a.size(), [&](std::size_t i) { return &a[i].get(0, 0); },
+        [&](std::size_t i) { return &b[i].get(0, 0); }, out, pool);
+}
+
+// out[i] = a * b[i], e.g. a view-projection matrix times instance
+// transforms.
+template <std::floating_point T>
+void multiply_batch(const Matrix<4, 4, T> &a,
+                    std::type_identity_t<std::span<const Matrix<4, 4, T>>> b,
+                    std::span<Matrix<4, 4, T>> out,
+                    ThreadPool &pool = ThreadPool::global()) {
+    if (b.size() != out.size()) {
+        throw std::invalid_argument("multiply_batch: size mismatch");
+    }
+    // Copied, as it may be one of the outputs.
+    const auto m = a;
+    detail::mat4_products<T>(
+        b.size(), [&](std::size_t) { return &m.get(0, 0); },
+        [&](std::size_t i) { return &b[i].get(0, 0); }, out, pool);
+}
+
+// out[i] = a[i] * b, e.g. bone poses times a shared correction.
+template <std::floating_point T>
+void multiply_batch(std::type_identity_t<std::span<const Matrix<4, 4, T>>> a,
+                    const Matrix<4, 4, T> &b, std::span<Matrix<4, 4, T>> out,
+                    ThreadPool &pool = ThreadPool::global()) {
+    if (a.size() != out.size()) {
+        throw std::invalid_argument("multiply_batch: size mismatch");
+    }
+    // Copied, as it may be one of the outputs.
+    const auto m = b;
+    detail::mat4_products<T>(
+        a.size(), [&](std::size_t i) { return &a[i].get(0, 0); },
+        [&](std::size_t) { return &m.get(0, 0); }, out, pool);
+}
+
+} // namespace cml
@@ -1,5 +1,7 @@
 #pragma once
 #include "common.hpp"
+#include "instrumentation.hpp"
+#include "unroll.hpp"
 #include <algorithm>
 #include <array>
 #include <cmath>
@@ -18,7 +20,11 @@ concept SquareMatrix = requires {
     requires T::RowsCnt == T::ColsCnt;
 };
 
-template <unsigned int Rows, unsigned int Cols, arithmetic T = default_type>
+// Largest Rows * Cols * RHCols for which Matrix::operator* is generated as
+// straight-line code.
+inline constexpr unsigned int max_unrolled_product = 64;
+
+template <unsigned int Rows, unsigned int Cols, scalar T = default_type>
 class Matrix {
   public:
     static constexpr auto RowsCnt = Rows;
@@ -46,77 +52,105 @@ class Matrix {
     }
 
     Matrix<Cols, Rows, T> transposed() const {
+        CML_INSTRUMENT(matrix_transpose, Rows, Cols, T, 0,
+                       2 * Rows * Cols * sizeof(T));
         Matrix<Cols, Rows, T> t;
-        for (int i = 0; i < Rows; i++) {
-            for (int j = 0; j < Cols; j++) {
-                t[j][i] = get(i, j);
-            }
-        }
+        static_for<Rows>([&](unsigned int i) CML_ALWAYS_INLINE {
+            static_for<Cols>([&](unsigned int j) CML_ALWAYS_INLINE {
+                t.get(j, i) = get(i, j);
+            });
+        });
         return t;
     }
 
     Matrix operator-() {
+        CML_INSTRUMENT(matrix_negate, Rows, Cols, T, Rows * Cols,
+                       2 * Rows * Cols * sizeof(T));
         Matrix matrix;
-        for (std::size_t i = 0; i < Rows * Cols; ++i) {
-            matrix.vals[i] = -this->vals[i];
-        }
+        static_for<Rows * Cols>([&](unsigned int i) CML_ALWAYS_INLINE {
+            matrix.vals[i] = -vals[i];
+        });
         return matrix;
     }
 
     Matrix operator+(const Matrix &rhs) {
+        CML_INSTRUMENT(matrix_add, Rows, Cols, T, Rows * Cols,
+                       3 * Rows * Cols * sizeof(T));
         Matrix matrix;
-        for (int i = 0; i < Rows * Cols; i++) {
+        static_for<Rows * Cols>([&](unsigned int i) CML_ALWAYS_INLINE {
             matrix.vals[i] = vals[i] + rhs.vals[i];
-        }
+        });
         return matrix;
     }
 
     Matrix &operator+=(const Matrix &rhs) {
-        for (int i = 0; i < Rows * Cols; i++) {
-            vals[i] += rhs.vals[i];
-        }
+        CML_INSTRUMENT(matrix_add, Rows, Cols, T, Rows * Cols,
+                       3 * Rows * Cols * sizeof(T));
+        static_for<Rows * Cols>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { vals[i] += rhs.vals[i]; });
         return *this;
     }
 
     Matrix operator-(const Matrix &rhs) {
+        CML_INSTRUMENT(matrix_subtract, Rows, Cols, T, Rows * Cols,
+                       3 * Rows * Cols * sizeof(T));
         Matrix matrix;
-        for (int i = 0; i < Rows * Cols; i++) {
+        static_for<Rows * Cols>([&](unsigned int i) CML_ALWAYS_INLINE {
             matrix.vals[i] = vals[i] - rhs.vals[i];
-        }
+        });
         return matrix;
     }
 
     Matrix &operator-=(const Matrix &rhs) {
-        for (int i = 0; i < Rows * Cols; i++) {
-            vals[i] -= rhs.vals[i];
-        }
+        CML_INSTRUMENT(matrix_subtract, Rows, Cols, T, Rows * Cols,
+                       3 * Rows * Cols * sizeof(T));
+        static_for<Rows * Cols>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { vals[i] -= rhs.vals[i]; });
         return *this;
     }
 
+    // Small products (up to max_unrolled_product multiply-adds, which covers
+    // Mat4 * Mat4) are fully expanded; larger ones keep the row and column
+    // loops and only expand the dot products.
     // TODO: Consider transposing rhs to improve cache locality
     template <unsigned RHCols>
     Matrix<Rows, RHCols, T>
     operator*(const Matrix<Cols, RHCols, T> &rhs) const {
+        CML_INSTRUMENT(
+            matrix_multiply, Rows, Cols, T, 2 * Rows * Cols * RHCols,
+            (Rows * Cols + Cols * RHCols + Rows * RHCols) * sizeof(T));
         Matrix<Rows, RHCols, T> r;
-        for (auto col = 0; col < RHCols; col++) {
-            for (auto row = 0; row < Rows; row++) {
-                T sum = T();
-                for (auto k = 0u; k < Cols; k++) {
-                    sum += get(row, k) * rhs.get(k, col);
+        const auto element = [&](unsigned int row,
+                                 unsigned int col) CML_ALWAYS_INLINE {
+            T sum = T();
+            static_for<Cols>([&](unsigned int k) CML_ALWAYS_INLINE {
+                sum += get(row, k) * rhs.get(k, col);
+            });
+            r.get(row, col) = sum;
+        };
+        if constexpr (Rows * RHCols * Cols <= max_unrolled_product) {
+            static_for<Rows>([&](unsigned int row) CML_ALWAYS_INLINE {
+                static_for<RHCols>([&](unsigned int col) CML_ALWAYS_INLINE {
+                    element(row, col);
+                });
+            });
+        } else {
+            for (auto row = 0u; row < Rows; row++) {
+                for (auto col = 0u; col < RHCols; col++) {
+                    element(row, col);
                 }
-                r[row][col] = sum;
             }
         }
         return r;
     }
 
     Matrix operator*(const T &scalar) const {
+        CML_INSTRUMENT(matrix_scale, Rows, Cols, T, Rows * Cols,
+                       2 * Rows * Cols * sizeof(T));
         Matrix result;
-        for (unsigned int i = 0; i < Rows; ++i) {
-            for (unsigned int j = 0; j < Cols; ++j) {
-                result[i][j] = get(i, j) * scalar;
-            }
-        }
+        static_for<Rows * Cols>([&](unsigned int i) CML_ALWAYS_INLINE {
+            result.vals[i] = vals[i] * scalar;
+        });
         return result;
     }
 
@@ -168,9 +202,8 @@ class Matrix {
         requires SquareMatrix<Matrix<Rows, Cols, T>>
     {
         Matrix id;
-        for (unsigned int i = 0; i < Rows; ++i) {
-            id[i][i] = T(1);
-        }
+        static_for<Rows>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { id.get(i, i) = T(1); });
         return id;
     }
 
@@ -178,11 +211,11 @@ class Matrix {
     std::array<T, Rows * Cols> vals;
 };
 
-template <unsigned int Rows, unsigned int Cols, arithmetic T>
+template <unsigned int Rows, unsigned int Cols, scalar T>
 std::ostream &operator<<(std::ostream &os, const Matrix<Rows, Cols, T> &m) {
-    for (int i = 0; i < Rows; i++) {
+    for (auto i = 0u; i < Rows; i++) {
         os << "[";
-        for (int j = 0; j < Cols; j++) {
+        for (auto j = 0u; j < Cols; j++) {
             os << m[i][j];
             if (j != Cols - 1)
                 os << " ";
@@ -192,9 +225,9 @@ std::ostream &operator<<(std::ostream &os, const Matrix<Rows, Cols, T> &m) {
     return os;
 }
 
-template <arithmetic T = default_type> using Mat4 = Matrix<4, 4, T>;
-template <arithmetic T = default_type> using Mat3 = Matrix<3, 3, T>;
-template <arithmetic T = default_type> using Mat2 = Matrix<2, 2, T>;
+template <scalar T = default_type> using Mat4 = Matrix<4, 4, T>;
+template <scalar T = default_type> using Mat3 = Matrix<3, 3, T>;
+template <scalar T = default_type> using Mat2 = Matrix<2, 2, T>;
 using Mat4d = Mat4<double>;
 using Mat4f = Mat4<float>;
 using Mat3d = Mat3<double>;
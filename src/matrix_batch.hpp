@@ -0,0 +1,105 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace cml {
+
+// Interleaved storage for many Matrix<Rows, Cols, T>: matrices are grouped
+// in blocks of `lanes`, and within a block element (row, col) of all of
+// them is stored contiguously. A kernel loads a block's element (row, col)
+// as one SIMD register and works on `lanes` matrices at once; a whole block
+// is contiguous, so each kernel call streams through memory once.
+//
+// Element (row, col) of matrix i is at
+//   block(i / lanes)[(row * Cols + col) * lanes + i % lanes].
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+class MatrixBatch {
+  public:
+    using value_type = T;
+    static constexpr unsigned int rows = Rows;
+    static constexpr unsigned int cols = Cols;
+    static constexpr std::size_t lanes = 16;
+    static constexpr std::size_t block_size = Rows * Cols * lanes;
+
+    MatrixBatch() = default;
+    explicit MatrixBatch(std::size_t size) { resize(size); }
+
+    explicit MatrixBatch(std::span<const Matrix<Rows, Cols, T>> matrices) {
+        resize(matrices.size());
+        for (std::size_t i = 0; i < matrices.size(); i++) {
+            set(i, matrices[i]);
+        }
+    }
+
+    explicit MatrixBatch(const std::vector<Matrix<Rows, Cols, T>> &matrices)
+        : MatrixBatch(std::span<const Matrix<Rows, Cols, T>>(matrices)) {}
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    std::size_t blocks() const { return m_data.size() / block_size; }
+
+    // Resizes the batch; existing elements are not preserved. Lanes past
+    // size() in the last block are zero.
+    void resize(std::size_t size) {
+        m_size = size;
+        m_data.assign((size + lanes - 1) / lanes * block_size, T());
+    }
+
+    std::span<T, block_size> block(std::size_t b) {
+        return std::span<T, block_size>(m_data.data() + b * block_size,
+                                        block_size);
+    }
+    std::span<const T, block_size> block(std::size_t b) const {
+        return std::span<const T, block_size>(m_data.data() + b * block_size,
+                                              block_size);
+    }
+
+    T &get(std::size_t i, unsigned int row, unsigned int col) {
+        return m_data[index(i, row, col)];
+    }
+    T get(std::size_t i, unsigned int row, unsigned int col) const {
+        return m_data[index(i, row, col)];
+    }
+
+    Matrix<Rows, Cols, T> operator[](std::size_t i) const {
+        Matrix<Rows, Cols, T> m;
+        for (auto row = 0u; row < Rows; row++) {
+            for (auto col = 0u; col < Cols; col++) {
+                m.get(row, col) = get(i, row, col);
+            }
+        }
+        return m;
+    }
+
+    void set(std::size_t i, const Matrix<Rows, Cols, T> &m) {
+        for (auto row = 0u; row < Rows; row++) {
+            for (auto col = 0u; col < Cols; col++) {
+                get(i, row, col) = m.get(row, col);
+            }
+        }
+    }
+
+    std::vector<Matrix<Rows, Cols, T>> to_matrices() const {
+        std::vector<Matrix<Rows, Cols, T>> matrices(m_size);
+        for (std::size_t i = 0; i < m_size; i++) {
+            matrices[i] = operator[](i);
+        }
+        return matrices;
+    }
+
+  private:
+    static std::size_t index(std::size_t i, unsigned int row,
+                             unsigned int col) {
+        return i / lanes * block_size + (row * Cols + col) * lanes +
+               i % lanes;
+    }
+
+    std::size_t m_size = 0;
+    std::vector<T> m_data;
+};
+
+} // namespace cml
@@ -0,0 +1,511 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix_batch.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch_ops.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <stdexcept>
+
+// Factorizations and solves of many small independent systems stored in a
+// MatrixBatch, one matrix per SIMD lane. Every block is copied into local
+// arrays, factored or solved there with fixed trip count lane loops (which
+// the compiler turns into vector instructions for the level chosen by
+// run_with_isa, see vec_batch_ops.hpp), and stored back.
+//
+// Lanes are independent, so pivoting is done with per-lane selects rather
+// than branches. Nothing throws for singular or indefinite matrices: the
+// factorizations return how many of them there were, and their results hold
+// infinities or NaNs.
+
+namespace cml {
+
+namespace detail {
+
+static_assert(MatrixBatch<1, 1, float>::lanes == batch_lanes);
+
+template <typename T, std::size_t Count>
+using LaneBlock = std::array<Lanes<T>, Count>;
+
+// The lanes f(0), ..., f(batch_lanes - 1). Kernels assign the result rather
+// than updating a block element lane by lane: with the values built in a
+// local, GCC's vectorizer has no aliasing between block elements to prove.
+// Selects in f read both operands into locals first (not std::max), as a
+// conditional load keeps the loop from being if-converted.
+template <typename T, typename F>
+CML_ALWAYS_INLINE inline Lanes<T> make_lanes(F &&f) {
+    Lanes<T> r;
+    for (std::size_t l = 0; l < batch_lanes; l++) {
+        r[l] = f(l);
+    }
+    return r;
+}
+
+template <std::size_t Count, typename T>
+CML_ALWAYS_INLINE inline void load_block(const T *src,
+                                         LaneBlock<T, Count> &dst) {
+    for (std::size_t e = 0; e < Count; e++) {
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            dst[e][l] = src[e * batch_lanes + l];
+        }
+    }
+}
+
+template <std::size_t Count, typename T>
+CML_ALWAYS_INLINE inline void store_block(const LaneBlock<T, Count> &src,
+                                          T *dst) {
+    for (std::size_t e = 0; e < Count; e++) {
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            dst[e * batch_lanes + l] = src[e][l];
+        }
+    }
+}
+
+// Calls kernel(b, lanes) for every block b of a batch of `size` matrices;
+// returns the sum of what the kernel returned, which counts failed lanes.
+template <typename Kernel>
+std::size_t for_each_matrix_block(std::size_t size, ThreadPool &pool,
+                                  Kernel &&kernel) {
+    std::atomic<std::size_t> failed{0};
+    for_each_block(size, pool, [&](std::size_t base, std::size_t lanes) {
+        if (const std::size_t f = kernel(base / batch_lanes, lanes)) {
+            failed.fetch_add(f, std::memory_order_relaxed);
+        }
+    });
+    return failed.load();
+}
+
+template <typename T>
+CML_ALWAYS_INLINE inline std::size_t count_set(const Lanes<T> &flags,
+                                               std::size_t lanes) {
+    std::size_t count = 0;
+    for (std::size_t l = 0; l < lanes; l++) {
+        count += flags[l] != T(0);
+    }
+    return count;
+}
+
+// Row k of a is swapped with row pivot[l] >= k in every lane l. Pivot
+// indices are stored as T so that the selects stay one vector wide.
+template <unsigned int N, unsigned int Cols, typename T>
+CML_ALWAYS_INLINE inline void swap_rows(LaneBlock<T, N * Cols> &a,
+                                        unsigned int k,
+                                        const Lanes<T> &pivot) {
+    for (auto r = k + 1; r < N; r++) {
+        for (auto j = 0u; j < Cols; j++) {
+            auto &x = a[k * Cols + j];
+            auto &y = a[r * Cols + j];
+            const auto new_x = make_lanes<T>([&](std::size_t l) {
+                const auto xl = x[l];
+                const auto yl = y[l];
+                return pivot[l] == T(r) ? yl : xl;
+            });
+            y = make_lanes<T>([&](std::size_t l) {
+                const auto xl = x[l];
+                const auto yl = y[l];
+                return pivot[l] == T(r) ? xl : yl;
+            });
+            x = new_x;
+        }
+    }
+}
+
+// b[i] -= m * b[k], lane by lane, for the Cols elements of rows i and k.
+template <unsigned int Cols, typename T, std::size_t Count>
+CML_ALWAYS_INLINE inline void subtract_row(LaneBlock<T, Count> &b,
+                                           unsigned int i, const Lanes<T> &m,
+                                           unsigned int k) {
+    for (auto j = 0u; j < Cols; j++) {
+        const auto &bi = b[i * Cols + j];
+        const auto &bk = b[k * Cols + j];
+        b[i * Cols + j] =
+            make_lanes<T>([&](std::size_t l) { return bi[l] - m[l] * bk[l]; });
+    }
+}
+
+// b[i] /= d, lane by lane.
+template <unsigned int Cols, typename T, std::size_t Count>
+CML_ALWAYS_INLINE inline void divide_row(LaneBlock<T, Count> &b,
+                                         unsigned int i, const Lanes<T> &d) {
+    for (auto j = 0u; j < Cols; j++) {
+        const auto &bi = b[i * Cols + j];
+        b[i * Cols + j] =
+            make_lanes<T>([&](std::size_t l) { return bi[l] / d[l]; });
+    }
+}
+
+// In-place LU factorization with partial pivoting, P a = L U: L unit lower
+// triangular below the diagonal, U on and above it. pivots[k] is the row
+// swapped with row k at step k. Returns a flag per lane, set if a pivot
+// was zero.
+template <unsigned int N, typename T>
+CML_ALWAYS_INLINE inline Lanes<T> lu_lanes(LaneBlock<T, N * N> &a,
+                                           LaneBlock<T, N> &pivots) {
+    Lanes<T> singular{};
+    for (auto k = 0u; k < N; k++) {
+        const auto &akk = a[k * N + k];
+        auto largest =
+            make_lanes<T>([&](std::size_t l) { return std::abs(akk[l]); });
+        auto &pivot = pivots[k];
+        pivot.fill(T(k));
+        for (auto r = k + 1; r < N; r++) {
+            const auto &ark = a[r * N + k];
+            const auto row = T(r);
+            pivot = make_lanes<T>([&](std::size_t l) {
+                const auto p = pivot[l];
+                const auto v = std::abs(ark[l]);
+                const auto m = largest[l];
+                return v > m ? row : p;
+            });
+            largest = make_lanes<T>([&](std::size_t l) {
+                const auto v = std::abs(ark[l]);
+                const auto m = largest[l];
+                return v > m ? v : m;
+            });
+        }
+        swap_rows<N, N>(a, k, pivot);
+        singular = make_lanes<T>([&](std::size_t l) {
+            const auto s = singular[l];
+            return largest[l] == T(0) ? T(1) : s;
+        });
+        const auto inverse =
+            make_lanes<T>([&](std::size_t l) { return T(1) / akk[l]; });
+        for (auto i = k + 1; i < N; i++) {
+            const auto &aik = a[i * N + k];
+            a[i * N + k] = make_lanes<T>(
+                [&](std::size_t l) { return aik[l] * inverse[l]; });
+            for (auto j = k + 1; j < N; j++) {
+                const auto &aij = a[i * N + j];
+                const auto &akj = a[k * N + j];
+                a[i * N + j] = make_lanes<T>([&](std::size_t l) {
+                    return aij[l] - aik[l] * akj[l];
+                });
+            }
+        }
+    }
+    return singular;
+}
+
+// b = (L U)^-1 P b for the output of lu_lanes().
+template <unsigned int N, unsigned int K, typename T>
+CML_ALWAYS_INLINE inline void lu_solve_lanes(const LaneBlock<T, N * N> &lu,
+                                             const LaneBlock<T, N> &pivots,
+                                             LaneBlock<T, N * K> &b) {
+    for (auto k = 0u; k < N; k++) {
+        swap_rows<N, K>(b, k, pivots[k]);
+    }
+    for (auto i = 1u; i < N; i++) {
+        for (auto k = 0u; k < i; k++) {
+            subtract_row<K>(b, i, lu[i * N + k], k);
+        }
+    }
+    for (auto i = N; i-- > 0;) {
+        for (auto k = i + 1; k < N; k++) {
+            subtract_row<K>(b, i, lu[i * N + k], k);
+        }
+        divide_row<K>(b, i, lu[i * N + i]);
+    }
+}
+
+// In-place Cholesky factorization a = L L^T from the lower triangle of a;
+// the upper triangle is zeroed. Returns a flag per lane, set if a is not
+// positive definite.
+template <unsigned int N, typename T>
+CML_ALWAYS_INLINE inline Lanes<T> cholesky_lanes(LaneBlock<T, N * N> &a) {
+    Lanes<T> indefinite{};
+    for (auto j = 0u; j < N; j++) {
+        const auto &ajj = a[j * N + j];
+        for (auto k = 0u; k < j; k++) {
+            const auto &ajk = a[j * N + k];
+            a[j * N + j] = make_lanes<T>(
+                [&](std::size_t l) { return ajj[l] - ajk[l] * ajk[l]; });
+        }
+        indefinite = make_lanes<T>([&](std::size_t l) {
+            return ajj[l] > T(0) ? indefinite[l] : T(1);
+        });
+        a[j * N + j] =
+            make_lanes<T>([&](std::size_t l) { return std::sqrt(ajj[l]); });
+        const auto inverse =
+            make_lanes<T>([&](std::size_t l) { return T(1) / ajj[l]; });
+        for (auto i = j + 1; i < N; i++) {
+            const auto &aij = a[i * N + j];
+            auto lij = aij;
+            for (auto k = 0u; k < j; k++) {
+                const auto &aik = a[i * N + k];
+                const auto &ajk = a[j * N + k];
+                lij = make_lanes<T>([&](std::size_t l) {
+                    return lij[l] - aik[l] * ajk[l];
+                });
+            }
+            a[i * N + j] = make_lanes<T>(
+                [&](std::size_t l) { return lij[l] * inverse[l]; });
+            a[j * N + i].fill(T(0));
+        }
+    }
+    return indefinite;
+}
+
+// b = (L L^T)^-1 b for the output of cholesky_lanes().
+template <unsigned int N, unsigned int K, typename T>
+CML_ALWAYS_INLINE inline void
+cholesky_solve_lanes(const LaneBlock<T, N * N> &chol, LaneBlock<T, N * K> &b) {
+    for (auto i = 0u; i < N; i++) {
+        for (auto k = 0u; k < i; k++) {
+            subtract_row<K>(b, i, chol[i * N + k], k);
+        }
+        divide_row<K>(b, i, chol[i * N + i]);
+    }
+    for (auto i = N; i-- > 0;) {
+        for (auto k = i + 1; k < N; k++) {
+            subtract_row<K>(b, i, chol[k * N + i], k);
+        }
+        divide_row<K>(b, i, chol[i * N + i]);
+    }
+}
+
+// r = a * b lane by lane; a(i, k) and b(k, j) are given as functions
+// returning their lanes (or a broadcast scalar per lane).
+template <unsigned int Rows, unsigned int Inner, unsigned int Cols,
+          typename T, typename A, typename B>
+CML_ALWAYS_INLINE inline void multiply_lanes(A &&a, B &&b,
+                                             LaneBlock<T, Rows * Cols> &r) {
+    static_for<Rows>([&](unsigned int i) CML_ALWAYS_INLINE {
+        static_for<Cols>([&](unsigned int j) CML_ALWAYS_INLINE {
+            r[i * Cols + j] = make_lanes<T>([&](std::size_t l) {
+                T sum = 0;
+                static_for<Inner>([&](unsigned int k) CML_ALWAYS_INLINE {
+                    sum += a(i, k, l) * b(k, j, l);
+                });
+                return sum;
+            });
+        });
+    });
+}
+
+template <typename T, unsigned int Rows, unsigned int Cols>
+void match_size(MatrixBatch<Rows, Cols, T> &out, std::size_t size) {
+    if (out.size() != size) {
+        out.resize(size);
+    }
+}
+
+} // namespace detail
+
+// Factors every matrix of `a` in place as P a = L U (see detail::lu_lanes
+// for the layout) and stores the row swaps in `pivots`, which is resized to
+// a.size(). Returns the number of singular matrices.
+template <unsigned int N, std::floating_point T>
+std::size_t lu_factor(MatrixBatch<N, N, T> &a, MatrixBatch<N, 1, T> &pivots,
+                      ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    match_size(pivots, a.size());
+    return for_each_matrix_block(
+        a.size(), pool, [&](std::size_t b, std::size_t lanes) {
+            LaneBlock<T, N * N> lu;
+            LaneBlock<T, N> p;
+            load_block<N * N>(a.block(b).data(), lu);
+            const auto singular = lu_lanes<N>(lu, p);
+            store_block<N * N>(lu, a.block(b).data());
+            store_block<N>(p, pivots.block(b).data());
+            return count_set(singular, lanes);
+        });
+}
+
+// Overwrites `b` with the solutions of a x = b, given lu_factor()'s output.
+// Throws std::invalid_argument if the batch sizes differ.
+template <unsigned int N, unsigned int K, std::floating_point T>
+void lu_solve(const MatrixBatch<N, N, T> &lu,
+              const MatrixBatch<N, 1, T> &pivots, MatrixBatch<N, K, T> &b,
+              ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_same_size(lu, b, "lu_solve: batch size mismatch");
+    check_same_size(lu, pivots, "lu_solve: batch size mismatch");
+    for_each_matrix_block(
+        b.size(), pool, [&](std::size_t block, std::size_t) -> std::size_t {
+            LaneBlock<T, N * N> f;
+            LaneBlock<T, N> p;
+            LaneBlock<T, N * K> x;
+            load_block<N * N>(lu.block(block).data(), f);
+            load_block<N>(pivots.block(block).data(), p);
+            load_block<N * K>(b.block(block).data(), x);
+            lu_solve_lanes<N, K>(f, p, x);
+            store_block<N * K>(x, b.block(block).data());
+            return 0;
+        });
+}
+
+// Factors every matrix of `a` in place as L L^T, reading its lower
+// triangle; the upper one is zeroed. Returns the number of matrices that
+// are not positive definite.
+template <unsigned int N, std::floating_point T>
+std::size_t cholesky_factor(MatrixBatch<N, N, T> &a,
+                            ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    return for_each_matrix_block(
+        a.size(), pool, [&](std::size_t b, std::size_t lanes) {
+            LaneBlock<T, N * N> l;
+            load_block<N * N>(a.block(b).data(), l);
+            const auto indefinite = cholesky_lanes<N>(l);
+            store_block<N * N>(l, a.block(b).data());
+            return count_set(indefinite, lanes);
+        });
+}
+
+// Overwrites `b` with the solutions of a x = b, given cholesky_factor()'s
+// output. Throws std::invalid_argument if the batch sizes differ.
+template <unsigned int N, unsigned int K, std::floating_point T>
+void cholesky_solve(const MatrixBatch<N, N, T> &chol, MatrixBatch<N, K, T> &b,
+                    ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_same_size(chol, b, "cholesky_solve: batch size mismatch");
+    for_each_matrix_block(
+        b.size(), pool, [&](std::size_t block, std::size_t) -> std::size_t {
+            LaneBlock<T, N * N> l;
+            LaneBlock<T, N * K> x;
+            load_block<N * N>(chol.block(block).data(), l);
+            load_block<N * K>(b.block(block).data(), x);
+            cholesky_solve_lanes<N, K>(l, x);
+            store_block<N * K>(x, b.block(block).data());
+            return 0;
+        });
+}
+
+// x[i] = a[i]^-1 b[i] by LU with partial pivoting, leaving a unchanged; x
+// is resized to b.size() and may be b. Returns the number of singular
+// matrices; throws std::invalid_argument if a and b differ in size.
+template <unsigned int N, unsigned int K, std::floating_point T>
+std::size_t solve(const MatrixBatch<N, N, T> &a, const MatrixBatch<N, K, T> &b,
+                  MatrixBatch<N, K, T> &x,
+                  ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_same_size(a, b, "solve: batch size mismatch");
+    match_size(x, b.size());
+    return for_each_matrix_block(
+        a.size(), pool, [&](std::size_t block, std::size_t lanes) {
+            LaneBlock<T, N * N> lu;
+            LaneBlock<T, N> p;
+            LaneBlock<T, N * K> y;
+            load_block<N * N>(a.block(block).data(), lu);
+            load_block<N * K>(b.block(block).data(), y);
+            const auto singular = lu_lanes<N>(lu, p);
+            lu_solve_lanes<N, K>(lu, p, y);
+            store_block<N * K>(y, x.block(block).data());
+            return count_set(singular, lanes);
+        });
+}
+
+// out[i] = a[i]^-1 by LU with partial pivoting; out is resized to a.size()
+// and may be a. Returns the number of singular matrices.
+template <unsigned int N, std::floating_point T>
+std::size_t inverse(const MatrixBatch<N, N, T> &a, MatrixBatch<N, N, T> &out,
+                    ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    match_size(out, a.size());
+    return for_each_matrix_block(
+        a.size(), pool, [&](std::size_t block, std::size_t lanes) {
+            LaneBlock<T, N * N> lu;
+            LaneBlock<T, N> p;
+            LaneBlock<T, N * N> inv{};
+            load_block<N * N>(a.block(block).data(), lu);
+            for (auto i = 0u; i < N; i++) {
+                inv[i * N + i].fill(T(1));
+            }
+            const auto singular = lu_lanes<N>(lu, p);
+            lu_solve_lanes<N, N>(lu, p, inv);
+            store_block<N * N>(inv, out.block(block).data());
+            return count_set(singular, lanes);
+        });
+}
+
+// out[i] = a[i] * b[i]; out is resized to a.size() and may be a or b.
+// Throws std::invalid_argument if a and b differ in size.
+template <unsigned int Rows, unsigned int Inner, unsigned int Cols,
+          arithmetic T>
+void multiply(const MatrixBatch<Rows, Inner, T> &a,
+              const MatrixBatch<Inner, Cols, T> &b,
+              MatrixBatch<Rows, Cols, T> &out,
+              ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_same_size(a, b, "multiply: batch size mismatch");
+    match_size(out, a.size());
+    for_each_matrix_block(
+        a.size(), pool, [&](std::size_t block, std::size_t) -> std::size_t {
+            LaneBlock<T, Rows * Inner> la;
+            LaneBlock<T, Inner * Cols> lb;
+            LaneBlock<T, Rows * Cols> r;
+            load_block<Rows * Inner>(a.block(block).data(), la);
+            load_block<Inner * Cols>(b.block(block).data(), lb);
+            multiply_lanes<Rows, Inner, Cols, T>(
+                [&](unsigned int i, unsigned int k, std::size_t l) {
+                    return la[i * Inner + k][l];
+                },
+                [&](unsigned int k, unsigned int j, std::size_t l) {
+                    return lb[k * Cols + j][l];
+                },
+                r);
+            store_block<Rows * Cols>(r, out.block(block).data());
+            return 0;
+        });
+}
+
+// out[i] = a * b[i], e.g. one view-projection matrix applied to many
+// instance transforms; out is resized to b.size() and may be b.
+template <unsigned int Rows, unsigned int Inner, unsigned int Cols,
+          arithmetic T>
+void multiply(const Matrix<Rows, Inner, T> &a,
+              const MatrixBatch<Inner, Cols, T> &b,
+              MatrixBatch<Rows, Cols, T> &out,
+              ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    match_size(out, b.size());
+    for_each_matrix_block(
+        b.size(), pool, [&](std::size_t block, std::size_t) -> std::size_t {
+            LaneBlock<T, Inner * Cols> lb;
+            LaneBlock<T, Rows * Cols> r;
+            load_block<Inner * Cols>(b.block(block).data(), lb);
+            multiply_lanes<Rows, Inner, Cols, T>(
+                [&](unsigned int i, unsigned int k, std::size_t) {
+                    return a.get(i, k);
+                },
+                [&](unsigned int k, unsigned int j, std::size_t l) {
+                    return lb[k * Cols + j][l];
+                },
+                r);
+            store_block<Rows * Cols>(r, out.block(block).data());
+            return 0;
+        });
+}
+
+// out[i] = a[i] * b; out is resized to a.size() and may be a.
+template <unsigned int Rows, unsigned int Inner, unsigned int Cols,
+          arithmetic T>
+void multiply(const MatrixBatch<Rows, Inner, T> &a,
+              const Matrix<Inner, Cols, T> &b,
+              MatrixBatch<Rows, Cols, T> &out,
+              ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    match_size(out, a.size());
+    for_each_matrix_block(
+        a.size(), pool, [&](std::size_t block, std::size_t) -> std::size_t {
+            LaneBlock<T, Rows * Inner> la;
+            LaneBlock<T, Rows * Cols> r;
+            load_block<Rows * Inner>(a.block(block).data(), la);
+            multiply_lanes<Rows, Inner, Cols, T>(
+                [&](unsigned int i, unsigned int k, std::size_t l) {
+                    return la[i * Inner + k][l];
+                },
+                [&](unsigned int k, unsigned int j, std::size_t) {
+                    return b.get(k, j);
+                },
+                r);
+            store_block<Rows * Cols>(r, out.block(block).data());
+            return 0;
+        });
+}
+
+} // namespace cml
@@ -0,0 +1,180 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include "vector.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <tuple>
+
+namespace cml {
+
+// Optimal evaluation order of a product of N matrices, operand i being
+// dims[i] x dims[i + 1]. Solved by the textbook O(N^3) dynamic program; the
+// cost of a product is its number of multiply-adds.
+template <std::size_t N> struct MatrixChainPlan {
+    std::array<std::uint64_t, N + 1> dims;
+    // cost[i][j]: cheapest product of operands i..j; it is split into
+    // (i..split[i][j]) * (split[i][j] + 1..j).
+    std::array<std::array<std::uint64_t, N>, N> cost{};
+    std::array<std::array<std::size_t, N>, N> split{};
+
+    constexpr explicit MatrixChainPlan(
+        const std::array<std::uint64_t, N + 1> &dims)
+        : dims(dims) {
+        for (std::size_t length = 2; length <= N; length++) {
+            for (std::size_t i = 0; i + length <= N; i++) {
+                const auto j = i + length - 1;
+                cost[i][j] = std::numeric_limits<std::uint64_t>::max();
+                for (auto k = i; k < j; k++) {
+                    const auto c = cost[i][k] + cost[k + 1][j] +
+                                   dims[i] * dims[k + 1] * dims[j + 1];
+                    if (c < cost[i][j]) {
+                        cost[i][j] = c;
+                        split[i][j] = k;
+                    }
+                }
+            }
+        }
+    }
+
+    constexpr std::uint64_t optimal_cost() const { return cost[0][N - 1]; }
+
+    // Cost of evaluating ((A0 A1) A2) ..., as chained operator* does.
+    constexpr std::uint64_t left_to_right_cost() const {
+        std::uint64_t total = 0;
+        for (std::size_t k = 1; k < N; k++) {
+            total += dims[0] * dims[k] * dims[k + 1];
+        }
+        return total;
+    }
+
+    // The order as text, e.g. "(A0 (A1 A2))".
+    std::string parenthesization(std::size_t i = 0,
+                                 std::size_t j = N - 1) const {
+        if (i == j) {
+            return "A" + std::to_string(i);
+        }
+        return "(" + parenthesization(i, split[i][j]) + " " +
+               parenthesization(split[i][j] + 1, j) + ")";
+    }
+};
+
+namespace detail {
+
+template <typename M> struct ChainOperand;
+
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+struct ChainOperand<Matrix<Rows, Cols, T>> {
+    static constexpr unsigned int rows = Rows;
+    static constexpr unsigned int cols = Cols;
+    using value_type = T;
+
+    static const Matrix<Rows, Cols, T> &
+    as_matrix(const Matrix<Rows, Cols, T> &m) {
+        return m;
+    }
+
+    template <unsigned int R, unsigned int C>
+    static Matrix<R, C, T> from_product(const Matrix<R, C, T> &m) {
+        return m;
+    }
+};
+
+// A Vec is a column.
+template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+struct ChainOperand<Vec<T, Dim, LenT>> {
+    static constexpr unsigned int rows = Dim;
+    static constexpr unsigned int cols = 1;
+    using value_type = T;
+
+    static Matrix<Dim, 1, T> as_matrix(const Vec<T, Dim, LenT> &v) {
+        Matrix<Dim, 1, T> m;
+        static_for<Dim>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { m.get(i, 0) = v[i]; });
+        return m;
+    }
+
+    template <unsigned int R>
+    static Vec<T, R, LenT> from_product(const Matrix<R, 1, T> &m) {
+        Vec<T, R, LenT> v;
+        static_for<R>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { v[i] = m.get(i, 0); });
+        return v;
+    }
+};
+
+template <typename... Operands>
+concept chainable_operands =
+    sizeof...(Operands) >= 2 &&
+    (requires { ChainOperand<Operands>::rows; } && ...);
+
+template <std::size_t I, typename... Operands>
+using chain_operand_t =
+    ChainOperand<std::tuple_element_t<I, std::tuple<Operands...>>>;
+
+template <typename... Operands> constexpr bool dims_match() {
+    constexpr std::array<unsigned int, sizeof...(Operands)> rows{
+        ChainOperand<Operands>::rows...};
+    constexpr std::array<unsigned int, sizeof...(Operands)> cols{
+        ChainOperand<Operands>::cols...};
+    for (std::size_t i = 0; i + 1 < sizeof...(Operands); i++) {
+        if (cols[i] != rows[i + 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace detail
+
+// The plan chain() uses for these operand types.
+template <typename... Operands>
+    requires detail::chainable_operands<Operands...>
+inline constexpr MatrixChainPlan<sizeof...(Operands)> matrix_chain_plan{
+    [] {
+        constexpr std::array<unsigned int, sizeof...(Operands)> rows{
+            detail::ChainOperand<Operands>::rows...};
+        std::array<std::uint64_t, sizeof...(Operands) + 1> dims{};
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            dims[i] = rows[i];
+        }
+        dims.back() =
+            detail::chain_operand_t<sizeof...(Operands) - 1, Operands...>::cols;
+        return dims;
+    }()};
+
+namespace detail {
+
+template <std::size_t I, std::size_t J, typename... Operands>
+decltype(auto) chain_product(const std::tuple<const Operands &...> &operands) {
+    if constexpr (I == J) {
+        return chain_operand_t<I, Operands...>::as_matrix(
+            std::get<I>(operands));
+    } else {
+        constexpr auto K = matrix_chain_plan<Operands...>.split[I][J];
+        return chain_product<I, K, Operands...>(operands) *
+               chain_product<K + 1, J, Operands...>(operands);
+    }
+}
+
+} // namespace detail
+
+// Product of the operands, A0 * A1 * ... * An, evaluated in the order that
+// needs the fewest multiply-adds (see matrix_chain_plan) instead of left to
+// right. Operands are Matrix of one element type; the last one may be a Vec,
+// which is taken as a column and makes the result a Vec.
+template <typename... Operands>
+    requires detail::chainable_operands<Operands...> &&
+             (detail::dims_match<Operands...>())
+auto chain(const Operands &...operands) {
+    constexpr auto n = sizeof...(Operands);
+    return detail::chain_operand_t<n - 1, Operands...>::from_product(
+        detail::chain_product<0, n - 1, Operands...>(
+            std::tuple<const Operands &...>(operands...)));
+}
+
+} // namespace cml
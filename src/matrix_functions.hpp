@@ -0,0 +1,487 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include "vec_batch_ops.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Matrix powers and exponentials of square matrices, e.g. k-step Markov
+// transitions P^k and linear ODE propagators exp(A t), and kernels applying
+// such a propagator to a batch of state vectors.
+//
+// Integer matrices can be raised to powers modulo m (pow_mod(),
+// propagate_mod()), for integer recurrences whose terms would overflow.
+
+namespace cml {
+
+namespace detail {
+
+// From this order on square products go through gemm(); below it the
+// packing costs more than it saves.
+inline constexpr std::size_t matrix_function_gemm_order = 32;
+
+#if defined(__SIZEOF_INT128__)
+// __extension__ keeps -Wpedantic from rejecting the non-standard type.
+__extension__ typedef unsigned __int128 ModularWide128;
+#endif
+
+// (acc + a * b) mod modulus for residues acc, a and b below modulus.
+template <std::integral T>
+CML_ALWAYS_INLINE inline T mul_add_modulo(T acc, T a, T b, T modulus) {
+    if constexpr (sizeof(T) <= 4) {
+        using Wide = std::uint64_t;
+        return T((Wide(acc) + Wide(a) * Wide(b)) % Wide(modulus));
+    } else {
+#if defined(__SIZEOF_INT128__)
+        using Wide = ModularWide128;
+        return T((Wide(acc) + Wide(a) * Wide(b)) % Wide(modulus));
+#else
+        // Double and add, every partial result staying below modulus.
+        using U = std::make_unsigned_t<T>;
+        const auto m = U(modulus);
+        const auto add = [m](U x, U y) {
+            return x >= m - y ? x - (m - y) : x + y;
+        };
+        U r = U(acc), x = U(a);
+        for (auto y = U(b); y != 0; y >>= 1) {
+            if (y & 1) {
+                r = add(r, x);
+            }
+            x = add(x, x);
+        }
+        return T(r);
+#endif
+    }
+}
+
+template <std::integral T> T reduce_modulo(T x, T modulus) {
+    const auto r = x % modulus;
+    return r < 0 ? r + modulus : r;
+}
+
+// c = a * b for n x n operands, c not overlapping a or b. A non-zero modulus
+// computes the product modulo it, the operands being already reduced.
+template <arithmetic T>
+void square_multiply(ConstMatrixView<T> a, ConstMatrixView<T> b,
+                     MatrixView<T> c, T modulus, ThreadPool &pool) {
+    const auto n = c.rows();
+    if constexpr (std::floating_point<T>) {
+        if (n >= matrix_function_gemm_order) {
+            gemm(a, b, c, pool);
+            return;
+        }
+    }
+    for (std::size_t i = 0; i < n; i++) {
+        std::fill(c[i].begin(), c[i].end(), T(0));
+        for (std::size_t k = 0; k < n; k++) {
+            const auto aik = a.get(i, k);
+            const auto bk = b[k];
+            const auto ci = c[i];
+            if constexpr (std::integral<T>) {
+                if (modulus != 0) {
+                    for (std::size_t j = 0; j < n; j++) {
+                        ci[j] = mul_add_modulo(ci[j], aik, bk[j], modulus);
+                    }
+                    continue;
+                }
+            }
+            for (std::size_t j = 0; j < n; j++) {
+                ci[j] += aik * bk[j];
+            }
+        }
+    }
+}
+
+template <arithmetic T> void set_identity(MatrixView<T> m, T modulus) {
+    for (std::size_t i = 0; i < m.rows(); i++) {
+        std::fill(m[i].begin(), m[i].end(), T(0));
+        m.get(i, i) = modulus == T(1) ? T(0) : T(1);
+    }
+}
+
+template <arithmetic T>
+void copy_view(ConstMatrixView<T> from, MatrixView<T> to) {
+    for (std::size_t i = 0; i < from.rows(); i++) {
+        std::copy(from[i].begin(), from[i].end(), to[i].begin());
+    }
+}
+
+// out = m^k by left-to-right binary exponentiation: one squaring per bit of
+// k below the leading one, plus a product by m per set bit. All products
+// alternate between two n x n buffers allocated up front.
+template <arithmetic T>
+void power(ConstMatrixView<T> m, std::uint64_t k, T modulus,
+           MatrixView<T> out, ThreadPool &pool) {
+    const auto n = m.rows();
+    if (m.cols() != n || out.rows() != n || out.cols() != n) {
+        throw std::invalid_argument("pow: matrix is not square");
+    }
+    if (k == 0) {
+        set_identity(out, modulus);
+        return;
+    }
+    std::vector<T> scratch((modulus != 0 ? 3 : 2) * n * n);
+    MatrixView<T> current(scratch.data(), n, n);
+    MatrixView<T> next(scratch.data() + n * n, n, n);
+    ConstMatrixView<T> base = m;
+    if constexpr (std::integral<T>) {
+        if (modulus != 0) {
+            MatrixView<T> reduced(scratch.data() + 2 * n * n, n, n);
+            for (std::size_t i = 0; i < n; i++) {
+                for (std::size_t j = 0; j < n; j++) {
+                    reduced.get(i, j) = reduce_modulo(m.get(i, j), modulus);
+                }
+            }
+            base = reduced;
+        }
+    }
+    copy_view(base, current);
+    for (auto bit = std::bit_width(k) - 1; bit-- > 0;) {
+        square_multiply<T>(current, current, next, modulus, pool);
+        std::swap(current, next);
+        if ((k >> bit) & 1) {
+            square_multiply<T>(current, base, next, modulus, pool);
+            std::swap(current, next);
+        }
+    }
+    copy_view<T>(current, out);
+}
+
+template <std::floating_point T> T norm1(ConstMatrixView<T> a) {
+    T norm = 0;
+    for (std::size_t j = 0; j < a.cols(); j++) {
+        T sum = 0;
+        for (std::size_t i = 0; i < a.rows(); i++) {
+            sum += std::abs(a.get(i, j));
+        }
+        // std::max would drop a NaN sum.
+        norm = std::isnan(sum) ? sum : std::max(norm, sum);
+    }
+    return norm;
+}
+
+// a += s * b.
+template <std::floating_point T>
+void add_scaled(DynamicMatrix<T> &a, T s, const DynamicMatrix<T> &b) {
+    for (std::size_t i = 0; i < a.size(); i++) {
+        a.data()[i] += s * b.data()[i];
+    }
+}
+
+template <std::floating_point T> void add_identity(DynamicMatrix<T> &a, T s) {
+    for (std::size_t i = 0; i < a.rows(); i++) {
+        a.get(i, i) += s;
+    }
+}
+
+// Overwrites b with the solution x of a x = b (any number of right-hand
+// columns) by Gaussian elimination with partial pivoting; destroys a.
+template <std::floating_point T>
+void solve_in_place(DynamicMatrix<T> &a, DynamicMatrix<T> &b) {
+    const auto n = a.rows();
+    for (std::size_t k = 0; k < n; k++) {
+        auto pivot = k;
+        for (auto i = k + 1; i < n; i++) {
+            if (std::abs(a.get(i, k)) > std::abs(a.get(pivot, k))) {
+                pivot = i;
+            }
+        }
+        if (a.get(pivot, k) == T(0)) {
+            throw std::domain_error("expm: singular Pade denominator");
+        }
+        if (pivot != k) {
+            std::swap_ranges(a[k].begin(), a[k].end(), a[pivot].begin());
+            std::swap_ranges(b[k].begin(), b[k].end(), b[pivot].begin());
+        }
+        for (auto i = k + 1; i < n; i++) {
+            const auto f = a.get(i, k) / a.get(k, k);
+            for (auto j = k; j < n; j++) {
+                a.get(i, j) -= f * a.get(k, j);
+            }
+            for (std::size_t j = 0; j < b.cols(); j++) {
+                b.get(i, j) -= f * b.get(k, j);
+            }
+        }
+    }
+    for (auto k = n; k-- > 0;) {
+        for (std::size_t j = 0; j < b.cols(); j++) {
+            auto x = b.get(k, j);
+            for (auto i = k + 1; i < n; i++) {
+                x -= a.get(k, i) * b.get(i, j);
+            }
+            b.get(k, j) = x / a.get(k, k);
+        }
+    }
+}
+
+// Coefficients of the [m/m] Pade approximant of exp, b[0] to b[m], and the
+// largest 1-norm theta_m for which it is accurate to unit roundoff, from
+// Higham, "The Scaling and Squaring Method for the Matrix Exponential
+// Revisited" (2005), tables 2.2 and 2.3.
+struct PadeDegree {
+    unsigned int m;
+    double theta_double;
+    double theta_single;
+    std::array<double, 14> b;
+};
+
+inline constexpr std::array<PadeDegree, 5> pade_degrees{{
+    {3, 1.495585217958292e-2, 4.258730016922831e-1, {120, 60, 12, 1}},
+    {5,
+     2.539398330063230e-1,
+     1.880152677804762e0,
+     {30240, 15120, 3360, 420, 30, 1}},
+    {7,
+     9.504178996162932e-1,
+     3.925724783138660e0,
+     {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1}},
+    {9,
+     2.097847961257068e0,
+     0,
+     {17643225600., 8821612800., 2075673600., 302702400., 30270240.,
+      2162160., 110880., 3960., 90., 1.}},
+    {13,
+     5.371920351148152e0,
+     0,
+     {64764752532480000., 32382376266240000., 7771770303897600.,
+      1187353796428800., 129060195264000., 10559470521600., 670442572800.,
+      33522128640., 1323241920., 40840800., 960960., 16380., 182., 1.}},
+}};
+
+// r = [m/m] Pade approximant of exp(a) = (V - U)^-1 (V + U), U holding the
+// odd and V the even powers of a.
+template <std::floating_point T>
+DynamicMatrix<T> pade(const DynamicMatrix<T> &a, const PadeDegree &degree,
+                      ThreadPool &pool) {
+    const auto n = a.rows();
+    const auto product = [&](const DynamicMatrix<T> &x,
+                             const DynamicMatrix<T> &y) {
+        DynamicMatrix<T> r(n, n);
+        square_multiply<T>(x, y, r, T(0), pool);
+        return r;
+    };
+    const auto &b = degree.b;
+    const auto coefficient = [&](unsigned int j) { return T(b[j]); };
+    const auto a2 = product(a, a);
+    DynamicMatrix<T> u_factor(n, n);
+    DynamicMatrix<T> v(n, n);
+    if (degree.m == 13) {
+        const auto a4 = product(a2, a2);
+        const auto a6 = product(a4, a2);
+        DynamicMatrix<T> inner(n, n);
+        add_scaled(inner, coefficient(13), a6);
+        add_scaled(inner, coefficient(11), a4);
+        add_scaled(inner, coefficient(9), a2);
+        u_factor = product(a6, inner);
+        add_scaled(u_factor, coefficient(7), a6);
+        add_scaled(u_factor, coefficient(5), a4);
+        add_scaled(u_factor, coefficient(3), a2);
+        add_identity(u_factor, coefficient(1));
+
+        inner = DynamicMatrix<T>(n, n);
+        add_scaled(inner, coefficient(12), a6);
+        add_scaled(inner, coefficient(10), a4);
+        add_scaled(inner, coefficient(8), a2);
+        v = product(a6, inner);
+        add_scaled(v, coefficient(6), a6);
+        add_scaled(v, coefficient(4), a4);
+        add_scaled(v, coefficient(2), a2);
+        add_identity(v, coefficient(0));
+    } else {
+        // powers[j] = a^(2 j)
+        std::vector<DynamicMatrix<T>> powers{DynamicMatrix<T>::identity(n),
+                                             a2};
+        for (auto j = 2u; 2 * j <= degree.m; j++) {
+            powers.push_back(product(powers.back(), a2));
+        }
+        for (auto j = 0u; 2 * j <= degree.m; j++) {
+            add_scaled(u_factor, coefficient(2 * j + 1), powers[j]);
+            add_scaled(v, coefficient(2 * j), powers[j]);
+        }
+    }
+    const auto u = product(a, u_factor);
+    auto denominator = v;
+    add_scaled(denominator, T(-1), u);
+    auto r = std::move(v);
+    add_scaled(r, T(1), u);
+    solve_in_place(denominator, r);
+    return r;
+}
+
+// Applies p to every vector of a batch; the kernel below handles plain
+// and modular arithmetic.
+template <unsigned int N, arithmetic T>
+void propagate(const Matrix<N, N, T> &p, const VecBatch<T, N> &states,
+               VecBatch<T, N> &out, T modulus, ThreadPool &pool) {
+    const auto x = component_pointers(states);
+    const auto o = component_pointers(out, states.size());
+    for_each_block(states.size(), pool, [&](std::size_t base,
+                                            std::size_t lanes) {
+        // Every row is computed before any is stored, so out may be states.
+        std::array<Lanes<T>, N> r;
+        for (auto row = 0u; row < N; row++) {
+            Lanes<T> sum{};
+            for (auto col = 0u; col < N; col++) {
+                const auto c = p.get(row, col);
+                const auto *xc = x[col] + base;
+                if constexpr (std::integral<T>) {
+                    if (modulus != 0) {
+                        for (std::size_t l = 0; l < batch_lanes; l++) {
+                            const auto xl = reduce_modulo(xc[l], modulus);
+                            sum[l] = mul_add_modulo(sum[l], c, xl, modulus);
+                        }
+                        continue;
+                    }
+                }
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    sum[l] += c * xc[l];
+                }
+            }
+            r[row] = sum;
+        }
+        for (auto row = 0u; row < N; row++) {
+            store_lanes(o[row] + base, r[row], lanes);
+        }
+    });
+}
+
+} // namespace detail
+
+// m^k by repeated squaring, about 2 log2(k) products instead of k - 1.
+// Integer powers wrap like the integer products they are made of; see
+// pow_mod().
+template <unsigned int N, arithmetic T>
+Matrix<N, N, T> pow(const Matrix<N, N, T> &m, std::uint64_t k,
+                    ThreadPool &pool = ThreadPool::global()) {
+    Matrix<N, N, T> r;
+    detail::power<T>(view(m), k, T(0), view(r), pool);
+    return r;
+}
+
+template <arithmetic T>
+DynamicMatrix<T> pow(const DynamicMatrix<T> &m, std::uint64_t k,
+                     ThreadPool &pool = ThreadPool::global()) {
+    DynamicMatrix<T> r(m.rows(), m.cols());
+    detail::power<T>(m, k, T(0), r, pool);
+    return r;
+}
+
+// m^k modulo `modulus`, entries in [0, modulus). Intermediate products are
+// computed in a type twice as wide as T, so nothing overflows for any
+// positive modulus.
+template <unsigned int N, std::integral T>
+Matrix<N, N, T> pow_mod(const Matrix<N, N, T> &m, std::uint64_t k,
+                        T modulus) {
+    if (modulus <= 0) {
+        throw std::invalid_argument("pow_mod: modulus must be positive");
+    }
+    Matrix<N, N, T> r;
+    detail::power<T>(view(m), k, modulus, view(r), ThreadPool::global());
+    return r;
+}
+
+template <std::integral T>
+DynamicMatrix<T> pow_mod(const DynamicMatrix<T> &m, std::uint64_t k,
+                         T modulus) {
+    if (modulus <= 0) {
+        throw std::invalid_argument("pow_mod: modulus must be positive");
+    }
+    DynamicMatrix<T> r(m.rows(), m.cols());
+    detail::power<T>(m, k, modulus, r, ThreadPool::global());
+    return r;
+}
+
+// exp(a) by scaling and squaring (Higham 2005, algorithm 2.3): the lowest
+// degree Pade approximant accurate to unit roundoff for the 1-norm of a,
+// or a scaled down by 2^s until the highest degree one is, squared s times.
+// The highest degree is 13 for double and 7 for float. Throws
+// std::invalid_argument if a is not square, or its 1-norm is not finite
+// (an Inf or NaN entry, or columns summing past the largest T).
+template <std::floating_point T>
+DynamicMatrix<T> expm(const DynamicMatrix<T> &a,
+                      ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    if (!a.is_square()) {
+        throw std::invalid_argument("expm: matrix is not square");
+    }
+    const auto n = a.rows();
+    if (n == 0) {
+        return a;
+    }
+    constexpr bool single = sizeof(T) <= sizeof(float);
+    const auto theta = [](const PadeDegree &d) {
+        return single ? d.theta_single : d.theta_double;
+    };
+    const auto &highest = pade_degrees[single ? 2 : 4];
+    const auto norm = double(norm1<T>(a));
+    if (!std::isfinite(norm)) {
+        throw std::invalid_argument("expm: matrix norm is not finite");
+    }
+    for (const auto &degree : pade_degrees) {
+        if (&degree == &highest) {
+            break;
+        }
+        if (norm <= theta(degree)) {
+            return pade(a, degree, pool);
+        }
+    }
+    const auto s = norm > theta(highest)
+                       ? int(std::ceil(std::log2(norm / theta(highest))))
+                       : 0;
+    auto r = pade(a * T(std::ldexp(1.0, -s)), highest, pool);
+    DynamicMatrix<T> squared(n, n);
+    for (int i = 0; i < s; i++) {
+        square_multiply<T>(r, r, squared, T(0), pool);
+        std::swap(r, squared);
+    }
+    return r;
+}
+
+template <unsigned int N, std::floating_point T>
+Matrix<N, N, T> expm(const Matrix<N, N, T> &a,
+                     ThreadPool &pool = ThreadPool::global()) {
+    return expm(DynamicMatrix<T>(a), pool).template to_matrix<N, N>();
+}
+
+// out[i] = p * states[i], e.g. one step of a linear recurrence or a
+// propagator from expm() applied to many states. out may be states. For
+// states stored as the columns of a matrix, gemm() is the batched form.
+template <unsigned int N, arithmetic T>
+void propagate(const Matrix<N, N, T> &p, const VecBatch<T, N> &states,
+               VecBatch<T, N> &out, ThreadPool &pool = ThreadPool::global()) {
+    detail::propagate(p, states, out, T(0), pool);
+}
+
+// out[i] = p * states[i] modulo `modulus`, entries in [0, modulus).
+template <unsigned int N, std::integral T>
+void propagate_mod(const Matrix<N, N, T> &p, const VecBatch<T, N> &states,
+                   VecBatch<T, N> &out, T modulus,
+                   ThreadPool &pool = ThreadPool::global()) {
+    if (modulus <= 0) {
+        throw std::invalid_argument("propagate_mod: modulus must be positive");
+    }
+    Matrix<N, N, T> reduced;
+    for (auto i = 0u; i < N; i++) {
+        for (auto j = 0u; j < N; j++) {
+            reduced.get(i, j) = detail::reduce_modulo(p.get(i, j), modulus);
+        }
+    }
+    detail::propagate(reduced, states, out, modulus, pool);
+}
+
+} // namespace cml
@@ -0,0 +1,402 @@
+#pragma once
+#include "aabb.hpp"
+#include "common.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace cml {
+
+// Bits per coordinate of 2D and 3D Morton and Hilbert keys; a key fits in 64
+// bits.
+template <unsigned int Dim>
+    requires(Dim == 2 || Dim == 3)
+inline constexpr unsigned int curve_bits = Dim == 2 ? 32 : 21;
+
+namespace detail {
+
+// Portable bit spreading ("magic bits"): the low curve_bits<Dim> bits of v
+// moved to every Dim-th bit of the result, and back.
+template <unsigned int Dim>
+constexpr std::uint64_t spread_bits(std::uint64_t v) {
+    if constexpr (Dim == 2) {
+        v &= 0xFFFFFFFFu;
+        v = (v | v << 16) & 0x0000FFFF0000FFFFull;
+        v = (v | v << 8) & 0x00FF00FF00FF00FFull;
+        v = (v | v << 4) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | v << 2) & 0x3333333333333333ull;
+        v = (v | v << 1) & 0x5555555555555555ull;
+    } else {
+        v &= 0x1FFFFFu;
+        v = (v | v << 32) & 0x001F00000000FFFFull;
+        v = (v | v << 16) & 0x001F0000FF0000FFull;
+        v = (v | v << 8) & 0x100F00F00F00F00Full;
+        v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+    }
+    return v;
+}
+
+template <unsigned int Dim>
+constexpr std::uint64_t compact_bits(std::uint64_t v) {
+    if constexpr (Dim == 2) {
+        v &= 0x5555555555555555ull;
+        v = (v | v >> 1) & 0x3333333333333333ull;
+        v = (v | v >> 2) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | v >> 4) & 0x00FF00FF00FF00FFull;
+        v = (v | v >> 8) & 0x0000FFFF0000FFFFull;
+        v = (v | v >> 16) & 0x00000000FFFFFFFFull;
+    } else {
+        v &= 0x1249249249249249ull;
+        v = (v | v >> 2) & 0x10C30C30C30C30C3ull;
+        v = (v | v >> 4) & 0x100F00F00F00F00Full;
+        v = (v | v >> 8) & 0x001F0000FF0000FFull;
+        v = (v | v >> 16) & 0x001F00000000FFFFull;
+        v = (v | v >> 32) & 0x00000000001FFFFFull;
+    }
+    return v;
+}
+
+// Bits of coordinate 0 of a Dim-dimensional key.
+template <unsigned int Dim>
+inline constexpr std::uint64_t lane_bits =
+    Dim == 2 ? 0x5555555555555555ull : 0x1249249249249249ull;
+
+template <unsigned int Dim>
+constexpr std::uint64_t morton_encode(const Vec<unsigned int, Dim> &p) {
+    std::uint64_t key = 0;
+#if defined(__BMI2__)
+    if (!std::is_constant_evaluated()) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            key |= _pdep_u64(p[d], lane_bits<Dim> << d);
+        });
+        return key;
+    }
+#endif
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        key |= spread_bits<Dim>(p[d]) << d;
+    });
+    return key;
+}
+
+template <unsigned int Dim>
+constexpr Vec<unsigned int, Dim> morton_decode(std::uint64_t key) {
+    Vec<unsigned int, Dim> p;
+#if defined(__BMI2__)
+    if (!std::is_constant_evaluated()) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            p[d] = static_cast<unsigned int>(
+                _pext_u64(key, lane_bits<Dim> << d));
+        });
+        return p;
+    }
+#endif
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        p[d] = static_cast<unsigned int>(compact_bits<Dim>(key >> d));
+    });
+    return p;
+}
+
+} // namespace detail
+
+// Morton (Z-order) key of p: the bits of the coordinates interleaved, x in
+// the lowest bit. Coordinates are truncated to curve_bits<Dim> bits. Uses
+// BMI2 pdep/pext when the target has them (-mbmi2 or a -march that
+// implies it).
+template <std::floating_point LenT>
+constexpr std::uint64_t morton_encode(const Vec<unsigned int, 2, LenT> &p) {
+    return detail::morton_encode<2>({p[0], p[1]});
+}
+
+template <std::floating_point LenT>
+constexpr std::uint64_t morton_encode(const Vec<unsigned int, 3, LenT> &p) {
+    return detail::morton_encode<3>({p[0], p[1], p[2]});
+}
+
+constexpr Vec2u morton_decode_2d(std::uint64_t key) {
+    return detail::morton_decode<2>(key);
+}
+
+constexpr Vec3u morton_decode_3d(std::uint64_t key) {
+    return detail::morton_decode<3>(key);
+}
+
+// Hilbert key of p with `bits` bits per coordinate, 1 to curve_bits<Dim>;
+// throws std::invalid_argument otherwise. Consecutive keys are cells that share a face, which
+// keeps more neighbors close in the order than Morton keys do, at several
+// times the encoding cost. Uses Skilling's transform ("Programming the
+// Hilbert curve", 2004).
+template <unsigned int Dim, std::floating_point LenT>
+    requires(Dim == 2 || Dim == 3)
+constexpr std::uint64_t hilbert_encode(const Vec<unsigned int, Dim, LenT> &p,
+                                       unsigned int bits = curve_bits<Dim>) {
+    if (bits == 0 || bits > curve_bits<Dim>) {
+        throw std::invalid_argument("hilbert_encode: bits out of range");
+    }
+    std::array<std::uint32_t, Dim> x;
+    const auto mask =
+        static_cast<std::uint32_t>((std::uint64_t(1) << bits) - 1);
+    for (auto d = 0u; d < Dim; d++) {
+        x[d] = p[d] & mask;
+    }
+    // Undo the excess work of the Gray code, then Gray encode.
+    const auto top = std::uint32_t(1) << (bits - 1);
+    for (auto q = top; q > 1; q >>= 1) {
+        const auto low = q - 1;
+        // Invert the low bits of x[0] if bit q of x[d] is set, otherwise
+        // exchange them with those of x[d]; branch-free, as the bits are
+        // unpredictable.
+        for (auto d = 0u; d < Dim; d++) {
+            const auto set = 0u - ((x[d] & q) != 0);
+            const auto t = (x[0] ^ x[d]) & low & ~set;
+            x[0] ^= (low & set) | t;
+            x[d] ^= t;
+        }
+    }
+    for (auto d = 1u; d < Dim; d++) {
+        x[d] ^= x[d - 1];
+    }
+    std::uint32_t t = 0;
+    for (auto q = top; q > 1; q >>= 1) {
+        t ^= (q - 1) & (0u - ((x[Dim - 1] & q) != 0));
+    }
+    // The key reads the transposed bits with x[0] most significant.
+    Vec<unsigned int, Dim> transposed;
+    for (auto d = 0u; d < Dim; d++) {
+        transposed[Dim - 1 - d] = x[d] ^ t;
+    }
+    return detail::morton_encode<Dim>(transposed);
+}
+
+namespace detail {
+
+// Maps points to cells of a 2^bits grid over a box with one multiply per
+// axis; the divisions are done once.
+template <std::floating_point T> struct GridQuantizer {
+    GridQuantizer(const Aabb<T> &bounds, unsigned int bits)
+        : min(bounds.min),
+          cells(static_cast<T>((std::uint64_t(1) << bits) - 1)) {
+        static_for<3>([&](unsigned int d) CML_ALWAYS_INLINE {
+            const auto extent = bounds.max[d] - bounds.min[d];
+            scale[d] = extent > 0 ? cells / extent : T(0);
+        });
+    }
+
+    Vec3u operator()(const Vec3<T> &p) const {
+        Vec3u cell;
+        static_for<3>([&](unsigned int d) CML_ALWAYS_INLINE {
+            const auto q =
+                std::min(std::max((p[d] - min[d]) * scale[d], T(0)), cells);
+            cell[d] = static_cast<unsigned int>(q);
+        });
+        return cell;
+    }
+
+    Vec3<T> min;
+    Vec3<T> scale;
+    T cells;
+};
+
+} // namespace detail
+
+// Cell of p in a 2^bits grid over `bounds` (bits <= 32); points outside the
+// box are clamped to it.
+template <std::floating_point T>
+Vec3u quantize(const Vec3<T> &p, const Aabb<T> &bounds,
+               unsigned int bits = curve_bits<3>) {
+    return detail::GridQuantizer<T>(bounds, bits)(p);
+}
+
+template <std::floating_point T>
+std::uint64_t morton_encode(const Vec3<T> &p, const Aabb<T> &bounds) {
+    return morton_encode(quantize(p, bounds));
+}
+
+template <std::floating_point T>
+std::uint64_t hilbert_encode(const Vec3<T> &p, const Aabb<T> &bounds) {
+    return hilbert_encode(quantize(p, bounds));
+}
+
+namespace detail {
+
+inline constexpr std::size_t radix_grain = std::size_t(1) << 16;
+inline constexpr unsigned int radix_digit_bits = 8;
+inline constexpr std::size_t radix_buckets = 1u << radix_digit_bits;
+
+} // namespace detail
+
+// Sorts keys ascending and applies the same permutation to values. LSD
+// radix sort on 8-bit digits; each pass counts digits per chunk of the
+// input, scans the counts and scatters stably, so the result does not
+// depend on the thread count. Passes whose digit is the same for every key
+// (e.g. the unused top bits of 3D keys) are skipped. Throws
+// std::invalid_argument if the spans differ in size.
+inline void radix_sort_pairs(std::span<std::uint64_t> keys,
+                             std::span<std::uint32_t> values,
+                             ThreadPool &pool = ThreadPool::global()) {
+    using detail::radix_buckets;
+    if (keys.size() != values.size()) {
+        throw std::invalid_argument("radix_sort_pairs: size mismatch");
+    }
+    const auto n = keys.size();
+    const auto chunks = std::max<std::size_t>(
+        std::min<std::size_t>(pool.size(), n / detail::radix_grain), 1);
+    const auto chunk_size = (n + chunks - 1) / chunks;
+
+    std::vector<std::uint64_t> key_scratch(n);
+    std::vector<std::uint32_t> value_scratch(n);
+    std::vector<std::size_t> histograms(chunks * radix_buckets);
+    auto *keys_in = keys.data();
+    auto *keys_out = key_scratch.data();
+    auto *values_in = values.data();
+    auto *values_out = value_scratch.data();
+
+    for (unsigned int shift = 0; shift < 64;
+         shift += detail::radix_digit_bits) {
+        const auto digit = [&](std::uint64_t key) {
+            return static_cast<std::size_t>(key >> shift) &
+                   (radix_buckets - 1);
+        };
+        std::fill(histograms.begin(), histograms.end(), 0);
+        pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+            auto *histogram = histograms.data() + c * radix_buckets;
+            const auto last = std::min(n, (c + 1) * chunk_size);
+            for (auto i = c * chunk_size; i < last; i++) {
+                histogram[digit(keys_in[i])]++;
+            }
+        });
+
+        // Exclusive scan in (digit, chunk) order.
+        std::size_t offset = 0;
+        bool trivial = false;
+        for (std::size_t b = 0; b < radix_buckets; b++) {
+            const auto start = offset;
+            for (std::size_t c = 0; c < chunks; c++) {
+                auto &count = histograms[c * radix_buckets + b];
+                const auto next = offset + count;
+                count = offset;
+                offset = next;
+            }
+            trivial = trivial || offset - start == n;
+        }
+        if (trivial) {
+            continue;
+        }
+
+        pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+            auto *offsets = histograms.data() + c * radix_buckets;
+            const auto last = std::min(n, (c + 1) * chunk_size);
+            for (auto i = c * chunk_size; i < last; i++) {
+                const auto pos = offsets[digit(keys_in[i])]++;
+                keys_out[pos] = keys_in[i];
+                values_out[pos] = values_in[i];
+            }
+        });
+        std::swap(keys_in, keys_out);
+        std::swap(values_in, values_out);
+    }
+
+    if (keys_in != keys.data()) {
+        std::copy(keys_in, keys_in + n, keys.data());
+        std::copy(values_in, values_in + n, values.data());
+    }
+}
+
+namespace detail {
+
+template <std::floating_point T, std::floating_point LenT, typename Encode>
+std::vector<std::uint32_t> curve_order(std::span<const Vec<T, 3, LenT>> points,
+                                       ThreadPool &pool, Encode &&encode) {
+    const auto n = points.size();
+    const auto chunks = (n + radix_grain - 1) / radix_grain;
+    std::vector<Aabb<T>> chunk_bounds(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        const auto last = std::min(n, (c + 1) * radix_grain);
+        for (auto i = c * radix_grain; i < last; i++) {
+            chunk_bounds[c].expand(
+                Vec3<T>(points[i][0], points[i][1], points[i][2]));
+        }
+    });
+    Aabb<T> bounds;
+    for (const auto &box : chunk_bounds) {
+        bounds.expand(box);
+    }
+
+    const GridQuantizer<T> quantizer(bounds, curve_bits<3>);
+    std::vector<std::uint64_t> keys(n);
+    std::vector<std::uint32_t> order(n);
+    pool.parallel_for(0, n, radix_grain, [&](std::size_t first,
+                                             std::size_t last) {
+        for (auto i = first; i < last; i++) {
+            const Vec3<T> p(points[i][0], points[i][1], points[i][2]);
+            keys[i] = encode(quantizer(p));
+            order[i] = static_cast<std::uint32_t>(i);
+        }
+    });
+    radix_sort_pairs(keys, order, pool);
+    return order;
+}
+
+} // namespace detail
+
+// Permutation that sorts points along the Morton curve over their bounding
+// box: order[i] is the input index of the i-th point on the curve. Ties keep
+// the input order.
+template <std::floating_point T, std::floating_point LenT>
+std::vector<std::uint32_t>
+morton_order(std::span<const Vec<T, 3, LenT>> points,
+             ThreadPool &pool = ThreadPool::global()) {
+    return detail::curve_order(points, pool, [](const Vec3u &cell) {
+        return morton_encode(cell);
+    });
+}
+
+// Like morton_order() along the Hilbert curve.
+template <std::floating_point T, std::floating_point LenT>
+std::vector<std::uint32_t>
+hilbert_order(std::span<const Vec<T, 3, LenT>> points,
+              ThreadPool &pool = ThreadPool::global()) {
+    return detail::curve_order(points, pool, [](const Vec3u &cell) {
+        return hilbert_encode(cell);
+    });
+}
+
+// Permutes values so that values[i] becomes the old values[order[i]].
+// `order` must be a permutation of [0, values.size()).
+template <typename T>
+void reorder(std::span<T> values, std::span<const std::uint32_t> order,
+             ThreadPool &pool = ThreadPool::global()) {
+    const std::vector<std::remove_const_t<T>> old(values.begin(),
+                                                  values.end());
+    pool.parallel_for(0, values.size(), detail::radix_grain,
+                      [&](std::size_t first, std::size_t last) {
+                          for (auto i = first; i < last; i++) {
+                              values[i] = old[order[i]];
+                          }
+                      });
+}
+
+// Permutes every component of the batch, see reorder(std::span<T>, ...).
+template <arithmetic T, unsigned int Dim>
+void reorder(VecBatch<T, Dim> &batch, std::span<const std::uint32_t> order,
+             ThreadPool &pool = ThreadPool::global()) {
+    for (auto d = 0u; d < Dim; d++) {
+        reorder(batch.component(d), order, pool);
+    }
+}
+
+} // namespace cml
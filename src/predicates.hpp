@@ -0,0 +1,873 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vec_batch_ops.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+// Robust geometric predicates on double coordinates, after Shewchuk,
+// "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+// Predicates" (1997). Each returns a value whose sign is exactly the sign
+// of its determinant:
+//   orient2d(a, b, c)        > 0 if a, b, c are counterclockwise
+//   orient3d(a, b, c, d)     > 0 if d lies below the plane of a, b, c, seen
+//                            counterclockwise from above
+//   incircle(a, b, c, d)     > 0 if d lies inside the circle through a, b, c
+//                            (counterclockwise)
+//   insphere(a, b, c, d, e)  > 0 if e lies inside the sphere through a, b,
+//                            c, d (with orient3d(a, b, c, d) > 0)
+// and 0 for degenerate input.
+//
+// The determinant is first computed in plain floating point together with
+// Shewchuk's error bound, derived from the permanent of the same
+// expression. Only when the bound does not settle the sign, the *_exact
+// fallbacks refine it in Shewchuk's adaptive stages:
+//   B  the determinant of the rounded coordinate differences, exactly;
+//      enough unless the differences themselves were rounded
+//   C  B corrected to first order in the roundoff of the differences,
+//      against a tighter bound
+//   D  the determinant of the exact differences, exactly.
+// Each stage only runs when the previous one leaves the sign open, and
+// all expansions live in fixed-size buffers on the stack, sized by the
+// longest result their operation can produce.
+//
+// Assumes no overflow or underflow, and IEEE double arithmetic. The error
+// free transformations use std::fma explicitly; contraction of a * b + c
+// into fused multiply-adds elsewhere (GCC's default when optimizing) keeps
+// the bounds and so the signs, but lets the magnitude returned differ in
+// the last bits between instruction sets. Build with -ffp-contract=off
+// for identical values. The *_exact fallbacks are kept out of line, away
+// from the hot loops and the per-ISA clones that inline the filters.
+
+namespace cml {
+
+namespace detail {
+
+inline constexpr double predicate_epsilon = 0x1p-53;
+inline constexpr double predicate_result_bound =
+    (3.0 + 8.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double orient2d_bound =
+    (3.0 + 16.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double orient2d_bound_b =
+    (2.0 + 12.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double orient2d_bound_c =
+    (9.0 + 64.0 * predicate_epsilon) * predicate_epsilon * predicate_epsilon;
+inline constexpr double orient3d_bound =
+    (7.0 + 56.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double orient3d_bound_b =
+    (3.0 + 28.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double orient3d_bound_c =
+    (26.0 + 288.0 * predicate_epsilon) * predicate_epsilon *
+    predicate_epsilon;
+inline constexpr double incircle_bound =
+    (10.0 + 96.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double incircle_bound_b =
+    (4.0 + 48.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double incircle_bound_c =
+    (44.0 + 576.0 * predicate_epsilon) * predicate_epsilon *
+    predicate_epsilon;
+inline constexpr double insphere_bound =
+    (16.0 + 224.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double insphere_bound_b =
+    (5.0 + 72.0 * predicate_epsilon) * predicate_epsilon;
+inline constexpr double insphere_bound_c =
+    (71.0 + 1408.0 * predicate_epsilon) * predicate_epsilon *
+    predicate_epsilon;
+
+// A sum of at most N doubles ordered by increasing magnitude,
+// nonoverlapping and without zero components (zero is the single
+// component 0).
+template <std::size_t N> struct Expansion {
+    std::array<double, N> c;
+    std::size_t size = 0;
+
+    std::span<const double> components() const { return {c.data(), size}; }
+};
+
+// x + y == a + b exactly, x being the rounded sum.
+CML_ALWAYS_INLINE inline void two_sum(double a, double b, double &x,
+                                      double &y) {
+    x = a + b;
+    const auto bv = x - a;
+    const auto av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+// As two_sum, for |a| >= |b|.
+CML_ALWAYS_INLINE inline void fast_two_sum(double a, double b, double &x,
+                                           double &y) {
+    x = a + b;
+    y = b - (x - a);
+}
+
+CML_ALWAYS_INLINE inline void two_diff(double a, double b, double &x,
+                                       double &y) {
+    x = a - b;
+    const auto bv = a - x;
+    const auto av = x + bv;
+    y = (a - av) + (bv - b);
+}
+
+CML_ALWAYS_INLINE inline void two_product(double a, double b, double &x,
+                                          double &y) {
+    x = a * b;
+    y = std::fma(a, b, -x);
+}
+
+// Expansion arithmetic, after Shewchuk's *_zeroelim routines. Results are
+// typed by their worst-case length.
+namespace expansion {
+
+// h = e + f (fast_expansion_sum_zeroelim), h having room for
+// e.size() + f.size() components. Returns the length of h.
+inline std::size_t sum(std::span<const double> e, std::span<const double> f,
+                       double *h) {
+    std::size_t i = 0, j = 0, n = 0;
+    // The next component of smallest magnitude from either expansion.
+    const auto next = [&] {
+        if (j == f.size() ||
+            (i < e.size() && (f[j] > e[i]) == (f[j] > -e[i]))) {
+            return e[i++];
+        }
+        return f[j++];
+    };
+    auto q = next();
+    double hh;
+    if (i < e.size() && j < f.size()) {
+        fast_two_sum(next(), q, q, hh);
+        if (hh != 0.0) {
+            h[n++] = hh;
+        }
+    }
+    while (i < e.size() || j < f.size()) {
+        two_sum(q, next(), q, hh);
+        if (hh != 0.0) {
+            h[n++] = hh;
+        }
+    }
+    if (q != 0.0 || n == 0) {
+        h[n++] = q;
+    }
+    return n;
+}
+
+// h = e * b (scale_expansion_zeroelim), h having room for 2 e.size()
+// components. Returns the length of h.
+inline std::size_t scale(std::span<const double> e, double b, double *h) {
+    std::size_t n = 0;
+    double q, hh;
+    two_product(e[0], b, q, hh);
+    if (hh != 0.0) {
+        h[n++] = hh;
+    }
+    for (std::size_t i = 1; i < e.size(); i++) {
+        double p1, p0, s;
+        two_product(e[i], b, p1, p0);
+        two_sum(q, p0, s, hh);
+        if (hh != 0.0) {
+            h[n++] = hh;
+        }
+        fast_two_sum(p1, s, q, hh);
+        if (hh != 0.0) {
+            h[n++] = hh;
+        }
+    }
+    if (q != 0.0 || n == 0) {
+        h[n++] = q;
+    }
+    return n;
+}
+
+// head + tail, for a tail from two_diff() or two_product().
+inline Expansion<2> parts(double head, double tail) {
+    if (tail == 0.0) {
+        return {{head}, 1};
+    }
+    return {{tail, head}, 2};
+}
+
+// a - b exactly.
+inline Expansion<2> difference(double a, double b) {
+    double x, y;
+    two_diff(a, b, x, y);
+    return parts(x, y);
+}
+
+// a * b exactly.
+inline Expansion<2> product(double a, double b) {
+    double x, y;
+    two_product(a, b, x, y);
+    return parts(x, y);
+}
+
+template <std::size_t M, std::size_t N>
+Expansion<M + N> sum(const Expansion<M> &e, const Expansion<N> &f) {
+    Expansion<M + N> h;
+    h.size = sum(e.components(), f.components(), h.c.data());
+    return h;
+}
+
+template <std::size_t N>
+Expansion<2 * N> scale(const Expansion<N> &e, double b) {
+    Expansion<2 * N> h;
+    h.size = scale(e.components(), b, h.c.data());
+    return h;
+}
+
+// e * f, one scale() of e per component of f, so f is best the shorter.
+template <std::size_t M, std::size_t N>
+Expansion<2 * M * N> product(const Expansion<M> &e, const Expansion<N> &f) {
+    Expansion<2 * M * N> h;
+    std::array<double, 2 * M * N> other;
+    std::array<double, 2 * M> scaled;
+    auto *acc = h.c.data();
+    auto *next = other.data();
+    auto size = scale(e.components(), f.c[0], acc);
+    for (std::size_t i = 1; i < f.size; i++) {
+        const auto n = scale(e.components(), f.c[i], scaled.data());
+        size = sum({acc, size}, {scaled.data(), n}, next);
+        std::swap(acc, next);
+    }
+    if (acc != h.c.data()) {
+        std::copy_n(acc, size, h.c.data());
+    }
+    h.size = size;
+    return h;
+}
+
+template <std::size_t N> void negate(Expansion<N> &e) {
+    for (std::size_t i = 0; i < e.size; i++) {
+        e.c[i] = -e.c[i];
+    }
+}
+
+// a * d - b * c, on doubles or expansions.
+inline auto cross(const auto &a, const auto &b, const auto &c,
+                  const auto &d) {
+    auto bc = product(b, c);
+    negate(bc);
+    return sum(product(a, d), bc);
+}
+
+// The most significant component, which has the sign of the expansion.
+template <std::size_t N> double estimate(const Expansion<N> &e) {
+    return e.c[e.size - 1];
+}
+
+// The components summed in floating point: close to the value, and of the
+// same sign.
+template <std::size_t N> double approximate(const Expansion<N> &e) {
+    auto q = e.c[0];
+    for (std::size_t i = 1; i < e.size; i++) {
+        q += e.c[i];
+    }
+    return q;
+}
+
+} // namespace expansion
+
+struct FilteredDet {
+    double det;
+    double bound;
+    double permanent;
+};
+
+// Each *_filter computes the determinant in floating point and the bound
+// its error cannot exceed; both are straight-line code, so the batched
+// versions vectorize across lanes.
+CML_ALWAYS_INLINE inline FilteredDet orient2d_filter(double ax, double ay,
+                                                     double bx, double by,
+                                                     double cx, double cy) {
+    const auto left = (ax - cx) * (by - cy);
+    const auto right = (ay - cy) * (bx - cx);
+    const auto permanent = std::abs(left) + std::abs(right);
+    return {left - right, orient2d_bound * permanent, permanent};
+}
+
+CML_ALWAYS_INLINE inline FilteredDet
+orient3d_filter(double ax, double ay, double az, double bx, double by,
+                double bz, double cx, double cy, double cz, double dx,
+                double dy, double dz) {
+    const auto adx = ax - dx, ady = ay - dy, adz = az - dz;
+    const auto bdx = bx - dx, bdy = by - dy, bdz = bz - dz;
+    const auto cdx = cx - dx, cdy = cy - dy, cdz = cz - dz;
+    const auto bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    const auto cdxady = cdx * ady, adxcdy = adx * cdy;
+    const auto adxbdy = adx * bdy, bdxady = bdx * ady;
+    const auto det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) +
+                     cdz * (adxbdy - bdxady);
+    const auto permanent =
+        (std::abs(bdxcdy) + std::abs(cdxbdy)) * std::abs(adz) +
+        (std::abs(cdxady) + std::abs(adxcdy)) * std::abs(bdz) +
+        (std::abs(adxbdy) + std::abs(bdxady)) * std::abs(cdz);
+    return {det, orient3d_bound * permanent, permanent};
+}
+
+CML_ALWAYS_INLINE inline FilteredDet
+incircle_filter(double ax, double ay, double bx, double by, double cx,
+                double cy, double dx, double dy) {
+    const auto adx = ax - dx, ady = ay - dy;
+    const auto bdx = bx - dx, bdy = by - dy;
+    const auto cdx = cx - dx, cdy = cy - dy;
+    const auto bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+    const auto cdxady = cdx * ady, adxcdy = adx * cdy;
+    const auto adxbdy = adx * bdy, bdxady = bdx * ady;
+    const auto alift = adx * adx + ady * ady;
+    const auto blift = bdx * bdx + bdy * bdy;
+    const auto clift = cdx * cdx + cdy * cdy;
+    const auto det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) +
+                     clift * (adxbdy - bdxady);
+    const auto permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * alift +
+                           (std::abs(cdxady) + std::abs(adxcdy)) * blift +
+                           (std::abs(adxbdy) + std::abs(bdxady)) * clift;
+    return {det, incircle_bound * permanent, permanent};
+}
+
+CML_ALWAYS_INLINE inline FilteredDet
+insphere_filter(double ax, double ay, double az, double bx, double by,
+                double bz, double cx, double cy, double cz, double dx,
+                double dy, double dz, double ex, double ey, double ez) {
+    const auto aex = ax - ex, aey = ay - ey, aez = az - ez;
+    const auto bex = bx - ex, bey = by - ey, bez = bz - ez;
+    const auto cex = cx - ex, cey = cy - ey, cez = cz - ez;
+    const auto dex = dx - ex, dey = dy - ey, dez = dz - ez;
+    const auto aexbey = aex * bey, bexaey = bex * aey;
+    const auto bexcey = bex * cey, cexbey = cex * bey;
+    const auto cexdey = cex * dey, dexcey = dex * cey;
+    const auto dexaey = dex * aey, aexdey = aex * dey;
+    const auto aexcey = aex * cey, cexaey = cex * aey;
+    const auto bexdey = bex * dey, dexbey = dex * bey;
+    const auto ab = aexbey - bexaey, bc = bexcey - cexbey;
+    const auto cd = cexdey - dexcey, da = dexaey - aexdey;
+    const auto ac = aexcey - cexaey, bd = bexdey - dexbey;
+    const auto abc = aez * bc - bez * ac + cez * ab;
+    const auto bcd = bez * cd - cez * bd + dez * bc;
+    const auto cda = cez * da + dez * ac + aez * cd;
+    const auto dab = dez * ab + aez * bd + bez * da;
+    const auto alift = aex * aex + aey * aey + aez * aez;
+    const auto blift = bex * bex + bey * bey + bez * bez;
+    const auto clift = cex * cex + cey * cey + cez * cez;
+    const auto dlift = dex * dex + dey * dey + dez * dez;
+    const auto det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+
+    const auto az_ = std::abs(aez), bz_ = std::abs(bez);
+    const auto cz_ = std::abs(cez), dz_ = std::abs(dez);
+    const auto ab_ = std::abs(aexbey) + std::abs(bexaey);
+    const auto bc_ = std::abs(bexcey) + std::abs(cexbey);
+    const auto cd_ = std::abs(cexdey) + std::abs(dexcey);
+    const auto da_ = std::abs(dexaey) + std::abs(aexdey);
+    const auto ac_ = std::abs(aexcey) + std::abs(cexaey);
+    const auto bd_ = std::abs(bexdey) + std::abs(dexbey);
+    const auto permanent = (cd_ * bz_ + bd_ * cz_ + bc_ * dz_) * alift +
+                           (da_ * cz_ + ac_ * dz_ + cd_ * az_) * blift +
+                           (ab_ * dz_ + bd_ * az_ + da_ * bz_) * clift +
+                           (bc_ * az_ + ac_ * bz_ + ab_ * cz_) * dlift;
+    return {det, insphere_bound * permanent, permanent};
+}
+
+// The determinant unless the bound leaves its sign open.
+CML_ALWAYS_INLINE inline bool settled(const FilteredDet &f) {
+    return f.det > f.bound || -f.det > f.bound ||
+           (f.det == 0.0 && f.bound == 0.0);
+}
+
+// The *_exact fallbacks, for input the filter leaves open. Each stage
+// returns as soon as its bound settles the sign.
+CML_NOINLINE inline double orient2d_exact(double ax, double ay, double bx,
+                                          double by, double cx, double cy) {
+    using namespace expansion;
+    const auto permanent =
+        orient2d_filter(ax, ay, bx, by, cx, cy).permanent;
+    double acx, acy, bcx, bcy, acxtail, acytail, bcxtail, bcytail;
+    two_diff(ax, cx, acx, acxtail);
+    two_diff(ay, cy, acy, acytail);
+    two_diff(bx, cx, bcx, bcxtail);
+    two_diff(by, cy, bcy, bcytail);
+
+    const auto b = cross(acx, acy, bcx, bcy);
+    auto det = approximate(b);
+    if (std::abs(det) >= orient2d_bound_b * permanent ||
+        (acxtail == 0.0 && acytail == 0.0 && bcxtail == 0.0 &&
+         bcytail == 0.0)) {
+        return det;
+    }
+
+    const auto bound = orient2d_bound_c * permanent +
+                       predicate_result_bound * std::abs(det);
+    det += (acx * bcytail + bcy * acxtail) - (acy * bcxtail + bcx * acytail);
+    if (std::abs(det) >= bound) {
+        return det;
+    }
+
+    const auto c1 = sum(b, cross(acxtail, acytail, bcx, bcy));
+    const auto c2 = sum(c1, cross(acx, acy, bcxtail, bcytail));
+    return estimate(sum(c2, cross(acxtail, acytail, bcxtail, bcytail)));
+}
+
+CML_NOINLINE inline double
+orient3d_exact(double ax, double ay, double az, double bx, double by,
+               double bz, double cx, double cy, double cz, double dx,
+               double dy, double dz) {
+    using namespace expansion;
+    const auto permanent =
+        orient3d_filter(ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz)
+            .permanent;
+    double adx, ady, adz, bdx, bdy, bdz, cdx, cdy, cdz;
+    double adxtail, adytail, adztail, bdxtail, bdytail, bdztail;
+    double cdxtail, cdytail, cdztail;
+    two_diff(ax, dx, adx, adxtail);
+    two_diff(ay, dy, ady, adytail);
+    two_diff(az, dz, adz, adztail);
+    two_diff(bx, dx, bdx, bdxtail);
+    two_diff(by, dy, bdy, bdytail);
+    two_diff(bz, dz, bdz, bdztail);
+    two_diff(cx, dx, cdx, cdxtail);
+    two_diff(cy, dy, cdy, cdytail);
+    two_diff(cz, dz, cdz, cdztail);
+
+    auto det = approximate(
+        sum(sum(scale(cross(bdx, cdx, bdy, cdy), adz),
+                scale(cross(cdx, adx, cdy, ady), bdz)),
+            scale(cross(adx, bdx, ady, bdy), cdz)));
+    if (std::abs(det) >= orient3d_bound_b * permanent ||
+        (adxtail == 0.0 && adytail == 0.0 && adztail == 0.0 &&
+         bdxtail == 0.0 && bdytail == 0.0 && bdztail == 0.0 &&
+         cdxtail == 0.0 && cdytail == 0.0 && cdztail == 0.0)) {
+        return det;
+    }
+
+    const auto bound = orient3d_bound_c * permanent +
+                       predicate_result_bound * std::abs(det);
+    det += (adz * ((bdx * cdytail + cdy * bdxtail) -
+                   (bdy * cdxtail + cdx * bdytail)) +
+            adztail * (bdx * cdy - bdy * cdx)) +
+           (bdz * ((cdx * adytail + ady * cdxtail) -
+                   (cdy * adxtail + adx * cdytail)) +
+            bdztail * (cdx * ady - cdy * adx)) +
+           (cdz * ((adx * bdytail + bdy * adxtail) -
+                   (ady * bdxtail + bdx * adytail)) +
+            cdztail * (adx * bdy - ady * bdx));
+    if (std::abs(det) >= bound) {
+        return det;
+    }
+
+    const auto adx_ = parts(adx, adxtail), ady_ = parts(ady, adytail);
+    const auto adz_ = parts(adz, adztail), bdx_ = parts(bdx, bdxtail);
+    const auto bdy_ = parts(bdy, bdytail), bdz_ = parts(bdz, bdztail);
+    const auto cdx_ = parts(cdx, cdxtail), cdy_ = parts(cdy, cdytail);
+    const auto cdz_ = parts(cdz, cdztail);
+    return estimate(sum(sum(product(cross(bdx_, cdx_, bdy_, cdy_), adz_),
+                            product(cross(cdx_, adx_, cdy_, ady_), bdz_)),
+                        product(cross(adx_, bdx_, ady_, bdy_), cdz_)));
+}
+
+CML_NOINLINE inline double incircle_exact(double ax, double ay, double bx,
+                                          double by, double cx, double cy,
+                                          double dx, double dy) {
+    using namespace expansion;
+    const auto permanent =
+        incircle_filter(ax, ay, bx, by, cx, cy, dx, dy).permanent;
+    double adx, ady, bdx, bdy, cdx, cdy;
+    double adxtail, adytail, bdxtail, bdytail, cdxtail, cdytail;
+    two_diff(ax, dx, adx, adxtail);
+    two_diff(ay, dy, ady, adytail);
+    two_diff(bx, dx, bdx, bdxtail);
+    two_diff(by, dy, bdy, bdytail);
+    two_diff(cx, dx, cdx, cdxtail);
+    two_diff(cy, dy, cdy, cdytail);
+
+    // (x^2 + y^2) * minor, exactly.
+    const auto lifted = [](double x, double y, const Expansion<4> &minor) {
+        return sum(scale(scale(minor, x), x), scale(scale(minor, y), y));
+    };
+    auto det = approximate(
+        sum(sum(lifted(adx, ady, cross(bdx, cdx, bdy, cdy)),
+                lifted(bdx, bdy, cross(cdx, adx, cdy, ady))),
+            lifted(cdx, cdy, cross(adx, bdx, ady, bdy))));
+    if (std::abs(det) >= incircle_bound_b * permanent ||
+        (adxtail == 0.0 && adytail == 0.0 && bdxtail == 0.0 &&
+         bdytail == 0.0 && cdxtail == 0.0 && cdytail == 0.0)) {
+        return det;
+    }
+
+    const auto bound = incircle_bound_c * permanent +
+                       predicate_result_bound * std::abs(det);
+    det += ((adx * adx + ady * ady) * ((bdx * cdytail + cdy * bdxtail) -
+                                       (bdy * cdxtail + cdx * bdytail)) +
+            2.0 * (adx * adxtail + ady * adytail) * (bdx * cdy - bdy * cdx)) +
+           ((bdx * bdx + bdy * bdy) * ((cdx * adytail + ady * cdxtail) -
+                                       (cdy * adxtail + adx * cdytail)) +
+            2.0 * (bdx * bdxtail + bdy * bdytail) * (cdx * ady - cdy * adx)) +
+           ((cdx * cdx + cdy * cdy) * ((adx * bdytail + bdy * adxtail) -
+                                       (ady * bdxtail + bdx * adytail)) +
+            2.0 * (cdx * cdxtail + cdy * cdytail) * (adx * bdy - ady * bdx));
+    if (std::abs(det) >= bound) {
+        return det;
+    }
+
+    const auto adx_ = parts(adx, adxtail), ady_ = parts(ady, adytail);
+    const auto bdx_ = parts(bdx, bdxtail), bdy_ = parts(bdy, bdytail);
+    const auto cdx_ = parts(cdx, cdxtail), cdy_ = parts(cdy, cdytail);
+    const auto lift = [](const Expansion<2> &x, const Expansion<2> &y) {
+        return sum(product(x, x), product(y, y));
+    };
+    return estimate(
+        sum(sum(product(cross(bdx_, cdx_, bdy_, cdy_), lift(adx_, ady_)),
+                product(cross(cdx_, adx_, cdy_, ady_), lift(bdx_, bdy_))),
+            product(cross(adx_, bdx_, ady_, bdy_), lift(cdx_, cdy_))));
+}
+
+using Point3 = std::array<double, 3>;
+
+// The determinant of the rows (x, y, z) of p, q, r, exactly.
+inline Expansion<24> det3_exact(const Point3 &p, const Point3 &q,
+                                const Point3 &r) {
+    using namespace expansion;
+    auto pr = scale(cross(p[0], r[0], p[1], r[1]), q[2]);
+    negate(pr);
+    return sum(sum(scale(cross(q[0], r[0], q[1], r[1]), p[2]), pr),
+               scale(cross(p[0], q[0], p[1], q[1]), r[2]));
+}
+
+// The determinant of the rows (x, y, z, 1) of p, q, r, s, exactly.
+inline Expansion<96> det4_exact(const Point3 &p, const Point3 &q,
+                                const Point3 &r, const Point3 &s) {
+    using namespace expansion;
+    auto qrs = det3_exact(q, r, s);
+    negate(qrs);
+    auto pqs = det3_exact(p, q, s);
+    negate(pqs);
+    return sum(sum(qrs, det3_exact(p, r, s)), sum(pqs, det3_exact(p, q, r)));
+}
+
+// Stage D of insphere_exact, on the input coordinates rather than their
+// differences (whose exact products would need far longer expansions):
+// the 5 x 5 determinant of the rows (x, y, z, x^2 + y^2 + z^2, 1), by
+// cofactors along the lifted column. Up to 5760 components, as
+// Shewchuk's insphereexact.
+inline double insphere_stage_d(const std::array<Point3, 5> &p) {
+    using namespace expansion;
+    // (-1)^k lift(p[k]) times the minor without p[k].
+    const auto term = [&](unsigned int k) {
+        std::array<Point3, 4> rest;
+        for (auto i = 0u, j = 0u; i < 5; i++) {
+            if (i != k) {
+                rest[j++] = p[i];
+            }
+        }
+        auto lift = sum(sum(product(p[k][0], p[k][0]),
+                            product(p[k][1], p[k][1])),
+                        product(p[k][2], p[k][2]));
+        if (k % 2 == 0) {
+            negate(lift);
+        }
+        return product(det4_exact(rest[0], rest[1], rest[2], rest[3]), lift);
+    };
+    const auto ab = sum(term(0), term(1));
+    const auto cde = sum(sum(term(2), term(3)), term(4));
+    return estimate(sum(ab, cde));
+}
+
+CML_NOINLINE inline double
+insphere_exact(double ax, double ay, double az, double bx, double by,
+               double bz, double cx, double cy, double cz, double dx,
+               double dy, double dz, double ex, double ey, double ez) {
+    using namespace expansion;
+    const auto permanent =
+        insphere_filter(ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz, ex,
+                        ey, ez)
+            .permanent;
+    double aex, aey, aez, bex, bey, bez, cex, cey, cez, dex, dey, dez;
+    double aextail, aeytail, aeztail, bextail, beytail, beztail;
+    double cextail, ceytail, ceztail, dextail, deytail, deztail;
+    two_diff(ax, ex, aex, aextail);
+    two_diff(ay, ey, aey, aeytail);
+    two_diff(az, ez, aez, aeztail);
+    two_diff(bx, ex, bex, bextail);
+    two_diff(by, ey, bey, beytail);
+    two_diff(bz, ez, bez, beztail);
+    two_diff(cx, ex, cex, cextail);
+    two_diff(cy, ey, cey, ceytail);
+    two_diff(cz, ez, cez, ceztail);
+    two_diff(dx, ex, dex, dextail);
+    two_diff(dy, ey, dey, deytail);
+    two_diff(dz, ez, dez, deztail);
+
+    const auto ab = cross(aex, bex, aey, bey);
+    const auto bc = cross(bex, cex, bey, cey);
+    const auto cd = cross(cex, dex, cey, dey);
+    const auto da = cross(dex, aex, dey, aey);
+    const auto ac = cross(aex, cex, aey, cey);
+    const auto bd = cross(bex, dex, bey, dey);
+    // sign (x^2 + y^2 + z^2) * (minor_x z_x + minor_y z_y + minor_z z_z).
+    const auto lifted = [](double sign, double x, double y, double z,
+                           const Expansion<24> &minor) {
+        return sum(sum(scale(scale(minor, x), sign * x),
+                       scale(scale(minor, y), sign * y)),
+                   scale(scale(minor, z), sign * z));
+    };
+    const auto minor = [](const Expansion<4> &e, double ez,
+                          const Expansion<4> &f, double fz,
+                          const Expansion<4> &g, double gz) {
+        return sum(sum(scale(e, ez), scale(f, fz)), scale(g, gz));
+    };
+    const auto abc = minor(bc, aez, ac, -bez, ab, cez);
+    const auto bcd = minor(cd, bez, bd, -cez, bc, dez);
+    const auto cda = minor(da, cez, ac, dez, cd, aez);
+    const auto dab = minor(ab, dez, bd, aez, da, bez);
+    auto det = approximate(sum(sum(lifted(-1.0, aex, aey, aez, bcd),
+                                   lifted(1.0, bex, bey, bez, cda)),
+                               sum(lifted(-1.0, cex, cey, cez, dab),
+                                   lifted(1.0, dex, dey, dez, abc))));
+    if (std::abs(det) >= insphere_bound_b * permanent ||
+        (aextail == 0.0 && aeytail == 0.0 && aeztail == 0.0 &&
+         bextail == 0.0 && beytail == 0.0 && beztail == 0.0 &&
+         cextail == 0.0 && ceytail == 0.0 && ceztail == 0.0 &&
+         dextail == 0.0 && deytail == 0.0 && deztail == 0.0)) {
+        return det;
+    }
+
+    const auto bound = insphere_bound_c * permanent +
+                       predicate_result_bound * std::abs(det);
+    // The 2 x 2 minors in floating point, and to first order in the tails.
+    const auto ab3 = aex * bey - bex * aey, bc3 = bex * cey - cex * bey;
+    const auto cd3 = cex * dey - dex * cey, da3 = dex * aey - aex * dey;
+    const auto ac3 = aex * cey - cex * aey, bd3 = bex * dey - dex * bey;
+    const auto abeps =
+        (aex * beytail + bey * aextail) - (aey * bextail + bex * aeytail);
+    const auto bceps =
+        (bex * ceytail + cey * bextail) - (bey * cextail + cex * beytail);
+    const auto cdeps =
+        (cex * deytail + dey * cextail) - (cey * dextail + dex * ceytail);
+    const auto daeps =
+        (dex * aeytail + aey * dextail) - (dey * aextail + aex * deytail);
+    const auto aceps =
+        (aex * ceytail + cey * aextail) - (aey * cextail + cex * aeytail);
+    const auto bdeps =
+        (bex * deytail + dey * bextail) - (bey * dextail + dex * beytail);
+    det += (((bex * bex + bey * bey + bez * bez) *
+                 ((cez * daeps + dez * aceps + aez * cdeps) +
+                  (ceztail * da3 + deztail * ac3 + aeztail * cd3)) +
+             (dex * dex + dey * dey + dez * dez) *
+                 ((aez * bceps - bez * aceps + cez * abeps) +
+                  (aeztail * bc3 - beztail * ac3 + ceztail * ab3))) -
+            ((aex * aex + aey * aey + aez * aez) *
+                 ((bez * cdeps - cez * bdeps + dez * bceps) +
+                  (beztail * cd3 - ceztail * bd3 + deztail * bc3)) +
+             (cex * cex + cey * cey + cez * cez) *
+                 ((dez * abeps + aez * bdeps + bez * daeps) +
+                  (deztail * ab3 + aeztail * bd3 + beztail * da3)))) +
+           2.0 * (((bex * bextail + bey * beytail + bez * beztail) *
+                       (cez * da3 + dez * ac3 + aez * cd3) +
+                   (dex * dextail + dey * deytail + dez * deztail) *
+                       (aez * bc3 - bez * ac3 + cez * ab3)) -
+                  ((aex * aextail + aey * aeytail + aez * aeztail) *
+                       (bez * cd3 - cez * bd3 + dez * bc3) +
+                   (cex * cextail + cey * ceytail + cez * ceztail) *
+                       (dez * ab3 + aez * bd3 + bez * da3)));
+    if (std::abs(det) >= bound) {
+        return det;
+    }
+
+    return insphere_stage_d({Point3{ax, ay, az}, Point3{bx, by, bz},
+                             Point3{cx, cy, cz}, Point3{dx, dy, dz},
+                             Point3{ex, ey, ez}});
+}
+
+// out[i] = the determinant for element i of the batches: filter() on
+// every lane of a block, then exact() for the lanes it left open. Returns
+// how many needed exact().
+template <unsigned int Dim, unsigned int Points, typename Filter,
+          typename Exact>
+std::size_t predicate_batch(
+    const std::array<const VecBatch<double, Dim> *, Points> &points,
+    std::span<double> out, ThreadPool &pool, Filter &&filter,
+    Exact &&exact) {
+    const auto size = points[0]->size();
+    for (const auto *p : points) {
+        if (p->size() != size) {
+            throw std::invalid_argument("predicate: batch size mismatch");
+        }
+    }
+    if (out.size() != size) {
+        throw std::invalid_argument("predicate: output size mismatch");
+    }
+    std::array<std::array<const double *, Dim>, Points> c;
+    for (auto p = 0u; p < Points; p++) {
+        c[p] = component_pointers(*points[p]);
+    }
+    std::atomic<std::size_t> exact_count{0};
+    for_each_block(size, pool, [&](std::size_t base, std::size_t lanes) {
+        Lanes<double> det;
+        Lanes<double> open;
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            const auto f = filter(c, base + l);
+            det[l] = f.det;
+            open[l] = settled(f) ? 0.0 : 1.0;
+        }
+        store_lanes(out.data() + base, det, lanes);
+        std::size_t count = 0;
+        for (std::size_t l = 0; l < lanes; l++) {
+            if (open[l] != 0.0) {
+                out[base + l] = exact(c, base + l);
+                count++;
+            }
+        }
+        if (count != 0) {
+            exact_count.fetch_add(count, std::memory_order_relaxed);
+        }
+    });
+    return exact_count.load();
+}
+
+} // namespace detail
+
+template <std::floating_point LenT>
+double orient2d(const Vec<double, 2, LenT> &a, const Vec<double, 2, LenT> &b,
+                const Vec<double, 2, LenT> &c) {
+    const auto f = detail::orient2d_filter(a[0], a[1], b[0], b[1], c[0], c[1]);
+    if (detail::settled(f)) {
+        return f.det;
+    }
+    return detail::orient2d_exact(a[0], a[1], b[0], b[1], c[0], c[1]);
+}
+
+template <std::floating_point LenT>
+double orient3d(const Vec<double, 3, LenT> &a, const Vec<double, 3, LenT> &b,
+                const Vec<double, 3, LenT> &c, const Vec<double, 3, LenT> &d) {
+    const auto f =
+        detail::orient3d_filter(a[0], a[1], a[2], b[0], b[1], b[2], c[0],
+                                c[1], c[2], d[0], d[1], d[2]);
+    if (detail::settled(f)) {
+        return f.det;
+    }
+    return detail::orient3d_exact(a[0], a[1], a[2], b[0], b[1], b[2], c[0],
+                                  c[1], c[2], d[0], d[1], d[2]);
+}
+
+template <std::floating_point LenT>
+double incircle(const Vec<double, 2, LenT> &a, const Vec<double, 2, LenT> &b,
+                const Vec<double, 2, LenT> &c, const Vec<double, 2, LenT> &d) {
+    const auto f = detail::incircle_filter(a[0], a[1], b[0], b[1], c[0], c[1],
+                                           d[0], d[1]);
+    if (detail::settled(f)) {
+        return f.det;
+    }
+    return detail::incircle_exact(a[0], a[1], b[0], b[1], c[0], c[1], d[0],
+                                  d[1]);
+}
+
+template <std::floating_point LenT>
+double insphere(const Vec<double, 3, LenT> &a, const Vec<double, 3, LenT> &b,
+                const Vec<double, 3, LenT> &c, const Vec<double, 3, LenT> &d,
+                const Vec<double, 3, LenT> &e) {
+    const auto f = detail::insphere_filter(
+        a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2], d[0], d[1], d[2],
+        e[0], e[1], e[2]);
+    if (detail::settled(f)) {
+        return f.det;
+    }
+    return detail::insphere_exact(a[0], a[1], a[2], b[0], b[1], b[2], c[0],
+                                  c[1], c[2], d[0], d[1], d[2], e[0], e[1],
+                                  e[2]);
+}
+
+// Batched predicates over elements i of equally sized batches: the filter
+// runs SIMD across elements (through run_with_isa, on the pool) and only
+// the elements it leaves open go through the exact path. out must hold
+// size() values. Return how many elements needed the exact path; throw
+// std::invalid_argument on size mismatches.
+inline std::size_t orient2d(const VecBatch<double, 2> &a,
+                            const VecBatch<double, 2> &b,
+                            const VecBatch<double, 2> &c,
+                            std::span<double> out,
+                            ThreadPool &pool = ThreadPool::global()) {
+    return detail::predicate_batch<2, 3>(
+        {&a, &b, &c}, out, pool,
+        [](const auto &p, std::size_t i) CML_ALWAYS_INLINE {
+            return detail::orient2d_filter(p[0][0][i], p[0][1][i], p[1][0][i],
+                                           p[1][1][i], p[2][0][i],
+                                           p[2][1][i]);
+        },
+        [](const auto &p, std::size_t i) {
+            return detail::orient2d_exact(p[0][0][i], p[0][1][i], p[1][0][i],
+                                          p[1][1][i], p[2][0][i], p[2][1][i]);
+        });
+}
+
+inline std::size_t orient3d(const VecBatch<double, 3> &a,
+                            const VecBatch<double, 3> &b,
+                            const VecBatch<double, 3> &c,
+                            const VecBatch<double, 3> &d,
+                            std::span<double> out,
+                            ThreadPool &pool = ThreadPool::global()) {
+    return detail::predicate_batch<3, 4>(
+        {&a, &b, &c, &d}, out, pool,
+        [](const auto &p, std::size_t i) CML_ALWAYS_INLINE {
+            return detail::orient3d_filter(
+                p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i],
+                p[1][2][i], p[2][0][i], p[2][1][i], p[2][2][i], p[3][0][i],
+                p[3][1][i], p[3][2][i]);
+        },
+        [](const auto &p, std::size_t i) {
+            return detail::orient3d_exact(
+                p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i],
+                p[1][2][i], p[2][0][i], p[2][1][i], p[2][2][i], p[3][0][i],
+                p[3][1][i], p[3][2][i]);
+        });
+}
+
+inline std::size_t incircle(const VecBatch<double, 2> &a,
+                            const VecBatch<double, 2> &b,
+                            const VecBatch<double, 2> &c,
+                            const VecBatch<double, 2> &d,
+                            std::span<double> out,
+                            ThreadPool &pool = ThreadPool::global()) {
+    return detail::predicate_batch<2, 4>(
+        {&a, &b, &c, &d}, out, pool,
+        [](const auto &p, std::size_t i) CML_ALWAYS_INLINE {
+            return detail::incircle_filter(
+                p[0][0][i], p[0][1][i], p[1][0][i], p[1][1][i], p[2][0][i],
+                p[2][1][i], p[3][0][i], p[3][1][i]);
+        },
+        [](const auto &p, std::size_t i) {
+            return detail::incircle_exact(
+                p[0][0][i], p[0][1][i], p[1][0][i], p[1][1][i], p[2][0][i],
+                p[2][1][i], p[3][0][i], p[3][1][i]);
+        });
+}
+
+inline std::size_t insphere(const VecBatch<double, 3> &a,
+                            const VecBatch<double, 3> &b,
+                            const VecBatch<double, 3> &c,
+                            const VecBatch<double, 3> &d,
+                            const VecBatch<double, 3> &e,
+                            std::span<double> out,
+                            ThreadPool &pool = ThreadPool::global()) {
+    return detail::predicate_batch<3, 5>(
+        {&a, &b, &c, &d, &e}, out, pool,
+        [](const auto &p, std::size_t i) CML_ALWAYS_INLINE {
+            return detail::insphere_filter(
+                p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i],
+                p[1][2][i], p[2][0][i], p[2][1][i], p[2][2][i], p[3][0][i],
+                p[3][1][i], p[3][2][i], p[4][0][i], p[4][1][i], p[4][2][i]);
+        },
+        [](const auto &p, std::size_t i) {
+            return detail::insphere_exact(
+                p[0][0][i], p[0][1][i], p[0][2][i], p[1][0][i], p[1][1][i],
+                p[1][2][i], p[2][0][i], p[2][1][i], p[2][2][i], p[3][0][i],
+                p[3][1][i], p[3][2][i], p[4][0][i], p[4][1][i], p[4][2][i]);
+        });
+}
+
+} // namespace cml
@@ -0,0 +1,433 @@
+#pragma once
+#include "common.hpp"
+#include "constants.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace cml {
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Every 128-bit counter maps to four
+// independent 32-bit words, so sample i of a stream can be computed
+// directly from (seed, i) without any sequential state.
+class Philox4x32 {
+  public:
+    using Counter = std::array<std::uint32_t, 4>;
+    using Key = std::array<std::uint32_t, 2>;
+
+    constexpr explicit Philox4x32(std::uint64_t seed = 0)
+        : m_key{static_cast<std::uint32_t>(seed),
+                static_cast<std::uint32_t>(seed >> 32)} {}
+    constexpr explicit Philox4x32(Key key) : m_key(key) {}
+
+    constexpr Key key() const { return m_key; }
+
+    constexpr Counter operator()(Counter ctr) const {
+        auto key = m_key;
+        for (int round = 0; round < 10; round++) {
+            ctr = this->round(ctr, key);
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return ctr;
+    }
+
+    // Same as operator() for W counters at once, laid out as four arrays of
+    // W lanes; written so that the lanes vectorize.
+    template <std::size_t W>
+    static constexpr void generate(std::array<std::uint32_t, W> (&ctr)[4],
+                                   Key key) {
+        for (int round = 0; round < 10; round++) {
+            for (auto l = 0u; l < W; l++) {
+                const auto p0 = std::uint64_t(M0) * ctr[0][l];
+                const auto p1 = std::uint64_t(M1) * ctr[2][l];
+                const auto c1 = ctr[1][l];
+                const auto c3 = ctr[3][l];
+                const auto hi0 = static_cast<std::uint32_t>(p0 >> 32);
+                const auto hi1 = static_cast<std::uint32_t>(p1 >> 32);
+                ctr[0][l] = hi1 ^ c1 ^ key[0];
+                ctr[1][l] = static_cast<std::uint32_t>(p1);
+                ctr[2][l] = hi0 ^ c3 ^ key[1];
+                ctr[3][l] = static_cast<std::uint32_t>(p0);
+            }
+            key[0] += W0;
+            key[1] += W1;
+        }
+    }
+
+  private:
+    static constexpr std::uint32_t M0 = 0xD2511F53;
+    static constexpr std::uint32_t M1 = 0xCD9E8D57;
+    static constexpr std::uint32_t W0 = 0x9E3779B9;
+    static constexpr std::uint32_t W1 = 0xBB67AE85;
+
+    static constexpr Counter round(const Counter &ctr, const Key &key) {
+        const auto p0 = std::uint64_t(M0) * ctr[0];
+        const auto p1 = std::uint64_t(M1) * ctr[2];
+        return {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                static_cast<std::uint32_t>(p1),
+                static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                static_cast<std::uint32_t>(p0)};
+    }
+
+    Key m_key;
+};
+
+// xoshiro256** (Blackman & Vigna) with jump-ahead. Models
+// std::uniform_random_bit_generator. jump() advances by 2^128 and
+// long_jump() by 2^192 calls, which gives non-overlapping per-thread
+// streams from one seed.
+class Xoshiro256 {
+  public:
+    using result_type = std::uint64_t;
+
+    constexpr explicit Xoshiro256(std::uint64_t seed = 0) {
+        for (auto &word : m_state) {
+            seed += 0x9E3779B97F4A7C15ull;
+            auto z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr result_type operator()() {
+        const auto result = rotl(m_state[1] * 5, 7) * 9;
+        const auto t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+        return result;
+    }
+
+    constexpr void jump() {
+        apply_jump({0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+                    0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull});
+    }
+
+    constexpr void long_jump() {
+        apply_jump({0x76E15D3EFEFDCBBFull, 0xC5004E441C522FB3ull,
+                    0x77710069854EE241ull, 0x39109BB02ACBE635ull});
+    }
+
+    // Generator for stream `index`: the seed's generator jumped index times.
+    static constexpr Xoshiro256 stream(std::uint64_t seed,
+                                       std::uint64_t index) {
+        Xoshiro256 rng(seed);
+        for (std::uint64_t i = 0; i < index; i++) {
+            rng.jump();
+        }
+        return rng;
+    }
+
+    constexpr bool operator==(const Xoshiro256 &) const = default;
+
+  private:
+    static constexpr std::uint64_t rotl(std::uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    constexpr void apply_jump(const std::array<std::uint64_t, 4> &poly) {
+        std::array<std::uint64_t, 4> s{};
+        for (const auto word : poly) {
+            for (int b = 0; b < 64; b++) {
+                if (word & (std::uint64_t(1) << b)) {
+                    for (auto i = 0u; i < 4; i++) {
+                        s[i] ^= m_state[i];
+                    }
+                }
+                operator()();
+            }
+        }
+        m_state = s;
+    }
+
+    std::array<std::uint64_t, 4> m_state{};
+};
+
+// Maps random bits to [0, 1) using the top 24 (float) or 53 (double and
+// long double) bits.
+template <std::floating_point T>
+constexpr T uniform_from_bits(std::uint32_t x) {
+    return static_cast<T>(x >> 8) * static_cast<T>(0x1.0p-24);
+}
+template <std::floating_point T>
+constexpr T uniform_from_bits(std::uint64_t x) {
+    return static_cast<T>(x >> 11) * static_cast<T>(0x1.0p-53);
+}
+
+namespace detail {
+
+// Number of 32-bit words used for one uniform variate of type T.
+template <std::floating_point T>
+inline constexpr unsigned int words_per_uniform =
+    std::is_same_v<T, float> ? 1 : 2;
+
+// Calls emit(i, u) for every sample index i in [first, first + count),
+// where u is a std::array<T, K> of uniforms in [0, 1). The uniforms of
+// sample i depend only on (seed, i), so the output is identical for any
+// number of threads. Philox is evaluated for `lanes` samples at a time.
+template <std::floating_point T, unsigned int K, typename F>
+void generate_uniforms(std::uint64_t seed, std::uint64_t first,
+                       std::size_t count, ThreadPool &pool, F &&emit) {
+    constexpr std::size_t lanes = 16;
+    constexpr unsigned int words = K * words_per_uniform<T>;
+    constexpr unsigned int blocks = (words + 3) / 4;
+    const Philox4x32 philox(seed);
+
+    pool.parallel_for(0, count, 1 << 14, [&](std::size_t begin,
+                                             std::size_t end) {
+        for (auto base = begin; base < end; base += lanes) {
+            const auto n = std::min(lanes, end - base);
+            std::array<std::uint32_t, lanes> bits[blocks * 4];
+            for (auto b = 0u; b < blocks; b++) {
+                std::array<std::uint32_t, lanes> ctr[4];
+                for (auto l = 0u; l < lanes; l++) {
+                    const std::uint64_t index = first + base + l;
+                    ctr[0][l] = static_cast<std::uint32_t>(index);
+                    ctr[1][l] = static_cast<std::uint32_t>(index >> 32);
+                    ctr[2][l] = b;
+                    ctr[3][l] = 0;
+                }
+                Philox4x32::generate(ctr, philox.key());
+                for (auto w = 0u; w < 4; w++) {
+                    bits[b * 4 + w] = ctr[w];
+                }
+            }
+            for (auto l = 0u; l < n; l++) {
+                std::array<T, K> u;
+                static_for<K>([&](unsigned int k) CML_ALWAYS_INLINE {
+                    if constexpr (words_per_uniform<T> == 1) {
+                        u[k] = uniform_from_bits<T>(bits[k][l]);
+                    } else {
+                        const auto hi = std::uint64_t(bits[2 * k][l]) << 32;
+                        u[k] = uniform_from_bits<T>(hi | bits[2 * k + 1][l]);
+                    }
+                });
+                emit(base + l, u);
+            }
+        }
+    });
+}
+
+// Maps two uniforms in [0, 1) to two independent standard normals.
+template <std::floating_point T>
+std::array<T, 2> box_muller(T u0, T u1) {
+    const auto r = std::sqrt(T(-2) * std::log(T(1) - u0));
+    const auto phi = 2 * pi<T> * u1;
+    return {r * std::cos(phi), r * std::sin(phi)};
+}
+
+template <std::floating_point T, unsigned int Dim, typename Store>
+void sample_box(const Vec<T, Dim> &lo, const Vec<T, Dim> &hi,
+                std::uint64_t seed, std::uint64_t first, std::size_t count,
+                ThreadPool &pool, Store &&store) {
+    generate_uniforms<T, Dim>(
+        seed, first, count, pool,
+        [&](std::size_t i, const std::array<T, Dim> &u) CML_ALWAYS_INLINE {
+            Vec<T, Dim> v;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                v[d] = lo[d] + (hi[d] - lo[d]) * u[d];
+            });
+            store(i, v);
+        });
+}
+
+template <std::floating_point T, unsigned int Dim, typename Store>
+void sample_gaussian(const Vec<T, Dim> &mean, T stddev, std::uint64_t seed,
+                     std::uint64_t first, std::size_t count, ThreadPool &pool,
+                     Store &&store) {
+    constexpr unsigned int pairs = (Dim + 1) / 2;
+    generate_uniforms<T, 2 * pairs>(
+        seed, first, count, pool,
+        [&](std::size_t i, const std::array<T, 2 * pairs> &u) {
+            Vec<T, Dim> v;
+            for (auto p = 0u; p < pairs; p++) {
+                const auto n = box_muller(u[2 * p], u[2 * p + 1]);
+                v[2 * p] = mean[2 * p] + stddev * n[0];
+                if (2 * p + 1 < Dim) {
+                    v[2 * p + 1] = mean[2 * p + 1] + stddev * n[1];
+                }
+            }
+            store(i, v);
+        });
+}
+
+template <std::floating_point T, unsigned int Dim, typename Store>
+void sample_sphere(std::uint64_t seed, std::uint64_t first, std::size_t count,
+                   ThreadPool &pool, Store &&store) {
+    if constexpr (Dim == 2) {
+        generate_uniforms<T, 1>(seed, first, count, pool,
+                                [&](std::size_t i, const std::array<T, 1> &u) {
+                                    const auto phi = 2 * pi<T> * u[0];
+                                    store(i, Vec<T, 2>(std::cos(phi),
+                                                       std::sin(phi)));
+                                });
+    } else if constexpr (Dim == 3) {
+        generate_uniforms<T, 2>(
+            seed, first, count, pool,
+            [&](std::size_t i, const std::array<T, 2> &u) {
+                const auto z = T(1) - 2 * u[0];
+                const auto r = std::sqrt(std::max(T(0), T(1) - z * z));
+                const auto phi = 2 * pi<T> * u[1];
+                store(i, Vec<T, 3>(r * std::cos(phi), r * std::sin(phi), z));
+            });
+    } else {
+        sample_gaussian<T, Dim>(Vec<T, Dim>(), T(1), seed, first, count, pool,
+                                [&](std::size_t i, Vec<T, Dim> v) {
+                                    const auto len = static_cast<T>(v.length());
+                                    store(i, len > 0 ? v / len : Vec<T, Dim>());
+                                });
+    }
+}
+
+template <std::floating_point T, typename Store>
+void sample_disk(std::uint64_t seed, std::uint64_t first, std::size_t count,
+                 ThreadPool &pool, Store &&store) {
+    generate_uniforms<T, 2>(seed, first, count, pool,
+                            [&](std::size_t i, const std::array<T, 2> &u) {
+                                const auto r = std::sqrt(u[0]);
+                                const auto phi = 2 * pi<T> * u[1];
+                                store(i, Vec<T, 2>(r * std::cos(phi),
+                                                   r * std::sin(phi)));
+                            });
+}
+
+template <std::floating_point T, typename Store>
+void sample_cosine_hemisphere(std::uint64_t seed, std::uint64_t first,
+                              std::size_t count, ThreadPool &pool,
+                              Store &&store) {
+    sample_disk<T>(seed, first, count, pool, [&](std::size_t i, Vec<T, 2> d) {
+        const auto r2 = static_cast<T>(d.length_sq());
+        const auto z = std::sqrt(std::max(T(0), T(1) - r2));
+        store(i, Vec<T, 3>(d.x(), d.y(), z));
+    });
+}
+
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+auto span_store(std::span<Vec<T, Dim, LenT>> out) {
+    return [out](std::size_t i, const Vec<T, Dim> &v) CML_ALWAYS_INLINE {
+        static_for<Dim>(
+            [&](unsigned int d) CML_ALWAYS_INLINE { out[i][d] = v[d]; });
+    };
+}
+
+template <std::floating_point T, unsigned int Dim>
+auto batch_store(VecBatch<T, Dim> &out) {
+    return [&out](std::size_t i, const Vec<T, Dim> &v) CML_ALWAYS_INLINE {
+        out.set(i, v);
+    };
+}
+
+} // namespace detail
+
+// Batched samplers. Output element i is sample number `first + i` of the
+// stream identified by `seed`; results do not depend on the thread pool
+// size, and disjoint index ranges can be filled independently.
+
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+void fill_uniform_box(std::span<Vec<T, Dim, LenT>> out,
+                      const Vec<T, Dim> &lo, const Vec<T, Dim> &hi,
+                      std::uint64_t seed, std::uint64_t first = 0,
+                      ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_box<T, Dim>(lo, hi, seed, first, out.size(), pool,
+                               detail::span_store(out));
+}
+
+template <std::floating_point T, unsigned int Dim>
+void fill_uniform_box(VecBatch<T, Dim> &out, const Vec<T, Dim> &lo,
+                      const Vec<T, Dim> &hi, std::uint64_t seed,
+                      std::uint64_t first = 0,
+                      ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_box<T, Dim>(lo, hi, seed, first, out.size(), pool,
+                               detail::batch_store(out));
+}
+
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+void fill_gaussian(std::span<Vec<T, Dim, LenT>> out, const Vec<T, Dim> &mean,
+                   T stddev, std::uint64_t seed, std::uint64_t first = 0,
+                   ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_gaussian<T, Dim>(mean, stddev, seed, first, out.size(),
+                                    pool, detail::span_store(out));
+}
+
+template <std::floating_point T, unsigned int Dim>
+void fill_gaussian(VecBatch<T, Dim> &out, const Vec<T, Dim> &mean, T stddev,
+                   std::uint64_t seed, std::uint64_t first = 0,
+                   ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_gaussian<T, Dim>(mean, stddev, seed, first, out.size(),
+                                    pool, detail::batch_store(out));
+}
+
+// Uniform directions on the unit sphere S^(Dim-1).
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+    requires(Dim >= 2)
+void fill_uniform_sphere(std::span<Vec<T, Dim, LenT>> out, std::uint64_t seed,
+                         std::uint64_t first = 0,
+                         ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_sphere<T, Dim>(seed, first, out.size(), pool,
+                                  detail::span_store(out));
+}
+
+template <std::floating_point T, unsigned int Dim>
+    requires(Dim >= 2)
+void fill_uniform_sphere(VecBatch<T, Dim> &out, std::uint64_t seed,
+                         std::uint64_t first = 0,
+                         ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_sphere<T, Dim>(seed, first, out.size(), pool,
+                                  detail::batch_store(out));
+}
+
+// Uniform points in the unit disk.
+template <std::floating_point T, std::floating_point LenT>
+void fill_uniform_disk(std::span<Vec<T, 2, LenT>> out, std::uint64_t seed,
+                       std::uint64_t first = 0,
+                       ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_disk<T>(seed, first, out.size(), pool,
+                           detail::span_store(out));
+}
+
+template <std::floating_point T>
+void fill_uniform_disk(VecBatch<T, 2> &out, std::uint64_t seed,
+                       std::uint64_t first = 0,
+                       ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_disk<T>(seed, first, out.size(), pool,
+                           detail::batch_store(out));
+}
+
+// Cosine-weighted directions on the +z hemisphere (pdf = cos(theta) / pi).
+template <std::floating_point T, std::floating_point LenT>
+void fill_cosine_hemisphere(std::span<Vec<T, 3, LenT>> out,
+                            std::uint64_t seed, std::uint64_t first = 0,
+                            ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_cosine_hemisphere<T>(seed, first, out.size(), pool,
+                                        detail::span_store(out));
+}
+
+template <std::floating_point T>
+void fill_cosine_hemisphere(VecBatch<T, 3> &out, std::uint64_t seed,
+                            std::uint64_t first = 0,
+                            ThreadPool &pool = ThreadPool::global()) {
+    detail::sample_cosine_hemisphere<T>(seed, first, out.size(), pool,
+                                        detail::batch_store(out));
+}
+
+} // namespace cml
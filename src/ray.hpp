@@ -0,0 +1,640 @@
+#pragma once
+#include "aabb.hpp"
+#include "common.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace cml {
+
+// The half line origin + t * dir for t in [t_min, t_max].
+template <std::floating_point T> struct Ray {
+    Vec3<T> origin;
+    Vec3<T> dir;
+    T t_min = 0;
+    T t_max = std::numeric_limits<T>::infinity();
+
+    constexpr Ray() = default;
+    constexpr Ray(const Vec3<T> &origin, const Vec3<T> &dir, T t_min = 0,
+                  T t_max = std::numeric_limits<T>::infinity())
+        : origin(origin), dir(dir), t_min(t_min), t_max(t_max) {}
+
+    constexpr Vec3<T> at(T t) const { return origin + dir * t; }
+};
+
+// Hit at ray distance t on the triangle (a, b, c), at the point
+// (1 - u - v) * a + u * b + v * c.
+template <std::floating_point T> struct TriangleHit {
+    T t;
+    T u;
+    T v;
+};
+
+// Ray transformed for the watertight test of Woop, Benthin and Wald
+// (2013): vertices are translated to the origin and sheared so that the
+// ray becomes the +z axis. Adjacent triangles then compute identical edge
+// functions for a shared edge, so rays cannot slip between them.
+//
+// The permutation and shear are folded into three linear forms: the
+// sheared coordinates of a vertex p relative to the origin are
+// (shear_x.dot(p), shear_y.dot(p), shear_z.dot(p)), where each form has one
+// or two non-zero coefficients, so the result is rounded exactly like the
+// reference formulation.
+template <std::floating_point T> struct WatertightRay {
+    Vec3<T> origin;
+    Vec3<T> shear_x;
+    Vec3<T> shear_y;
+    Vec3<T> shear_z;
+    T t_min = 0;
+    T t_max = std::numeric_limits<T>::infinity();
+
+    WatertightRay() = default;
+    explicit WatertightRay(const Ray<T> &ray)
+        : origin(ray.origin), t_min(ray.t_min), t_max(ray.t_max) {
+        const auto &d = ray.dir;
+        unsigned int kz = 0;
+        if (std::abs(d[1]) > std::abs(d[kz])) {
+            kz = 1;
+        }
+        if (std::abs(d[2]) > std::abs(d[kz])) {
+            kz = 2;
+        }
+        auto kx = (kz + 1) % 3;
+        auto ky = (kx + 1) % 3;
+        // Keep the winding of the edge functions.
+        if (d[kz] < 0) {
+            std::swap(kx, ky);
+        }
+        shear_x[kx] = 1;
+        shear_x[kz] = -d[kx] / d[kz];
+        shear_y[ky] = 1;
+        shear_y[kz] = -d[ky] / d[kz];
+        shear_z[kz] = 1 / d[kz];
+    }
+};
+
+namespace detail {
+
+// 2D cross product of sheared edge endpoints, recomputed in double when it
+// is exactly zero in float, as in the reference implementation.
+template <std::floating_point T>
+T edge_function(T px, T py, T qx, T qy) {
+    const auto e = px * qy - py * qx;
+    if constexpr (std::is_same_v<T, float>) {
+        if (e == 0) {
+            return static_cast<T>(double(px) * double(qy) -
+                                  double(py) * double(qx));
+        }
+    }
+    return e;
+}
+
+} // namespace detail
+
+// Möller–Trumbore ray-triangle intersection.
+template <std::floating_point T>
+std::optional<TriangleHit<T>>
+intersect_moller_trumbore(const Ray<T> &ray, const Vec3<T> &a,
+                          const Vec3<T> &b, const Vec3<T> &c) {
+    const auto e1 = b - a;
+    const auto e2 = c - a;
+    const auto p = ray.dir.cross(e2);
+    const auto det = e1.dot(p);
+    if (det == 0) {
+        return std::nullopt;
+    }
+    const auto inv_det = 1 / det;
+    const auto s = ray.origin - a;
+    const auto u = s.dot(p) * inv_det;
+    const auto q = s.cross(e1);
+    const auto v = ray.dir.dot(q) * inv_det;
+    const auto t = e2.dot(q) * inv_det;
+    if (u >= 0 && v >= 0 && u + v <= 1 && t >= ray.t_min && t <= ray.t_max) {
+        return TriangleHit<T>{t, u, v};
+    }
+    return std::nullopt;
+}
+
+// Watertight ray-triangle intersection; hits exactly on an edge or vertex
+// count for every triangle sharing it.
+template <std::floating_point T>
+std::optional<TriangleHit<T>>
+intersect_watertight(const WatertightRay<T> &ray, const Vec3<T> &a,
+                     const Vec3<T> &b, const Vec3<T> &c) {
+    const auto pa = a - ray.origin;
+    const auto pb = b - ray.origin;
+    const auto pc = c - ray.origin;
+    const auto ax = ray.shear_x.dot(pa);
+    const auto ay = ray.shear_y.dot(pa);
+    const auto bx = ray.shear_x.dot(pb);
+    const auto by = ray.shear_y.dot(pb);
+    const auto cx = ray.shear_x.dot(pc);
+    const auto cy = ray.shear_y.dot(pc);
+    const auto wa = detail::edge_function(cx, cy, bx, by);
+    const auto wb = detail::edge_function(ax, ay, cx, cy);
+    const auto wc = detail::edge_function(bx, by, ax, ay);
+    if ((wa < 0 || wb < 0 || wc < 0) && (wa > 0 || wb > 0 || wc > 0)) {
+        return std::nullopt;
+    }
+    const auto det = wa + wb + wc;
+    if (det == 0) {
+        return std::nullopt;
+    }
+    const auto inv_det = 1 / det;
+    const auto t = (wa * ray.shear_z.dot(pa) + wb * ray.shear_z.dot(pb) +
+                    wc * ray.shear_z.dot(pc)) *
+                   inv_det;
+    if (t < ray.t_min || t > ray.t_max) {
+        return std::nullopt;
+    }
+    return TriangleHit<T>{t, wb * inv_det, wc * inv_det};
+}
+
+// W rays in structure-of-arrays form, for coherent rays (for example the
+// texels of a lightmap tile) traced against the same primitives.
+template <std::floating_point T, unsigned int W>
+    requires(W == 4 || W == 8 || W == 16)
+struct RayPacket {
+    static constexpr unsigned int width = W;
+
+    std::array<T, W> origin_x{}, origin_y{}, origin_z{};
+    std::array<T, W> dir_x{}, dir_y{}, dir_z{};
+    std::array<T, W> inv_dir_x{}, inv_dir_y{}, inv_dir_z{};
+    std::array<T, W> t_min{}, t_max{};
+
+    void set(unsigned int lane, const Ray<T> &ray) {
+        origin_x[lane] = ray.origin.x();
+        origin_y[lane] = ray.origin.y();
+        origin_z[lane] = ray.origin.z();
+        dir_x[lane] = ray.dir.x();
+        dir_y[lane] = ray.dir.y();
+        dir_z[lane] = ray.dir.z();
+        inv_dir_x[lane] = 1 / ray.dir.x();
+        inv_dir_y[lane] = 1 / ray.dir.y();
+        inv_dir_z[lane] = 1 / ray.dir.z();
+        t_min[lane] = ray.t_min;
+        t_max[lane] = ray.t_max;
+    }
+
+    Ray<T> ray(unsigned int lane) const {
+        return {{origin_x[lane], origin_y[lane], origin_z[lane]},
+                {dir_x[lane], dir_y[lane], dir_z[lane]},
+                t_min[lane],
+                t_max[lane]};
+    }
+};
+
+// A RayPacket prepared for watertight intersection, see WatertightRay.
+template <std::floating_point T, unsigned int W>
+    requires(W == 4 || W == 8 || W == 16)
+struct WatertightRayPacket {
+    std::array<T, W> origin_x, origin_y, origin_z;
+    std::array<T, W> sx_x, sx_y, sx_z;
+    std::array<T, W> sy_x, sy_y, sy_z;
+    std::array<T, W> sz_x, sz_y, sz_z;
+    std::array<T, W> t_min;
+
+    explicit WatertightRayPacket(const RayPacket<T, W> &rays)
+        : origin_x(rays.origin_x), origin_y(rays.origin_y),
+          origin_z(rays.origin_z), t_min(rays.t_min) {
+        for (auto l = 0u; l < W; l++) {
+            const WatertightRay<T> ray(rays.ray(l));
+            sx_x[l] = ray.shear_x.x();
+            sx_y[l] = ray.shear_x.y();
+            sx_z[l] = ray.shear_x.z();
+            sy_x[l] = ray.shear_y.x();
+            sy_y[l] = ray.shear_y.y();
+            sy_z[l] = ray.shear_y.z();
+            sz_x[l] = ray.shear_z.x();
+            sz_y[l] = ray.shear_z.y();
+            sz_z[l] = ray.shear_z.z();
+        }
+    }
+
+    WatertightRay<T> ray(unsigned int lane) const {
+        WatertightRay<T> ray;
+        ray.origin = {origin_x[lane], origin_y[lane], origin_z[lane]};
+        ray.shear_x = {sx_x[lane], sx_y[lane], sx_z[lane]};
+        ray.shear_y = {sy_x[lane], sy_y[lane], sy_z[lane]};
+        ray.shear_z = {sz_x[lane], sz_y[lane], sz_z[lane]};
+        ray.t_min = t_min[lane];
+        return ray;
+    }
+};
+
+// Closest hits found so far for the rays of a packet. `t` doubles as the
+// far bound of later tests, so it starts at the rays' t_max.
+template <std::floating_point T, unsigned int W>
+    requires(W == 4 || W == 8 || W == 16)
+struct PacketHits {
+    static constexpr std::uint32_t no_hit =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::array<T, W> t;
+    std::array<T, W> u{};
+    std::array<T, W> v{};
+    std::array<std::uint32_t, W> primitive;
+
+    explicit PacketHits(const RayPacket<T, W> &rays) : t(rays.t_max) {
+        primitive.fill(no_hit);
+    }
+};
+
+// W triangles in structure-of-arrays form, for testing one ray against
+// several triangles at once (for example the contents of a BVH leaf).
+// Unused lanes are degenerate and never hit.
+template <std::floating_point T, unsigned int W>
+    requires(W == 4 || W == 8 || W == 16)
+struct TrianglePacket {
+    static constexpr unsigned int width = W;
+
+    std::array<T, W> a_x{}, a_y{}, a_z{};
+    std::array<T, W> b_x{}, b_y{}, b_z{};
+    std::array<T, W> c_x{}, c_y{}, c_z{};
+
+    void set(unsigned int lane, const Vec3<T> &a, const Vec3<T> &b,
+             const Vec3<T> &c) {
+        a_x[lane] = a.x();
+        a_y[lane] = a.y();
+        a_z[lane] = a.z();
+        b_x[lane] = b.x();
+        b_y[lane] = b.y();
+        b_z[lane] = b.z();
+        c_x[lane] = c.x();
+        c_y[lane] = c.y();
+        c_z[lane] = c.z();
+    }
+};
+
+// W boxes in structure-of-arrays form. Unused lanes are empty boxes and
+// never hit.
+template <std::floating_point T, unsigned int W>
+    requires(W == 4 || W == 8 || W == 16)
+struct AabbPacket {
+    static constexpr unsigned int width = W;
+
+    std::array<T, W> min_x, min_y, min_z;
+    std::array<T, W> max_x, max_y, max_z;
+
+    AabbPacket() {
+        for (auto *lanes : {&min_x, &min_y, &min_z}) {
+            lanes->fill(std::numeric_limits<T>::infinity());
+        }
+        for (auto *lanes : {&max_x, &max_y, &max_z}) {
+            lanes->fill(-std::numeric_limits<T>::infinity());
+        }
+    }
+
+    void set(unsigned int lane, const Aabb<T> &box) {
+        min_x[lane] = box.min.x();
+        min_y[lane] = box.min.y();
+        min_z[lane] = box.min.z();
+        max_x[lane] = box.max.x();
+        max_y[lane] = box.max.y();
+        max_z[lane] = box.max.z();
+    }
+};
+
+// Hit of one ray against a TrianglePacket: the lane of the closest
+// triangle and the hit on it.
+template <std::floating_point T> struct PacketTriangleHit {
+    unsigned int lane;
+    TriangleHit<T> hit;
+};
+
+// The packet kernels below evaluate every lane with the same branch-free
+// arithmetic into lane arrays (conditions are combined with & and | rather
+// than && and ||), so the arithmetic loop compiles to SIMD, and then merge
+// the lanes that hit. They return a bit mask of the lanes that hit.
+
+namespace detail {
+
+template <unsigned int W, typename Flags>
+std::uint32_t lane_mask(const Flags &flags) {
+    std::uint32_t mask = 0;
+    for (auto l = 0u; l < W; l++) {
+        mask |= std::uint32_t(flags[l]) << l;
+    }
+    return mask;
+}
+
+template <std::floating_point T, unsigned int W>
+std::optional<PacketTriangleHit<T>>
+closest_lane(const std::array<std::uint32_t, W> &hit,
+             const std::array<T, W> &t, const std::array<T, W> &u,
+             const std::array<T, W> &v) {
+    std::optional<PacketTriangleHit<T>> closest;
+    for (auto l = 0u; l < W; l++) {
+        if (hit[l] && (!closest || t[l] < closest->hit.t)) {
+            closest = PacketTriangleHit<T>{l, {t[l], u[l], v[l]}};
+        }
+    }
+    return closest;
+}
+
+template <std::floating_point T, unsigned int W>
+void blend_hits(const std::type_identity_t<std::array<std::uint32_t, W>> &hit,
+                const std::type_identity_t<std::array<T, W>> &t,
+                const std::type_identity_t<std::array<T, W>> &u,
+                const std::type_identity_t<std::array<T, W>> &v,
+                std::uint32_t primitive, PacketHits<T, W> &hits) {
+    for (auto l = 0u; l < W; l++) {
+        hits.t[l] = hit[l] ? t[l] : hits.t[l];
+        hits.u[l] = hit[l] ? u[l] : hits.u[l];
+        hits.v[l] = hit[l] ? v[l] : hits.v[l];
+        hits.primitive[l] = hit[l] ? primitive : hits.primitive[l];
+    }
+}
+
+} // namespace detail
+
+// Möller–Trumbore test of the triangle (a, b, c) against every ray of the
+// packet. Lanes whose hit is closer than hits.t are updated to this
+// primitive.
+template <std::floating_point T, unsigned int W>
+std::uint32_t intersect_moller_trumbore(const RayPacket<T, W> &rays,
+                                        const Vec3<T> &a, const Vec3<T> &b,
+                                        const Vec3<T> &c,
+                                        std::uint32_t primitive,
+                                        PacketHits<T, W> &hits) {
+    const auto e1 = b - a;
+    const auto e2 = c - a;
+    std::array<std::uint32_t, W> hit;
+    std::array<T, W> ts, us, vs;
+    for (auto l = 0u; l < W; l++) {
+        const auto px = rays.dir_y[l] * e2.z() - rays.dir_z[l] * e2.y();
+        const auto py = rays.dir_z[l] * e2.x() - rays.dir_x[l] * e2.z();
+        const auto pz = rays.dir_x[l] * e2.y() - rays.dir_y[l] * e2.x();
+        const auto det = e1.x() * px + e1.y() * py + e1.z() * pz;
+        const auto inv_det = 1 / det;
+        const auto sx = rays.origin_x[l] - a.x();
+        const auto sy = rays.origin_y[l] - a.y();
+        const auto sz = rays.origin_z[l] - a.z();
+        const auto u = (sx * px + sy * py + sz * pz) * inv_det;
+        const auto qx = sy * e1.z() - sz * e1.y();
+        const auto qy = sz * e1.x() - sx * e1.z();
+        const auto qz = sx * e1.y() - sy * e1.x();
+        const auto v =
+            (rays.dir_x[l] * qx + rays.dir_y[l] * qy + rays.dir_z[l] * qz) *
+            inv_det;
+        const auto t = (e2.x() * qx + e2.y() * qy + e2.z() * qz) * inv_det;
+        const bool h = (det != 0) & (u >= 0) & (v >= 0) & (u + v <= 1) &
+                       (t >= rays.t_min[l]) & (t < hits.t[l]);
+        hit[l] = h;
+        ts[l] = t;
+        us[l] = u;
+        vs[l] = v;
+    }
+    detail::blend_hits(hit, ts, us, vs, primitive, hits);
+    return detail::lane_mask<W>(hit);
+}
+
+// Watertight test of the triangle (a, b, c) against every ray of the
+// packet, see intersect_watertight(const WatertightRay &, ...).
+template <std::floating_point T, unsigned int W>
+std::uint32_t intersect_watertight(const WatertightRayPacket<T, W> &rays,
+                                   const Vec3<T> &a, const Vec3<T> &b,
+                                   const Vec3<T> &c, std::uint32_t primitive,
+                                   PacketHits<T, W> &hits) {
+    std::array<std::uint32_t, W> hit;
+    std::array<std::uint32_t, W> degenerate;
+    std::array<T, W> ts, us, vs;
+    for (auto l = 0u; l < W; l++) {
+        const auto pax = a.x() - rays.origin_x[l];
+        const auto pay = a.y() - rays.origin_y[l];
+        const auto paz = a.z() - rays.origin_z[l];
+        const auto pbx = b.x() - rays.origin_x[l];
+        const auto pby = b.y() - rays.origin_y[l];
+        const auto pbz = b.z() - rays.origin_z[l];
+        const auto pcx = c.x() - rays.origin_x[l];
+        const auto pcy = c.y() - rays.origin_y[l];
+        const auto pcz = c.z() - rays.origin_z[l];
+        const auto ax = rays.sx_x[l] * pax + rays.sx_y[l] * pay +
+                        rays.sx_z[l] * paz;
+        const auto ay = rays.sy_x[l] * pax + rays.sy_y[l] * pay +
+                        rays.sy_z[l] * paz;
+        const auto bx = rays.sx_x[l] * pbx + rays.sx_y[l] * pby +
+                        rays.sx_z[l] * pbz;
+        const auto by = rays.sy_x[l] * pbx + rays.sy_y[l] * pby +
+                        rays.sy_z[l] * pbz;
+        const auto cx = rays.sx_x[l] * pcx + rays.sx_y[l] * pcy +
+                        rays.sx_z[l] * pcz;
+        const auto cy = rays.sy_x[l] * pcx + rays.sy_y[l] * pcy +
+                        rays.sy_z[l] * pcz;
+        const auto wa = cx * by - cy * bx;
+        const auto wb = ax * cy - ay * cx;
+        const auto wc = bx * ay - by * ax;
+        degenerate[l] = (wa == 0) | (wb == 0) | (wc == 0);
+        const auto det = wa + wb + wc;
+        const auto inv_det = 1 / det;
+        const auto az = rays.sz_x[l] * pax + rays.sz_y[l] * pay +
+                        rays.sz_z[l] * paz;
+        const auto bz = rays.sz_x[l] * pbx + rays.sz_y[l] * pby +
+                        rays.sz_z[l] * pbz;
+        const auto cz = rays.sz_x[l] * pcx + rays.sz_y[l] * pcy +
+                        rays.sz_z[l] * pcz;
+        const auto t = (wa * az + wb * bz + wc * cz) * inv_det;
+        const bool same_sign = ((wa >= 0) & (wb >= 0) & (wc >= 0)) |
+                               ((wa <= 0) & (wb <= 0) & (wc <= 0));
+        hit[l] = same_sign & (det != 0) & (t >= rays.t_min[l]) &
+                 (t < hits.t[l]);
+        ts[l] = t;
+        us[l] = wb * inv_det;
+        vs[l] = wc * inv_det;
+    }
+    // Lanes with an edge function of exactly zero are redone by the scalar
+    // test, which falls back to double precision for float.
+    if constexpr (std::is_same_v<T, float>) {
+        for (auto l = 0u; l < W; l++) {
+            if (!degenerate[l]) {
+                continue;
+            }
+            auto ray = rays.ray(l);
+            ray.t_max = hits.t[l];
+            const auto redo = intersect_watertight(ray, a, b, c);
+            hit[l] = redo && redo->t < hits.t[l];
+            if (redo) {
+                ts[l] = redo->t;
+                us[l] = redo->u;
+                vs[l] = redo->v;
+            }
+        }
+    }
+    detail::blend_hits(hit, ts, us, vs, primitive, hits);
+    return detail::lane_mask<W>(hit);
+}
+
+// Möller–Trumbore test of one ray against every triangle of the packet;
+// returns the closest hit within [ray.t_min, ray.t_max].
+template <std::floating_point T, unsigned int W>
+std::optional<PacketTriangleHit<T>>
+intersect_moller_trumbore(const Ray<T> &ray,
+                          const TrianglePacket<T, W> &triangles) {
+    const auto &o = ray.origin;
+    const auto &d = ray.dir;
+    std::array<std::uint32_t, W> hit;
+    std::array<T, W> ts, us, vs;
+    for (auto l = 0u; l < W; l++) {
+        const auto e1x = triangles.b_x[l] - triangles.a_x[l];
+        const auto e1y = triangles.b_y[l] - triangles.a_y[l];
+        const auto e1z = triangles.b_z[l] - triangles.a_z[l];
+        const auto e2x = triangles.c_x[l] - triangles.a_x[l];
+        const auto e2y = triangles.c_y[l] - triangles.a_y[l];
+        const auto e2z = triangles.c_z[l] - triangles.a_z[l];
+        const auto px = d.y() * e2z - d.z() * e2y;
+        const auto py = d.z() * e2x - d.x() * e2z;
+        const auto pz = d.x() * e2y - d.y() * e2x;
+        const auto det = e1x * px + e1y * py + e1z * pz;
+        const auto inv_det = 1 / det;
+        const auto sx = o.x() - triangles.a_x[l];
+        const auto sy = o.y() - triangles.a_y[l];
+        const auto sz = o.z() - triangles.a_z[l];
+        const auto u = (sx * px + sy * py + sz * pz) * inv_det;
+        const auto qx = sy * e1z - sz * e1y;
+        const auto qy = sz * e1x - sx * e1z;
+        const auto qz = sx * e1y - sy * e1x;
+        const auto v = (d.x() * qx + d.y() * qy + d.z() * qz) * inv_det;
+        const auto t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+        hit[l] = (det != 0) & (u >= 0) & (v >= 0) & (u + v <= 1) &
+                 (t >= ray.t_min) & (t <= ray.t_max);
+        ts[l] = t;
+        us[l] = u;
+        vs[l] = v;
+    }
+    return detail::closest_lane<T, W>(hit, ts, us, vs);
+}
+
+// Watertight test of one ray against every triangle of the packet;
+// returns the closest hit within [ray.t_min, ray.t_max].
+template <std::floating_point T, unsigned int W>
+std::optional<PacketTriangleHit<T>>
+intersect_watertight(const WatertightRay<T> &ray,
+                     const TrianglePacket<T, W> &triangles) {
+    const auto &o = ray.origin;
+    const auto &sx = ray.shear_x;
+    const auto &sy = ray.shear_y;
+    const auto &sz = ray.shear_z;
+    std::array<std::uint32_t, W> hit;
+    std::array<std::uint32_t, W> degenerate;
+    std::array<T, W> ts, us, vs;
+    for (auto l = 0u; l < W; l++) {
+        const auto pax = triangles.a_x[l] - o.x();
+        const auto pay = triangles.a_y[l] - o.y();
+        const auto paz = triangles.a_z[l] - o.z();
+        const auto pbx = triangles.b_x[l] - o.x();
+        const auto pby = triangles.b_y[l] - o.y();
+        const auto pbz = triangles.b_z[l] - o.z();
+        const auto pcx = triangles.c_x[l] - o.x();
+        const auto pcy = triangles.c_y[l] - o.y();
+        const auto pcz = triangles.c_z[l] - o.z();
+        const auto ax = sx.x() * pax + sx.y() * pay + sx.z() * paz;
+        const auto ay = sy.x() * pax + sy.y() * pay + sy.z() * paz;
+        const auto bx = sx.x() * pbx + sx.y() * pby + sx.z() * pbz;
+        const auto by = sy.x() * pbx + sy.y() * pby + sy.z() * pbz;
+        const auto cx = sx.x() * pcx + sx.y() * pcy + sx.z() * pcz;
+        const auto cy = sy.x() * pcx + sy.y() * pcy + sy.z() * pcz;
+        const auto wa = cx * by - cy * bx;
+        const auto wb = ax * cy - ay * cx;
+        const auto wc = bx * ay - by * ax;
+        degenerate[l] = (wa == 0) | (wb == 0) | (wc == 0);
+        const auto det = wa + wb + wc;
+        const auto inv_det = 1 / det;
+        const auto t = (wa * (sz.x() * pax + sz.y() * pay + sz.z() * paz) +
+                        wb * (sz.x() * pbx + sz.y() * pby + sz.z() * pbz) +
+                        wc * (sz.x() * pcx + sz.y() * pcy + sz.z() * pcz)) *
+                       inv_det;
+        const bool same_sign = ((wa >= 0) & (wb >= 0) & (wc >= 0)) |
+                               ((wa <= 0) & (wb <= 0) & (wc <= 0));
+        hit[l] = same_sign & (det != 0) & (t >= ray.t_min) & (t <= ray.t_max);
+        ts[l] = t;
+        us[l] = wb * inv_det;
+        vs[l] = wc * inv_det;
+    }
+    if constexpr (std::is_same_v<T, float>) {
+        for (auto l = 0u; l < W; l++) {
+            if (!degenerate[l]) {
+                continue;
+            }
+            const auto redo = intersect_watertight(
+                ray, Vec3<T>(triangles.a_x[l], triangles.a_y[l],
+                             triangles.a_z[l]),
+                Vec3<T>(triangles.b_x[l], triangles.b_y[l], triangles.b_z[l]),
+                Vec3<T>(triangles.c_x[l], triangles.c_y[l],
+                        triangles.c_z[l]));
+            hit[l] = redo.has_value();
+            if (redo) {
+                ts[l] = redo->t;
+                us[l] = redo->u;
+                vs[l] = redo->v;
+            }
+        }
+    }
+    return detail::closest_lane<T, W>(hit, ts, us, vs);
+}
+
+// Slab test of the box against every ray of the packet, for rays with
+// t in [rays.t_min, t_max]. Lanes that hit get their entry distance in
+// t_entry.
+template <std::floating_point T, unsigned int W>
+std::uint32_t
+intersect_aabb(const RayPacket<T, W> &rays, const Aabb<T> &box,
+               const std::type_identity_t<std::array<T, W>> &t_max,
+               std::type_identity_t<std::array<T, W>> &t_entry) {
+    std::array<std::uint32_t, W> hit;
+    for (auto l = 0u; l < W; l++) {
+        auto t0 = rays.t_min[l];
+        auto t1 = t_max[l];
+        const auto slab = [&](T lo, T hi, T origin, T inv_dir) {
+            const auto a = (lo - origin) * inv_dir;
+            const auto b = (hi - origin) * inv_dir;
+            const auto near = a < b ? a : b;
+            const auto far = a < b ? b : a;
+            // Written so that a NaN slab (0 * inf) leaves the interval.
+            t0 = near > t0 ? near : t0;
+            t1 = far < t1 ? far : t1;
+        };
+        slab(box.min.x(), box.max.x(), rays.origin_x[l], rays.inv_dir_x[l]);
+        slab(box.min.y(), box.max.y(), rays.origin_y[l], rays.inv_dir_y[l]);
+        slab(box.min.z(), box.max.z(), rays.origin_z[l], rays.inv_dir_z[l]);
+        hit[l] = t0 <= t1;
+        t_entry[l] = t0;
+    }
+    return detail::lane_mask<W>(hit);
+}
+
+// Slab test of one ray, given inv_dir = 1 / ray.dir, against every box of
+// the packet. Lanes that hit get their entry distance in t_entry.
+template <std::floating_point T, unsigned int W>
+std::uint32_t
+intersect_aabbs(const Ray<T> &ray, const Vec3<T> &inv_dir,
+                const AabbPacket<T, W> &boxes,
+                std::type_identity_t<std::array<T, W>> &t_entry) {
+    std::array<std::uint32_t, W> hit;
+    for (auto l = 0u; l < W; l++) {
+        auto t0 = ray.t_min;
+        auto t1 = ray.t_max;
+        const auto slab = [&](T lo, T hi, T origin, T inv) {
+            const auto a = (lo - origin) * inv;
+            const auto b = (hi - origin) * inv;
+            const auto near = a < b ? a : b;
+            const auto far = a < b ? b : a;
+            t0 = near > t0 ? near : t0;
+            t1 = far < t1 ? far : t1;
+        };
+        slab(boxes.min_x[l], boxes.max_x[l], ray.origin.x(), inv_dir.x());
+        slab(boxes.min_y[l], boxes.max_y[l], ray.origin.y(), inv_dir.y());
+        slab(boxes.min_z[l], boxes.max_z[l], ray.origin.z(), inv_dir.z());
+        // Swapping the slab ends would turn an empty lane into everything.
+        hit[l] = (t0 <= t1) & (boxes.min_x[l] <= boxes.max_x[l]);
+        t_entry[l] = t0;
+    }
+    return detail::lane_mask<W>(hit);
+}
+
+} // namespace cml
@@ -0,0 +1,289 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch_ops.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace cml {
+
+// What reduce_points() computes; everything else is skipped.
+struct PointReduction {
+    bool min = false;
+    bool max = false;
+    bool sum = false;
+    bool mean = false;
+    // Implies mean.
+    bool covariance = false;
+    bool length_sq_sum = false;
+
+    static constexpr PointReduction all() {
+        return {true, true, true, true, true, true};
+    }
+};
+
+// Members that were not requested keep these initial values, as do min
+// and max of an empty span.
+template <std::floating_point T, unsigned int Dim,
+          std::floating_point LenT = default_len_type>
+struct PointStatistics {
+    using Vector = Vec<T, Dim, LenT>;
+
+    std::size_t count = 0;
+    Vector min = filled(std::numeric_limits<T>::max());
+    Vector max = filled(std::numeric_limits<T>::lowest());
+    Vector sum;
+    Vector mean;
+    // Population covariance, sum of (p - mean)(p - mean)^T over count.
+    Matrix<Dim, Dim, T> covariance;
+    T length_sq_sum = 0;
+
+  private:
+    static Vector filled(T value) {
+        Vector v;
+        static_for<Dim>(
+            [&](unsigned int d) CML_ALWAYS_INLINE { v[d] = value; });
+        return v;
+    }
+};
+
+namespace detail {
+
+// Points per task. Task results are merged in index order, so the result
+// does not depend on the pool size.
+inline constexpr std::size_t reduction_grain = 1 << 14;
+
+// Partial results; m2 holds the upper triangle of the sum of outer products
+// of the deviations from mean, row by row.
+template <typename T, unsigned int Dim> struct PointMoments {
+    static constexpr unsigned int pairs = Dim * (Dim + 1) / 2;
+
+    std::size_t count = 0;
+    std::array<T, Dim> min;
+    std::array<T, Dim> max;
+    std::array<T, Dim> sum{};
+    std::array<T, Dim> mean{};
+    std::array<T, pairs> m2{};
+    T length_sq = 0;
+
+    PointMoments() {
+        min.fill(std::numeric_limits<T>::max());
+        max.fill(std::numeric_limits<T>::lowest());
+    }
+};
+
+// a = a merged with b, by Chan et al.'s pairwise update for the moments:
+// with delta = mean_b - mean_a, the mean moves by delta * n_b / n and m2
+// gains delta delta^T * n_a * n_b / n.
+template <typename T, unsigned int Dim>
+void merge_moments(PointMoments<T, Dim> &a, const PointMoments<T, Dim> &b,
+                   const PointReduction &what) {
+    if (b.count == 0) {
+        return;
+    }
+    const auto na = T(a.count);
+    const auto nb = T(b.count);
+    const auto n = na + nb;
+    std::array<T, Dim> delta;
+    for (auto d = 0u; d < Dim; d++) {
+        a.min[d] = std::min(a.min[d], b.min[d]);
+        a.max[d] = std::max(a.max[d], b.max[d]);
+        a.sum[d] += b.sum[d];
+        delta[d] = b.mean[d] - a.mean[d];
+        a.mean[d] += delta[d] * (nb / n);
+    }
+    if (what.covariance) {
+        const auto f = na * nb / n;
+        auto k = 0u;
+        for (auto d = 0u; d < Dim; d++) {
+            for (auto e = d; e < Dim; e++, k++) {
+                a.m2[k] += b.m2[k] + delta[d] * delta[e] * f;
+            }
+        }
+    }
+    a.length_sq += b.length_sq;
+    a.count += b.count;
+}
+
+// Reduces points[0, size). Every lane of a block of batch_lanes points
+// accumulates its own strided subsequence, updating the moments point by
+// point with Welford's recurrence; the lanes and the points past the last
+// full block are merged at the end.
+template <typename T, unsigned int Dim, typename LenT>
+PointMoments<T, Dim> reduce_point_range(const Vec<T, Dim, LenT> *points,
+                                        std::size_t size,
+                                        const PointReduction &what) {
+    using Moments = PointMoments<T, Dim>;
+    const bool bounds = what.min || what.max;
+    const bool moments = what.mean || what.covariance;
+    std::array<Lanes<T>, Dim> lo, hi, sum{}, mean{};
+    std::array<Lanes<T>, Moments::pairs> m2{};
+    Lanes<T> length_sq{};
+    for (auto d = 0u; d < Dim; d++) {
+        lo[d].fill(std::numeric_limits<T>::max());
+        hi[d].fill(std::numeric_limits<T>::lowest());
+    }
+
+    const auto blocks = size / batch_lanes;
+    for (std::size_t b = 0; b < blocks; b++) {
+        const auto *p = points + b * batch_lanes;
+        std::array<Lanes<T>, Dim> x;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                x[d][l] = p[l][d];
+            }
+        });
+        if (bounds) {
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    const auto v = x[d][l];
+                    const auto low = lo[d][l];
+                    const auto high = hi[d][l];
+                    lo[d][l] = v < low ? v : low;
+                    hi[d][l] = v > high ? v : high;
+                }
+            });
+        }
+        if (what.sum) {
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    sum[d][l] += x[d][l];
+                }
+            });
+        }
+        if (what.length_sq_sum) {
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    length_sq[l] += x[d][l] * x[d][l];
+                }
+            });
+        }
+        if (moments) {
+            const auto inv = T(1) / T(b + 1);
+            std::array<Lanes<T>, Dim> delta;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                for (std::size_t l = 0; l < batch_lanes; l++) {
+                    delta[d][l] = x[d][l] - mean[d][l];
+                    mean[d][l] += delta[d][l] * inv;
+                }
+            });
+            if (what.covariance) {
+                auto k = 0u;
+                for (auto d = 0u; d < Dim; d++) {
+                    for (auto e = d; e < Dim; e++, k++) {
+                        for (std::size_t l = 0; l < batch_lanes; l++) {
+                            m2[k][l] += delta[d][l] * (x[e][l] - mean[e][l]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Moments result;
+    for (std::size_t l = 0; l < batch_lanes && blocks > 0; l++) {
+        Moments lane;
+        lane.count = blocks;
+        for (auto d = 0u; d < Dim; d++) {
+            lane.min[d] = lo[d][l];
+            lane.max[d] = hi[d][l];
+            lane.sum[d] = sum[d][l];
+            lane.mean[d] = mean[d][l];
+        }
+        for (auto k = 0u; k < Moments::pairs; k++) {
+            lane.m2[k] = m2[k][l];
+        }
+        lane.length_sq = length_sq[l];
+        merge_moments(result, lane, what);
+    }
+    for (auto i = blocks * batch_lanes; i < size; i++) {
+        Moments point;
+        point.count = 1;
+        for (auto d = 0u; d < Dim; d++) {
+            const auto v = points[i][d];
+            point.min[d] = point.max[d] = point.sum[d] = point.mean[d] = v;
+            point.length_sq += v * v;
+        }
+        merge_moments(result, point, what);
+    }
+    return result;
+}
+
+} // namespace detail
+
+// Computes the requested statistics of `points` in one pass. Tasks of
+// detail::reduction_grain points run on the pool through run_with_isa,
+// SIMD across points; their results are merged pairwise (Chan et al.) in
+// index order, so the result is the same for every pool size and the
+// covariance does not suffer from the cancellation of a sum of squares.
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+PointStatistics<T, Dim, LenT>
+reduce_points(std::span<const Vec<T, Dim, LenT>> points,
+              const PointReduction &what,
+              ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    const auto chunks =
+        (points.size() + reduction_grain - 1) / reduction_grain;
+    std::vector<PointMoments<T, Dim>> partial(chunks);
+    const auto isa = active_isa();
+    pool.parallel_for(0, points.size(), reduction_grain,
+                      [&](std::size_t first, std::size_t last) {
+                          run_with_isa(isa, [&] {
+                              partial[first / reduction_grain] =
+                                  reduce_point_range(points.data() + first,
+                                                     last - first, what);
+                          });
+                      });
+    PointMoments<T, Dim> total;
+    for (const auto &p : partial) {
+        merge_moments(total, p, what);
+    }
+
+    PointStatistics<T, Dim, LenT> stats;
+    stats.count = total.count;
+    auto k = 0u;
+    for (auto d = 0u; d < Dim; d++) {
+        if (what.min) {
+            stats.min[d] = total.min[d];
+        }
+        if (what.max) {
+            stats.max[d] = total.max[d];
+        }
+        if (what.sum) {
+            stats.sum[d] = total.sum[d];
+        }
+        if (what.mean || what.covariance) {
+            stats.mean[d] = total.mean[d];
+        }
+        for (auto e = d; e < Dim; e++, k++) {
+            if (what.covariance && total.count > 0) {
+                stats.covariance.get(d, e) = stats.covariance.get(e, d) =
+                    total.m2[k] / T(total.count);
+            }
+        }
+    }
+    if (what.length_sq_sum) {
+        stats.length_sq_sum = total.length_sq;
+    }
+    return stats;
+}
+
+template <std::floating_point T, unsigned int Dim, std::floating_point LenT>
+PointStatistics<T, Dim, LenT>
+reduce_points(const std::vector<Vec<T, Dim, LenT>> &points,
+              const PointReduction &what,
+              ThreadPool &pool = ThreadPool::global()) {
+    return reduce_points(std::span<const Vec<T, Dim, LenT>>(points), what,
+                         pool);
+}
+
+} // namespace cml
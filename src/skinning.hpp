@@ -0,0 +1,163 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include "vec_batch_ops.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace cml {
+
+// Up to Influences bones per vertex: vertex i is bound to bones
+// bones.get(k, i) with weights weights.get(k, i). Unused slots keep weight
+// 0 (their bone index is still read, so it must be valid too); weights of
+// a vertex are expected to sum to 1.
+template <std::floating_point T, unsigned int Influences = 4>
+struct SkinInfluences {
+    VecBatch<std::uint32_t, Influences> bones;
+    VecBatch<T, Influences> weights;
+
+    SkinInfluences() = default;
+    explicit SkinInfluences(std::size_t size) { resize(size); }
+
+    std::size_t size() const { return weights.size(); }
+
+    void resize(std::size_t size) {
+        bones.resize(size);
+        weights.resize(size);
+    }
+};
+
+namespace detail {
+
+// The top three rows of sum over k of weight k * palette[bone k], for
+// every lane of the block at base. Each lane blends the contiguous rows of
+// its bones; gathering one element of every lane's bones at a time is two
+// to three times slower.
+template <typename T, unsigned int Influences>
+CML_ALWAYS_INLINE inline void
+blend_bones(const T *palette, const SkinInfluences<T, Influences> &influences,
+            std::size_t base, std::array<Lanes<T>, 12> &m) {
+    const auto bones = component_pointers(influences.bones);
+    const auto weights = component_pointers(influences.weights);
+    for (std::size_t l = 0; l < batch_lanes; l++) {
+        std::array<T, 12> r{};
+        static_for<Influences>([&](unsigned int k) CML_ALWAYS_INLINE {
+            const auto *bone = palette + bones[k][base + l] * 16;
+            const auto w = weights[k][base + l];
+            for (auto e = 0u; e < 12; e++) {
+                r[e] += w * bone[e];
+            }
+        });
+        for (auto e = 0u; e < 12; e++) {
+            m[e][l] = r[e];
+        }
+    }
+}
+
+template <typename T, unsigned int Influences>
+void check_skin(std::span<const Matrix<4, 4, T>> palette,
+                const SkinInfluences<T, Influences> &influences,
+                const VecBatch<T, 3> &positions) {
+    if (influences.size() != positions.size()) {
+        throw std::invalid_argument("linear_blend_skin: size mismatch");
+    }
+    if (palette.empty() && !positions.empty()) {
+        throw std::invalid_argument("linear_blend_skin: empty palette");
+    }
+}
+
+} // namespace detail
+
+// Linear blend skinning: out[i] = (sum over k of w_k * palette[b_k]) *
+// (positions[i], 1), the palette holding affine skinning matrices (bone
+// world transform times bind-pose inverse, see multiply_batch()). Bone
+// indices must be below palette.size(). Throws std::invalid_argument if
+// influences and positions differ in size, or the palette is empty.
+template <std::floating_point T, unsigned int Influences>
+void linear_blend_skin(
+    std::type_identity_t<std::span<const Matrix<4, 4, T>>> palette,
+    const SkinInfluences<T, Influences> &influences,
+    const VecBatch<T, 3> &positions, VecBatch<T, 3> &out,
+    ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_skin(palette, influences, positions);
+    const auto *pm = palette.empty() ? nullptr : &palette[0].get(0, 0);
+    const auto p = component_pointers(positions);
+    const auto o = component_pointers(out, positions.size());
+    for_each_block(
+        positions.size(), pool, [&](std::size_t base, std::size_t lanes) {
+            std::array<Lanes<T>, 12> m;
+            blend_bones(pm, influences, base, m);
+            std::array<Lanes<T>, 3> r;
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                const auto x = p[0][base + l];
+                const auto y = p[1][base + l];
+                const auto z = p[2][base + l];
+                for (auto row = 0u; row < 3; row++) {
+                    r[row][l] = m[row * 4][l] * x + m[row * 4 + 1][l] * y +
+                                m[row * 4 + 2][l] * z + m[row * 4 + 3][l];
+                }
+            }
+            static_for<3>([&](unsigned int d) CML_ALWAYS_INLINE {
+                store_lanes(o[d] + base, r[d], lanes);
+            });
+        });
+}
+
+// As above, also mapping normals through the blended 3x3 part. Normals are
+// not renormalized, and the blended matrix stands in for its inverse
+// transpose, which is exact only for rotations and uniform scales.
+template <std::floating_point T, unsigned int Influences>
+void linear_blend_skin(
+    std::type_identity_t<std::span<const Matrix<4, 4, T>>> palette,
+    const SkinInfluences<T, Influences> &influences,
+    const VecBatch<T, 3> &positions, const VecBatch<T, 3> &normals,
+    VecBatch<T, 3> &out_positions, VecBatch<T, 3> &out_normals,
+    ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    check_skin(palette, influences, positions);
+    if (normals.size() != positions.size()) {
+        throw std::invalid_argument("linear_blend_skin: size mismatch");
+    }
+    const auto *pm = palette.empty() ? nullptr : &palette[0].get(0, 0);
+    const auto p = component_pointers(positions);
+    const auto n = component_pointers(normals);
+    const auto op = component_pointers(out_positions, positions.size());
+    const auto on = component_pointers(out_normals, positions.size());
+    for_each_block(
+        positions.size(), pool, [&](std::size_t base, std::size_t lanes) {
+            std::array<Lanes<T>, 12> m;
+            blend_bones(pm, influences, base, m);
+            std::array<Lanes<T>, 3> rp;
+            std::array<Lanes<T>, 3> rn;
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                const auto x = p[0][base + l];
+                const auto y = p[1][base + l];
+                const auto z = p[2][base + l];
+                const auto nx = n[0][base + l];
+                const auto ny = n[1][base + l];
+                const auto nz = n[2][base + l];
+                for (auto row = 0u; row < 3; row++) {
+                    const auto m0 = m[row * 4][l];
+                    const auto m1 = m[row * 4 + 1][l];
+                    const auto m2 = m[row * 4 + 2][l];
+                    rp[row][l] = m0 * x + m1 * y + m2 * z + m[row * 4 + 3][l];
+                    rn[row][l] = m0 * nx + m1 * ny + m2 * nz;
+                }
+            }
+            static_for<3>([&](unsigned int d) CML_ALWAYS_INLINE {
+                store_lanes(op[d] + base, rp[d], lanes);
+                store_lanes(on[d] + base, rn[d], lanes);
+            });
+        });
+}
+
+} // namespace cml
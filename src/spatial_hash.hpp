@@ -0,0 +1,295 @@
+#pragma once
+#include "common.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cml {
+
+// Uniform grid over 2D or 3D points, stored as a spatial hash.
+//
+// build() hashes the cell of every point into a power-of-two bucket table
+// and counting-sorts the points by bucket, so the points of a cell are
+// contiguous in sorted_points(). The sort is stable, so the layout does
+// not depend on the thread count. Buffers are kept between builds; a
+// simulation should keep one grid alive and rebuild it every frame.
+//
+// Cells that hash to the same bucket share it; queries filter by distance
+// and cell, so collisions only cost time. Queries are cheapest when the
+// radius is at most the cell size, which limits them to 2^Dim..3^Dim cells.
+template <std::floating_point T, unsigned int Dim>
+    requires(Dim == 2 || Dim == 3)
+class SpatialHashGrid {
+  public:
+    using Point = Vec<T, Dim>;
+
+    explicit SpatialHashGrid(T cell_size)
+        : m_cell_size(cell_size), m_inv_cell_size(T(1) / cell_size) {}
+
+    template <std::floating_point LenT>
+    SpatialHashGrid(T cell_size, std::span<const Vec<T, Dim, LenT>> points,
+                    ThreadPool &pool = ThreadPool::global())
+        : SpatialHashGrid(cell_size) {
+        build(points, pool);
+    }
+
+    T cell_size() const { return m_cell_size; }
+    std::size_t size() const { return m_sorted_points.size(); }
+    bool empty() const { return m_sorted_points.empty(); }
+
+    // Points grouped by bucket and the input index of each of them.
+    std::span<const Point> sorted_points() const { return m_sorted_points; }
+    std::span<const std::uint32_t> sorted_indices() const {
+        return m_sorted_indices;
+    }
+
+    template <std::floating_point LenT>
+    void build(std::span<const Vec<T, Dim, LenT>> points,
+               ThreadPool &pool = ThreadPool::global());
+
+    // Calls fn(index, distance_sq) for every point within `radius` of p
+    // (inclusive), in no particular order.
+    template <typename F>
+    void for_each_neighbor(const Point &p, T radius, F &&fn) const {
+        visit_positions(p, radius, [&](std::size_t pos, T distance_sq) {
+            fn(m_sorted_indices[pos], distance_sq);
+        });
+    }
+
+    // Calls fn(i, j, distance_sq) once for every unordered pair of distinct
+    // points closer than or at `radius`. fn is called concurrently from the
+    // pool's threads.
+    template <typename F>
+    void for_each_pair(T radius, F &&fn,
+                       ThreadPool &pool = ThreadPool::global()) const;
+
+  private:
+    using Cell = std::array<std::int32_t, Dim>;
+
+    static constexpr std::size_t chunk_grain = std::size_t(1) << 16;
+
+    // floor(v / cell_size) without a libm call.
+    std::int32_t cell_coord(T v) const {
+        const auto scaled = v * m_inv_cell_size;
+        const auto i = static_cast<std::int32_t>(scaled);
+        return i - (scaled < static_cast<T>(i));
+    }
+
+    Cell cell_of(const Point &p) const {
+        Cell cell;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            cell[d] = cell_coord(p[d]);
+        });
+        return cell;
+    }
+
+    // Linear in the cell coordinates, so a run of cells along x maps to a
+    // run of consecutive buckets and a query scans a few contiguous ranges
+    // of sorted_points(). The large odd multipliers spread the rows.
+    std::uint32_t bucket_of(const Cell &cell) const {
+        constexpr std::uint32_t multipliers[] = {1u, 0x9E3779B1u, 0x85EBCA77u};
+        std::uint32_t h = 0;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            h += static_cast<std::uint32_t>(cell[d]) * multipliers[d];
+        });
+        return h & m_bucket_mask;
+    }
+
+    template <typename F>
+    void visit_positions(const Point &p, T radius, F &&fn) const;
+
+    T m_cell_size;
+    T m_inv_cell_size;
+    std::uint32_t m_bucket_mask = 0;
+    std::vector<Point> m_sorted_points;
+    std::vector<std::uint32_t> m_sorted_indices;
+    // Points of bucket b are at [m_bucket_start[b], m_bucket_start[b + 1]).
+    std::vector<std::uint32_t> m_bucket_start;
+    // Scratch kept between builds.
+    std::vector<std::uint32_t> m_buckets;
+    std::vector<std::uint32_t> m_histograms;
+};
+
+template <std::floating_point T, unsigned int Dim>
+    requires(Dim == 2 || Dim == 3)
+template <std::floating_point LenT>
+void SpatialHashGrid<T, Dim>::build(std::span<const Vec<T, Dim, LenT>> points,
+                                    ThreadPool &pool) {
+    const auto n = points.size();
+    const auto buckets = std::bit_ceil(std::max<std::size_t>(n, 64));
+    m_bucket_mask = static_cast<std::uint32_t>(buckets - 1);
+    const auto chunks = std::max<std::size_t>(
+        std::min<std::size_t>(pool.size(), n / chunk_grain), 1);
+    const auto chunk_size = (n + chunks - 1) / chunks;
+
+    m_buckets.resize(n);
+    m_histograms.assign(chunks * buckets, 0);
+    m_sorted_points.resize(n);
+    m_sorted_indices.resize(n);
+    m_bucket_start.resize(buckets + 1);
+
+    // Bucket of every point and a histogram per chunk.
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        auto *histogram = m_histograms.data() + c * buckets;
+        const auto last = std::min(n, (c + 1) * chunk_size);
+        for (auto i = c * chunk_size; i < last; i++) {
+            Point p;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                p[d] = points[i][d];
+            });
+            const auto b = bucket_of(cell_of(p));
+            m_buckets[i] = b;
+            histogram[b]++;
+        }
+    });
+
+    // Exclusive scan over (bucket, chunk): per-range totals first, then
+    // each range turns its counts into write offsets.
+    const auto ranges = std::max<std::size_t>(
+        std::min<std::size_t>(pool.size(), buckets / chunk_grain), 1);
+    const auto range_first = [&](std::size_t r) {
+        return r * buckets / ranges;
+    };
+    std::vector<std::uint32_t> range_base(ranges + 1, 0);
+    pool.parallel_for_each(0, ranges, 1, [&](std::size_t r) {
+        std::uint32_t total = 0;
+        for (auto c = 0u; c < chunks; c++) {
+            const auto *histogram = m_histograms.data() + c * buckets;
+            for (auto b = range_first(r); b < range_first(r + 1); b++) {
+                total += histogram[b];
+            }
+        }
+        range_base[r + 1] = total;
+    });
+    for (auto r = 0u; r < ranges; r++) {
+        range_base[r + 1] += range_base[r];
+    }
+    pool.parallel_for_each(0, ranges, 1, [&](std::size_t r) {
+        auto offset = range_base[r];
+        for (auto b = range_first(r); b < range_first(r + 1); b++) {
+            m_bucket_start[b] = offset;
+            for (auto c = 0u; c < chunks; c++) {
+                auto &count = m_histograms[c * buckets + b];
+                const auto start = offset;
+                offset += count;
+                count = start;
+            }
+        }
+    });
+    m_bucket_start[buckets] = static_cast<std::uint32_t>(n);
+
+    // Stable scatter.
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        auto *offsets = m_histograms.data() + c * buckets;
+        const auto last = std::min(n, (c + 1) * chunk_size);
+        for (auto i = c * chunk_size; i < last; i++) {
+            const auto pos = offsets[m_buckets[i]]++;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                m_sorted_points[pos][d] = points[i][d];
+            });
+            m_sorted_indices[pos] = static_cast<std::uint32_t>(i);
+        }
+    });
+}
+
+template <std::floating_point T, unsigned int Dim>
+    requires(Dim == 2 || Dim == 3)
+template <typename F>
+void SpatialHashGrid<T, Dim>::visit_positions(const Point &p, T radius,
+                                              F &&fn) const {
+    if (m_sorted_points.empty()) {
+        return;
+    }
+    Point lo_point;
+    Point hi_point;
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        lo_point[d] = p[d] - radius;
+        hi_point[d] = p[d] + radius;
+    });
+    const auto lo = cell_of(lo_point);
+    const auto hi = cell_of(hi_point);
+    const auto buckets = std::size_t(m_bucket_mask) + 1;
+    const auto run = std::min<std::size_t>(
+        static_cast<std::size_t>(hi[0] - lo[0]) + 1, buckets);
+    const auto radius_sq = radius * radius;
+
+    // Every point within the radius lies in the query box, so it belongs to
+    // exactly one scanned row; checking the row skips its copies in other
+    // rows whose runs share its bucket.
+    const auto scan = [&](std::size_t first, std::size_t last,
+                          const Cell &row) {
+        const auto end = m_bucket_start[last];
+        for (auto pos = m_bucket_start[first]; pos < end; pos++) {
+            const auto &q = m_sorted_points[pos];
+            T distance_sq = 0;
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                const auto diff = q[d] - p[d];
+                distance_sq += diff * diff;
+            });
+            if (distance_sq > radius_sq) {
+                continue;
+            }
+            bool in_row = true;
+            static_for<Dim - 1>([&](unsigned int d) CML_ALWAYS_INLINE {
+                in_row = in_row && cell_coord(q[d + 1]) == row[d + 1];
+            });
+            if (in_row) {
+                fn(std::size_t(pos), distance_sq);
+            }
+        }
+    };
+
+    Cell row = lo;
+    while (true) {
+        const auto first = std::size_t(bucket_of(row));
+        if (first + run <= buckets) {
+            scan(first, first + run, row);
+        } else {
+            scan(first, buckets, row);
+            scan(0, first + run - buckets, row);
+        }
+        unsigned int d = 1;
+        while (d < Dim && row[d] == hi[d]) {
+            row[d] = lo[d];
+            d++;
+        }
+        if (d == Dim) {
+            break;
+        }
+        row[d]++;
+    }
+}
+
+template <std::floating_point T, unsigned int Dim>
+    requires(Dim == 2 || Dim == 3)
+template <typename F>
+void SpatialHashGrid<T, Dim>::for_each_pair(T radius, F &&fn,
+                                            ThreadPool &pool) const {
+    // Walking the sorted layout keeps consecutive queries in the same
+    // cells; each pair is reported from its lower sorted position.
+    const auto pairs_from = [&](std::size_t s) {
+        visit_positions(m_sorted_points[s], radius,
+                        [&](std::size_t pos, T distance_sq) {
+                            if (pos > s) {
+                                fn(m_sorted_indices[s], m_sorted_indices[pos],
+                                   distance_sq);
+                            }
+                        });
+    };
+    pool.parallel_for(0, m_sorted_points.size(), 1024,
+                      [&](std::size_t first, std::size_t last) {
+                          for (auto s = first; s < last; s++) {
+                              pairs_from(s);
+                          }
+                      });
+}
+
+} // namespace cml
@@ -0,0 +1,336 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace cml {
+
+// Order at or below which strassen_multiply() hands a sub-product to
+// gemm(). Tuned with benchmarks/strassen_bench on an AVX-512 machine, where
+// the additions are memory bound: below 2048 Strassen levels are within
+// noise of gemm(), and one level at 2048 saves 15-40%.
+inline constexpr std::size_t strassen_cutoff = 1024;
+
+namespace detail {
+
+inline constexpr std::size_t strassen_combine_grain = 1 << 14;
+
+// c = a + s * b elementwise, s being 1 or -1; c may be a or b.
+template <typename T>
+void combine(ConstMatrixView<T> a, T s, ConstMatrixView<T> b, MatrixView<T> c,
+             ThreadPool &pool) {
+    constexpr std::size_t lanes = 16;
+    const auto isa = active_isa();
+    const auto cols = c.cols();
+    const auto grain = std::max<std::size_t>(1, strassen_combine_grain / cols);
+    pool.parallel_for(0, c.rows(), grain, [&](std::size_t first,
+                                              std::size_t last) {
+        run_with_isa(isa, [&] {
+            for (auto r = first; r < last; r++) {
+                const auto *pa = &a.get(r, 0);
+                const auto *pb = &b.get(r, 0);
+                auto *pc = &c.get(r, 0);
+                std::size_t j = 0;
+                // Computed into a local first, so the loads vectorize even
+                // though c may alias a or b.
+                for (; j + lanes <= cols; j += lanes) {
+                    std::array<T, lanes> sum;
+                    for (std::size_t l = 0; l < lanes; l++) {
+                        sum[l] = pa[j + l] + s * pb[j + l];
+                    }
+                    for (std::size_t l = 0; l < lanes; l++) {
+                        pc[j + l] = sum[l];
+                    }
+                }
+                for (; j < cols; j++) {
+                    pc[j] = pa[j] + s * pb[j];
+                }
+            }
+        });
+    });
+}
+
+constexpr std::size_t strassen_sequential_workspace(std::size_t n,
+                                                    std::size_t cutoff) {
+    if (n <= cutoff) {
+        return 0;
+    }
+    if (n % 2 == 1) {
+        return strassen_sequential_workspace(n - 1, cutoff);
+    }
+    const auto h = n / 2;
+    return 2 * h * h + strassen_sequential_workspace(h, cutoff);
+}
+
+constexpr std::size_t strassen_task_workspace(std::size_t n,
+                                              std::size_t cutoff) {
+    if (n <= cutoff) {
+        return 0;
+    }
+    if (n % 2 == 1) {
+        return strassen_task_workspace(n - 1, cutoff);
+    }
+    const auto h = n / 2;
+    return 11 * h * h + 7 * strassen_sequential_workspace(h, cutoff);
+}
+
+template <typename T> struct Quadrants {
+    std::array<MatrixView<T>, 4> q;
+
+    explicit Quadrants(MatrixView<T> m) {
+        const auto h = m.rows() / 2;
+        q = {m.block(0, 0, h, h), m.block(0, h, h, h), m.block(h, 0, h, h),
+             m.block(h, h, h, h)};
+    }
+};
+
+// For odd n: C = A * B with the leading (n - 1) x (n - 1) product done by
+// `product` and the last row and column by gemm().
+template <typename T, typename Product>
+void strassen_peel(ConstMatrixView<T> a, ConstMatrixView<T> b,
+                   MatrixView<T> c, ThreadPool &pool, Product &&product) {
+    const auto m = c.rows() - 1;
+    product(a.block(0, 0, m, m), b.block(0, 0, m, m), c.block(0, 0, m, m));
+    gemm(T(1), a.block(0, m, m, 1), b.block(m, 0, 1, m), T(1),
+         c.block(0, 0, m, m), pool);
+    gemm(a, b.block(0, m, m + 1, 1), c.block(0, m, m + 1, 1), pool);
+    gemm(a.block(m, 0, 1, m + 1), b.block(0, 0, m + 1, m),
+         c.block(m, 0, 1, m), pool);
+}
+
+// Strassen-Winograd with the two-temporary schedule of Boyer, Dumas,
+// Pernet and Zhou: X holds sums of A quadrants, Y of B quadrants, and the
+// seven products are accumulated in the quadrants of C. `workspace` holds
+// strassen_sequential_workspace(n, cutoff) elements.
+template <typename T>
+void strassen_sequential(ConstMatrixView<T> a, ConstMatrixView<T> b,
+                         MatrixView<T> c, T *workspace, std::size_t cutoff,
+                         ThreadPool &pool) {
+    const auto n = c.rows();
+    if (n <= cutoff) {
+        gemm(a, b, c, pool);
+        return;
+    }
+    if (n % 2 == 1) {
+        strassen_peel(a, b, c, pool, [&](auto a11, auto b11, auto c11) {
+            strassen_sequential(a11, b11, c11, workspace, cutoff, pool);
+        });
+        return;
+    }
+    const auto h = n / 2;
+    const Quadrants<const T> qa(a);
+    const Quadrants<const T> qb(b);
+    const Quadrants<T> qc(c);
+    const MatrixView<T> x(workspace, h, h);
+    const MatrixView<T> y(workspace + h * h, h, h);
+    auto *rest = workspace + 2 * h * h;
+    const auto multiply = [&](ConstMatrixView<T> lhs, ConstMatrixView<T> rhs,
+                              MatrixView<T> out) {
+        strassen_sequential(lhs, rhs, out, rest, cutoff, pool);
+    };
+    const auto add = [&](ConstMatrixView<T> lhs, ConstMatrixView<T> rhs,
+                         MatrixView<T> out) {
+        combine(lhs, T(1), rhs, out, pool);
+    };
+    const auto sub = [&](ConstMatrixView<T> lhs, ConstMatrixView<T> rhs,
+                         MatrixView<T> out) {
+        combine(lhs, T(-1), rhs, out, pool);
+    };
+    const auto &[a11, a12, a21, a22] = qa.q;
+    const auto &[b11, b12, b21, b22] = qb.q;
+    const auto &[c11, c12, c21, c22] = qc.q;
+
+    sub(a11, a21, x);        // S3
+    sub(b22, b12, y);        // T3
+    multiply(x, y, c21);     // P7
+    add(a21, a22, x);        // S1
+    sub(b12, b11, y);        // T1
+    multiply(x, y, c22);     // P5
+    sub(x, a11, x);          // S2
+    sub(b22, y, y);          // T2
+    multiply(x, y, c12);     // P6
+    sub(a12, x, x);          // S4
+    multiply(x, b22, c11);   // P3
+    multiply(a11, b11, x);   // P1
+    add(x, c12, c12);        // U2 = P1 + P6
+    add(c12, c21, c21);      // U3 = U2 + P7
+    add(c12, c22, c12);      // U4 = U2 + P5
+    add(c21, c22, c22);      // U7 = U3 + P5
+    add(c12, c11, c12);      // U5 = U4 + P3
+    sub(y, b21, y);          // T4
+    multiply(a22, y, c11);   // P4
+    sub(c21, c11, c21);      // U6 = U3 - P4
+    multiply(a12, b21, c11); // P2
+    add(x, c11, c11);        // U1 = P1 + P2
+}
+
+// The top level with the seven products run as pool tasks, each with its
+// own operands and output and the sequential algorithm below it.
+// `workspace` holds strassen_task_workspace(n, cutoff) elements.
+template <typename T>
+void strassen_tasks(ConstMatrixView<T> a, ConstMatrixView<T> b,
+                    MatrixView<T> c, T *workspace, std::size_t cutoff,
+                    ThreadPool &pool) {
+    const auto n = c.rows();
+    if (n <= cutoff) {
+        gemm(a, b, c, pool);
+        return;
+    }
+    if (n % 2 == 1) {
+        strassen_peel(a, b, c, pool, [&](auto a11, auto b11, auto c11) {
+            strassen_tasks(a11, b11, c11, workspace, cutoff, pool);
+        });
+        return;
+    }
+    const auto h = n / 2;
+    const Quadrants<const T> qa(a);
+    const Quadrants<const T> qb(b);
+    const Quadrants<T> qc(c);
+    std::array<MatrixView<T>, 11> tmp;
+    for (auto i = 0u; i < tmp.size(); i++) {
+        tmp[i] = MatrixView<T>(workspace + i * h * h, h, h);
+    }
+    auto *rest = workspace + tmp.size() * h * h;
+    const auto &[a11, a12, a21, a22] = qa.q;
+    const auto &[b11, b12, b21, b22] = qb.q;
+    const auto &[c11, c12, c21, c22] = qc.q;
+    const auto &[s1, s2, s3, s4, t1, t2, t3, t4, x1, x2, x3] = tmp;
+
+    combine<T>(a21, T(1), a22, s1, pool);
+    combine<T>(s1, T(-1), a11, s2, pool);
+    combine<T>(a11, T(-1), a21, s3, pool);
+    combine<T>(a12, T(-1), s2, s4, pool);
+    combine<T>(b12, T(-1), b11, t1, pool);
+    combine<T>(b22, T(-1), t1, t2, pool);
+    combine<T>(b22, T(-1), b12, t3, pool);
+    combine<T>(t2, T(-1), b21, t4, pool);
+
+    // P1..P7 into x1, c11, c12, c21, c22, x2, x3.
+    const std::array<std::array<ConstMatrixView<T>, 2>, 7> operands{{
+        {a11, b11},
+        {a12, b21},
+        {s4, b22},
+        {a22, t4},
+        {s1, t1},
+        {s2, t2},
+        {s3, t3},
+    }};
+    const std::array<MatrixView<T>, 7> products{x1, c11, c12, c21,
+                                                c22, x2, x3};
+    const auto task_workspace = strassen_sequential_workspace(h, cutoff);
+    pool.parallel_for_each(0, 7, 1, [&](std::size_t i) {
+        strassen_sequential(operands[i][0], operands[i][1], products[i],
+                            rest + i * task_workspace, cutoff, pool);
+    });
+
+    combine<T>(x1, T(1), c11, c11, pool);  // U1 = P1 + P2
+    combine<T>(x1, T(1), x2, x2, pool);    // U2 = P1 + P6
+    combine<T>(x2, T(1), x3, x3, pool);    // U3 = U2 + P7
+    combine<T>(x2, T(1), c22, x2, pool);   // U4 = U2 + P5
+    combine<T>(x3, T(1), c22, c22, pool);  // U7 = U3 + P5
+    combine<T>(x2, T(1), c12, c12, pool);  // U5 = U4 + P3
+    combine<T>(x3, T(-1), c21, c21, pool); // U6 = U3 - P4
+}
+
+} // namespace detail
+
+// Scratch memory for strassen_multiply(). Keeping one alive across calls
+// means the recursion never allocates; it grows to the largest product it
+// was used for.
+template <std::floating_point T> class StrassenWorkspace {
+  public:
+    // Elements needed for n x n products: the sums and products of every
+    // level below the cutoff, and at the top level one set per task when
+    // the pool has more than one thread.
+    static std::size_t required(std::size_t n, std::size_t cutoff,
+                                bool tasks) {
+        return tasks ? detail::strassen_task_workspace(n, cutoff)
+                     : detail::strassen_sequential_workspace(n, cutoff);
+    }
+
+    T *reserve(std::size_t size) {
+        if (m_data.size() < size) {
+            m_data.resize(size);
+        }
+        return m_data.data();
+    }
+
+    std::size_t capacity() const { return m_data.size(); }
+
+  private:
+    std::vector<T> m_data;
+};
+
+// C = A * B for n x n matrices by Strassen-Winograd recursion (7 products
+// and 15 additions of n/2 x n/2 blocks per level) down to `cutoff`, below
+// which gemm() is used; odd orders peel off their last row and column. With
+// a pool of more than one thread the seven top-level products run as
+// tasks. C must not overlap A or B.
+//
+// The error bound is normwise rather than componentwise and grows with the
+// number of levels, roughly like (n / cutoff)^log2(18) (Higham, Accuracy
+// and Stability of Numerical Algorithms, 23.2.2). With one or two levels
+// the error is in practice a few times that of gemm().
+template <std::floating_point T>
+void strassen_multiply(std::type_identity_t<ConstMatrixView<T>> a,
+                       std::type_identity_t<ConstMatrixView<T>> b,
+                       MatrixView<T> c, StrassenWorkspace<T> &workspace,
+                       ThreadPool &pool = ThreadPool::global(),
+                       std::size_t cutoff = strassen_cutoff) {
+    const auto n = c.rows();
+    if (a.rows() != n || a.cols() != n || b.rows() != n || b.cols() != n ||
+        c.cols() != n) {
+        throw std::invalid_argument("strassen_multiply: shape mismatch");
+    }
+    cutoff = std::max<std::size_t>(cutoff, 1);
+    const bool tasks = pool.size() > 1;
+    auto *scratch =
+        workspace.reserve(StrassenWorkspace<T>::required(n, cutoff, tasks));
+    if (tasks) {
+        detail::strassen_tasks(a, b, c, scratch, cutoff, pool);
+    } else {
+        detail::strassen_sequential(a, b, c, scratch, cutoff, pool);
+    }
+}
+
+template <std::floating_point T>
+void strassen_multiply(std::type_identity_t<ConstMatrixView<T>> a,
+                       std::type_identity_t<ConstMatrixView<T>> b,
+                       MatrixView<T> c, ThreadPool &pool = ThreadPool::global(),
+                       std::size_t cutoff = strassen_cutoff) {
+    StrassenWorkspace<T> workspace;
+    strassen_multiply(a, b, c, workspace, pool, cutoff);
+}
+
+template <std::floating_point T>
+DynamicMatrix<T> strassen_multiply(const DynamicMatrix<T> &a,
+                                   const DynamicMatrix<T> &b,
+                                   ThreadPool &pool = ThreadPool::global(),
+                                   std::size_t cutoff = strassen_cutoff) {
+    DynamicMatrix<T> c(a.rows(), b.cols());
+    strassen_multiply(a.view(), b.view(), c.view(), pool, cutoff);
+    return c;
+}
+
+// For a large square Matrix; c is an output parameter since such a Matrix
+// usually does not fit on the stack.
+template <unsigned int N, std::floating_point T>
+void strassen_multiply(const Matrix<N, N, T> &a, const Matrix<N, N, T> &b,
+                       Matrix<N, N, T> &c,
+                       ThreadPool &pool = ThreadPool::global(),
+                       std::size_t cutoff = strassen_cutoff) {
+    strassen_multiply(view(a), view(b), view(c), pool, cutoff);
+}
+
+} // namespace cml
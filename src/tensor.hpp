@@ -0,0 +1,736 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// N-dimensional arrays with a shape chosen at run time: Tensor owns its
+// elements (row-major, contiguous), TensorView addresses any strided layout
+// of them. reshape(), slice(), select(), permute(), transpose() and
+// broadcast_to() make new views of the same elements without copying.
+//
+// The elementwise kernels broadcast their inputs to the output's shape
+// (trailing dimensions aligned, extent 1 or missing dimensions repeated)
+// and merge the dimensions that all operands step through contiguously, so
+// that the innermost loop is as long as possible. That loop runs on the
+// pool and through run_with_isa(active_isa()), in fixed blocks the compiler
+// vectorizes when its strides are 1 (or 0, for a broadcast operand).
+
+namespace cml {
+
+// Largest rank of a Tensor; shapes and strides are held inline.
+inline constexpr std::size_t max_tensor_rank = 8;
+
+// The extents of the dimensions of a tensor, outermost first.
+class TensorShape {
+  public:
+    TensorShape() = default;
+    TensorShape(std::initializer_list<std::size_t> extents)
+        : TensorShape(std::span(extents.begin(), extents.size())) {}
+    TensorShape(std::span<const std::size_t> extents)
+        : m_rank(extents.size()) {
+        if (extents.size() > max_tensor_rank) {
+            throw std::invalid_argument("TensorShape: rank too large");
+        }
+        std::copy(extents.begin(), extents.end(), m_extents.begin());
+    }
+
+    std::size_t rank() const { return m_rank; }
+    std::size_t operator[](std::size_t dim) const { return m_extents[dim]; }
+    std::size_t &operator[](std::size_t dim) { return m_extents[dim]; }
+    const std::size_t *begin() const { return m_extents.data(); }
+    const std::size_t *end() const { return m_extents.data() + m_rank; }
+
+    // Number of elements; 1 for rank 0.
+    std::size_t size() const {
+        std::size_t size = 1;
+        for (std::size_t d = 0; d < m_rank; d++) {
+            size *= m_extents[d];
+        }
+        return size;
+    }
+
+    friend bool operator==(const TensorShape &a, const TensorShape &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+
+  private:
+    std::array<std::size_t, max_tensor_rank> m_extents{};
+    std::size_t m_rank = 0;
+};
+
+// The shape both operands broadcast to, numpy style.
+inline TensorShape broadcast_shapes(const TensorShape &a,
+                                    const TensorShape &b) {
+    const auto rank = std::max(a.rank(), b.rank());
+    std::array<std::size_t, max_tensor_rank> extents;
+    for (std::size_t d = 0; d < rank; d++) {
+        const auto ea = d < rank - a.rank() ? 1 : a[d - (rank - a.rank())];
+        const auto eb = d < rank - b.rank() ? 1 : b[d - (rank - b.rank())];
+        if (ea != eb && ea != 1 && eb != 1) {
+            throw std::invalid_argument("Tensor: shapes do not broadcast");
+        }
+        extents[d] = ea == 1 ? eb : ea;
+    }
+    return TensorShape(std::span<const std::size_t>(extents.data(), rank));
+}
+
+// Non-owning view of the elements of a tensor: element (i0, i1, ...) is at
+// data()[i0 * stride(0) + i1 * stride(1) + ...]. Strides are in elements
+// and may be 0 (broadcast dimensions). T may be const.
+template <typename T> class TensorView {
+  public:
+    TensorView() = default;
+    // Row-major contiguous elements.
+    TensorView(T *data, const TensorShape &shape)
+        : m_data(data), m_shape(shape) {
+        std::size_t stride = 1;
+        for (auto d = shape.rank(); d-- > 0;) {
+            m_strides[d] = stride;
+            stride *= shape[d];
+        }
+    }
+    TensorView(T *data, const TensorShape &shape,
+               std::span<const std::size_t> strides)
+        : m_data(data), m_shape(shape) {
+        if (strides.size() != shape.rank()) {
+            throw std::invalid_argument("TensorView: rank mismatch");
+        }
+        std::copy(strides.begin(), strides.end(), m_strides.begin());
+    }
+
+    // A view of mutable elements converts to a view of const ones.
+    template <typename U>
+        requires(std::is_same_v<const U, T> && !std::is_same_v<U, T>)
+    TensorView(const TensorView<U> &other)
+        : TensorView(other.data(), other.shape(), other.strides()) {}
+
+    T *data() const { return m_data; }
+    const TensorShape &shape() const { return m_shape; }
+    std::size_t rank() const { return m_shape.rank(); }
+    std::size_t extent(std::size_t dim) const { return m_shape[dim]; }
+    std::size_t stride(std::size_t dim) const { return m_strides[dim]; }
+    std::span<const std::size_t> strides() const {
+        return {m_strides.data(), rank()};
+    }
+    std::size_t size() const { return m_shape.size(); }
+    bool empty() const { return size() == 0; }
+
+    // True if the elements are row-major without gaps, as in a Tensor.
+    bool is_contiguous() const {
+        std::size_t expected = 1;
+        for (auto d = rank(); d-- > 0;) {
+            if (m_shape[d] != 1 && m_strides[d] != expected) {
+                return false;
+            }
+            expected *= m_shape[d];
+        }
+        return true;
+    }
+
+    template <std::integral... I> T &operator()(I... index) const {
+        std::size_t offset = 0, d = 0;
+        ((offset += static_cast<std::size_t>(index) * m_strides[d++]), ...);
+        return m_data[offset];
+    }
+
+    // The same elements with another shape of the same size; the view must
+    // be contiguous.
+    TensorView reshape(const TensorShape &shape) const {
+        if (shape.size() != size()) {
+            throw std::invalid_argument("Tensor: reshape changes the size");
+        }
+        if (!is_contiguous()) {
+            throw std::invalid_argument(
+                "Tensor: reshape of a non-contiguous view");
+        }
+        return {m_data, shape};
+    }
+
+    // Indices first, first + step, ... below last of dimension dim.
+    TensorView slice(std::size_t dim, std::size_t first, std::size_t last,
+                     std::size_t step = 1) const {
+        if (dim >= rank() || first > last || last > m_shape[dim] ||
+            step == 0) {
+            throw std::out_of_range("Tensor: slice out of range");
+        }
+        auto r = *this;
+        r.m_data += first * m_strides[dim];
+        r.m_shape[dim] = (last - first + step - 1) / step;
+        r.m_strides[dim] *= step;
+        return r;
+    }
+
+    // The view at index of dimension dim, one rank lower.
+    TensorView select(std::size_t dim, std::size_t index) const {
+        if (dim >= rank() || index >= m_shape[dim]) {
+            throw std::out_of_range("Tensor: select out of range");
+        }
+        std::array<std::size_t, max_tensor_rank> extents, strides;
+        for (std::size_t d = 0, e = 0; d < rank(); d++) {
+            if (d != dim) {
+                extents[e] = m_shape[d];
+                strides[e++] = m_strides[d];
+            }
+        }
+        return {m_data + index * m_strides[dim],
+                TensorShape({extents.data(), rank() - 1}),
+                {strides.data(), rank() - 1}};
+    }
+
+    // Dimension d of the result is dimension order[d] of this view.
+    TensorView permute(std::span<const std::size_t> order) const {
+        std::array<bool, max_tensor_rank> seen{};
+        if (order.size() != rank()) {
+            throw std::invalid_argument("Tensor: invalid permutation");
+        }
+        auto r = *this;
+        for (std::size_t d = 0; d < rank(); d++) {
+            if (order[d] >= rank() || seen[order[d]]) {
+                throw std::invalid_argument("Tensor: invalid permutation");
+            }
+            seen[order[d]] = true;
+            r.m_shape[d] = m_shape[order[d]];
+            r.m_strides[d] = m_strides[order[d]];
+        }
+        return r;
+    }
+    TensorView permute(std::initializer_list<std::size_t> order) const {
+        return permute(std::span(order.begin(), order.size()));
+    }
+
+    TensorView transpose(std::size_t a, std::size_t b) const {
+        if (a >= rank() || b >= rank()) {
+            throw std::out_of_range("Tensor: transpose out of range");
+        }
+        auto r = *this;
+        std::swap(r.m_shape[a], r.m_shape[b]);
+        std::swap(r.m_strides[a], r.m_strides[b]);
+        return r;
+    }
+
+    // This view repeated along the dimensions that shape adds or where this
+    // view has extent 1, with stride 0.
+    TensorView broadcast_to(const TensorShape &shape) const {
+        if (shape.rank() < rank()) {
+            throw std::invalid_argument("Tensor: shapes do not broadcast");
+        }
+        const auto lead = shape.rank() - rank();
+        std::array<std::size_t, max_tensor_rank> strides{};
+        for (std::size_t d = 0; d < rank(); d++) {
+            if (m_shape[d] == shape[lead + d]) {
+                strides[lead + d] = m_strides[d];
+            } else if (m_shape[d] != 1) {
+                throw std::invalid_argument(
+                    "Tensor: shapes do not broadcast");
+            }
+        }
+        return {m_data, shape, {strides.data(), shape.rank()}};
+    }
+
+    // A rank 2 view as a matrix; its rows must be contiguous.
+    MatrixView<T> matrix() const {
+        if (rank() != 2 || (m_shape[1] > 1 && m_strides[1] != 1)) {
+            throw std::invalid_argument("Tensor: not a row-major matrix");
+        }
+        return {m_data, m_shape[0], m_shape[1], m_strides[0]};
+    }
+
+  private:
+    T *m_data = nullptr;
+    TensorShape m_shape;
+    std::array<std::size_t, max_tensor_rank> m_strides{};
+};
+
+template <typename T> using ConstTensorView = TensorView<const T>;
+
+namespace detail {
+
+// Rows of at least this many elements are grouped into one task.
+inline constexpr std::size_t tensor_grain = 1 << 14;
+// Innermost loops with unit strides go in blocks of this many elements,
+// computed into locals and then stored.
+inline constexpr std::size_t tensor_lanes = 16;
+
+// An elementwise loop over K operands (the output first): the dimensions of
+// extent 1 are dropped and adjacent ones merged wherever every operand
+// steps through the pair as through one dimension.
+template <std::size_t K> struct TensorLoop {
+    std::size_t rank = 0;
+    std::array<std::size_t, max_tensor_rank> shape{};
+    std::array<std::array<std::size_t, max_tensor_rank>, K> strides{};
+};
+
+template <std::size_t K>
+TensorLoop<K>
+collapse(const TensorShape &shape,
+         const std::array<std::span<const std::size_t>, K> &strides) {
+    TensorLoop<K> loop;
+    for (std::size_t d = 0; d < shape.rank(); d++) {
+        if (shape[d] == 1) {
+            continue;
+        }
+        auto merge = loop.rank > 0;
+        for (std::size_t k = 0; k < K && merge; k++) {
+            merge = loop.strides[k][loop.rank - 1] == strides[k][d] * shape[d];
+        }
+        if (!merge) {
+            loop.shape[loop.rank++] = 1;
+        }
+        loop.shape[loop.rank - 1] *= shape[d];
+        for (std::size_t k = 0; k < K; k++) {
+            loop.strides[k][loop.rank - 1] = strides[k][d];
+        }
+    }
+    if (loop.rank == 0) {
+        loop.shape[loop.rank++] = 1;
+    }
+    return loop;
+}
+
+// Calls row(offsets, n) for every innermost row of the loop, offsets[k]
+// being the offset of operand k at the start of the row and n its length.
+template <std::size_t K, typename Row>
+void for_each_row(const TensorLoop<K> &loop, ThreadPool &pool, Row &&row) {
+    const auto outer = loop.rank - 1;
+    const auto n = loop.shape[outer];
+    std::size_t rows = 1;
+    for (std::size_t d = 0; d < outer; d++) {
+        rows *= loop.shape[d];
+    }
+    const auto isa = active_isa();
+    pool.parallel_for(
+        0, rows, std::max<std::size_t>(1, tensor_grain / n),
+        [&](std::size_t first, std::size_t last) {
+            std::array<std::size_t, max_tensor_rank> index{};
+            std::array<std::size_t, K> offsets{};
+            for (auto d = outer, rest = first; d-- > 0;) {
+                index[d] = rest % loop.shape[d];
+                rest /= loop.shape[d];
+                for (std::size_t k = 0; k < K; k++) {
+                    offsets[k] += index[d] * loop.strides[k][d];
+                }
+            }
+            run_with_isa(isa, [&] {
+                for (auto r = first; r < last; r++) {
+                    row(offsets, n);
+                    // Next row, as an odometer.
+                    for (auto d = outer; d-- > 0;) {
+                        for (std::size_t k = 0; k < K; k++) {
+                            offsets[k] += loop.strides[k][d];
+                        }
+                        if (++index[d] < loop.shape[d]) {
+                            break;
+                        }
+                        for (std::size_t k = 0; k < K; k++) {
+                            offsets[k] -= loop.strides[k][d] * loop.shape[d];
+                        }
+                        index[d] = 0;
+                    }
+                }
+            });
+        });
+}
+
+// out[i] = f(i) for i in [0, n): blocks of tensor_lanes, then the rest.
+template <typename T, typename F>
+CML_ALWAYS_INLINE inline void store_row(T *out, std::size_t n, F &&f) {
+    std::size_t i = 0;
+    for (; i + tensor_lanes <= n; i += tensor_lanes) {
+        std::array<T, tensor_lanes> r;
+        for (std::size_t l = 0; l < tensor_lanes; l++) {
+            r[l] = f(i + l);
+        }
+        for (std::size_t l = 0; l < tensor_lanes; l++) {
+            out[i + l] = r[l];
+        }
+    }
+    for (; i < n; i++) {
+        out[i] = f(i);
+    }
+}
+
+inline void check_shape(const TensorShape &shape, const TensorShape &out) {
+    if (broadcast_shapes(shape, out) != out) {
+        throw std::invalid_argument("Tensor: shapes do not broadcast");
+    }
+}
+
+} // namespace detail
+
+// out(i) = f(a(i)), a broadcast to out's shape. out may be a itself but not
+// overlap it otherwise.
+template <arithmetic T, typename F>
+void transform(std::type_identity_t<ConstTensorView<T>> a, TensorView<T> out,
+               F &&f, ThreadPool &pool = ThreadPool::global()) {
+    detail::check_shape(a.shape(), out.shape());
+    const auto in = a.broadcast_to(out.shape());
+    if (out.empty()) {
+        return;
+    }
+    const auto loop =
+        detail::collapse<2>(out.shape(), {out.strides(), in.strides()});
+    const auto last = loop.rank - 1;
+    const auto so = loop.strides[0][last], sa = loop.strides[1][last];
+    detail::for_each_row(
+        loop, pool,
+        [&](const std::array<std::size_t, 2> &offsets, std::size_t n) {
+            auto *o = out.data() + offsets[0];
+            const auto *x = in.data() + offsets[1];
+            if (so == 1 && sa == 1) {
+                detail::store_row(o, n,
+                                  [&](std::size_t i) { return f(x[i]); });
+            } else if (so == 1 && sa == 0) {
+                const auto v = f(*x);
+                detail::store_row(o, n, [&](std::size_t) { return v; });
+            } else {
+                for (std::size_t i = 0; i < n; i++) {
+                    o[i * so] = f(x[i * sa]);
+                }
+            }
+        });
+}
+
+// out(i) = f(a(i), b(i)), a and b broadcast to out's shape. out may be one
+// of the inputs but not overlap them otherwise.
+template <arithmetic T, typename F>
+void transform(std::type_identity_t<ConstTensorView<T>> a,
+               std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+               F &&f, ThreadPool &pool = ThreadPool::global()) {
+    detail::check_shape(a.shape(), out.shape());
+    detail::check_shape(b.shape(), out.shape());
+    const auto ia = a.broadcast_to(out.shape());
+    const auto ib = b.broadcast_to(out.shape());
+    if (out.empty()) {
+        return;
+    }
+    const auto loop = detail::collapse<3>(
+        out.shape(), {out.strides(), ia.strides(), ib.strides()});
+    const auto last = loop.rank - 1;
+    const auto so = loop.strides[0][last], sa = loop.strides[1][last],
+               sb = loop.strides[2][last];
+    detail::for_each_row(
+        loop, pool,
+        [&](const std::array<std::size_t, 3> &offsets, std::size_t n) {
+            auto *o = out.data() + offsets[0];
+            const auto *x = ia.data() + offsets[1];
+            const auto *y = ib.data() + offsets[2];
+            if (so == 1 && sa == 1 && sb == 1) {
+                detail::store_row(
+                    o, n, [&](std::size_t i) { return f(x[i], y[i]); });
+            } else if (so == 1 && sa == 1 && sb == 0) {
+                const auto v = *y;
+                detail::store_row(o, n,
+                                  [&](std::size_t i) { return f(x[i], v); });
+            } else if (so == 1 && sa == 0 && sb == 1) {
+                const auto u = *x;
+                detail::store_row(o, n,
+                                  [&](std::size_t i) { return f(u, y[i]); });
+            } else {
+                for (std::size_t i = 0; i < n; i++) {
+                    o[i * so] = f(x[i * sa], y[i * sb]);
+                }
+            }
+        });
+}
+
+// out = a + b, broadcasting.
+template <arithmetic T>
+void add(std::type_identity_t<ConstTensorView<T>> a,
+         std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+         ThreadPool &pool = ThreadPool::global()) {
+    transform(a, b, out, [](T x, T y) { return x + y; }, pool);
+}
+
+// out = a - b, broadcasting.
+template <arithmetic T>
+void subtract(std::type_identity_t<ConstTensorView<T>> a,
+              std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+              ThreadPool &pool = ThreadPool::global()) {
+    transform(a, b, out, [](T x, T y) { return x - y; }, pool);
+}
+
+// out = a * b elementwise, broadcasting.
+template <arithmetic T>
+void multiply(std::type_identity_t<ConstTensorView<T>> a,
+              std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+              ThreadPool &pool = ThreadPool::global()) {
+    transform(a, b, out, [](T x, T y) { return x * y; }, pool);
+}
+
+// out = a / b elementwise, broadcasting.
+template <arithmetic T>
+void divide(std::type_identity_t<ConstTensorView<T>> a,
+            std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+            ThreadPool &pool = ThreadPool::global()) {
+    transform(a, b, out, [](T x, T y) { return x / y; }, pool);
+}
+
+// Heap-allocated, contiguous row-major tensor. The views it hands out stay
+// valid until it is destroyed or assigned to.
+template <arithmetic T = default_type> class Tensor {
+  public:
+    using value_type = T;
+
+    Tensor() = default;
+    explicit Tensor(const TensorShape &shape)
+        : m_shape(shape), m_data(shape.size(), T()) {}
+    // The elements in row-major order, exactly shape.size() of them.
+    Tensor(const TensorShape &shape, std::initializer_list<T> list)
+        : Tensor(shape) {
+        if (list.size() != m_data.size()) {
+            throw std::invalid_argument("Tensor: initializer size mismatch");
+        }
+        std::copy(list.begin(), list.end(), m_data.begin());
+    }
+    // A contiguous copy of the elements of a view.
+    explicit Tensor(ConstTensorView<T> view,
+                    ThreadPool &pool = ThreadPool::global())
+        : Tensor(view.shape()) {
+        transform(view, this->view(), [](T x) { return x; }, pool);
+    }
+
+    const TensorShape &shape() const { return m_shape; }
+    std::size_t rank() const { return m_shape.rank(); }
+    std::size_t extent(std::size_t dim) const { return m_shape[dim]; }
+    std::size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.empty(); }
+
+    T *data() { return m_data.data(); }
+    const T *data() const { return m_data.data(); }
+
+    TensorView<T> view() { return {m_data.data(), m_shape}; }
+    ConstTensorView<T> view() const { return {m_data.data(), m_shape}; }
+    operator TensorView<T>() { return view(); }
+    operator ConstTensorView<T>() const { return view(); }
+
+    template <std::integral... I> T &operator()(I... index) {
+        return view()(index...);
+    }
+    template <std::integral... I> const T &operator()(I... index) const {
+        return view()(index...);
+    }
+
+    TensorView<T> reshape(const TensorShape &shape) {
+        return view().reshape(shape);
+    }
+    ConstTensorView<T> reshape(const TensorShape &shape) const {
+        return view().reshape(shape);
+    }
+    TensorView<T> slice(std::size_t dim, std::size_t first, std::size_t last,
+                        std::size_t step = 1) {
+        return view().slice(dim, first, last, step);
+    }
+    ConstTensorView<T> slice(std::size_t dim, std::size_t first,
+                             std::size_t last, std::size_t step = 1) const {
+        return view().slice(dim, first, last, step);
+    }
+    TensorView<T> select(std::size_t dim, std::size_t index) {
+        return view().select(dim, index);
+    }
+    ConstTensorView<T> select(std::size_t dim, std::size_t index) const {
+        return view().select(dim, index);
+    }
+    TensorView<T> permute(std::initializer_list<std::size_t> order) {
+        return view().permute(order);
+    }
+    ConstTensorView<T>
+    permute(std::initializer_list<std::size_t> order) const {
+        return view().permute(order);
+    }
+    TensorView<T> transpose(std::size_t a, std::size_t b) {
+        return view().transpose(a, b);
+    }
+    ConstTensorView<T> transpose(std::size_t a, std::size_t b) const {
+        return view().transpose(a, b);
+    }
+    ConstTensorView<T> broadcast_to(const TensorShape &shape) const {
+        return view().broadcast_to(shape);
+    }
+
+    friend bool operator==(const Tensor &, const Tensor &) = default;
+
+  private:
+    TensorShape m_shape;
+    std::vector<T> m_data;
+};
+
+namespace detail {
+
+template <arithmetic T, typename Op>
+Tensor<T> broadcast_op(ConstTensorView<T> a, ConstTensorView<T> b, Op op) {
+    Tensor<T> out(broadcast_shapes(a.shape(), b.shape()));
+    op(a, b, out.view(), ThreadPool::global());
+    return out;
+}
+
+} // namespace detail
+
+template <arithmetic T>
+Tensor<T> operator+(const Tensor<T> &a, const Tensor<T> &b) {
+    return detail::broadcast_op<T>(a, b, add<T>);
+}
+template <arithmetic T>
+Tensor<T> operator-(const Tensor<T> &a, const Tensor<T> &b) {
+    return detail::broadcast_op<T>(a, b, subtract<T>);
+}
+template <arithmetic T>
+Tensor<T> operator*(const Tensor<T> &a, const Tensor<T> &b) {
+    return detail::broadcast_op<T>(a, b, multiply<T>);
+}
+template <arithmetic T>
+Tensor<T> operator/(const Tensor<T> &a, const Tensor<T> &b) {
+    return detail::broadcast_op<T>(a, b, divide<T>);
+}
+template <arithmetic T> Tensor<T> operator*(const Tensor<T> &a, T s) {
+    return detail::broadcast_op<T>(a, ConstTensorView<T>(&s, {}),
+                                   multiply<T>);
+}
+
+// The shape of matmul(a, b): the leading dimensions of a and b broadcast,
+// then a's rows and b's columns.
+inline TensorShape matmul_shape(const TensorShape &a, const TensorShape &b) {
+    if (a.rank() < 2 || b.rank() < 2 || a[a.rank() - 1] != b[b.rank() - 2]) {
+        throw std::invalid_argument("matmul: shape mismatch");
+    }
+    auto shape = broadcast_shapes(
+        TensorShape({a.begin(), a.rank() - 2}),
+        TensorShape({b.begin(), b.rank() - 2}));
+    std::array<std::size_t, max_tensor_rank> extents;
+    std::copy(shape.begin(), shape.end(), extents.begin());
+    extents[shape.rank()] = a[a.rank() - 2];
+    extents[shape.rank() + 1] = b[b.rank() - 1];
+    return TensorShape({extents.data(), shape.rank() + 2});
+}
+
+namespace detail {
+
+// Batches of at most this many multiply-adds run one per task instead of
+// each spreading over the pool.
+inline constexpr std::size_t matmul_small_batch = 1 << 18;
+
+// The view, or a contiguous copy of it if its rows are not contiguous.
+template <std::floating_point T>
+ConstTensorView<T> row_major(ConstTensorView<T> v, Tensor<T> &copy,
+                             ThreadPool &pool) {
+    const auto r = v.rank();
+    if (v.extent(r - 1) <= 1 || v.stride(r - 1) == 1) {
+        return v;
+    }
+    copy = Tensor<T>(v, pool);
+    return copy.view();
+}
+
+// True if the rows of all batches of v are evenly spaced, so that v is one
+// matrix of stacked batches with v.stride(rank - 2) between rows.
+template <typename T> bool stacks_rows(TensorView<T> v) {
+    const auto r = v.rank();
+    auto expected = v.stride(r - 2) * v.extent(r - 2);
+    for (auto d = r - 2; d-- > 0;) {
+        if (v.extent(d) > 1 && v.stride(d) != expected) {
+            return false;
+        }
+        expected *= v.extent(d);
+    }
+    return true;
+}
+
+} // namespace detail
+
+// out[..., :, :] = a[..., :, :] * b[..., :, :] for every index of the
+// leading dimensions, which broadcast between a and b (see matmul_shape()).
+// Each product goes through gemm(); when b is one matrix shared by all
+// batches and the batches of a and out stack as rows, they are a single
+// gemm() call. out must not overlap a or b.
+template <std::floating_point T>
+void matmul(std::type_identity_t<ConstTensorView<T>> a,
+            std::type_identity_t<ConstTensorView<T>> b, TensorView<T> out,
+            ThreadPool &pool = ThreadPool::global()) {
+    using namespace detail;
+    const auto shape = matmul_shape(a.shape(), b.shape());
+    if (shape != out.shape()) {
+        throw std::invalid_argument("matmul: shape mismatch");
+    }
+    if (out.empty()) {
+        return;
+    }
+    const auto r = shape.rank();
+    const auto m = shape[r - 2], n = shape[r - 1], k = a.extent(a.rank() - 1);
+    // Leading dimensions with the matrix ones kept as they are.
+    auto lead = shape;
+    lead[r - 2] = a.extent(a.rank() - 2);
+    lead[r - 1] = k;
+    Tensor<T> a_copy, b_copy, out_copy;
+    const auto ta = row_major(a.broadcast_to(lead), a_copy, pool);
+    lead[r - 2] = k;
+    lead[r - 1] = n;
+    const auto tb = row_major(b.broadcast_to(lead), b_copy, pool);
+    auto to = out;
+    if (n > 1 && out.stride(r - 1) != 1) {
+        out_copy = Tensor<T>(shape);
+        to = out_copy.view();
+    }
+    const auto batches = shape.size() / (m * n);
+
+    bool shared_b = true;
+    for (std::size_t d = 0; d + 2 < r; d++) {
+        shared_b = shared_b && (tb.extent(d) == 1 || tb.stride(d) == 0);
+    }
+    if (batches > 1 && shared_b && m > 0 && stacks_rows(ta) &&
+        stacks_rows(to)) {
+        gemm(MatrixView<const T>(ta.data(), batches * m, k,
+                                 ta.stride(r - 2)),
+             MatrixView<const T>(tb.data(), k, n, tb.stride(r - 2)),
+             MatrixView<T>(to.data(), batches * m, n, to.stride(r - 2)),
+             pool);
+    } else {
+        const auto product = [&](std::size_t batch, ThreadPool &inner) {
+            std::size_t oa = 0, ob = 0, oo = 0;
+            for (auto d = r - 2, rest = batch; d-- > 0;) {
+                const auto i = rest % shape[d];
+                rest /= shape[d];
+                oa += i * ta.stride(d);
+                ob += i * tb.stride(d);
+                oo += i * to.stride(d);
+            }
+            gemm(MatrixView<const T>(ta.data() + oa, m, k, ta.stride(r - 2)),
+                 MatrixView<const T>(tb.data() + ob, k, n, tb.stride(r - 2)),
+                 MatrixView<T>(to.data() + oo, m, n, to.stride(r - 2)),
+                 inner);
+        };
+        if (m * n * k <= matmul_small_batch && batches > 1) {
+            // gemm() called from a pool task runs on that thread only.
+            pool.parallel_for_each(0, batches, 1, [&](std::size_t batch) {
+                product(batch, pool);
+            });
+        } else {
+            for (std::size_t batch = 0; batch < batches; batch++) {
+                product(batch, pool);
+            }
+        }
+    }
+    if (to.data() != out.data()) {
+        transform(to, out, [](T x) { return x; }, pool);
+    }
+}
+
+template <std::floating_point T>
+Tensor<T> matmul(const Tensor<T> &a, const Tensor<T> &b,
+                 ThreadPool &pool = ThreadPool::global()) {
+    Tensor<T> out(matmul_shape(a.shape(), b.shape()));
+    matmul(a, b, out.view(), pool);
+    return out;
+}
+
+} // namespace cml
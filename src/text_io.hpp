@@ -0,0 +1,312 @@
+#pragma once
+#include "common.hpp"
+#include "mapped_file.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+// Locale-independent text formatting and parsing of Vec and Matrix built on
+// std::to_chars / std::from_chars. Components are separated by spaces,
+// tabs or commas; in the bulk readers every line holds one element.
+
+namespace cml {
+
+class TextParseError : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+template <typename E> struct text_element_traits;
+
+template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+struct text_element_traits<Vec<T, Dim, LenT>> {
+    using scalar_type = T;
+    static constexpr unsigned int size = Dim;
+    static T get(const Vec<T, Dim, LenT> &v, unsigned int i) { return v[i]; }
+    static T &get(Vec<T, Dim, LenT> &v, unsigned int i) { return v[i]; }
+};
+
+template <unsigned int Rows, unsigned int Cols, arithmetic T>
+struct text_element_traits<Matrix<Rows, Cols, T>> {
+    using scalar_type = T;
+    static constexpr unsigned int size = Rows * Cols;
+    static T get(const Matrix<Rows, Cols, T> &m, unsigned int i) {
+        return m.get(i / Cols, i % Cols);
+    }
+    static T &get(Matrix<Rows, Cols, T> &m, unsigned int i) {
+        return m.get(i / Cols, i % Cols);
+    }
+};
+
+template <typename E>
+concept text_element = requires { typename text_element_traits<E>::scalar_type; };
+
+// Upper bound on the characters format_to() writes for one element.
+template <text_element E> constexpr std::size_t formatted_size_bound() {
+    using T = typename text_element_traits<E>::scalar_type;
+    constexpr std::size_t per_scalar =
+        std::is_floating_point_v<T>
+            ? std::numeric_limits<T>::max_digits10 + 16
+            : std::numeric_limits<T>::digits10 + 3;
+    return text_element_traits<E>::size * (per_scalar + 1);
+}
+
+// Writes the components of `element` separated by `separator`. Mirrors
+// std::to_chars: on overflow returns {last, std::errc::value_too_large}.
+template <text_element E>
+std::to_chars_result format_to(char *first, char *last, const E &element,
+                               char separator = ' ') {
+    using traits = text_element_traits<E>;
+    for (auto i = 0u; i < traits::size; i++) {
+        if (i > 0) {
+            if (first == last) {
+                return {last, std::errc::value_too_large};
+            }
+            *first++ = separator;
+        }
+        const auto result = std::to_chars(first, last, traits::get(element, i));
+        if (result.ec != std::errc()) {
+            return result;
+        }
+        first = result.ptr;
+    }
+    return {first, std::errc()};
+}
+
+// Appends the formatted element to `out`.
+template <text_element E>
+void format_to(std::string &out, const E &element, char separator = ' ') {
+    const auto old_size = out.size();
+    out.resize(old_size + formatted_size_bound<E>());
+    const auto result = format_to(out.data() + old_size,
+                                  out.data() + out.size(), element, separator);
+    out.resize(static_cast<std::size_t>(result.ptr - out.data()));
+}
+
+namespace detail {
+
+inline bool is_field_separator(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+inline const char *skip_field_separators(const char *first, const char *last) {
+    while (first != last && is_field_separator(*first)) {
+        ++first;
+    }
+    return first;
+}
+
+template <arithmetic T>
+std::from_chars_result parse_scalar(const char *first, const char *last,
+                                    T &value) {
+    if (first != last && *first == '+') {
+        ++first;
+    }
+    if constexpr (std::is_same_v<T, bool>) {
+        unsigned int v = 0;
+        const auto result = std::from_chars(first, last, v);
+        value = v != 0;
+        return result;
+    } else {
+        return std::from_chars(first, last, value);
+    }
+}
+
+} // namespace detail
+
+// Parses one element from the start of [first, last) without crossing a
+// newline. Leading separators are skipped; `ptr` points one past the last
+// consumed component.
+template <text_element E>
+std::from_chars_result parse_prefix(const char *first, const char *last,
+                                    E &out) {
+    using traits = text_element_traits<E>;
+    for (auto i = 0u; i < traits::size; i++) {
+        first = detail::skip_field_separators(first, last);
+        const auto result =
+            detail::parse_scalar(first, last, traits::get(out, i));
+        if (result.ec != std::errc()) {
+            return result;
+        }
+        first = result.ptr;
+    }
+    return {first, std::errc()};
+}
+
+// Parses a whole string as one element. Any whitespace, including newlines,
+// separates components; trailing garbage makes the parse fail.
+template <text_element E> std::optional<E> parse(std::string_view text) {
+    E element;
+    const char *first = text.data();
+    const char *last = text.data() + text.size();
+    using traits = text_element_traits<E>;
+    for (auto i = 0u; i < traits::size; i++) {
+        while (first != last &&
+               (detail::is_field_separator(*first) || *first == '\n')) {
+            ++first;
+        }
+        const auto result =
+            detail::parse_scalar(first, last, traits::get(element, i));
+        if (result.ec != std::errc()) {
+            return std::nullopt;
+        }
+        first = result.ptr;
+    }
+    while (first != last &&
+           (detail::is_field_separator(*first) || *first == '\n')) {
+        ++first;
+    }
+    if (first != last) {
+        return std::nullopt;
+    }
+    return element;
+}
+
+struct TextReadOptions {
+    // Only lines starting with this prefix are parsed (e.g. "v " for OBJ
+    // vertices); all other lines are ignored. Empty means every non-blank
+    // line must hold an element.
+    std::string_view line_prefix = {};
+    // Lines starting with this character are treated as comments.
+    char comment = '#';
+    // Bytes of input handed to one task; chunks end on line boundaries.
+    std::size_t chunk_bytes = std::size_t(1) << 20;
+};
+
+namespace detail {
+
+template <text_element E>
+void parse_lines(std::string_view text, std::size_t base_offset,
+                 const TextReadOptions &options, std::vector<E> &out) {
+    const char *p = text.data();
+    const char *end = text.data() + text.size();
+    while (p != end) {
+        const char *line_end = std::find(p, end, '\n');
+        const char *q = skip_field_separators(p, line_end);
+        if (q != line_end && *q != options.comment) {
+            const std::string_view line(q, static_cast<std::size_t>(
+                                               line_end - q));
+            if (options.line_prefix.empty() ||
+                line.starts_with(options.line_prefix)) {
+                q += options.line_prefix.size();
+                E element;
+                const auto result = parse_prefix(q, line_end, element);
+                if (result.ec != std::errc() ||
+                    skip_field_separators(result.ptr, line_end) != line_end) {
+                    throw TextParseError(
+                        "cml: malformed element at byte offset " +
+                        std::to_string(base_offset +
+                                       static_cast<std::size_t>(
+                                           p - text.data())));
+                }
+                out.push_back(element);
+            }
+        }
+        p = line_end == end ? end : line_end + 1;
+    }
+}
+
+} // namespace detail
+
+// Parses one element per line, in parallel over line-aligned chunks. The
+// result keeps the input order.
+template <text_element E>
+std::vector<E> parse_lines(std::string_view text,
+                           const TextReadOptions &options = {},
+                           ThreadPool &pool = ThreadPool::global()) {
+    std::vector<std::string_view> chunks;
+    const auto chunk_bytes = std::max<std::size_t>(options.chunk_bytes, 1);
+    std::size_t begin = 0;
+    while (begin < text.size()) {
+        auto end = std::min(begin + chunk_bytes, text.size());
+        const auto newline = text.find('\n', end == 0 ? 0 : end - 1);
+        end = newline == std::string_view::npos ? text.size() : newline + 1;
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<std::vector<E>> parsed(chunks.size());
+    pool.parallel_for_each(0, chunks.size(), 1, [&](std::size_t i) {
+        const auto offset =
+            static_cast<std::size_t>(chunks[i].data() - text.data());
+        parsed[i].reserve(chunks[i].size() / (2 * text_element_traits<E>::size));
+        detail::parse_lines(chunks[i], offset, options, parsed[i]);
+    });
+
+    std::vector<std::size_t> offsets(parsed.size() + 1, 0);
+    for (auto i = 0u; i < parsed.size(); i++) {
+        offsets[i + 1] = offsets[i] + parsed[i].size();
+    }
+    std::vector<E> result(offsets.back());
+    pool.parallel_for_each(0, parsed.size(), 1, [&](std::size_t i) {
+        std::copy(parsed[i].begin(), parsed[i].end(),
+                  result.begin() + static_cast<std::ptrdiff_t>(offsets[i]));
+    });
+    return result;
+}
+
+// Maps the file and parses it with parse_lines().
+template <text_element E>
+std::vector<E> read_lines(const std::filesystem::path &path,
+                          const TextReadOptions &options = {},
+                          ThreadPool &pool = ThreadPool::global()) {
+    MappedFile file(path);
+    file.advise(MappedFile::Access::sequential);
+    const auto bytes = file.bytes();
+    return parse_lines<E>(
+        std::string_view(reinterpret_cast<const char *>(bytes.data()),
+                         bytes.size()),
+        options, pool);
+}
+
+// Formats one element per line, each line starting with `line_prefix`.
+// Chunks are formatted in parallel and concatenated in order.
+template <text_element E>
+std::string format_lines(std::span<const E> elements, char separator = ' ',
+                         std::string_view line_prefix = {},
+                         ThreadPool &pool = ThreadPool::global()) {
+    constexpr std::size_t grain = 1 << 14;
+    const auto chunks = (elements.size() + grain - 1) / grain;
+    std::vector<std::string> parts(chunks);
+    pool.parallel_for_each(0, chunks, 1, [&](std::size_t c) {
+        const auto first = c * grain;
+        const auto last = std::min(first + grain, elements.size());
+        auto &part = parts[c];
+        part.resize((last - first) *
+                    (formatted_size_bound<E>() + line_prefix.size() + 1));
+        char *p = part.data();
+        char *end = part.data() + part.size();
+        for (auto i = first; i < last; i++) {
+            p = std::copy(line_prefix.begin(), line_prefix.end(), p);
+            p = format_to(p, end, elements[i], separator).ptr;
+            *p++ = '\n';
+        }
+        part.resize(static_cast<std::size_t>(p - part.data()));
+    });
+
+    std::size_t total = 0;
+    for (const auto &part : parts) {
+        total += part.size();
+    }
+    std::string out;
+    out.reserve(total);
+    for (const auto &part : parts) {
+        out += part;
+    }
+    return out;
+}
+
+} // namespace cml
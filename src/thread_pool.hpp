@@ -0,0 +1,207 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cml {
+
+// Fixed-size pool of worker threads used by the batch algorithms.
+//
+// parallel_for() splits [begin, end) into chunks of `grain` indices. The
+// chunking only depends on the range and the grain, never on the number of
+// threads, so algorithms that do per-chunk work and merge chunk results in
+// index order are reproducible regardless of the pool size. The calling
+// thread takes part in the work. Calls made from inside a worker run
+// serially on that worker, so nesting cannot deadlock. If calls of fn
+// throw, parallel_for() waits for the chunks in flight and rethrows the
+// exception of the lowest chunk, as the serial loop would; later chunks may
+// be skipped.
+class ThreadPool {
+  public:
+    explicit ThreadPool(unsigned int threads = default_thread_count()) {
+        const auto workers = std::max(threads, 1u) - 1;
+        m_workers.reserve(workers);
+        for (auto i = 0u; i < workers; i++) {
+            m_workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    // Number of threads taking part in parallel_for, including the caller.
+    unsigned int size() const {
+        return static_cast<unsigned int>(m_workers.size()) + 1;
+    }
+
+    // Calls fn(chunk_begin, chunk_end) for every chunk of the range.
+    template <typename F>
+    void parallel_for(std::size_t begin, std::size_t end, std::size_t grain,
+                      F &&fn) {
+        if (end <= begin) {
+            return;
+        }
+        grain = std::max<std::size_t>(grain, 1);
+        const auto chunks = (end - begin + grain - 1) / grain;
+        if (chunks == 1 || m_workers.empty() || t_in_worker) {
+            for (auto first = begin; first < end; first += grain) {
+                fn(first, std::min(first + grain, end));
+            }
+            return;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->run = [&fn, begin, end, grain](std::size_t chunk) {
+            const auto first = begin + chunk * grain;
+            fn(first, std::min(first + grain, end));
+        };
+        job->chunks = chunks;
+        {
+            std::lock_guard lock(m_mutex);
+            m_jobs.push_back(job);
+        }
+        m_wake.notify_all();
+
+        {
+            const InWorker in_worker;
+            run_chunks(*job);
+        }
+
+        std::unique_lock lock(job->mutex);
+        job->finished.wait(lock, [&] { return job->done == job->chunks; });
+        if (job->error) {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+    // Calls fn(i) for every index, grouping `grain` indices per task.
+    template <typename F>
+    void parallel_for_each(std::size_t begin, std::size_t end,
+                           std::size_t grain, F &&fn) {
+        parallel_for(begin, end, grain,
+                     [&fn](std::size_t first, std::size_t last) {
+                         for (auto i = first; i < last; i++) {
+                             fn(i);
+                         }
+                     });
+    }
+
+    static unsigned int default_thread_count() {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    static ThreadPool &global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+  private:
+    struct Job {
+        std::function<void(std::size_t)> run;
+        std::size_t chunks = 0;
+        std::atomic<std::size_t> next{0};
+        std::size_t done = 0;
+        // Lowest chunk that threw, and its exception (under mutex).
+        std::atomic<std::size_t> failed{SIZE_MAX};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    // Marks the calling thread as running pool work for its lifetime.
+    class InWorker {
+      public:
+        InWorker() : m_was_in_worker(t_in_worker) { t_in_worker = true; }
+        InWorker(const InWorker &) = delete;
+        InWorker &operator=(const InWorker &) = delete;
+        ~InWorker() { t_in_worker = m_was_in_worker; }
+
+      private:
+        bool m_was_in_worker;
+    };
+
+    // Runs chunks until none are left. A chunk that throws still counts as
+    // done, so the caller is never left waiting, and chunks after the
+    // lowest failed one are claimed without being run.
+    static void run_chunks(Job &job) {
+        std::size_t completed = 0;
+        for (auto chunk = job.next.fetch_add(1); chunk < job.chunks;
+             chunk = job.next.fetch_add(1)) {
+            completed++;
+            if (chunk > job.failed.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            try {
+                job.run(chunk);
+            } catch (...) {
+                std::lock_guard lock(job.mutex);
+                if (chunk < job.failed.load(std::memory_order_relaxed)) {
+                    job.failed.store(chunk, std::memory_order_relaxed);
+                    job.error = std::current_exception();
+                }
+            }
+        }
+        if (completed > 0) {
+            std::lock_guard lock(job.mutex);
+            job.done += completed;
+            if (job.done == job.chunks) {
+                job.finished.notify_all();
+            }
+        }
+    }
+
+    void worker_loop() {
+        t_in_worker = true;
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock lock(m_mutex);
+                m_wake.wait(lock,
+                            [this] { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping && m_jobs.empty()) {
+                    return;
+                }
+                job = m_jobs.front();
+                if (job->next.load() >= job->chunks) {
+                    m_jobs.pop_front();
+                    continue;
+                }
+            }
+            run_chunks(*job);
+            std::lock_guard lock(m_mutex);
+            if (!m_jobs.empty() && m_jobs.front() == job) {
+                m_jobs.pop_front();
+            }
+        }
+    }
+
+    static inline thread_local bool t_in_worker = false;
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Job>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
+
+} // namespace cml
@@ -0,0 +1,216 @@
+#pragma once
+#include "common.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "vec_mat_operations.hpp"
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace cml {
+
+struct TransformUpdateStats {
+    // Nodes whose local matrix was set since the previous update.
+    std::size_t dirty = 0;
+    // Nodes whose world matrix was recomputed: the dirty ones and their
+    // descendants.
+    std::size_t recomputed = 0;
+    // Depth levels that were visited.
+    unsigned int levels = 0;
+};
+
+// Scene graph of local transforms with cached world transforms, world =
+// parent world * local (column vectors, as built by translate() and
+// rotate()).
+//
+// Nodes keep the id add() returned, but are stored in breadth-first order
+// so that every level is a contiguous range whose parents all lie in
+// earlier levels. update() walks the levels in order and recomputes the
+// nodes of each level in parallel, but only those that were set since the
+// last update or whose parent was recomputed. Products of affine matrices
+// use affine_multiply().
+template <std::floating_point T> class TransformHierarchy {
+  public:
+    using Matrix = Mat4<T>;
+    static constexpr std::uint32_t no_parent =
+        std::numeric_limits<std::uint32_t>::max();
+
+    std::size_t size() const { return m_position.size(); }
+    bool empty() const { return m_position.empty(); }
+
+    // Adds a node below `parent` (no_parent for a root), which must have
+    // been added before, and returns its id. Ids count up from 0.
+    std::uint32_t add(std::uint32_t parent,
+                      const Matrix &local = Matrix::identity());
+
+    std::uint32_t parent(std::uint32_t id) const {
+        const auto p = m_parent[m_position[id]];
+        return p == no_parent ? no_parent : m_id[p];
+    }
+
+    const Matrix &local(std::uint32_t id) const {
+        return m_local[m_position[id]];
+    }
+
+    void set_local(std::uint32_t id, const Matrix &local) {
+        const auto pos = m_position[id];
+        m_local[pos] = local;
+        m_local_affine[pos] = is_affine(local);
+        m_dirty_count += !m_dirty[pos];
+        m_dirty[pos] = 1;
+    }
+
+    // The world matrix as of the last update().
+    const Matrix &world(std::uint32_t id) const {
+        return m_world[m_position[id]];
+    }
+
+    // Recomputes the world matrices that changed since the last update.
+    TransformUpdateStats update(ThreadPool &pool = ThreadPool::global());
+
+    const TransformUpdateStats &last_update_stats() const { return m_stats; }
+
+  private:
+    static constexpr std::size_t level_grain = 2048;
+
+    void sort_breadth_first();
+
+    // Indexed by id.
+    std::vector<std::uint32_t> m_position;
+    // Indexed by position.
+    std::vector<std::uint32_t> m_id;
+    std::vector<std::uint32_t> m_parent;
+    std::vector<Matrix> m_local;
+    std::vector<Matrix> m_world;
+    std::vector<std::uint8_t> m_local_affine;
+    std::vector<std::uint8_t> m_world_affine;
+    std::vector<std::uint8_t> m_dirty;
+    // Set for the nodes recomputed by the update in progress.
+    std::vector<std::uint8_t> m_changed;
+    // Positions [m_level_start[l], m_level_start[l + 1]) have depth l.
+    std::vector<std::size_t> m_level_start;
+    std::vector<std::uint32_t> m_depth;
+    std::size_t m_dirty_count = 0;
+    // Nodes were added since the last update.
+    bool m_added = false;
+    TransformUpdateStats m_stats;
+};
+
+template <std::floating_point T>
+std::uint32_t TransformHierarchy<T>::add(std::uint32_t parent,
+                                         const Matrix &local) {
+    const auto id = static_cast<std::uint32_t>(m_position.size());
+    const auto pos = id;
+    // New nodes are appended and moved to their level by the next update.
+    m_position.push_back(pos);
+    m_id.push_back(id);
+    m_parent.push_back(parent == no_parent ? no_parent : m_position[parent]);
+    m_depth.push_back(parent == no_parent ? 0
+                                          : m_depth[m_position[parent]] + 1);
+    m_local.push_back(local);
+    m_world.push_back(local);
+    m_local_affine.push_back(is_affine(local));
+    m_world_affine.push_back(0);
+    m_dirty.push_back(1);
+    m_changed.push_back(0);
+    m_dirty_count++;
+    m_added = true;
+    return id;
+}
+
+template <std::floating_point T>
+void TransformHierarchy<T>::sort_breadth_first() {
+    const auto n = m_id.size();
+    // Counting sort by depth; stable, so siblings keep their order.
+    const auto levels =
+        std::size_t(*std::max_element(m_depth.begin(), m_depth.end())) + 1;
+    m_level_start.assign(levels + 1, 0);
+    for (const auto depth : m_depth) {
+        m_level_start[depth + 1]++;
+    }
+    for (auto l = 0u; l < levels; l++) {
+        m_level_start[l + 1] += m_level_start[l];
+    }
+    std::vector<std::uint32_t> new_position(n);
+    auto next = m_level_start;
+    for (auto pos = 0u; pos < n; pos++) {
+        new_position[pos] = static_cast<std::uint32_t>(next[m_depth[pos]]++);
+    }
+
+    const auto permute = [&](auto &values) {
+        auto old = values;
+        for (auto pos = 0u; pos < n; pos++) {
+            values[new_position[pos]] = std::move(old[pos]);
+        }
+    };
+    for (auto &parent : m_parent) {
+        parent = parent == no_parent ? no_parent : new_position[parent];
+    }
+    permute(m_id);
+    permute(m_parent);
+    permute(m_depth);
+    permute(m_local);
+    permute(m_world);
+    permute(m_local_affine);
+    permute(m_world_affine);
+    permute(m_dirty);
+    for (auto pos = 0u; pos < n; pos++) {
+        m_position[m_id[pos]] = pos;
+    }
+    m_added = false;
+}
+
+template <std::floating_point T>
+TransformUpdateStats TransformHierarchy<T>::update(ThreadPool &pool) {
+    m_stats = {m_dirty_count, 0, 0};
+    if (m_dirty_count == 0) {
+        return m_stats;
+    }
+    if (m_added) {
+        sort_breadth_first();
+    }
+
+    std::atomic<std::size_t> recomputed = 0;
+    const auto levels = m_level_start.size() - 1;
+    for (auto l = 0u; l < levels; l++) {
+        pool.parallel_for(
+            m_level_start[l], m_level_start[l + 1], level_grain,
+            [&](std::size_t first, std::size_t last) {
+                std::size_t count = 0;
+                for (auto pos = first; pos < last; pos++) {
+                    const auto parent = m_parent[pos];
+                    const bool root = parent == no_parent;
+                    const bool changed =
+                        m_dirty[pos] || (!root && m_changed[parent]);
+                    m_changed[pos] = changed;
+                    if (!changed) {
+                        continue;
+                    }
+                    m_dirty[pos] = 0;
+                    count++;
+                    if (root) {
+                        m_world[pos] = m_local[pos];
+                        m_world_affine[pos] = m_local_affine[pos];
+                    } else if (m_world_affine[parent] && m_local_affine[pos]) {
+                        m_world[pos] =
+                            affine_multiply(m_world[parent], m_local[pos]);
+                        m_world_affine[pos] = 1;
+                    } else {
+                        m_world[pos] = m_world[parent] * m_local[pos];
+                        m_world_affine[pos] = 0;
+                    }
+                }
+                recomputed += count;
+            });
+    }
+    m_stats.recomputed = recomputed;
+    m_stats.levels = static_cast<unsigned int>(levels);
+    m_dirty_count = 0;
+    return m_stats;
+}
+
+} // namespace cml
@@ -0,0 +1,36 @@
+#pragma once
+#include <utility>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CML_ALWAYS_INLINE __attribute__((always_inline))
+#define CML_NOINLINE __attribute__((noinline))
+#else
+#define CML_ALWAYS_INLINE
+#define CML_NOINLINE
+#endif
+
+namespace cml {
+
+// Loops with at most this many iterations are expanded into straight-line
+// code by static_for, independently of the optimization level.
+inline constexpr unsigned int max_unrolled_dim = 16;
+
+// Calls f(i) with an unsigned int i for every i in [0, N). For
+// N <= max_unrolled_dim the calls are expanded from an index sequence with
+// constant arguments; larger N use a plain loop. Lambdas passed here should
+// be marked CML_ALWAYS_INLINE so the expansion survives -O0/-O1 builds.
+template <unsigned int N, typename F>
+CML_ALWAYS_INLINE constexpr void static_for(F &&f) {
+    if constexpr (N <= max_unrolled_dim) {
+        [&]<unsigned int... I>(std::integer_sequence<unsigned int, I...>)
+            CML_ALWAYS_INLINE {
+                (f(I), ...);
+            }(std::make_integer_sequence<unsigned int, N>{});
+    } else {
+        for (auto i = 0u; i < N; i++) {
+            f(i);
+        }
+    }
+}
+
+} // namespace cml
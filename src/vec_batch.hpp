@@ -0,0 +1,96 @@
+#pragma once
+#include "common.hpp"
+#include "vector.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace cml {
+
+// Structure-of-arrays storage for many Vec<T, Dim>: component d of every
+// element is stored contiguously, so kernels can stream over x, y, z
+// separately and process several elements per SIMD instruction.
+template <arithmetic T, unsigned int Dim> class VecBatch {
+  public:
+    using value_type = T;
+    static constexpr unsigned int dimension = Dim;
+    // Component arrays start on multiples of this many elements.
+    static constexpr std::size_t padding = 16;
+
+    VecBatch() = default;
+    explicit VecBatch(std::size_t size) { resize(size); }
+
+    template <std::floating_point LenT>
+    explicit VecBatch(std::span<const Vec<T, Dim, LenT>> vecs) {
+        resize(vecs.size());
+        for (std::size_t i = 0; i < vecs.size(); i++) {
+            set(i, vecs[i]);
+        }
+    }
+
+    template <std::floating_point LenT>
+    explicit VecBatch(const std::vector<Vec<T, Dim, LenT>> &vecs)
+        : VecBatch(std::span<const Vec<T, Dim, LenT>>(vecs)) {}
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    // Resizes every component; existing elements are not preserved.
+    void resize(std::size_t size) {
+        m_size = size;
+        m_stride = (size + padding - 1) / padding * padding;
+        m_data.assign(m_stride * Dim, T());
+    }
+
+    std::span<T> component(unsigned int d) {
+        return {m_data.data() + d * m_stride, m_size};
+    }
+    std::span<const T> component(unsigned int d) const {
+        return {m_data.data() + d * m_stride, m_size};
+    }
+
+    // size() rounded up to a multiple of padding. Elements past size() are
+    // storage only: kernels may read them and never need a scalar tail loop.
+    std::size_t padded_size() const { return m_stride; }
+    std::span<T> padded_component(unsigned int d) {
+        return {m_data.data() + d * m_stride, m_stride};
+    }
+    std::span<const T> padded_component(unsigned int d) const {
+        return {m_data.data() + d * m_stride, m_stride};
+    }
+
+    T &get(unsigned int d, std::size_t i) { return m_data[d * m_stride + i]; }
+    T get(unsigned int d, std::size_t i) const {
+        return m_data[d * m_stride + i];
+    }
+
+    template <std::floating_point LenT = default_len_type>
+    Vec<T, Dim, LenT> operator[](std::size_t i) const {
+        Vec<T, Dim, LenT> v;
+        static_for<Dim>(
+            [&](unsigned int d) CML_ALWAYS_INLINE { v[d] = get(d, i); });
+        return v;
+    }
+
+    template <std::floating_point LenT>
+    void set(std::size_t i, const Vec<T, Dim, LenT> &v) {
+        static_for<Dim>(
+            [&](unsigned int d) CML_ALWAYS_INLINE { get(d, i) = v[d]; });
+    }
+
+    template <std::floating_point LenT = default_len_type>
+    std::vector<Vec<T, Dim, LenT>> to_vecs() const {
+        std::vector<Vec<T, Dim, LenT>> vecs(m_size);
+        for (std::size_t i = 0; i < m_size; i++) {
+            vecs[i] = operator[]<LenT>(i);
+        }
+        return vecs;
+    }
+
+  private:
+    std::size_t m_size = 0;
+    std::size_t m_stride = 0;
+    std::vector<T> m_data;
+};
+
+} // namespace cml
@@ -0,0 +1,299 @@
+#pragma once
+#include "common.hpp"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "unroll.hpp"
+#include "vec_batch.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+
+// Elementwise kernels over VecBatch. They run on the pool and through
+// run_with_isa(active_isa()), so the lane loops are compiled for the widest
+// instruction set the CPU supports (see cpu_dispatch.hpp).
+//
+// Outputs may be the same batch as an input; an output VecBatch is resized
+// to the input's size if it differs, scalar outputs must have size()
+// elements. Inputs of different sizes and scalar outputs of the wrong size
+// throw std::invalid_argument.
+
+namespace cml {
+
+namespace detail {
+
+// Elements are processed in blocks of VecBatch::padding lanes: every block
+// is a fixed trip count loop over the padded components, computed into
+// locals and then stored.
+inline constexpr std::size_t batch_lanes = VecBatch<float, 1>::padding;
+inline constexpr std::size_t batch_grain = 1 << 14;
+
+template <typename T> using Lanes = std::array<T, batch_lanes>;
+
+// Calls block(base, lanes) for the blocks of [0, size), `lanes` being the
+// number of elements of the block below size.
+template <typename Block>
+void for_each_block(std::size_t size, ThreadPool &pool, Block &&block) {
+    const auto isa = active_isa();
+    const auto blocks = (size + batch_lanes - 1) / batch_lanes;
+    pool.parallel_for(
+        0, blocks, batch_grain / batch_lanes,
+        [&](std::size_t first, std::size_t last) {
+            run_with_isa(isa, [&] {
+                for (auto b = first; b < last; b++) {
+                    const auto base = b * batch_lanes;
+                    block(base, std::min(batch_lanes, size - base));
+                }
+            });
+        });
+}
+
+template <typename T>
+CML_ALWAYS_INLINE inline void store_lanes(T *dst, const Lanes<T> &src,
+                                          std::size_t lanes) {
+    if (lanes == batch_lanes) {
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            dst[l] = src[l];
+        }
+    } else {
+        for (std::size_t l = 0; l < lanes; l++) {
+            dst[l] = src[l];
+        }
+    }
+}
+
+// The first `lanes` elements at src, the rest zero; for inputs that are not
+// padded like VecBatch components.
+template <typename T>
+CML_ALWAYS_INLINE inline Lanes<T> load_lanes(const T *src,
+                                             std::size_t lanes) {
+    Lanes<T> r{};
+    if (lanes == batch_lanes) {
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            r[l] = src[l];
+        }
+    } else {
+        for (std::size_t l = 0; l < lanes; l++) {
+            r[l] = src[l];
+        }
+    }
+    return r;
+}
+
+template <typename T, unsigned int Dim>
+std::array<const T *, Dim> component_pointers(const VecBatch<T, Dim> &v) {
+    std::array<const T *, Dim> p;
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        p[d] = v.padded_component(d).data();
+    });
+    return p;
+}
+
+template <typename T, unsigned int Dim>
+std::array<T *, Dim> component_pointers(VecBatch<T, Dim> &v, std::size_t size) {
+    if (v.size() != size) {
+        v.resize(size);
+    }
+    std::array<T *, Dim> p;
+    static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+        p[d] = v.padded_component(d).data();
+    });
+    return p;
+}
+
+template <typename A, typename B>
+void check_same_size(const A &a, const B &b, const char *what) {
+    if (a.size() != b.size()) {
+        throw std::invalid_argument(what);
+    }
+}
+
+// out[d][i] = f(d, i) for every component d and element i.
+template <typename T, unsigned int Dim, typename F>
+void map_components(std::size_t size, VecBatch<T, Dim> &out, ThreadPool &pool,
+                    F &&f) {
+    const auto o = component_pointers(out, size);
+    for_each_block(size, pool, [&](std::size_t base, std::size_t lanes) {
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            Lanes<T> r;
+            for (std::size_t l = 0; l < batch_lanes; l++) {
+                r[l] = f(d, base + l);
+            }
+            store_lanes(o[d] + base, r, lanes);
+        });
+    });
+}
+
+// out[i] = f(i).
+template <typename T, typename F>
+void map_scalars(std::size_t size, std::span<T> out, ThreadPool &pool,
+                 F &&f) {
+    if (out.size() != size) {
+        throw std::invalid_argument("vec batch: output size mismatch");
+    }
+    for_each_block(size, pool, [&](std::size_t base, std::size_t lanes) {
+        Lanes<T> r;
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            r[l] = f(base + l);
+        }
+        store_lanes(out.data() + base, r, lanes);
+    });
+}
+
+template <std::floating_point T>
+void transform(const Matrix<4, 4, T> &m, T w, const VecBatch<T, 3> &in,
+               VecBatch<T, 3> &out, ThreadPool &pool) {
+    const auto p = component_pointers(in);
+    const auto o = component_pointers(out, in.size());
+    std::array<T, 12> c;
+    for (auto row = 0u; row < 3; row++) {
+        for (auto col = 0u; col < 4; col++) {
+            c[row * 4 + col] = m.get(row, col) * (col == 3 ? w : T(1));
+        }
+    }
+    for_each_block(in.size(), pool, [&](std::size_t base, std::size_t lanes) {
+        std::array<Lanes<T>, 3> r;
+        for (std::size_t l = 0; l < batch_lanes; l++) {
+            const auto x = p[0][base + l];
+            const auto y = p[1][base + l];
+            const auto z = p[2][base + l];
+            r[0][l] = c[0] * x + c[1] * y + c[2] * z + c[3];
+            r[1][l] = c[4] * x + c[5] * y + c[6] * z + c[7];
+            r[2][l] = c[8] * x + c[9] * y + c[10] * z + c[11];
+        }
+        static_for<3>([&](unsigned int d) CML_ALWAYS_INLINE {
+            store_lanes(o[d] + base, r[d], lanes);
+        });
+    });
+}
+
+} // namespace detail
+
+// out = a + b.
+template <std::floating_point T, unsigned int Dim>
+void add(const VecBatch<T, Dim> &a, const VecBatch<T, Dim> &b,
+         VecBatch<T, Dim> &out, ThreadPool &pool = ThreadPool::global()) {
+    detail::check_same_size(a, b, "add: batch size mismatch");
+    const auto pa = detail::component_pointers(a);
+    const auto pb = detail::component_pointers(b);
+    detail::map_components(a.size(), out, pool,
+                           [&](unsigned int d, std::size_t i) {
+                               return pa[d][i] + pb[d][i];
+                           });
+}
+
+// out = a - b.
+template <std::floating_point T, unsigned int Dim>
+void subtract(const VecBatch<T, Dim> &a, const VecBatch<T, Dim> &b,
+              VecBatch<T, Dim> &out, ThreadPool &pool = ThreadPool::global()) {
+    detail::check_same_size(a, b, "subtract: batch size mismatch");
+    const auto pa = detail::component_pointers(a);
+    const auto pb = detail::component_pointers(b);
+    detail::map_components(a.size(), out, pool,
+                           [&](unsigned int d, std::size_t i) {
+                               return pa[d][i] - pb[d][i];
+                           });
+}
+
+// out = a * s.
+template <std::floating_point T, unsigned int Dim>
+void scale(const VecBatch<T, Dim> &a, T s, VecBatch<T, Dim> &out,
+           ThreadPool &pool = ThreadPool::global()) {
+    const auto pa = detail::component_pointers(a);
+    detail::map_components(
+        a.size(), out, pool,
+        [&](unsigned int d, std::size_t i) { return pa[d][i] * s; });
+}
+
+// out = a * s + b.
+template <std::floating_point T, unsigned int Dim>
+void multiply_add(const VecBatch<T, Dim> &a, T s, const VecBatch<T, Dim> &b,
+                  VecBatch<T, Dim> &out,
+                  ThreadPool &pool = ThreadPool::global()) {
+    detail::check_same_size(a, b, "multiply_add: batch size mismatch");
+    const auto pa = detail::component_pointers(a);
+    const auto pb = detail::component_pointers(b);
+    detail::map_components(a.size(), out, pool,
+                           [&](unsigned int d, std::size_t i) {
+                               return pa[d][i] * s + pb[d][i];
+                           });
+}
+
+// out[i] = a[i].dot(b[i]).
+template <std::floating_point T, unsigned int Dim>
+void dot(const VecBatch<T, Dim> &a, const VecBatch<T, Dim> &b,
+         std::span<T> out, ThreadPool &pool = ThreadPool::global()) {
+    detail::check_same_size(a, b, "dot: batch size mismatch");
+    const auto pa = detail::component_pointers(a);
+    const auto pb = detail::component_pointers(b);
+    detail::map_scalars(a.size(), out, pool, [&](std::size_t i) {
+        T sum = 0;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            sum += pa[d][i] * pb[d][i];
+        });
+        return sum;
+    });
+}
+
+// out[i] = a[i].length().
+template <std::floating_point T, unsigned int Dim>
+void length(const VecBatch<T, Dim> &a, std::span<T> out,
+            ThreadPool &pool = ThreadPool::global()) {
+    const auto pa = detail::component_pointers(a);
+    detail::map_scalars(a.size(), out, pool, [&](std::size_t i) {
+        T sum = 0;
+        static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+            sum += pa[d][i] * pa[d][i];
+        });
+        return std::sqrt(sum);
+    });
+}
+
+// out[i] = a[i].normalized().
+template <std::floating_point T, unsigned int Dim>
+void normalize(const VecBatch<T, Dim> &a, VecBatch<T, Dim> &out,
+               ThreadPool &pool = ThreadPool::global()) {
+    const auto pa = detail::component_pointers(a);
+    const auto o = detail::component_pointers(out, a.size());
+    detail::for_each_block(
+        a.size(), pool, [&](std::size_t base, std::size_t lanes) {
+            detail::Lanes<T> len;
+            for (std::size_t l = 0; l < detail::batch_lanes; l++) {
+                T sum = 0;
+                static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                    sum += pa[d][base + l] * pa[d][base + l];
+                });
+                len[l] = std::sqrt(sum);
+            }
+            static_for<Dim>([&](unsigned int d) CML_ALWAYS_INLINE {
+                detail::Lanes<T> r;
+                for (std::size_t l = 0; l < detail::batch_lanes; l++) {
+                    r[l] = pa[d][base + l] / len[l];
+                }
+                detail::store_lanes(o[d] + base, r, lanes);
+            });
+        });
+}
+
+// out[i] = m * (in[i], 1) for an affine m (see is_affine()), i.e. the points
+// mapped as rotate() and translate() compose them.
+template <std::floating_point T>
+void transform_points(const Matrix<4, 4, T> &m, const VecBatch<T, 3> &in,
+                      VecBatch<T, 3> &out,
+                      ThreadPool &pool = ThreadPool::global()) {
+    detail::transform(m, T(1), in, out, pool);
+}
+
+// out[i] = m * (in[i], 0): directions ignore the translation.
+template <std::floating_point T>
+void transform_directions(const Matrix<4, 4, T> &m, const VecBatch<T, 3> &in,
+                          VecBatch<T, 3> &out,
+                          ThreadPool &pool = ThreadPool::global()) {
+    detail::transform(m, T(0), in, out, pool);
+}
+
+} // namespace cml
@@ -1,25 +1,30 @@
 #pragma once
 #include "common.hpp"
+#include "instrumentation.hpp"
 #include "matrix.hpp"
 #include "vector.hpp"
 
 namespace cml {
 
-template <arithmetic T, unsigned int Dim> using ColumnVec = Matrix<Dim, 1, T>;
+template <scalar T, unsigned int Dim> using ColumnVec = Matrix<Dim, 1, T>;
 
-template <arithmetic T, unsigned int Rows, unsigned int Cols,
+template <scalar T, unsigned int Rows, unsigned int Cols,
           std::floating_point LenT>
 Vec<T, Rows, LenT> operator*(const Matrix<Rows, Cols, T> &lhs,
                              const Vec<T, Cols, LenT> &rhs) {
+    // The arithmetic is counted by the Matrix product.
+    CML_INSTRUMENT(matrix_vector_multiply, Rows, Cols, T, 0, 0);
     const auto rhs_as_mat = *reinterpret_cast<const ColumnVec<T, Cols> *>(&rhs);
     const auto result = lhs * rhs_as_mat;
     return *reinterpret_cast<const Vec<T, Rows, LenT> *>(&result);
 }
 
-template <arithmetic T>
+template <scalar T>
 Matrix<4, 4, T> rotate(const Matrix<4, 4, T> &matrix, T angle, Vec3<T> axis) {
-    const auto c = std::cos(angle);
-    const auto s = std::sin(angle);
+    CML_INSTRUMENT(rotate, 4, 4, T, 24, 16 * sizeof(T));
+    using std::cos, std::sin;
+    const auto c = cos(angle);
+    const auto s = sin(angle);
     const auto t = 1 - c;
     const auto x = axis.x();
     const auto y = axis.y();
@@ -53,8 +58,9 @@ Matrix<4, 4, T> rotate(const Matrix<4, 4, T> &matrix, T angle, Vec3<T> axis) {
     return rotation_matrix * matrix;
 }
 
-template <arithmetic T>
+template <scalar T>
 Matrix<4, 4, T> translate(const Matrix<4, 4, T> &matrix, Vec3<T> translation) {
+    CML_INSTRUMENT(translate, 4, 4, T, 0, 16 * sizeof(T));
     Matrix<4, 4, T> translation_matrix;
     translation_matrix[0][0] = 1;
     translation_matrix[0][1] = 0;
@@ -75,8 +81,35 @@ Matrix<4, 4, T> translate(const Matrix<4, 4, T> &matrix, Vec3<T> translation) {
     return translation_matrix * matrix;
 }
 
-template <arithmetic T>
+// True if m maps column vectors affinely, i.e. its last row is (0, 0, 0, 1)
+// as for the products of translate() and rotate().
+template <scalar T> bool is_affine(const Matrix<4, 4, T> &m) {
+    return m.get(3, 0) == 0 && m.get(3, 1) == 0 && m.get(3, 2) == 0 &&
+           m.get(3, 3) == 1;
+}
+
+// lhs * rhs for two affine matrices (see is_affine()); skips the constant
+// last row, 36 multiplies instead of 64.
+template <scalar T>
+Matrix<4, 4, T> affine_multiply(const Matrix<4, 4, T> &lhs,
+                                const Matrix<4, 4, T> &rhs) {
+    CML_INSTRUMENT(affine_multiply, 4, 4, T, 63, 48 * sizeof(T));
+    Matrix<4, 4, T> r;
+    static_for<3>([&](unsigned int row) CML_ALWAYS_INLINE {
+        static_for<4>([&](unsigned int col) CML_ALWAYS_INLINE {
+            r.get(row, col) = lhs.get(row, 0) * rhs.get(0, col) +
+                              lhs.get(row, 1) * rhs.get(1, col) +
+                              lhs.get(row, 2) * rhs.get(2, col);
+        });
+        r.get(row, 3) += lhs.get(row, 3);
+    });
+    r.get(3, 3) = 1;
+    return r;
+}
+
+template <scalar T>
 Matrix<4, 4, T> lookAt(Vec3<T> eye, Vec3<T> center, Vec3<T> up) {
+    CML_INSTRUMENT(look_at, 4, 4, T, 5, 16 * sizeof(T));
     const auto f = (center - eye).normalized();
     const auto s = f.cross(up).normalized();
     const auto u = s.cross(f);
@@ -100,9 +133,11 @@ Matrix<4, 4, T> lookAt(Vec3<T> eye, Vec3<T> center, Vec3<T> up) {
     return look_at_matrix;
 }
 
-template <arithmetic T>
+template <scalar T>
 Matrix<4, 4, T> perspective(T fovy, T aspect, T near, T far) {
-    const auto f = 1 / std::tan(fovy / 2);
+    CML_INSTRUMENT(perspective, 4, 4, T, 10, 16 * sizeof(T));
+    using std::tan;
+    const auto f = 1 / tan(fovy / 2);
     Matrix<4, 4, T> perspective_matrix;
     perspective_matrix[0][0] = f / aspect;
     perspective_matrix[0][1] = 0;
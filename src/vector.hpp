@@ -1,5 +1,7 @@
 #pragma once
 #include "common.hpp"
+#include "instrumentation.hpp"
+#include "unroll.hpp"
 #include <array>
 #include <cmath>
 #include <concepts>
@@ -11,18 +13,22 @@ namespace cml {
 
 using default_len_type = default_type;
 
-template <arithmetic T, unsigned int Dim,
+template <scalar T, unsigned int Dim,
           std::floating_point LenT = default_len_type>
 class Vec {
   public:
+    // Lengths of arithmetic vectors are LenT; those of other scalars (such
+    // as Dual) are T, so they keep what the scalar carries.
+    using LengthType = std::conditional_t<arithmetic<T>, LenT, T>;
+
     constexpr Vec() : vals{0} {}
     constexpr Vec(std::initializer_list<T> list) {
         std::copy(list.begin(), list.end(), vals.begin());
     }
-    template <unsigned int RHDim> explicit Vec(const Vec<T, RHDim, LenT> &rhs) {
-        for (auto i = 0u; i < std::min(RHDim, Dim); i++) {
-            vals[i] = rhs[i];
-        }
+    template <unsigned int RHDim>
+    explicit Vec(const Vec<T, RHDim, LenT> &rhs) : vals{0} {
+        static_for<std::min(RHDim, Dim)>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { vals[i] = rhs[i]; });
     }
 
     constexpr Vec(T x, T y)
@@ -34,53 +40,61 @@ class Vec {
 
     constexpr unsigned int dimension() const { return Dim; }
 
-    constexpr T operator[](int i) const { return vals[i]; }
-    constexpr T &operator[](int i) { return vals[i]; }
+    constexpr T operator[](unsigned int i) const { return vals[i]; }
+    constexpr T &operator[](unsigned int i) { return vals[i]; }
 
-    template <arithmetic T2, std::floating_point LenT2>
+    template <scalar T2, std::floating_point LenT2>
         requires(std::is_convertible_v<T2, T>)
     constexpr T dot(const Vec<T2, Dim, LenT2> &rhs) const {
+        CML_INSTRUMENT(vec_dot, Dim, 1, T, 2 * Dim, 2 * Dim * sizeof(T));
         T sum = 0;
-        for (int i = 0; i < Dim; i++) {
-            sum += vals[i] * rhs[i];
-        }
+        static_for<Dim>(
+            [&](unsigned int i) CML_ALWAYS_INLINE { sum += vals[i] * rhs[i]; });
         return sum;
     }
 
-    template <arithmetic T2, std::floating_point LenT2>
+    template <scalar T2, std::floating_point LenT2>
         requires(std::is_convertible_v<T2, T> && Dim == 3)
     constexpr Vec cross(const Vec<T2, Dim, LenT2> &rhs) const {
+        CML_INSTRUMENT(vec_cross, Dim, 1, T, 9, 9 * sizeof(T));
         return {vals[1] * rhs[2] - vals[2] * rhs[1],
                 vals[2] * rhs[0] - vals[0] * rhs[2],
                 vals[0] * rhs[1] - vals[1] * rhs[0]};
     }
 
-    constexpr LenT length_sq() const {
-        LenT sum = 0;
-        for (int i = 0; i < Dim; i++) {
+    constexpr LengthType length_sq() const {
+        CML_INSTRUMENT(vec_length_sq, Dim, 1, T, 2 * Dim, Dim * sizeof(T));
+        LengthType sum = 0;
+        static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
             sum += vals[i] * vals[i];
-        }
+        });
         return sum;
     }
 
-    constexpr LenT length() const { return std::sqrt(length_sq()); }
+    constexpr LengthType length() const {
+        CML_INSTRUMENT(vec_length, Dim, 1, T, 1, 0);
+        using std::sqrt;
+        return sqrt(length_sq());
+    }
 
-    template <arithmetic T2 = LenT>
-        requires(std::is_floating_point_v<T2>)
+    template <scalar T2 = LengthType>
+        requires(!std::integral<T2>)
     constexpr Vec<T2, Dim, LenT> normalized() const {
-        LenT len = length();
-        Vec<LenT, Dim, LenT> normalized;
-        for (int i = 0; i < Dim; i++) {
+        CML_INSTRUMENT(vec_normalize, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+        LengthType len = length();
+        Vec<LengthType, Dim, LenT> normalized;
+        static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
             normalized[i] = vals[i] / len;
-        }
+        });
         return normalized;
     }
 
     constexpr Vec interpolated(LenT scalar) const {
+        CML_INSTRUMENT(vec_scale, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
         Vec interpolated;
-        for (int i = 0; i < Dim; i++) {
+        static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
             interpolated[i] = vals[i] * scalar;
-        }
+        });
         return interpolated;
     }
 
@@ -152,105 +166,112 @@ class Vec {
     Iterator crbegin() { return Iterator(vals.crbegin()); }
     Iterator crend() const { return Iterator(vals.crend()); }
 
-    using LengthType = LenT;
-
   protected:
     std::array<T, Dim> vals;
 };
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator-(Vec<T, Dim, LenT> rhs)
-    requires(std::is_signed<T>() == true)
+    requires(!std::is_unsigned_v<T>)
 {
-    for (auto i = 0u; i < Dim; i++) {
-        rhs[i] = -rhs[i];
-    }
+    CML_INSTRUMENT(vec_negate, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { rhs[i] = -rhs[i]; });
     return rhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator+(Vec<T, Dim, LenT> lhs,
                             const Vec<T, Dim, LenT> &rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] += rhs[i];
-    }
+    CML_INSTRUMENT(vec_add, Dim, 1, T, Dim, 3 * Dim * sizeof(T));
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] += rhs[i]; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> &operator+=(Vec<T, Dim, LenT> &lhs,
                               const Vec<T, Dim, LenT> &rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] += rhs[i];
-    }
+    CML_INSTRUMENT(vec_add, Dim, 1, T, Dim, 3 * Dim * sizeof(T));
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] += rhs[i]; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator-(Vec<T, Dim, LenT> lhs,
                             const Vec<T, Dim, LenT> &rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] -= rhs[i];
-    }
+    CML_INSTRUMENT(vec_subtract, Dim, 1, T, Dim, 3 * Dim * sizeof(T));
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] -= rhs[i]; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> &operator-=(Vec<T, Dim, LenT> &lhs,
                               const Vec<T, Dim, LenT> &rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] -= rhs[i];
-    }
+    CML_INSTRUMENT(vec_subtract, Dim, 1, T, Dim, 3 * Dim * sizeof(T));
+    static_for<Dim>(
+        [&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] -= rhs[i]; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator*(T lhs, Vec<T, Dim, LenT> rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        rhs[i] *= lhs;
-    }
+    CML_INSTRUMENT(vec_scale, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE { rhs[i] *= lhs; });
     return rhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator*(const Vec<T, Dim, LenT> &lhs, T rhs) {
     return rhs * lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> &operator*=(Vec<T, Dim, LenT> &lhs, const T rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] *= rhs;
-    }
+    CML_INSTRUMENT(vec_scale, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] *= rhs; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> operator/(Vec<T, Dim, LenT> lhs, const T rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] /= rhs;
-    }
+    CML_INSTRUMENT(vec_divide, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] /= rhs; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 Vec<T, Dim, LenT> &operator/=(Vec<T, Dim, LenT> &lhs, const T rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        lhs[i] /= rhs;
-    }
+    CML_INSTRUMENT(vec_divide, Dim, 1, T, Dim, 2 * Dim * sizeof(T));
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE { lhs[i] /= rhs; });
     return lhs;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+// a * (1 - t) + b * t: exactly a at t = 0 and b at t = 1.
+template <scalar T, unsigned int Dim, std::floating_point LenT>
+    requires(!std::integral<T>)
+constexpr Vec<T, Dim, LenT> lerp(const Vec<T, Dim, LenT> &a,
+                                 const Vec<T, Dim, LenT> &b, T t) {
+    CML_INSTRUMENT(vec_lerp, Dim, 1, T, 3 * Dim, 3 * Dim * sizeof(T));
+    Vec<T, Dim, LenT> r;
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
+        r[i] = a[i] * (T(1) - t) + b[i] * t;
+    });
+    return r;
+}
+
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 bool operator==(const Vec<T, Dim, LenT> &lhs, const Vec<T, Dim, LenT> &rhs) {
-    for (auto i = 0u; i < Dim; i++) {
-        if (lhs[i] != rhs[i])
-            return false;
-    }
-    return true;
+    bool equal = true;
+    static_for<Dim>([&](unsigned int i) CML_ALWAYS_INLINE {
+        equal = equal && lhs[i] == rhs[i];
+    });
+    return equal;
 }
 
-template <arithmetic T, unsigned int Dim, std::floating_point LenT>
+template <scalar T, unsigned int Dim, std::floating_point LenT>
 std::ostream &operator<<(std::ostream &out, const Vec<T, Dim, LenT> &vec) {
     for (auto i = 0u; i < Dim; i++) {
         out << vec[i];
@@ -260,14 +281,14 @@ std::ostream &operator<<(std::ostream &out, const Vec<T, Dim, LenT> &vec) {
     return out;
 }
 
-template <arithmetic T, std::floating_point LenT = default_len_type>
+template <scalar T, std::floating_point LenT = default_len_type>
 using Vec3 = Vec<T, 3, LenT>;
 using Vec3i = Vec3<int>;
 using Vec3u = Vec3<unsigned int>;
 using Vec3d = Vec3<double>;
 using Vec3f = Vec3<float>;
 
-template <arithmetic T, std::floating_point LenT = default_len_type>
+template <scalar T, std::floating_point LenT = default_len_type>
 using Vec2 = Vec<T, 2, LenT>;
 using Vec2i = Vec2<int>;
 using Vec2u = Vec2<unsigned int>;
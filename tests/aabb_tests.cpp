@@ -0,0 +1,59 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aabb.hpp"
+#include "doctest/doctest.h"
+#include "tests_common.hpp"
+#include "vector.hpp"
+
+using namespace cml;
+
+TEST_CASE_TEMPLATE("Aabb: empty and expand", T, ARITHMETIC_TYPES) {
+    Aabb<T> box;
+    CHECK(box.empty());
+    CHECK(box.surface_area() == T(0));
+
+    box.expand(Vec3<T>(T(1), T(2), T(3)));
+    CHECK_FALSE(box.empty());
+    CHECK(box.min == box.max);
+
+    box.expand(Aabb<T>(Vec3<T>(T(0), T(0), T(0)), Vec3<T>(T(2), T(3), T(4))));
+    CHECK(box.min == Vec3<T>(T(0), T(0), T(0)));
+    CHECK(box.max == Vec3<T>(T(2), T(3), T(4)));
+    CHECK(box.extent() == Vec3<T>(T(2), T(3), T(4)));
+    CHECK(box.surface_area() == T(2 * (6 + 12 + 8)));
+    CHECK(box.longest_axis() == 2);
+}
+
+TEST_CASE_TEMPLATE("Aabb: containment, overlap and distance", T,
+                   ARITHMETIC_TYPES) {
+    const Aabb<T> box(Vec3<T>(T(0), T(0), T(0)), Vec3<T>(T(2), T(2), T(2)));
+    CHECK(box.contains(Vec3<T>(T(1), T(2), T(0))));
+    CHECK_FALSE(box.contains(Vec3<T>(T(1), T(3), T(0))));
+
+    CHECK(box.overlaps(
+        Aabb<T>(Vec3<T>(T(2), T(2), T(2)), Vec3<T>(T(3), T(3), T(3)))));
+    CHECK_FALSE(box.overlaps(
+        Aabb<T>(Vec3<T>(T(3), T(0), T(0)), Vec3<T>(T(4), T(1), T(1)))));
+
+    CHECK(box.closest_point(Vec3<T>(T(5), T(1), T(-1))) ==
+          Vec3<T>(T(2), T(1), T(0)));
+    CHECK(box.distance_sq(Vec3<T>(T(5), T(1), T(-1))) == T(10));
+    CHECK(box.distance_sq(Vec3<T>(T(1), T(1), T(1))) == T(0));
+}
+
+TEST_CASE_TEMPLATE("Aabb: ray slab test", T, float, double) {
+    const Aabb<T> box(Vec3<T>(T(1), T(-1), T(-1)), Vec3<T>(T(3), T(1), T(1)));
+    const Vec3<T> origin(T(0), T(0), T(0));
+    const auto inf = std::numeric_limits<T>::infinity();
+
+    T t_min = 0;
+    CHECK(box.intersect_ray(origin, Vec3<T>(T(1), inf, inf), t_min, T(10)));
+    CHECK(t_min == doctest::Approx(1));
+
+    t_min = 0;
+    CHECK_FALSE(box.intersect_ray(origin, Vec3<T>(T(1), inf, inf), t_min,
+                                  T(0.5)));
+
+    t_min = 0;
+    CHECK_FALSE(
+        box.intersect_ray(origin, Vec3<T>(T(-1), inf, inf), t_min, T(10)));
+}
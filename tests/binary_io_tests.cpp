@@ -0,0 +1,98 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "binary_io.hpp"
+#include "doctest/doctest.h"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "vector.hpp"
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <vector>
+
+using namespace cml;
+
+#define TT typename T::Type
+
+namespace {
+std::filesystem::path temp_file(const std::string &name) {
+    return std::filesystem::temp_directory_path() / ("cml_" + name + ".cmlb");
+}
+} // namespace
+
+TEST_CASE_TEMPLATE("Binary IO: Vec round trip", T, ARITHMETIC_TYPES_AND_DIMS) {
+    std::vector<Vec<TT, T::dim>> vecs(37);
+    for (auto i = 0u; i < vecs.size(); i++) {
+        std::iota(vecs[i].begin(), vecs[i].end(), TT(i));
+    }
+    const auto path = temp_file("vec_round_trip");
+    write_binary(path, std::span<const Vec<TT, T::dim>>(vecs));
+
+    MappedArray<Vec<TT, T::dim>> mapped(path);
+    CHECK(mapped.size() == vecs.size());
+    CHECK(mapped.header().rows == T::dim);
+    CHECK(mapped.header().kind == BinaryKind::vec);
+    CHECK(reinterpret_cast<std::uintptr_t>(mapped.elements().data()) % 64 ==
+          0);
+    for (auto i = 0u; i < vecs.size(); i++) {
+        CHECK(mapped[i] == vecs[i]);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE_TEMPLATE("Binary IO: Matrix round trip", T, ARITHMETIC_TYPES) {
+    std::vector<Matrix<3, 4, T>> mats(5);
+    for (auto i = 0u; i < mats.size(); i++) {
+        std::iota(mats[i].begin(), mats[i].end(), T(i));
+    }
+    const auto path = temp_file("matrix_round_trip");
+    write_binary(path, std::span<const Matrix<3, 4, T>>(mats), 4096);
+
+    MappedArray<Matrix<3, 4, T>> mapped(path);
+    CHECK(mapped.header().data_offset == 4096);
+    REQUIRE(mapped.size() == mats.size());
+    for (auto i = 0u; i < mats.size(); i++) {
+        for (auto r = 0u; r < 3; r++) {
+            for (auto c = 0u; c < 4; c++) {
+                CHECK(mapped[i].get(r, c) == mats[i].get(r, c));
+            }
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Binary IO: chunked writer") {
+    const auto path = temp_file("chunked");
+    {
+        BinaryWriter<Vec3f> writer(path);
+        for (auto i = 0; i < 10; i++) {
+            writer.append(Vec3f(float(i), float(i + 1), float(i + 2)));
+        }
+    }
+    MappedArray<Vec3f> mapped(path);
+    const auto points = mapped.elements();
+    REQUIRE(points.size() == 10);
+    CHECK(points[9] == Vec3f(9.f, 10.f, 11.f));
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Binary IO: rejects mismatched and corrupt files") {
+    const auto path = temp_file("mismatch");
+    std::vector<Vec3f> vecs(3);
+    write_binary(path, std::span<const Vec3f>(vecs));
+
+    CHECK_THROWS_AS(MappedArray<Vec3d>(path), BinaryFormatError);
+    CHECK_THROWS_AS(MappedArray<Vec2f>(path), BinaryFormatError);
+    CHECK_THROWS_AS((MappedArray<Matrix<3, 1, float>>(path)),
+                    BinaryFormatError);
+
+    std::filesystem::resize_file(path, 64 + 12);
+    CHECK_THROWS_AS(MappedArray<Vec3f>(path), BinaryFormatError);
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "not a cmlb file at all, just some text padding it out to "
+               "more than sixty-four bytes";
+    }
+    CHECK_THROWS_AS(MappedArray<Vec3f>(path), BinaryFormatError);
+    std::filesystem::remove(path);
+}
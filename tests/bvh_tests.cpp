@@ -0,0 +1,159 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "doctest/doctest.h"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <optional>
+#include <set>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+std::vector<Aabbf> random_boxes(std::size_t count, std::uint64_t seed) {
+    std::vector<Vec3f> centers(count);
+    fill_uniform_box(std::span<Vec3f>(centers), Vec3f(0.f, 0.f, 0.f),
+                     Vec3f(100.f, 100.f, 100.f), seed);
+    std::vector<Vec3f> sizes(count);
+    fill_uniform_box(std::span<Vec3f>(sizes), Vec3f(0.1f, 0.1f, 0.1f),
+                     Vec3f(2.f, 2.f, 2.f), seed + 1);
+    std::vector<Aabbf> boxes(count);
+    for (auto i = 0u; i < count; i++) {
+        boxes[i] = Aabbf(centers[i] - sizes[i], centers[i] + sizes[i]);
+    }
+    return boxes;
+}
+
+std::optional<float> ray_box(const Aabbf &box, const Vec3f &origin,
+                             const Vec3f &dir, float t_max) {
+    const Vec3f inv(1.f / dir.x(), 1.f / dir.y(), 1.f / dir.z());
+    float t = 0;
+    if (box.intersect_ray(origin, inv, t, t_max)) {
+        return t;
+    }
+    return std::nullopt;
+}
+
+void check_structure(const Bvh<float> &bvh, std::size_t count) {
+    std::vector<int> seen(count, 0);
+    for (const auto &node : bvh.nodes()) {
+        if (node.is_leaf()) {
+            for (auto i = node.offset; i < node.offset + node.count; i++) {
+                seen[bvh.indices()[i]]++;
+            }
+        } else {
+            const auto self = static_cast<std::uint32_t>(
+                &node - bvh.nodes().data());
+            REQUIRE(node.offset > self + 1);
+            REQUIRE(node.offset < bvh.nodes().size());
+            const auto parent = node.bounds();
+            for (const auto child : {self + 1, node.offset}) {
+                auto merged = parent;
+                merged.expand(bvh.nodes()[child].bounds());
+                CHECK(merged == parent);
+            }
+        }
+    }
+    for (const auto s : seen) {
+        CHECK(s == 1);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Bvh: node layout") {
+    CHECK(sizeof(Bvh<float>::Node) == 32);
+
+    Bvh<float> empty(std::span<const Aabbf>{});
+    CHECK(empty.empty());
+
+    const std::vector<Aabbf> one{
+        Aabbf(Vec3f(0.f, 0.f, 0.f), Vec3f(1.f, 1.f, 1.f))};
+    Bvh<float> single{std::span<const Aabbf>(one)};
+    REQUIRE(single.nodes().size() == 1);
+    CHECK(single.nodes()[0].is_leaf());
+}
+
+TEST_CASE("Bvh: structure and determinism across pools") {
+    const auto boxes = random_boxes(20000, 11);
+    Bvh<float>::BuildOptions options;
+    options.parallel_binning_threshold = 1000;
+
+    ThreadPool one(1);
+    ThreadPool four(4);
+    const Bvh<float> serial(std::span<const Aabbf>(boxes), options, one);
+    const Bvh<float> parallel(std::span<const Aabbf>(boxes), options, four);
+    check_structure(serial, boxes.size());
+    check_structure(parallel, boxes.size());
+
+    REQUIRE(serial.nodes().size() == parallel.nodes().size());
+    CHECK(std::equal(serial.indices().begin(), serial.indices().end(),
+                     parallel.indices().begin()));
+}
+
+TEST_CASE("Bvh: degenerate input") {
+    std::vector<Aabbf> boxes(1000,
+                             Aabbf(Vec3f(1.f, 1.f, 1.f), Vec3f(2.f, 2.f, 2.f)));
+    const Bvh<float> bvh{std::span<const Aabbf>(boxes)};
+    check_structure(bvh, boxes.size());
+}
+
+TEST_CASE("Bvh: queries match brute force") {
+    const auto boxes = random_boxes(5000, 3);
+    const Bvh<float> bvh{std::span<const Aabbf>(boxes)};
+
+    std::vector<Vec3f> origins(200);
+    std::vector<Vec3f> dirs(200);
+    fill_uniform_box(std::span<Vec3f>(origins), Vec3f(0.f, 0.f, 0.f),
+                     Vec3f(100.f, 100.f, 100.f), 5);
+    fill_uniform_sphere(std::span<Vec3f>(dirs), 6);
+
+    for (auto r = 0u; r < origins.size(); r++) {
+        const auto hit =
+            bvh.raycast(origins[r], dirs[r], 1000.f,
+                        [&](std::uint32_t prim, float t_max) {
+                            return ray_box(boxes[prim], origins[r], dirs[r],
+                                           t_max);
+                        });
+        std::optional<float> expected;
+        for (const auto &box : boxes) {
+            const auto t = ray_box(box, origins[r], dirs[r], 1000.f);
+            if (t && (!expected || *t < *expected)) {
+                expected = t;
+            }
+        }
+        REQUIRE(hit.has_value() == expected.has_value());
+        if (hit) {
+            CHECK(hit->t == *expected);
+        }
+
+        const auto nearest = bvh.closest(origins[r], [&](std::uint32_t prim) {
+            return boxes[prim].distance_sq(origins[r]);
+        });
+        float best = std::numeric_limits<float>::infinity();
+        for (const auto &box : boxes) {
+            best = std::min(best, box.distance_sq(origins[r]));
+        }
+        REQUIRE(nearest.has_value());
+        CHECK(nearest->distance_sq == best);
+
+        const Aabbf query(origins[r] - Vec3f(5.f, 5.f, 5.f),
+                          origins[r] + Vec3f(5.f, 5.f, 5.f));
+        std::set<std::uint32_t> found;
+        bvh.query_overlap(query, [&](std::uint32_t prim) {
+            if (boxes[prim].overlaps(query)) {
+                found.insert(prim);
+            }
+        });
+        std::set<std::uint32_t> brute;
+        for (auto i = 0u; i < boxes.size(); i++) {
+            if (boxes[i].overlaps(query)) {
+                brute.insert(i);
+            }
+        }
+        CHECK(found == brute);
+    }
+}
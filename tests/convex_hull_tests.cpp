@@ -0,0 +1,230 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "convex_hull.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+// Sequential monotone chain over all points, duplicates resolved to the
+// smallest index.
+std::vector<std::uint32_t> reference_hull(const std::vector<Vec2d> &points) {
+    std::vector<std::uint32_t> order(points.size());
+    std::iota(order.begin(), order.end(), std::uint32_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) {
+        return points[a][0] < points[b][0] ||
+               (points[a][0] == points[b][0] && points[a][1] < points[b][1]);
+    });
+    order.erase(std::unique(order.begin(), order.end(),
+                            [&](auto a, auto b) {
+                                return points[a] == points[b];
+                            }),
+                order.end());
+    if (order.size() <= 2) {
+        return order;
+    }
+    std::vector<std::uint32_t> hull;
+    const auto chain = [&](auto first, auto last) {
+        const auto start = hull.size();
+        for (auto it = first; it != last; ++it) {
+            while (hull.size() >= start + 2 &&
+                   orient2d(points[hull[hull.size() - 2]],
+                            points[hull.back()], points[*it]) <= 0) {
+                hull.pop_back();
+            }
+            hull.push_back(*it);
+        }
+        hull.pop_back();
+    };
+    chain(order.begin(), order.end());
+    chain(order.rbegin(), order.rend());
+    return hull;
+}
+
+void check_hull(const std::vector<Vec2d> &points,
+                const std::vector<std::uint32_t> &hull) {
+    for (std::size_t i = 0; i < hull.size(); i++) {
+        const auto &a = points[hull[i]];
+        const auto &b = points[hull[(i + 1) % hull.size()]];
+        const auto &c = points[hull[(i + 2) % hull.size()]];
+        if (hull.size() >= 3) {
+            CHECK(orient2d(a, b, c) > 0);
+        }
+        for (const auto &p : points) {
+            CHECK(orient2d(a, b, p) >= 0);
+        }
+    }
+}
+
+void check_hull(const std::vector<Vec3d> &points, const ConvexHull3 &hull) {
+    // A closed, consistently oriented triangle mesh...
+    std::set<std::pair<std::uint32_t, std::uint32_t>> edges;
+    for (const auto &f : hull.faces) {
+        for (auto k = 0u; k < 3; k++) {
+            CHECK(edges.insert({f[k], f[(k + 1) % 3]}).second);
+        }
+    }
+    for (const auto &[a, b] : edges) {
+        CHECK(edges.count({b, a}) == 1);
+    }
+    CHECK_EQ(hull.vertices.size() + hull.faces.size() - edges.size() / 2,
+             2u);
+    // ...with every point inside or on every face.
+    for (const auto &f : hull.faces) {
+        for (const auto &p : points) {
+            CHECK(orient3d(points[f[0]], points[f[1]], points[f[2]], p) >= 0);
+        }
+    }
+}
+
+double volume(const std::vector<Vec3d> &points, const ConvexHull3 &hull) {
+    double total = 0;
+    for (const auto &f : hull.faces) {
+        const auto &a = points[f[0]];
+        const auto &b = points[f[1]];
+        const auto &c = points[f[2]];
+        total += a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                 a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                 a[2] * (b[0] * c[1] - b[1] * c[0]);
+    }
+    return total / 6;
+}
+
+} // namespace
+
+TEST_CASE("convex_hull 2D: random clouds match a sequential reference") {
+    std::mt19937 rng(5);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    ThreadPool single(1), pool(4);
+    for (const std::size_t n : {3u, 17u, 1000u, 200000u}) {
+        std::vector<Vec2d> gaussian(n), square(n), disk(n);
+        for (std::size_t i = 0; i < n; i++) {
+            gaussian[i] = Vec2d{normal(rng), normal(rng)};
+            square[i] = Vec2d{uniform(rng), uniform(rng)};
+            const auto angle = uniform(rng) * 3.14159265358979;
+            disk[i] = Vec2d{std::cos(angle), std::sin(angle)};
+        }
+        for (const auto *points : {&gaussian, &square, &disk}) {
+            const auto hull = convex_hull(*points, pool);
+            CHECK(hull == reference_hull(*points));
+            CHECK(hull == convex_hull(*points, single));
+            if (n <= 1000) {
+                check_hull(*points, hull);
+            }
+        }
+    }
+}
+
+TEST_CASE("convex_hull 2D: degenerate input") {
+    CHECK(convex_hull(std::vector<Vec2d>{}).empty());
+    CHECK(convex_hull(std::vector<Vec2d>{{1.0, 2.0}}) ==
+          std::vector<std::uint32_t>{0});
+    CHECK(convex_hull(std::vector<Vec2d>{{1.0, 2.0}, {1.0, 2.0}}) ==
+          std::vector<std::uint32_t>{0});
+    CHECK(convex_hull(std::vector<Vec2d>{{1.0, 2.0}, {0.0, 2.0}}) ==
+          std::vector<std::uint32_t>{1, 0});
+
+    // Collinear points, including ones a naive orientation test misjudges.
+    std::vector<Vec2d> line;
+    for (auto i = 0; i < 100; i++) {
+        line.push_back(Vec2d{0.1 * i, 0.3 * i});
+    }
+    CHECK(convex_hull(line) == reference_hull(line));
+
+    // A grid with duplicates: only the corners remain.
+    std::vector<Vec2d> grid;
+    for (auto copy = 0; copy < 2; copy++) {
+        for (auto x = 0; x < 40; x++) {
+            for (auto y = 0; y < 30; y++) {
+                grid.push_back(Vec2d{0.5 * x, 0.25 * y - 1.0});
+            }
+        }
+    }
+    const auto hull = convex_hull(grid);
+    REQUIRE(hull.size() == 4);
+    CHECK(grid[hull[0]] == Vec2d{0.0, -1.0});
+    CHECK(grid[hull[1]] == Vec2d{19.5, -1.0});
+    CHECK(grid[hull[2]] == Vec2d{19.5, 6.25});
+    CHECK(grid[hull[3]] == Vec2d{0.0, 6.25});
+    CHECK(hull == reference_hull(grid));
+    check_hull(grid, hull);
+}
+
+TEST_CASE("convex_hull 3D: random clouds") {
+    std::mt19937 rng(9);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    ThreadPool single(1), pool(4);
+    for (const std::size_t n : {4u, 50u, 2000u, 200000u}) {
+        std::vector<Vec3d> points(n);
+        for (auto &p : points) {
+            p = Vec3d{normal(rng), normal(rng), normal(rng)};
+        }
+        const auto hull = convex_hull(points, pool);
+        const auto again = convex_hull(points, single);
+        CHECK(hull.faces == again.faces);
+        CHECK(hull.vertices == again.vertices);
+        CHECK(hull.faces.size() == 2 * hull.vertices.size() - 4);
+        if (n <= 2000) {
+            check_hull(points, hull);
+        }
+        // The extreme point in any direction is a vertex.
+        for (auto k = 0; k < 20; k++) {
+            const Vec3d d{normal(rng), normal(rng), normal(rng)};
+            const auto best = std::max_element(
+                points.begin(), points.end(),
+                [&](const auto &a, const auto &b) {
+                    return a.dot(d) < b.dot(d);
+                });
+            CHECK(std::binary_search(
+                hull.vertices.begin(), hull.vertices.end(),
+                static_cast<std::uint32_t>(best - points.begin())));
+        }
+    }
+}
+
+TEST_CASE("convex_hull 3D: grids and degenerate input") {
+    std::vector<Vec3d> grid;
+    for (auto x = 0; x < 5; x++) {
+        for (auto y = 0; y < 6; y++) {
+            for (auto z = 0; z < 7; z++) {
+                grid.push_back(Vec3d{0.5 * x, 0.5 * y, 0.5 * z});
+            }
+        }
+    }
+    const auto hull = convex_hull(grid);
+    check_hull(grid, hull);
+    CHECK(volume(grid, hull) == 2.0 * 2.5 * 3.0);
+    for (const auto &corner : {Vec3d{0.0, 0.0, 0.0}, Vec3d{2.0, 2.5, 3.0},
+                               Vec3d{0.0, 2.5, 0.0}, Vec3d{2.0, 0.0, 3.0}}) {
+        CHECK(std::any_of(hull.vertices.begin(), hull.vertices.end(),
+                          [&](auto i) { return grid[i] == corner; }));
+    }
+
+    CHECK(convex_hull(std::vector<Vec3d>{}).faces.empty());
+    std::vector<Vec3d> plane;
+    for (auto i = 0; i < 50; i++) {
+        const auto x = double(i), y = double(i % 7);
+        plane.push_back(Vec3d{x, y, x + 2 * y});
+    }
+    CHECK(convex_hull(plane).faces.empty());
+    const std::vector<Vec3d> tetrahedron{
+        {0.0, 0.0, 0.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+    const auto simplex = convex_hull(tetrahedron);
+    CHECK(simplex.faces.size() == 4);
+    CHECK(simplex.vertices == std::vector<std::uint32_t>{0, 1, 2, 3});
+    check_hull(tetrahedron, simplex);
+}
@@ -0,0 +1,80 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "tests_common.hpp"
+#include <cstdlib>
+
+using namespace cml;
+
+TEST_CASE("ISA names round trip") {
+    for (const auto isa : all_isas) {
+        CHECK(parse_isa(isa_name(isa)) == isa);
+    }
+    CHECK(parse_isa("avx2") == Isa::avx2);
+    CHECK_FALSE(parse_isa("AVX2").has_value());
+    CHECK_FALSE(parse_isa("").has_value());
+}
+
+TEST_CASE("best_isa needs every feature of a level") {
+    CpuFeatures f;
+    CHECK(best_isa(f) == Isa::baseline);
+    f.sse42 = f.popcnt = true;
+    CHECK(best_isa(f) == Isa::sse42);
+    f.avx = f.avx2 = f.fma = true;
+    CHECK(best_isa(f) == Isa::sse42);
+    f.bmi2 = true;
+    CHECK(best_isa(f) == Isa::avx2);
+    f.avx512f = f.avx512dq = f.avx512bw = true;
+    CHECK(best_isa(f) == Isa::avx2);
+    f.avx512vl = true;
+    CHECK(best_isa(f) == Isa::avx512);
+}
+
+TEST_CASE("Detected features are consistent") {
+    const auto f = detect_cpu_features();
+    CHECK(best_isa(f) == supported_isa());
+    if (f.avx2) {
+        CHECK(f.avx);
+    }
+#if defined(__SSE4_2__)
+    CHECK(f.sse42);
+#endif
+#if defined(__AVX2__)
+    CHECK(f.avx2);
+#endif
+}
+
+TEST_CASE("CML_FORCE_ISA lowers the active ISA") {
+    // The test is also registered with CML_FORCE_ISA set.
+    auto expected = supported_isa();
+    if (const char *forced = std::getenv("CML_FORCE_ISA")) {
+        REQUIRE(parse_isa(forced).has_value());
+        expected = std::min(*parse_isa(forced), expected);
+    }
+    CHECK(active_isa() == expected);
+}
+
+TEST_CASE("set_active_isa is capped at the supported ISA") {
+    const IsaGuard guard;
+    CHECK(set_active_isa(Isa::baseline) == Isa::baseline);
+    CHECK(active_isa() == Isa::baseline);
+    CHECK(set_active_isa(Isa::avx512) == supported_isa());
+    CHECK(active_isa() == supported_isa());
+}
+
+TEST_CASE("run_with_isa runs the function on every supported ISA") {
+    for (const auto isa : all_isas) {
+        if (isa > supported_isa()) {
+            continue;
+        }
+        float sums[4] = {};
+        const float values[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        run_with_isa(isa, [&] {
+            for (auto i = 0u; i < 8; i++) {
+                sums[i % 4] += values[i] * 2;
+            }
+        });
+        CHECK(sums[0] == 12.f);
+        CHECK(sums[3] == 24.f);
+    }
+}
@@ -0,0 +1,178 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "curves.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+constexpr CubicBasis all_bases[] = {CubicBasis::bezier, CubicBasis::hermite,
+                                    CubicBasis::catmull_rom,
+                                    CubicBasis::bspline};
+
+const Vec3d g0{0.0, 0.0, 0.0};
+const Vec3d g1{1.0, 2.0, 0.5};
+const Vec3d g2{3.0, 2.0, -1.0};
+const Vec3d g3{4.0, 0.0, 2.0};
+
+} // namespace
+
+TEST_CASE("cubic segments interpolate where they should") {
+    check_close(bezier(g0, g1, g2, g3, 0.0), g0, 1e-15);
+    check_close(bezier(g0, g1, g2, g3, 1.0), g3, 1e-15);
+    check_close(catmull_rom(g0, g1, g2, g3, 0.0), g1, 1e-15);
+    check_close(catmull_rom(g0, g1, g2, g3, 1.0), g2, 1e-15);
+    check_close(hermite(g0, g1, g2, g3, 0.0), g0, 1e-15);
+    check_close(hermite(g0, g1, g2, g3, 1.0), g2, 1e-15);
+    // A B-spline starts at the weighted average (p0 + 4 p1 + p2) / 6.
+    check_close(bspline(g0, g1, g2, g3, 0.0), (g0 + g1 * 4.0 + g2) / 6.0,
+                1e-15);
+
+    // de Casteljau at t = 1/4.
+    const auto t = 0.25;
+    const auto a = lerp(lerp(g0, g1, t), lerp(g1, g2, t), t);
+    const auto b = lerp(lerp(g1, g2, t), lerp(g2, g3, t), t);
+    check_close(bezier(g0, g1, g2, g3, t), lerp(a, b, t), 1e-14);
+}
+
+TEST_CASE("curve weights sum to one") {
+    for (const auto basis : {CubicBasis::bezier, CubicBasis::catmull_rom,
+                             CubicBasis::bspline}) {
+        for (const auto t : {0.0, 0.3, 0.5, 1.0}) {
+            const auto w = detail::cubic_weights(basis, t);
+            CHECK(w[0] + w[1] + w[2] + w[3] == doctest::Approx(1));
+        }
+    }
+}
+
+TEST_CASE("CubicCurve matches the scalar form and its derivative") {
+    for (const auto basis : all_bases) {
+        const CubicCurve<double, 3> curve(basis, g0, g1, g2, g3);
+        for (const auto t : {0.0, 0.2, 0.7, 1.0}) {
+            check_close(curve(t), cubic(basis, g0, g1, g2, g3, t), 1e-14);
+            const auto h = 1e-6;
+            check_close(curve.derivative(t),
+                        (curve(t + h) - curve(t - h)) / (2 * h), 1e-7);
+        }
+    }
+    // Hermite tangents.
+    const CubicCurve<double, 3> curve(CubicBasis::hermite, g0, g1, g2, g3);
+    check_close(curve.derivative(0.0), g1, 1e-15);
+    check_close(curve.derivative(1.0), g3, 1e-15);
+}
+
+TEST_CASE_TEMPLATE("batched curve evaluation", T, float, double) {
+    const Vec<T, 2> p0{T(0), T(0)}, p1{T(1), T(3)}, p2{T(2), T(-1)},
+        p3{T(4), T(1)};
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<T> dist(T(0), T(1));
+    std::vector<T> t(1000);
+    for (auto &v : t) {
+        v = dist(rng);
+    }
+    const double epsilon = sizeof(T) == 4 ? 1e-5 : 1e-12;
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        for (const auto basis : all_bases) {
+            const CubicCurve<T, 2> curve(basis, p0, p1, p2, p3);
+            VecBatch<T, 2> soa;
+            std::vector<Vec<T, 2>> aos(t.size() - 3);
+            curve.evaluate(t, soa, pool);
+            curve.evaluate(std::span(t).first(aos.size()), std::span(aos),
+                           pool);
+            REQUIRE(soa.size() == t.size());
+            for (std::size_t i = 0; i < aos.size(); i++) {
+                check_close(soa[i], curve(t[i]), epsilon);
+                check_close(aos[i], curve(t[i]), epsilon);
+            }
+        }
+    });
+    const CubicCurve<T, 2> curve(CubicBasis::bezier, p0, p1, p2, p3);
+    std::vector<Vec<T, 2>> out(5);
+    CHECK_THROWS_AS(curve.evaluate(t, std::span(out)), std::invalid_argument);
+}
+
+TEST_CASE_TEMPLATE("forward differencing matches evaluation", T, float,
+                   double) {
+    const Vec3<T> p0{T(0), T(0), T(0)}, p1{T(1), T(2), T(0.5)},
+        p2{T(3), T(2), T(-1)}, p3{T(4), T(0), T(2)};
+    const CubicCurve<T, 3> curve(CubicBasis::catmull_rom, p0, p1, p2, p3);
+    // Several re-seeded runs, split over the pool, and a partial block.
+    const std::size_t count = 100'003;
+    const T first = T(-0.5), last = T(1.5);
+    const double epsilon = sizeof(T) == 4 ? 1e-4 : 1e-10;
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        VecBatch<T, 3> soa;
+        std::vector<Vec3<T>> aos(count);
+        curve.evaluate_uniform(first, last, count, soa, pool);
+        curve.evaluate_uniform(first, last, std::span(aos), pool);
+        REQUIRE(soa.size() == count);
+        for (std::size_t i = 0; i < count; i += 17) {
+            const auto t = first + (last - first) * T(i) / T(count - 1);
+            check_close(soa[i], curve(t), epsilon);
+            check_close(aos[i], curve(t), epsilon);
+        }
+        check_close(aos.back(), curve(last), epsilon);
+    });
+
+    std::vector<Vec3<T>> one(1);
+    curve.evaluate_uniform(T(0.5), T(1), std::span(one));
+    check_close(one[0], curve(T(0.5)), 1e-6);
+}
+
+TEST_CASE("arc length of a straight line") {
+    // Uneven control points: the speed along the line varies with t.
+    const CubicCurve<double, 3> line(CubicBasis::bezier, Vec3d{0, 0, 0},
+                                     Vec3d{0.1, 0, 0}, Vec3d{0.2, 0, 0},
+                                     Vec3d{3, 0, 0});
+    const ArcLengthTable<double> table(line, 512);
+    CHECK(table.segments() == 512);
+    CHECK(table.length() == doctest::Approx(3).epsilon(1e-12));
+    CHECK(table.parameter(-1) == 0);
+    CHECK(table.parameter(5) == 1);
+    for (const auto s : {0.25, 1.0, 2.9}) {
+        CHECK(line(table.parameter(s)).x() ==
+              doctest::Approx(s).epsilon(1e-4));
+    }
+
+    const auto t = table.uniform_parameters(31);
+    REQUIRE(t.size() == 31);
+    CHECK(t.front() == 0);
+    CHECK(t.back() == doctest::Approx(1));
+    std::vector<double> s(31), t2(31);
+    for (std::size_t k = 0; k < t.size(); k++) {
+        CHECK(line(t[k]).x() ==
+              doctest::Approx(0.1 * static_cast<double>(k)).epsilon(1e-4));
+        s[k] = 0.1 * static_cast<double>(k);
+    }
+    table.parameters(s, t2);
+    for (std::size_t k = 0; k < t.size(); k++) {
+        CHECK(t2[k] == doctest::Approx(t[k]).epsilon(1e-12));
+    }
+    CHECK_THROWS_AS(table.parameters(s, std::span(t2).first(3)),
+                    std::invalid_argument);
+}
+
+TEST_CASE("arc length of a quarter circle") {
+    // The usual Bezier approximation of a unit quarter circle.
+    const auto k = 4.0 / 3.0 * (std::sqrt(2.0) - 1.0);
+    const CubicCurve<double, 2> arc(CubicBasis::bezier, Vec2d{1, 0},
+                                    Vec2d{1, k}, Vec2d{k, 1}, Vec2d{0, 1});
+    const ArcLengthTable<double> table(arc);
+    CHECK(table.length() ==
+          doctest::Approx(std::numbers::pi / 2).epsilon(1e-4));
+    CHECK_THROWS_AS(ArcLengthTable<double>(arc, 0), std::invalid_argument);
+}
@@ -0,0 +1,235 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "convex_hull.hpp"
+#include "delaunay.hpp"
+#include "predicates.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <span>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+using Triangle = std::array<std::uint32_t, 3>;
+
+// The triangles, each rotated to start at its smallest index.
+std::set<Triangle> triangle_set(const DelaunayTriangulation &dt) {
+    std::set<Triangle> set;
+    const auto t = dt.triangles();
+    for (std::size_t i = 0; i < t.size(); i += 3) {
+        Triangle tri{t[i], t[i + 1], t[i + 2]};
+        std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()),
+                    tri.end());
+        set.insert(tri);
+    }
+    return set;
+}
+
+// Consistent adjacency, counterclockwise triangles, Euler's formula, and
+// (if empty_circles) no point strictly inside any circumcircle.
+void check_triangulation(const std::vector<Vec2d> &points,
+                         const DelaunayTriangulation &dt,
+                         bool empty_circles) {
+    const auto t = dt.triangles();
+    const auto h = dt.halfedges();
+    REQUIRE(t.size() == h.size());
+    std::set<std::uint32_t> vertices(t.begin(), t.end());
+    std::size_t hull_edges = 0;
+    for (std::uint32_t e = 0; e < h.size(); e++) {
+        if (h[e] == DelaunayTriangulation::none) {
+            hull_edges++;
+            continue;
+        }
+        CHECK(h[h[e]] == e);
+        CHECK(t[h[e]] == t[DelaunayTriangulation::next_halfedge(e)]);
+    }
+    CHECK(hull_edges == dt.hull().size());
+    // V - E + F = 1 for a triangulated disk.
+    CHECK(vertices.size() + dt.size() ==
+          1 + (t.size() + hull_edges) / 2);
+    for (std::size_t i = 0; i < t.size(); i += 3) {
+        const auto &a = points[t[i]];
+        const auto &b = points[t[i + 1]];
+        const auto &c = points[t[i + 2]];
+        CHECK(orient2d(a, b, c) > 0);
+        if (empty_circles) {
+            for (const auto &p : points) {
+                CHECK(incircle(a, b, c, p) <= 0);
+            }
+        }
+    }
+}
+
+// The hull without the points inside its edges.
+std::vector<std::uint32_t> strict_hull(const std::vector<Vec2d> &points,
+                                       std::span<const std::uint32_t> hull) {
+    std::vector<std::uint32_t> strict;
+    for (std::size_t i = 0; i < hull.size(); i++) {
+        const auto prev = hull[(i + hull.size() - 1) % hull.size()];
+        const auto next = hull[(i + 1) % hull.size()];
+        if (orient2d(points[prev], points[hull[i]], points[next]) != 0) {
+            strict.push_back(hull[i]);
+        }
+    }
+    return strict;
+}
+
+} // namespace
+
+TEST_CASE("Delaunay: random points") {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    ThreadPool single(1), pool(4);
+    for (const std::size_t n : {3u, 10u, 300u, 20000u}) {
+        std::vector<Vec2d> points(n);
+        for (auto &p : points) {
+            p = Vec2d{normal(rng), normal(rng)};
+        }
+        const DelaunayTriangulation dt(points, {}, single);
+        check_triangulation(points, dt, n <= 300);
+        CHECK(dt.size() == 2 * n - 2 - dt.hull().size());
+        CHECK(std::vector<std::uint32_t>(dt.hull().begin(),
+                                         dt.hull().end()) ==
+              convex_hull(points));
+        CHECK(triangle_set(dt) ==
+              triangle_set(DelaunayTriangulation(points, {}, pool)));
+        for (const auto partitions : {2u, 4u, 7u}) {
+            const DelaunayTriangulation strips(points, {partitions}, pool);
+            check_triangulation(points, strips, false);
+            CHECK(triangle_set(strips) == triangle_set(dt));
+        }
+        // Without falling back to one strip.
+        if (n >= 4 * detail::delaunay_min_strip) {
+            std::vector<std::uint32_t> triangles, halfedges;
+            CHECK(detail::triangulate_partitioned(
+                std::span<const Vec2d>(points), 4, pool, triangles,
+                halfedges));
+        }
+    }
+}
+
+TEST_CASE("Delaunay: grids, duplicates and collinear points") {
+    // Every 2x2 cell is cocircular; the perturbation picks one diagonal.
+    std::vector<Vec2d> grid;
+    for (auto copy = 0; copy < 2; copy++) {
+        for (auto x = 0; x < 40; x++) {
+            for (auto y = 0; y < 30; y++) {
+                grid.push_back(Vec2d{0.5 * x, 0.25 * y - 1.0});
+            }
+        }
+    }
+    const DelaunayTriangulation dt(grid);
+    check_triangulation(grid, dt, true);
+    CHECK(dt.size() == 2 * 39 * 29);
+    const auto used = dt.triangles();
+    CHECK(*std::max_element(used.begin(), used.end()) < 40 * 30);
+    CHECK(dt.hull().size() == 2 * (39 + 29));
+    CHECK(strict_hull(grid, dt.hull()) == convex_hull(grid));
+    for (const auto partitions : {2u, 3u}) {
+        CHECK(triangle_set(DelaunayTriangulation(grid, {partitions})) ==
+              triangle_set(dt));
+    }
+
+    // Points on a circle, where every triangle is degenerate.
+    std::vector<Vec2d> circle;
+    for (auto i = 0; i < 64; i++) {
+        const auto angle = 2 * 3.14159265358979 * i / 64;
+        circle.push_back(Vec2d{std::round(std::cos(angle) * 1e6),
+                               std::round(std::sin(angle) * 1e6)});
+    }
+    const DelaunayTriangulation ring(circle);
+    check_triangulation(circle, ring, true);
+
+    CHECK(DelaunayTriangulation(std::vector<Vec2d>{}).size() == 0);
+    std::vector<Vec2d> line;
+    for (auto i = 0; i < 100; i++) {
+        line.push_back(Vec2d{0.5 * i, 0.25 * i - 3.0});
+    }
+    CHECK(DelaunayTriangulation(line).size() == 0);
+    line.push_back(Vec2d{0.0, 1.0});
+    const DelaunayTriangulation fan(line);
+    check_triangulation(line, fan, true);
+    CHECK(fan.size() == 99);
+}
+
+TEST_CASE("Delaunay: a strip of collinear points") {
+    // The first strip triangulates to nothing on its own; its points must
+    // still reach the stitched part.
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> x(1.0, 2.0), y(0.0, 999.0);
+    std::vector<Vec2d> points;
+    for (auto i = 0; i < 1000; i++) {
+        points.push_back(Vec2d{0.0, double(i)});
+    }
+    for (auto i = 0; i < 2000; i++) {
+        points.push_back(Vec2d{x(rng), y(rng)});
+    }
+    ThreadPool pool(3);
+    const DelaunayTriangulation dt(points, {}, pool);
+    const DelaunayTriangulation strips(points, {3}, pool);
+    check_triangulation(points, strips, false);
+    CHECK(strips.size() == dt.size());
+    const auto t = strips.triangles();
+    CHECK(std::set<std::uint32_t>(t.begin(), t.end()).size() ==
+          points.size());
+    CHECK(triangle_set(strips) == triangle_set(dt));
+
+    std::vector<std::uint32_t> triangles, halfedges;
+    CHECK(detail::triangulate_partitioned(std::span<const Vec2d>(points), 3,
+                                          pool, triangles, halfedges));
+}
+
+TEST_CASE("Voronoi: cells of a Delaunay triangulation") {
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<Vec2d> points(2000);
+    for (auto &p : points) {
+        p = Vec2d{uniform(rng), uniform(rng)};
+    }
+    points.push_back(points[5]);
+    const DelaunayTriangulation dt(points);
+    const auto voronoi = voronoi_diagram(points, dt);
+    REQUIRE(voronoi.offsets.size() == points.size() + 1);
+    CHECK(voronoi.vertices.size() == dt.size());
+    CHECK(voronoi.cells.size() == 3 * dt.size());
+    CHECK(voronoi.offsets.back() == voronoi.cells.size());
+    CHECK(voronoi.offsets[points.size()] == voronoi.offsets[points.size() - 1]);
+
+    const std::set<std::uint32_t> hull(dt.hull().begin(), dt.hull().end());
+    for (std::uint32_t i = 0; i + 1 < points.size(); i++) {
+        CHECK(voronoi.unbounded[i] == hull.count(i));
+        const auto first = voronoi.offsets[i], last = voronoi.offsets[i + 1];
+        REQUIRE(last - first >= 2);
+        // Every vertex is equidistant from the point and the other
+        // vertices of its triangle...
+        for (auto k = first; k < last; k++) {
+            const auto t = voronoi.cells[k];
+            const auto &v = voronoi.vertices[t];
+            CHECK(std::count(&dt.triangles()[3 * t],
+                             &dt.triangles()[3 * t] + 3, i) == 1);
+            for (auto j = 0u; j < 3; j++) {
+                const auto &q = points[dt.triangles()[3 * t + j]];
+                CHECK((q - v).length() ==
+                      doctest::Approx((points[i] - v).length()));
+            }
+        }
+        // ...and bounded cells are convex, counterclockwise, around it.
+        if (!voronoi.unbounded[i]) {
+            for (auto k = first; k < last; k++) {
+                const auto &a = voronoi.vertices[voronoi.cells[k]];
+                const auto &b = voronoi.vertices
+                    [voronoi.cells[k + 1 < last ? k + 1 : first]];
+                CHECK(orient2d(a, b, points[i]) > 0);
+            }
+        }
+    }
+}
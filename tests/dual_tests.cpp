@@ -0,0 +1,181 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "dual.hpp"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "units.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <sstream>
+
+using namespace cml;
+
+namespace {
+
+using D1 = Dual<double, 1>;
+using D3 = Dual<double, 3>;
+using D4 = Dual<double, 4>;
+
+// Central differences of f, one column per variable of x.
+template <unsigned int M, unsigned int N, typename F>
+Matrix<M, N, double> finite_differences(F f, const Vec<double, N> &x) {
+    const double h = 1e-6;
+    Matrix<M, N, double> j;
+    for (auto k = 0u; k < N; k++) {
+        auto forward = x, backward = x;
+        forward[k] += h;
+        backward[k] -= h;
+        const auto difference = (f(forward) - f(backward)) / (2 * h);
+        for (auto i = 0u; i < M; i++) {
+            j.get(i, k) = difference[i];
+        }
+    }
+    return j;
+}
+
+// A camera pipeline: project `point` seen from `eye`, a Vec of either
+// doubles or duals.
+template <typename V> V project(const V &eye) {
+    using T = std::remove_cvref_t<decltype(eye[0])>;
+    const auto view = lookAt(eye, V{T(0), T(0.5), T(0)}, V{T(0), T(1), T(0)});
+    const auto projection = perspective(T(radians(60.0)), T(1.5), T(0.1),
+                                        T(100.0));
+    const auto clip = projection * view.transposed() *
+                      Vec<T, 4>{T(0.3), T(-0.2), T(1.1), T(1)};
+    return V{clip[0] / clip[3], clip[1] / clip[3], clip[2] / clip[3]};
+}
+
+} // namespace
+
+TEST_CASE("Dual: arithmetic and math functions") {
+    const auto x = D1::variable(0.7, 0);
+    const auto derivative = [](const D1 &y) { return y.derivative(0); };
+    CHECK(derivative(x * x * x) == doctest::Approx(3 * 0.49));
+    CHECK(derivative(1 / x) == doctest::Approx(-1 / 0.49));
+    CHECK(derivative((x + 1) / (x - 2)) ==
+          doctest::Approx(-3 / (1.3 * 1.3)));
+    CHECK(derivative(2 - 3 * x) == -3);
+    CHECK(derivative(-x / 2) == -0.5);
+    CHECK(derivative(sqrt(x)) == doctest::Approx(0.5 / std::sqrt(0.7)));
+    CHECK(derivative(exp(x)) == doctest::Approx(std::exp(0.7)));
+    CHECK(derivative(log(x)) == doctest::Approx(1 / 0.7));
+    CHECK(derivative(pow(x, 2.5)) ==
+          doctest::Approx(2.5 * std::pow(0.7, 1.5)));
+    CHECK(derivative(sin(x)) == doctest::Approx(std::cos(0.7)));
+    CHECK(derivative(cos(x)) == doctest::Approx(-std::sin(0.7)));
+    CHECK(derivative(tan(x)) ==
+          doctest::Approx(1 / (std::cos(0.7) * std::cos(0.7))));
+    CHECK(derivative(asin(x)) == doctest::Approx(1 / std::sqrt(1 - 0.49)));
+    CHECK(derivative(acos(x)) == doctest::Approx(-1 / std::sqrt(1 - 0.49)));
+    CHECK(derivative(atan(x)) == doctest::Approx(1 / 1.49));
+    CHECK(derivative(abs(-x)) == 1);
+    CHECK(derivative(atan2(x, D1(2.0))) == doctest::Approx(2 / 4.49));
+    CHECK(derivative(atan2(D1(2.0), x)) == doctest::Approx(-2 / 4.49));
+    CHECK((sin(x) * sin(x) + cos(x) * cos(x)).value() == doctest::Approx(1));
+
+    // Comparisons look at the value only.
+    CHECK(x == 0.7);
+    CHECK(x == D1(0.7));
+    CHECK(x < 1);
+    CHECK(0 < x);
+    CHECK_FALSE(x > x);
+
+    std::ostringstream out;
+    out << D3(2.0, {1.0, 0.0, 3.0});
+    CHECK(out.str() == "2{1 0 3}");
+}
+
+TEST_CASE("Dual: Vec Jacobians from one evaluation") {
+    const Vec3d x{0.3, -1.2, 2.0};
+    const Vec3d a{1.0, 2.0, -0.5};
+
+    // Linear maps: the Jacobian of m * x is m.
+    const Mat3d m{2.0, -1.0, 0.5, 0.0, 3.0, 1.0, 4.0, 0.25, -2.0};
+    const auto mx = jacobian(
+        [&](const auto &v) {
+            Matrix<3, 3, D3> md;
+            for (auto i = 0u; i < 3; i++) {
+                for (auto j = 0u; j < 3; j++) {
+                    md.get(i, j) = m.get(i, j);
+                }
+            }
+            return md * v;
+        },
+        x);
+    check_close(mx, m, 1e-6);
+
+    // Nonlinear: the normalized cross product, against finite differences.
+    const auto f = [&](const auto &v) {
+        using T = std::remove_cvref_t<decltype(v[0])>;
+        const Vec3<T> c{T(a[0]), T(a[1]), T(a[2])};
+        return (v.cross(c) + v * v.dot(c) - T(2) * v).normalized();
+    };
+    const auto j = jacobian(f, x);
+    check_close(j, finite_differences<3>(f, x), 1e-6);
+    const auto value = values(f(variables(x)));
+    for (auto i = 0u; i < 3; i++) {
+        CHECK(value[i] == doctest::Approx(f(x)[i]));
+    }
+
+    // d|x| / dx = x / |x|, and lerp is linear in its endpoints.
+    const auto length = variables(x).length();
+    for (auto i = 0u; i < 3; i++) {
+        CHECK(length.derivative(i) == doctest::Approx(x[i] / x.length()));
+    }
+    const auto mid = lerp(variables(x), Vec3<D3>{}, D3(0.25));
+    check_close(jacobian(mid), Mat3d::identity() * 0.75, 1e-6);
+    CHECK(derivatives(-variables(x), 1) == Vec3d{0.0, -1.0, 0.0});
+}
+
+TEST_CASE("Dual: transform builders") {
+    // rotate() with respect to the angle and the axis.
+    const double angle = 0.8;
+    const Vec3d axis = Vec3d{1.0, 2.0, 2.0}.normalized();
+    const Vec<double, 4> p{0.5, -1.0, 2.0, 1.0};
+    const auto rotated = [&](const Vec<double, 4> &q) {
+        return rotate(Mat4d::identity(), q[0], Vec3d{q[1], q[2], q[3]}) * p;
+    };
+    const Vec<double, 4> q{angle, axis[0], axis[1], axis[2]};
+    Vec<D4, 4> pd;
+    for (auto i = 0u; i < 4; i++) {
+        pd[i] = p[i];
+    }
+    const auto rotation =
+        rotate(Mat4<D4>::identity(), D4::variable(angle, 0),
+               Vec3<D4>{D4::variable(axis[0], 1), D4::variable(axis[1], 2),
+                        D4::variable(axis[2], 3)});
+    CHECK(is_affine(rotation));
+    check_close(values(rotation), rotate(Mat4d::identity(), angle, axis),
+                1e-6);
+    check_close(jacobian(rotation * pd), finite_differences<4>(rotated, q),
+                1e-6);
+    // The angle derivative of a rotation about a unit axis is the axis cross
+    // product after it.
+    const auto d_angle = derivatives(rotation, 0);
+    const auto turned = values(rotation * pd);
+    const Vec3d ax = axis.cross(Vec3d{turned[0], turned[1], turned[2]});
+    for (auto i = 0u; i < 3; i++) {
+        CHECK((d_angle * p)[i] == doctest::Approx(ax[i]));
+    }
+
+    // translate() moves by exactly the translation.
+    const auto moved =
+        translate(Mat4<D3>::identity(), variables(Vec3d{1.0, 2.0, 3.0}));
+    for (auto i = 0u; i < 3; i++) {
+        CHECK(moved.get(i, 3).derivative(i) == 1);
+    }
+
+    // lookAt() and perspective() through a whole projection.
+    const Vec3d eye{2.0, 1.5, 4.0};
+    const auto projected = [](const auto &e) { return project(e); };
+    check_close(jacobian(projected, eye),
+                finite_differences<3>(projected, eye), 1e-6);
+    const auto fovy = D1::variable(1.0, 0);
+    const auto f = perspective(fovy, D1(1.0), D1(0.1), D1(10.0)).get(1, 1);
+    CHECK(f.value() == doctest::Approx(1 / std::tan(0.5)));
+    CHECK(f.derivative(0) ==
+          doctest::Approx(-0.5 / (std::sin(0.5) * std::sin(0.5))));
+    CHECK(radians(D1::variable(180.0, 0)).derivative(0) ==
+          doctest::Approx(3.14159265358979 / 180));
+}
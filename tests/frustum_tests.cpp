@@ -0,0 +1,133 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aabb.hpp"
+#include "doctest/doctest.h"
+#include "frustum.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+// Camera at (0, 0, 5) looking down -z with a 90 degree vertical field of
+// view, so the frustum at depth d spans [-d, d] in x and y.
+Frustum<float> test_frustum() {
+    const auto view = lookAt(Vec3f(0.f, 0.f, 5.f), Vec3f(0.f, 0.f, 0.f),
+                             Vec3f(0.f, 1.f, 0.f));
+    const auto projection =
+        perspective(static_cast<float>(M_PI / 2), 1.f, 1.f, 100.f);
+    return Frustum<float>(view * projection);
+}
+
+bool bit(const std::vector<std::uint64_t> &mask, std::size_t i) {
+    return (mask[i / 64] >> (i % 64)) & 1;
+}
+
+} // namespace
+
+TEST_CASE("Frustum planes from lookAt and perspective") {
+    const auto frustum = test_frustum();
+    for (const auto &plane : frustum.planes()) {
+        CHECK(static_cast<float>(plane.normal.length()) ==
+              doctest::Approx(1.f));
+    }
+    // The near plane is 1 in front of the eye at z = 4, the far one at -95.
+    CHECK(frustum.plane(Frustum<float>::near).distance(Vec3f(0.f, 0.f, 3.f)) ==
+          doctest::Approx(1.f));
+    CHECK(frustum.plane(Frustum<float>::far).distance(Vec3f(0.f, 0.f, 0.f)) ==
+          doctest::Approx(95.f));
+
+    CHECK(frustum.contains(Vec3f(0.f, 0.f, 0.f)));
+    CHECK(frustum.contains(Vec3f(4.9f, -4.9f, 0.f)));
+    CHECK_FALSE(frustum.contains(Vec3f(5.1f, 0.f, 0.f)));
+    CHECK_FALSE(frustum.contains(Vec3f(0.f, -5.1f, 0.f)));
+    CHECK_FALSE(frustum.contains(Vec3f(0.f, 0.f, 4.5f)));
+    CHECK_FALSE(frustum.contains(Vec3f(0.f, 0.f, 10.f)));
+    CHECK_FALSE(frustum.contains(Vec3f(0.f, 0.f, -96.f)));
+
+    CHECK(frustum.intersects_sphere(Vec3f(6.f, 0.f, 0.f), 1.f));
+    CHECK_FALSE(frustum.intersects_sphere(Vec3f(7.f, 0.f, 0.f), 1.f));
+    CHECK(frustum.intersects(
+        Aabbf(Vec3f(5.5f, 0.f, -1.f), Vec3f(6.f, 1.f, 1.f))));
+    CHECK_FALSE(frustum.intersects(
+        Aabbf(Vec3f(5.5f, 0.f, 0.f), Vec3f(6.f, 1.f, 0.2f))));
+}
+
+TEST_CASE("Batched culling matches the scalar tests") {
+    const auto frustum = test_frustum();
+    const std::size_t count = 100'003;
+    std::vector<Vec3f> centers(count);
+    std::vector<Vec3f> sizes(count);
+    fill_uniform_box(std::span<Vec3f>(centers), Vec3f(-60.f, -60.f, -100.f),
+                     Vec3f(60.f, 60.f, 10.f), 1);
+    fill_uniform_box(std::span<Vec3f>(sizes), Vec3f(0.f, 0.f, 0.f),
+                     Vec3f(3.f, 3.f, 3.f), 2);
+    std::vector<float> radii(count);
+    std::vector<Vec3f> mins(count);
+    std::vector<Vec3f> maxs(count);
+    for (auto i = 0u; i < count; i++) {
+        radii[i] = sizes[i].x();
+        mins[i] = centers[i] - sizes[i];
+        maxs[i] = centers[i] + sizes[i];
+    }
+    const VecBatch<float, 3> center_batch(centers);
+    const VecBatch<float, 3> min_batch(mins);
+    const VecBatch<float, 3> max_batch(maxs);
+
+    ThreadPool pool(4);
+    std::vector<std::uint64_t> spheres(visibility_words(count));
+    std::vector<std::uint64_t> boxes(visibility_words(count));
+    cull_spheres(frustum, center_batch, std::span<const float>(radii),
+                 std::span<std::uint64_t>(spheres), pool);
+    cull_aabbs(frustum, min_batch, max_batch,
+               std::span<std::uint64_t>(boxes), pool);
+
+    std::size_t visible = 0;
+    std::vector<std::uint32_t> expected;
+    for (auto i = 0u; i < count; i++) {
+        const auto sphere = frustum.intersects_sphere(centers[i], radii[i]);
+        CHECK(bit(spheres, i) == sphere);
+        CHECK(bit(boxes, i) == frustum.intersects(Aabbf(mins[i], maxs[i])));
+        visible += sphere;
+        if (sphere) {
+            expected.push_back(i);
+        }
+    }
+    CHECK(visible > 0);
+    CHECK(visible < count);
+
+    std::vector<std::uint32_t> indices;
+    compact_visible(std::span<const std::uint64_t>(spheres), count, indices,
+                    pool);
+    CHECK(indices == expected);
+
+    // Bits past `count` are ignored.
+    std::vector<std::uint64_t> full{~std::uint64_t(0)};
+    compact_visible(std::span<const std::uint64_t>(full), 3, indices);
+    CHECK(indices == std::vector<std::uint32_t>{0, 1, 2});
+
+    // Short radii, boxes or masks throw instead of reading past the end.
+    const std::span<std::uint64_t> short_mask(spheres.data(),
+                                              spheres.size() - 1);
+    CHECK_THROWS_AS(cull_spheres(frustum, center_batch,
+                                 std::span<const float>(radii).first(3),
+                                 std::span<std::uint64_t>(spheres)),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(cull_spheres(frustum, center_batch,
+                                 std::span<const float>(radii), short_mask),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(cull_aabbs(frustum, min_batch, VecBatch<float, 3>(3),
+                               std::span<std::uint64_t>(boxes)),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(compact_visible(std::span<const std::uint64_t>(full), 65,
+                                    indices),
+                    std::invalid_argument);
+}
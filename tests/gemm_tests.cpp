@@ -0,0 +1,128 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+
+using namespace cml;
+
+namespace {
+
+template <typename T>
+DynamicMatrix<T> naive_product(const DynamicMatrix<T> &a,
+                               const DynamicMatrix<T> &b) {
+    DynamicMatrix<T> c(a.rows(), b.cols());
+    for (std::size_t i = 0; i < a.rows(); i++) {
+        for (std::size_t j = 0; j < b.cols(); j++) {
+            long double sum = 0;
+            for (std::size_t p = 0; p < a.cols(); p++) {
+                sum += (long double)a.get(i, p) * b.get(p, j);
+            }
+            c.get(i, j) = T(sum);
+        }
+    }
+    return c;
+}
+
+} // namespace
+
+TEST_CASE("DynamicMatrix basics") {
+    DynamicMatrixd m(2, 3, {1, 2, 3, 4, 5, 6});
+    CHECK(m.rows() == 2);
+    CHECK(m.cols() == 3);
+    CHECK(m.size() == 6);
+    CHECK_FALSE(m.is_square());
+    CHECK(m.get(1, 0) == 4);
+    CHECK(m[0][2] == 3);
+
+    const auto t = m.transposed();
+    CHECK(t.rows() == 3);
+    CHECK(t.get(2, 1) == 6);
+    CHECK(t.transposed() == m);
+
+    CHECK((m + m) == m * 2.0);
+    CHECK((m - m) == DynamicMatrixd(2, 3));
+    CHECK_THROWS_AS(m += t, std::invalid_argument);
+
+    CHECK(DynamicMatrixd::identity(3).get(1, 1) == 1);
+    CHECK(DynamicMatrixd::identity(3).get(1, 2) == 0);
+}
+
+TEST_CASE("DynamicMatrix converts to and from Matrix") {
+    Matrix<2, 3, double> fixed{1, 2, 3, 4, 5, 6};
+    const DynamicMatrixd m(fixed);
+    CHECK(m == DynamicMatrixd(2, 3, {1, 2, 3, 4, 5, 6}));
+    CHECK(DynamicMatrixd(m.to_matrix<2, 3>()) == m);
+    CHECK_THROWS_AS((m.to_matrix<3, 2>()), std::invalid_argument);
+
+    const auto block = DynamicMatrixd(m.view().block(0, 1, 2, 2));
+    CHECK(block == DynamicMatrixd(2, 2, {2, 3, 5, 6}));
+}
+
+TEST_CASE_TEMPLATE("gemm matches the naive product", T, float, double) {
+    const double epsilon = sizeof(T) == 4 ? 1e-4 : 1e-12;
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        for (const auto [m, k, n] :
+             {std::array<std::size_t, 3>{1, 1, 1}, {5, 7, 3}, {37, 300, 61},
+              {130, 17, 129}, {200, 260, 35}}) {
+            const auto a = random_matrix<T>(m, k, 1);
+            const auto b = random_matrix<T>(k, n, 2);
+            DynamicMatrix<T> c(m, n);
+            gemm<T>(a, b, c, pool);
+            check_close(c, naive_product(a, b), epsilon);
+        }
+    });
+}
+
+TEST_CASE("gemm applies alpha and beta") {
+    const auto a = random_matrix<double>(20, 30, 3);
+    const auto b = random_matrix<double>(30, 25, 4);
+    const auto c0 = random_matrix<double>(20, 25, 5);
+    const auto ab = naive_product(a, b);
+
+    auto c = c0;
+    gemm(2.0, a, b, -0.5, c.view());
+    check_close(c, ab * 2.0 + c0 * -0.5, 1e-12);
+
+    c = c0;
+    gemm(0.0, a, b, 3.0, c.view());
+    check_close(c, c0 * 3.0, 1e-12);
+
+    // beta == 0 ignores whatever C holds.
+    c = c0;
+    c.get(0, 0) = std::numeric_limits<double>::quiet_NaN();
+    gemm<double>(a, b, c);
+    check_close(c, ab, 1e-12);
+}
+
+TEST_CASE("gemm writes into blocks of a larger matrix") {
+    const auto a = random_matrix<double>(9, 11, 6);
+    const auto b = random_matrix<double>(11, 13, 7);
+    DynamicMatrixd big(20, 20);
+    gemm<double>(a, b, big.view().block(3, 4, 9, 13));
+    check_close(DynamicMatrixd(big.view().block(3, 4, 9, 13)),
+                naive_product(a, b), 1e-12);
+    CHECK(big.get(2, 4) == 0);
+    CHECK(big.get(3, 3) == 0);
+    CHECK(big.get(12, 4) == 0);
+}
+
+TEST_CASE("gemm rejects mismatched shapes") {
+    DynamicMatrixd a(3, 4), b(5, 2), c(3, 2);
+    CHECK_THROWS_AS(gemm<double>(a, b, c), std::invalid_argument);
+    CHECK_THROWS_AS(a * b, std::invalid_argument);
+}
+
+TEST_CASE("DynamicMatrix product") {
+    const DynamicMatrixd a(2, 2, {1, 2, 3, 4});
+    const DynamicMatrixd b(2, 2, {5, 6, 7, 8});
+    CHECK(a * b == DynamicMatrixd(2, 2, {19, 22, 43, 50}));
+    CHECK(a * DynamicMatrixd::identity(2) == a);
+}
@@ -0,0 +1,127 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "instrumentation.hpp"
+#include "matrix.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace cml;
+using namespace cml::instrumentation;
+
+static_assert(enabled);
+
+TEST_CASE("Matrix operations are counted with their shape and type") {
+    reset();
+    const auto a = Mat4d::identity();
+    const auto b = Mat4d::identity();
+    auto c = a * b;
+    c = c * b;
+    c += a;
+    const auto t = Matrix<2, 3, float>().transposed();
+    (void)t;
+
+    const auto s = snapshot();
+    CHECK(s.find({Op::matrix_multiply, 4, 4, "double"}) ==
+          OpCounters{2, 2 * 128, 2 * 48 * sizeof(double)});
+    CHECK(s.find({Op::matrix_add, 4, 4, "double"}) ==
+          OpCounters{1, 16, 48 * sizeof(double)});
+    CHECK(s.find({Op::matrix_transpose, 2, 3, "float"}) ==
+          OpCounters{1, 0, 12 * sizeof(float)});
+    CHECK(s.find({Op::matrix_multiply, 4, 4, "float"}) == OpCounters{});
+    CHECK(s.total().calls == 4);
+}
+
+TEST_CASE("Vec operations count only their own arithmetic") {
+    reset();
+    const Vec3d a(1., 2., 3.);
+    const Vec3d b(4., 5., 6.);
+    const auto sum = a + b;
+    CHECK(sum.dot(a) == doctest::Approx(46.));
+    const auto n = b.normalized();
+    (void)n;
+
+    const auto s = snapshot();
+    CHECK(s.find({Op::vec_add, 3, 1, "double"}).flops == 3);
+    CHECK(s.find({Op::vec_dot, 3, 1, "double"}).flops == 6);
+    CHECK(s.find({Op::vec_normalize, 3, 1, "double"}).flops == 3);
+    CHECK(s.find({Op::vec_length, 3, 1, "double"}).calls == 1);
+    CHECK(s.find({Op::vec_length_sq, 3, 1, "double"}).calls == 1);
+}
+
+TEST_CASE("Builders count themselves and the products they use") {
+    reset();
+    const auto m = rotate(Mat4f::identity(), 0.5f, Vec3f(0.f, 0.f, 1.f));
+    const auto p = m * Vec<float, 4>{1.f, 0.f, 0.f, 1.f};
+    (void)p;
+
+    const auto s = snapshot();
+    CHECK(s.find({Op::rotate, 4, 4, "float"}).calls == 1);
+    CHECK(s.find({Op::matrix_vector_multiply, 4, 4, "float"}) ==
+          OpCounters{1, 0, 0});
+    // rotate()'s own product and the Mat4 * column of the Vec product.
+    CHECK(s.find({Op::matrix_multiply, 4, 4, "float"}).calls == 2);
+}
+
+TEST_CASE("Constant evaluation is not counted") {
+    reset();
+    constexpr auto d = Vec3i(1, 2, 3).dot(Vec3i(1, 1, 1));
+    static_assert(d == 6);
+    CHECK(snapshot().empty());
+}
+
+TEST_CASE("Sites past the counter capacity are rejected") {
+    detail::Registry registry;
+    const OpKey full{Op::matrix_multiply, 1, 1, "float"};
+    registry.sites.assign(detail::ThreadCounters::max_sites, full);
+    CHECK(registry.register_site(full) == 0);
+    CHECK_THROWS_AS(
+        registry.register_site({Op::matrix_multiply, 2, 2, "float"}),
+        std::length_error);
+}
+
+TEST_CASE("Counters are per thread and survive thread exit") {
+    reset();
+    const auto work = [](unsigned int n) {
+        auto v = Vec2f(1.f, 1.f);
+        for (auto i = 0u; i < n; i++) {
+            v += Vec2f(1.f, 0.f);
+        }
+        return v;
+    };
+    Snapshot worker;
+    std::thread thread([&] {
+        work(5);
+        worker = thread_snapshot();
+    });
+    thread.join();
+    work(3);
+
+    const OpKey key{Op::vec_add, 2, 1, "float"};
+    CHECK(worker.find(key).calls == 5);
+    CHECK(thread_snapshot().find(key).calls == 3);
+    CHECK(snapshot().find(key).calls == 8);
+
+    auto merged = thread_snapshot();
+    merged.merge(worker);
+    CHECK(merged.records().size() == 1);
+    CHECK(merged.find(key) == snapshot().find(key));
+
+    reset();
+    CHECK(snapshot().empty());
+    CHECK(thread_snapshot().empty());
+}
+
+TEST_CASE("Snapshot is dumped as JSON") {
+    reset();
+    const auto v = Vec3d(1., 2., 3.) * 2.;
+    (void)v;
+    const auto json = snapshot().to_json();
+    CHECK(json.find("\"op\": \"vec_scale\"") != std::string::npos);
+    CHECK(json.find("\"rows\": 3, \"cols\": 1, \"type\": \"double\"") !=
+          std::string::npos);
+    CHECK(json.find("\"total\": {\"calls\": 1, \"flops\": 3, \"bytes\": 48}") !=
+          std::string::npos);
+}
@@ -0,0 +1,206 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "kd_tree.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <unsigned int Dim>
+std::vector<Vec<double, Dim>> random_points(std::size_t count,
+                                            std::uint64_t seed) {
+    Vec<double, Dim> lo;
+    Vec<double, Dim> hi;
+    for (auto d = 0u; d < Dim; d++) {
+        hi[d] = 10.0;
+    }
+    std::vector<Vec<double, Dim>> points(count);
+    fill_uniform_box(std::span<Vec<double, Dim>>(points), lo, hi, seed);
+    return points;
+}
+
+template <unsigned int Dim>
+std::vector<KdNeighbor<double>>
+brute_force(const std::vector<Vec<double, Dim>> &points,
+            const Vec<double, Dim> &q) {
+    std::vector<KdNeighbor<double>> all;
+    for (auto i = 0u; i < points.size(); i++) {
+        const auto d = points[i] - q;
+        all.push_back({i, d.dot(d)});
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+}
+
+} // namespace
+
+TEST_CASE("KdTree on empty and tiny inputs") {
+    KdTree<double, 3> empty;
+    CHECK(empty.empty());
+    CHECK(empty.knn(Vec3d(0., 0., 0.), 3).empty());
+    CHECK(empty.radius_search(Vec3d(0., 0., 0.), 1.).empty());
+
+    const std::vector<Vec3d> points{{0., 0., 0.}, {1., 0., 0.}, {0., 2., 0.}};
+    const KdTree<double, 3> tree{std::span<const Vec3d>(points)};
+    CHECK(tree.size() == 3);
+    const auto found = tree.knn(Vec3d(0.9, 0., 0.), 5);
+    REQUIRE(found.size() == 3);
+    CHECK(found[0].index == 1);
+    CHECK(found[1].index == 0);
+    CHECK(found[2].index == 2);
+    CHECK(found[0].distance_sq == doctest::Approx(0.01));
+    CHECK(tree.knn(Vec3d(0., 0., 0.), 0).empty());
+}
+
+TEST_CASE("KdTree layout keeps every input point once") {
+    const auto points = random_points<3>(5000, 11);
+    const KdTree<double, 3> tree{std::span<const Vec3d>(points)};
+    REQUIRE(tree.size() == points.size());
+    std::vector<bool> seen(points.size(), false);
+    for (const auto &node : tree.nodes()) {
+        CHECK_FALSE(seen[node.index]);
+        seen[node.index] = true;
+        CHECK(node.point == points[node.index]);
+    }
+}
+
+TEST_CASE("KdTree knn matches brute force") {
+    const auto points = random_points<3>(3000, 1);
+    const auto queries = random_points<3>(50, 2);
+    const KdTree<double, 3> tree{std::span<const Vec3d>(points)};
+    std::vector<KdNeighbor<double>> found;
+    for (const auto &q : queries) {
+        const auto expected = brute_force(points, q);
+        tree.knn(q, 10, found);
+        REQUIRE(found.size() == 10);
+        for (auto i = 0u; i < found.size(); i++) {
+            CHECK(found[i].index == expected[i].index);
+            CHECK(found[i].distance_sq == expected[i].distance_sq);
+        }
+    }
+}
+
+TEST_CASE("KdTree radius search matches brute force") {
+    const auto points = random_points<2>(4000, 3);
+    const auto queries = random_points<2>(40, 4);
+    const KdTree<double, 2> tree{std::span<const Vec2d>(points)};
+    for (const auto &q : queries) {
+        auto expected = brute_force(points, q);
+        std::erase_if(expected, [](const KdNeighbor<double> &n) {
+            return n.distance_sq > 0.25;
+        });
+        auto found = tree.radius_search(q, 0.5);
+        std::sort(found.begin(), found.end());
+        REQUIRE(found.size() == expected.size());
+        for (auto i = 0u; i < found.size(); i++) {
+            CHECK(found[i].index == expected[i].index);
+        }
+    }
+}
+
+TEST_CASE("KdTree approximate knn stays within the epsilon bound") {
+    const auto points = random_points<3>(3000, 5);
+    const auto queries = random_points<3>(50, 6);
+    const KdTree<double, 3> tree{std::span<const Vec3d>(points)};
+    const double epsilon = 0.5;
+    for (const auto &q : queries) {
+        const auto expected = brute_force(points, q);
+        const auto found = tree.knn(q, 4, epsilon);
+        REQUIRE(found.size() == 4);
+        for (auto i = 0u; i < found.size(); i++) {
+            CHECK(std::sqrt(found[i].distance_sq) <=
+                  (1 + epsilon) * std::sqrt(expected[i].distance_sq) + 1e-12);
+        }
+    }
+}
+
+TEST_CASE("KdTree batched queries match single queries") {
+    const auto points = random_points<3>(20000, 7);
+    const auto queries = random_points<3>(1000, 8);
+    ThreadPool pool(4);
+    ThreadPool single(1);
+    const KdTree<double, 3> tree(std::span<const Vec3d>(points), pool);
+    const KdTree<double, 3> serial(std::span<const Vec3d>(points), single);
+    for (auto i = 0u; i < tree.size(); i++) {
+        CHECK(tree.nodes()[i].index == serial.nodes()[i].index);
+    }
+
+    const std::size_t k = 6;
+    std::vector<KdNeighbor<double>> batch(queries.size() * k);
+    tree.knn_batch(std::span<const Vec3d>(queries), k,
+                   std::span<KdNeighbor<double>>(batch), 0., pool);
+    const auto lists =
+        tree.radius_search_batch(std::span<const Vec3d>(queries), 0.4, pool);
+    REQUIRE(lists.size() == queries.size());
+    for (auto q = 0u; q < queries.size(); q++) {
+        const auto one = tree.knn(queries[q], k);
+        for (auto i = 0u; i < k; i++) {
+            CHECK(batch[q * k + i].index == one[i].index);
+        }
+        auto within = tree.radius_search(queries[q], 0.4);
+        std::sort(within.begin(), within.end());
+        const auto listed = lists[q];
+        REQUIRE(listed.size() == within.size());
+        for (auto i = 0u; i < listed.size(); i++) {
+            CHECK(listed[i].index == within[i].index);
+        }
+    }
+
+    const std::vector<Vec3d> few{{0., 0., 0.}, {1., 1., 1.}};
+    const KdTree<double, 3> small{std::span<const Vec3d>(few)};
+    std::vector<KdNeighbor<double>> padded(3);
+    small.knn_batch(std::span<const Vec3d>(few).first(1), 3,
+                    std::span<KdNeighbor<double>>(padded));
+    CHECK(padded[0].index == 0);
+    CHECK(padded[1].index == 1);
+    CHECK(padded[2].index == std::numeric_limits<std::uint32_t>::max());
+    CHECK(std::isinf(padded[2].distance_sq));
+    CHECK_THROWS_AS(small.knn_batch(std::span<const Vec3d>(few), 2,
+                                    std::span<KdNeighbor<double>>(padded)),
+                    std::invalid_argument);
+}
+
+TEST_CASE("KdTree large builds split the upper levels on the pool") {
+    // Large enough for the parallel partition; the second set has many
+    // equal coordinates around every median.
+    auto points = random_points<3>(300000, 9);
+    auto grid = points;
+    for (auto &p : grid) {
+        p = Vec3d(std::floor(p[0]), std::floor(p[1] * 0.5), 1.0);
+    }
+    const auto queries = random_points<3>(10, 10);
+    ThreadPool pool(4);
+    ThreadPool single(1);
+    for (const auto *input : {&points, &grid}) {
+        const std::span<const Vec3d> span(*input);
+        const KdTree<double, 3> tree(span, pool);
+        const KdTree<double, 3> serial(span, single);
+        REQUIRE(tree.size() == input->size());
+        std::vector<bool> seen(input->size(), false);
+        bool once = true, same_layout = true;
+        for (auto i = 0u; i < tree.size(); i++) {
+            const auto index = tree.nodes()[i].index;
+            once = once && !seen[index];
+            seen[index] = true;
+            same_layout = same_layout && index == serial.nodes()[i].index;
+        }
+        CHECK(once);
+        CHECK(same_layout);
+        for (const auto &q : queries) {
+            const auto expected = brute_force(*input, q);
+            const auto found = tree.knn(q, 5);
+            REQUIRE(found.size() == 5);
+            for (auto i = 0u; i < found.size(); i++) {
+                CHECK(found[i].distance_sq == expected[i].distance_sq);
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "mat4_batch_ops.hpp"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+TEST_CASE_TEMPLATE("multiply_batch matches operator*", T, float, double) {
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        // Large enough to be split over the pool.
+        const auto a = random_matrices<4, 4, T>(10000, 1);
+        const auto b = random_matrices<4, 4, T>(10000, 2);
+        std::vector<Mat4<T>> out(a.size());
+        multiply_batch<T>(a, b, out, pool);
+        for (std::size_t i = 0; i < a.size(); i += 97) {
+            check_close(out[i], a[i] * b[i], 1e-5);
+        }
+
+        multiply_batch<T>(a[3], b, out, pool);
+        for (std::size_t i = 0; i < a.size(); i += 97) {
+            check_close(out[i], a[3] * b[i], 1e-5);
+        }
+        multiply_batch<T>(a, b[4], out, pool);
+        for (std::size_t i = 0; i < a.size(); i += 97) {
+            check_close(out[i], a[i] * b[4], 1e-5);
+        }
+    });
+}
+
+TEST_CASE("multiply_batch works in place") {
+    auto a = random_matrices<4, 4, float>(50, 3);
+    const auto b = random_matrices<4, 4, float>(50, 4);
+    const auto expected = a;
+    multiply_batch<float>(a, b, a);
+    for (std::size_t i = 0; i < a.size(); i++) {
+        check_close(a[i], expected[i] * b[i], 1e-5);
+    }
+
+    // The broadcast matrix may itself be one of the outputs.
+    a = expected;
+    multiply_batch<float>(a[0], a, a);
+    for (std::size_t i = 0; i < a.size(); i++) {
+        check_close(a[i], expected[0] * expected[i], 1e-5);
+    }
+}
+
+TEST_CASE("multiply_batch sizes must match") {
+    std::vector<Mat4f> a(3), b(4), out(3);
+    CHECK_THROWS_AS(multiply_batch<float>(a, b, out), std::invalid_argument);
+    CHECK_THROWS_AS(multiply_batch<float>(Mat4f(), b, out),
+                    std::invalid_argument);
+    CHECK_NOTHROW(multiply_batch<float>(a, Mat4f(), out));
+}
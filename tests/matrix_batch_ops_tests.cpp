@@ -0,0 +1,173 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "matrix_batch.hpp"
+#include "matrix_batch_ops.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+// a a^T + n I: symmetric positive definite and well conditioned.
+template <unsigned int N, typename T>
+std::vector<Matrix<N, N, T>> spd_matrices(std::size_t count,
+                                          unsigned int seed) {
+    auto matrices = random_matrices<N, N, T>(count, seed);
+    for (auto &m : matrices) {
+        m = m * m.transposed() + Matrix<N, N, T>::identity() * T(N);
+    }
+    return matrices;
+}
+
+template <typename T> double tolerance() {
+    return sizeof(T) == 4 ? 1e-4 : 1e-11;
+}
+
+} // namespace
+
+TEST_CASE_TEMPLATE("batched solve and inverse", T, float, double) {
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        const auto a = random_matrices<4, 4, T>(53, 1);
+        const auto b = random_matrices<4, 2, T>(53, 2);
+        const MatrixBatch<4, 4, T> batch_a(a);
+        const MatrixBatch<4, 2, T> batch_b(b);
+
+        MatrixBatch<4, 2, T> x;
+        CHECK(solve(batch_a, batch_b, x, pool) == 0);
+        MatrixBatch<4, 4, T> inv;
+        CHECK(inverse(batch_a, inv, pool) == 0);
+        REQUIRE(x.size() == a.size());
+        REQUIRE(inv.size() == a.size());
+        for (std::size_t i = 0; i < a.size(); i++) {
+            check_close(a[i] * x[i], b[i], tolerance<T>() * 10);
+            check_close(a[i] * inv[i], Matrix<4, 4, T>::identity(),
+                        tolerance<T>() * 10);
+        }
+    });
+}
+
+TEST_CASE_TEMPLATE("batched LU factor and solve", T, float, double) {
+    const auto a = random_matrices<6, 6, T>(40, 3);
+    const auto b = random_matrices<6, 1, T>(40, 4);
+    MatrixBatch<6, 6, T> lu(a);
+    MatrixBatch<6, 1, T> pivots;
+    CHECK(lu_factor(lu, pivots) == 0);
+
+    // P a = L U, applying the recorded swaps to a's rows.
+    for (std::size_t i = 0; i < a.size(); i++) {
+        Matrix<6, 6, T> l = Matrix<6, 6, T>::identity(), u;
+        for (auto r = 0u; r < 6; r++) {
+            for (auto c = 0u; c < 6; c++) {
+                (c < r ? l : u).get(r, c) = lu.get(i, r, c);
+            }
+        }
+        auto pa = a[i];
+        for (auto k = 0u; k < 6; k++) {
+            const auto p = static_cast<unsigned int>(pivots.get(i, k, 0));
+            CHECK(p >= k);
+            for (auto c = 0u; c < 6; c++) {
+                std::swap(pa.get(k, c), pa.get(p, c));
+            }
+        }
+        check_close(l * u, pa, tolerance<T>());
+    }
+
+    MatrixBatch<6, 1, T> x(b);
+    lu_solve(lu, pivots, x);
+    for (std::size_t i = 0; i < a.size(); i++) {
+        check_close(a[i] * x[i], b[i], tolerance<T>() * 10);
+    }
+}
+
+TEST_CASE("pivoting handles a zero leading element") {
+    // Without row swaps this would divide by zero.
+    const std::vector<Matrix<3, 3, double>> a{{0, 1, 2, 1, 0, 3, 4, -3, 8}};
+    MatrixBatch<3, 3, double> inv;
+    CHECK(inverse(MatrixBatch<3, 3, double>(a), inv) == 0);
+    check_close(a[0] * inv[0], Matrix<3, 3, double>::identity(), 1e-12);
+}
+
+TEST_CASE("singular matrices are counted") {
+    auto a = random_matrices<3, 3, double>(40, 5);
+    for (auto i : {3u, 17u, 39u}) {
+        for (auto c = 0u; c < 3; c++) {
+            a[i].get(2, c) = 0;
+        }
+    }
+    a[20] = Matrix<3, 3, double>();
+    MatrixBatch<3, 3, double> inv;
+    CHECK(inverse(MatrixBatch<3, 3, double>(a), inv) == 4);
+    check_close(a[0] * inv[0], Matrix<3, 3, double>::identity(), 1e-12);
+}
+
+TEST_CASE_TEMPLATE("batched Cholesky", T, float, double) {
+    for_each_isa([&] {
+        const auto a = spd_matrices<6, T>(45, 6);
+        const auto b = random_matrices<6, 3, T>(45, 7);
+        MatrixBatch<6, 6, T> chol(a);
+        CHECK(cholesky_factor(chol) == 0);
+        MatrixBatch<6, 3, T> x(b);
+        cholesky_solve(chol, x);
+        for (std::size_t i = 0; i < a.size(); i++) {
+            const auto l = chol[i];
+            CHECK(l.get(0, 5) == 0);
+            CHECK(l.get(2, 2) > 0);
+            check_close(l * l.transposed(), a[i], tolerance<T>());
+            check_close(a[i] * x[i], b[i], tolerance<T>() * 10);
+        }
+    });
+}
+
+TEST_CASE("indefinite matrices are counted") {
+    auto a = spd_matrices<3, double>(20, 8);
+    a[2].get(1, 1) = -1;
+    a[11] = Matrix<3, 3, double>::identity() * -1.0;
+    MatrixBatch<3, 3, double> chol(a);
+    CHECK(cholesky_factor(chol) == 2);
+    CHECK(std::isnan(chol[11].get(0, 0)));
+}
+
+TEST_CASE_TEMPLATE("batched products", T, float, double) {
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        const auto a = random_matrices<3, 4, T>(37, 9);
+        const auto b = random_matrices<4, 2, T>(37, 10);
+        const MatrixBatch<3, 4, T> batch_a(a);
+        const MatrixBatch<4, 2, T> batch_b(b);
+        MatrixBatch<3, 2, T> ab;
+        multiply(batch_a, batch_b, ab, pool);
+        REQUIRE(ab.size() == a.size());
+        for (std::size_t i = 0; i < a.size(); i++) {
+            check_close(ab[i], a[i] * b[i], tolerance<T>());
+        }
+
+        // One matrix on either side, in place.
+        MatrixBatch<4, 2, T> mb(b);
+        multiply(Matrix<4, 4, T>::identity() * T(2), mb, mb, pool);
+        MatrixBatch<3, 4, T> am(a);
+        multiply(am, a[5].transposed() * a[5], am, pool);
+        for (std::size_t i = 0; i < a.size(); i++) {
+            check_close(mb[i], b[i] * T(2), tolerance<T>());
+            check_close(am[i], a[i] * (a[5].transposed() * a[5]),
+                        tolerance<T>());
+        }
+    });
+}
+
+TEST_CASE("batch sizes must match") {
+    MatrixBatch<3, 3, double> a(4);
+    MatrixBatch<3, 1, double> b(5), x;
+    CHECK_THROWS_AS(solve(a, b, x), std::invalid_argument);
+    CHECK_THROWS_AS(cholesky_solve(a, b), std::invalid_argument);
+    MatrixBatch<3, 3, double> c;
+    CHECK_THROWS_AS(multiply(a, MatrixBatch<3, 3, double>(5), c),
+                    std::invalid_argument);
+}
@@ -0,0 +1,81 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "matrix.hpp"
+#include "matrix_batch.hpp"
+#include <cstddef>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <unsigned int Rows, unsigned int Cols, typename T>
+std::vector<Matrix<Rows, Cols, T>> numbered(std::size_t count) {
+    std::vector<Matrix<Rows, Cols, T>> matrices(count);
+    for (std::size_t i = 0; i < count; i++) {
+        for (auto row = 0u; row < Rows; row++) {
+            for (auto col = 0u; col < Cols; col++) {
+                matrices[i].get(row, col) = T(i * 100 + row * 10 + col);
+            }
+        }
+    }
+    return matrices;
+}
+
+template <unsigned int Rows, unsigned int Cols, typename T>
+bool equal(const Matrix<Rows, Cols, T> &a, const Matrix<Rows, Cols, T> &b) {
+    for (auto row = 0u; row < Rows; row++) {
+        for (auto col = 0u; col < Cols; col++) {
+            if (a.get(row, col) != b.get(row, col)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE_TEMPLATE("MatrixBatch: AoS round trip", T, int, float, double) {
+    const auto matrices = numbered<3, 2, T>(37);
+    const MatrixBatch<3, 2, T> batch(matrices);
+    REQUIRE(batch.size() == matrices.size());
+    CHECK(batch.blocks() == 3);
+    const auto back = batch.to_matrices();
+    REQUIRE(back.size() == matrices.size());
+    for (std::size_t i = 0; i < matrices.size(); i++) {
+        CHECK(equal(back[i], matrices[i]));
+        CHECK(equal(batch[i], matrices[i]));
+    }
+}
+
+TEST_CASE("MatrixBatch: interleaved layout") {
+    const auto matrices = numbered<2, 2, double>(20);
+    MatrixBatch<2, 2, double> batch(matrices);
+    constexpr auto lanes = MatrixBatch<2, 2, double>::lanes;
+    static_assert(MatrixBatch<2, 2, double>::block_size == 4 * lanes);
+
+    // Element (1, 0) of the 16 matrices of block 0 are contiguous.
+    const auto block = batch.block(0);
+    for (std::size_t l = 0; l < lanes; l++) {
+        CHECK(block[(1 * 2 + 0) * lanes + l] == matrices[l].get(1, 0));
+    }
+    // Matrix 17 is lane 1 of block 1; lanes past size() are zero.
+    CHECK(batch.block(1)[(0 * 2 + 1) * lanes + 1] == matrices[17].get(0, 1));
+    CHECK(batch.block(1)[(0 * 2 + 1) * lanes + 4] == 0);
+
+    batch.get(17, 1, 1) = -1;
+    CHECK(batch[17].get(1, 1) == -1);
+    batch.set(0, matrices[5]);
+    CHECK(equal(batch[0], matrices[5]));
+}
+
+TEST_CASE("MatrixBatch: resize") {
+    MatrixBatch<4, 4, float> batch;
+    CHECK(batch.empty());
+    CHECK(batch.blocks() == 0);
+    batch.resize(17);
+    CHECK(batch.size() == 17);
+    CHECK(batch.blocks() == 2);
+    CHECK(batch.get(16, 3, 3) == 0.f);
+}
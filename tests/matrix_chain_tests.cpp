@@ -0,0 +1,84 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "matrix.hpp"
+#include "matrix_chain.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <type_traits>
+
+using namespace cml;
+
+namespace {
+
+// Small integers, so every evaluation order gives exactly the same result.
+template <unsigned int Rows, unsigned int Cols>
+Matrix<Rows, Cols, double> sample_matrix(unsigned int seed) {
+    Matrix<Rows, Cols, double> m;
+    for (auto r = 0u; r < Rows; r++) {
+        for (auto c = 0u; c < Cols; c++) {
+            m.get(r, c) = double((r * 7 + c * 3 + seed) % 5) - 2.;
+        }
+    }
+    return m;
+}
+
+template <unsigned int Rows, unsigned int Cols>
+void check_equal(const Matrix<Rows, Cols, double> &a,
+                 const Matrix<Rows, Cols, double> &b) {
+    for (auto r = 0u; r < Rows; r++) {
+        for (auto c = 0u; c < Cols; c++) {
+            CHECK(a.get(r, c) == b.get(r, c));
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("MatrixChainPlan solves the textbook instance") {
+    // CLRS 15.2: 30x35, 35x15, 15x5, 5x10, 10x20, 20x25.
+    constexpr MatrixChainPlan<6> plan({30, 35, 15, 5, 10, 20, 25});
+    static_assert(plan.optimal_cost() == 15125);
+    CHECK(plan.parenthesization() == "((A0 (A1 A2)) ((A3 A4) A5))");
+    CHECK(plan.left_to_right_cost() == 40500);
+}
+
+TEST_CASE("chain picks the cheap order for A * B * C * v") {
+    using A = Matrix<64, 128, double>;
+    using B = Matrix<128, 4, double>;
+    using C = Matrix<4, 256, double>;
+    using V = Vec<double, 256>;
+    constexpr auto &plan = matrix_chain_plan<A, B, C, V>;
+    static_assert(plan.split[0][3] == 0);
+    static_assert(plan.split[1][3] == 1);
+    static_assert(plan.split[2][3] == 2);
+    static_assert(plan.optimal_cost() == 1024 + 512 + 8192);
+    static_assert(plan.left_to_right_cost() == 32768 + 65536 + 16384);
+    CHECK(plan.parenthesization() == "(A0 (A1 (A2 A3)))");
+
+    const auto a = sample_matrix<64, 128>(1);
+    const auto b = sample_matrix<128, 4>(2);
+    const auto c = sample_matrix<4, 256>(3);
+    V v;
+    for (auto i = 0u; i < 256; i++) {
+        v[i] = double(i % 3) - 1.;
+    }
+    const auto result = chain(a, b, c, v);
+    static_assert(std::is_same_v<std::remove_const_t<decltype(result)>,
+                                 Vec<double, 64>>);
+    const auto expected = a * b * c * v;
+    for (auto i = 0u; i < 64; i++) {
+        CHECK(result[i] == expected[i]);
+    }
+}
+
+TEST_CASE("chain of matrices matches left-to-right evaluation") {
+    const auto a = sample_matrix<2, 9>(4);
+    const auto b = sample_matrix<9, 3>(5);
+    const auto c = sample_matrix<3, 8>(6);
+    const auto d = sample_matrix<8, 2>(7);
+    CHECK(matrix_chain_plan<Matrix<2, 9, double>, Matrix<9, 3, double>,
+                            Matrix<3, 8, double>, Matrix<8, 2, double>>
+              .parenthesization() == "((A0 A1) (A2 A3))");
+    check_equal(chain(a, b, c, d), a * b * c * d);
+    check_equal(chain(a, b), a * b);
+}
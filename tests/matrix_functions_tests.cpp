@@ -0,0 +1,227 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "matrix_functions.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace cml;
+
+namespace {
+
+// (F(k), F(k + 1)) modulo m by fast doubling, independent of matrices.
+std::pair<std::uint64_t, std::uint64_t> fibonacci_mod(std::uint64_t k,
+                                                      std::uint64_t m) {
+    if (k == 0) {
+        return {0, 1 % m};
+    }
+    const auto [a, b] = fibonacci_mod(k / 2, m);
+    const auto c = a * ((2 * b + m - a) % m) % m;
+    const auto d = (a * a + b * b) % m;
+    return k % 2 == 0 ? std::pair{c, d} : std::pair{d, (c + d) % m};
+}
+
+} // namespace
+
+TEST_CASE("pow of Matrix") {
+    const Matrix<2, 2, std::int64_t> fib{1, 1, 1, 0};
+    const auto f90 = pow(fib, 90);
+    CHECK(f90.get(0, 1) == 2880067194370816120);
+    CHECK(f90.get(1, 1) == 1779979416004714189);
+
+    const auto id = pow(fib, 0);
+    CHECK(id.get(0, 0) == 1);
+    CHECK(id.get(0, 1) == 0);
+    CHECK(pow(fib, 1).get(0, 0) == 1);
+
+    Matrix<5, 5, double> m;
+    for (auto i = 0u; i < 5; i++) {
+        for (auto j = 0u; j < 5; j++) {
+            m.get(i, j) = 0.1 * double(i) - 0.05 * double(j * j) + 0.3;
+        }
+    }
+    auto expected = m;
+    for (int k = 2; k <= 13; k++) {
+        expected = expected * m;
+    }
+    const auto actual = pow(m, 13);
+    for (auto i = 0u; i < 5; i++) {
+        for (auto j = 0u; j < 5; j++) {
+            CHECK(actual.get(i, j) ==
+                  doctest::Approx(expected.get(i, j)).epsilon(1e-12));
+        }
+    }
+}
+
+TEST_CASE("pow of DynamicMatrix uses gemm for large orders") {
+    ThreadPool pool(2);
+    for (const std::size_t n : {7, 40}) {
+        const auto m = random_matrix<double>(n, n, 1, 0.3);
+        auto expected = m;
+        for (int k = 2; k <= 11; k++) {
+            expected = expected * m;
+        }
+        check_close(pow(m, 11, pool), expected, 1e-11);
+    }
+    CHECK(pow(DynamicMatrixd(3, 3), 0) == DynamicMatrixd::identity(3));
+    CHECK_THROWS_AS(pow(DynamicMatrixd(2, 3), 2), std::invalid_argument);
+}
+
+TEST_CASE("pow_mod") {
+    constexpr std::int64_t modulus = 1'000'000'007;
+    const Matrix<2, 2, std::int64_t> fib{1, 1, 1, 0};
+    for (const std::uint64_t k : {1ull, 2ull, 1000ull, 1'000'000'000ull,
+                                  (1ull << 62) + 12345}) {
+        const auto [fk, fk1] = fibonacci_mod(k, modulus);
+        const auto r = pow_mod(fib, k, modulus);
+        CHECK(std::uint64_t(r.get(0, 1)) == fk);
+        CHECK(std::uint64_t(r.get(0, 0)) == fk1);
+    }
+    CHECK(pow_mod(fib, 1'000'000'000, modulus).get(0, 1) == 21);
+
+    // Negative entries are reduced into [0, modulus).
+    const Matrix<2, 2, int> neg{-1, 0, 0, -1};
+    const auto r = pow_mod(neg, 3, 7);
+    CHECK(r.get(0, 0) == 6);
+    CHECK(r.get(0, 1) == 0);
+
+    // A 32-bit modulus close to the limit doesn't overflow.
+    const Matrix<2, 2, std::int32_t> big{2147483646, 2147483645, 1, 2};
+    const auto expected =
+        pow_mod(Matrix<2, 2, std::int64_t>{2147483646, 2147483645, 1, 2}, 5,
+                std::int64_t(2147483647));
+    const auto actual = pow_mod(big, 5, 2147483647);
+    for (auto i = 0u; i < 2; i++) {
+        for (auto j = 0u; j < 2; j++) {
+            CHECK(actual.get(i, j) == expected.get(i, j));
+        }
+    }
+
+    // A 64-bit modulus whose residue products need 128 bits: by Fermat,
+    // 3^(p - 1) = 1 for the prime p = 2^61 - 1.
+    const std::int64_t mersenne = (std::int64_t(1) << 61) - 1;
+    const Matrix<2, 2, std::int64_t> three{3, 0, 0, 3};
+    CHECK(pow_mod(three, std::uint64_t(mersenne - 1), mersenne).get(0, 0) ==
+          1);
+    CHECK(pow_mod(three, std::uint64_t(mersenne), mersenne).get(1, 1) == 3);
+
+    CHECK(pow_mod(fib, 5, std::int64_t(1)).get(0, 0) == 0);
+    CHECK(pow_mod(fib, 0, std::int64_t(1)).get(0, 0) == 0);
+    CHECK_THROWS_AS(pow_mod(fib, 5, std::int64_t(0)), std::invalid_argument);
+    CHECK(pow_mod(DynamicMatrix<int>(2, 2, {1, 1, 1, 0}), 10, 1000).get(0, 1) ==
+          55);
+}
+
+TEST_CASE_TEMPLATE("expm of known matrices", T, float, double) {
+    const double epsilon = sizeof(T) == 4 ? 1e-5 : 1e-13;
+    CHECK(expm(DynamicMatrix<T>(3, 3)) == DynamicMatrix<T>::identity(3));
+
+    const DynamicMatrix<T> nilpotent(2, 2, {0, 1, 0, 0});
+    check_close(expm(nilpotent), DynamicMatrix<T>(2, 2, {1, 1, 0, 1}),
+                epsilon);
+
+    // The generator of rotations, small enough for a low degree approximant
+    // and large enough to need scaling and squaring.
+    for (const T t : {T(0.001), T(0.1), T(1), T(10), T(30)}) {
+        const DynamicMatrix<T> a(2, 2, {0, -t, t, 0});
+        const auto c = std::cos(t);
+        const auto s = std::sin(t);
+        check_close(expm(a), DynamicMatrix<T>(2, 2, {c, -s, s, c}),
+                    epsilon * 10 * (1 + t));
+    }
+
+    const Matrix<3, 3, T> diagonal{T(-2), 0, 0, 0, T(0.5), 0, 0, 0, T(3)};
+    const auto e = expm(diagonal);
+    CHECK(e.get(0, 0) == doctest::Approx(std::exp(-2.0)).epsilon(epsilon));
+    CHECK(e.get(1, 1) == doctest::Approx(std::exp(0.5)).epsilon(epsilon));
+    CHECK(e.get(2, 2) == doctest::Approx(std::exp(3.0)).epsilon(epsilon));
+    CHECK(e.get(0, 1) == doctest::Approx(0).epsilon(epsilon));
+
+    CHECK_THROWS_AS(expm(DynamicMatrix<T>(2, 3)), std::invalid_argument);
+    // Non-finite 1-norms, including a NaN in a column that is not the
+    // largest.
+    const auto inf = std::numeric_limits<T>::infinity();
+    const auto nan = std::numeric_limits<T>::quiet_NaN();
+    const auto max = std::numeric_limits<T>::max();
+    for (const auto &bad : {DynamicMatrix<T>(2, 2, {1, 0, 0, inf}),
+                            DynamicMatrix<T>(2, 2, {5, nan, 5, 0}),
+                            DynamicMatrix<T>(2, 2, {max, 0, max, 0})}) {
+        CHECK_THROWS_AS(expm(bad), std::invalid_argument);
+    }
+}
+
+TEST_CASE("expm(a) expm(-a) is the identity") {
+    ThreadPool pool(2);
+    for (const double scale : {0.001, 0.05, 0.5}) {
+        const auto a = random_matrix<double>(40, 40, 2, scale);
+        const auto product = expm(a, pool) * expm(a * -1.0, pool);
+        check_close(product, DynamicMatrixd::identity(40), 1e-12);
+    }
+}
+
+TEST_CASE("propagate applies one matrix to a batch") {
+    const Matrix<3, 3, double> p{0.5, 0.25, 0.25, 0.1, 0.8, 0.1,
+                                 0.3, 0.3,  0.4};
+    VecBatch<double, 3> states(37);
+    for (std::size_t i = 0; i < states.size(); i++) {
+        for (auto d = 0u; d < 3; d++) {
+            states.get(d, i) = double(i % 5) + d;
+        }
+    }
+    VecBatch<double, 3> out;
+    propagate(p, states, out);
+    REQUIRE(out.size() == states.size());
+    for (std::size_t i = 0; i < states.size(); i++) {
+        for (auto row = 0u; row < 3; row++) {
+            double expected = 0;
+            for (auto col = 0u; col < 3; col++) {
+                expected += p.get(row, col) * states.get(col, i);
+            }
+            CHECK(out.get(row, i) == doctest::Approx(expected));
+        }
+    }
+
+    // Ten steps in place equal one step of p^10.
+    auto stepped = states;
+    for (int k = 0; k < 10; k++) {
+        propagate(p, stepped, stepped);
+    }
+    propagate(pow(p, 10), states, out);
+    for (std::size_t i = 0; i < states.size(); i++) {
+        for (auto d = 0u; d < 3; d++) {
+            CHECK(stepped.get(d, i) ==
+                  doctest::Approx(out.get(d, i)).epsilon(1e-12));
+        }
+    }
+}
+
+TEST_CASE("propagate_mod") {
+    const Matrix<2, 2, std::int64_t> fib{1, 1, 1, 0};
+    constexpr std::int64_t modulus = 1'000'000'007;
+    VecBatch<std::int64_t, 2> states(20);
+    for (std::size_t i = 0; i < states.size(); i++) {
+        states.get(0, i) = 1;
+        states.get(1, i) = -std::int64_t(i);
+    }
+    VecBatch<std::int64_t, 2> out;
+    const auto step = pow_mod(fib, 1000, modulus);
+    propagate_mod(step, states, out, modulus);
+    const auto [f1000, f1001] = fibonacci_mod(1000, modulus);
+    const auto [f999, unused] = fibonacci_mod(999, modulus);
+    for (std::size_t i = 0; i < states.size(); i++) {
+        const auto x = std::uint64_t(modulus) - i % modulus;
+        CHECK(std::uint64_t(out.get(0, i)) == (f1001 + f1000 * x) % modulus);
+        CHECK(std::uint64_t(out.get(1, i)) == (f1000 + f999 * x) % modulus);
+    }
+    CHECK_THROWS_AS(propagate_mod(fib, states, out, std::int64_t(-3)),
+                    std::invalid_argument);
+}
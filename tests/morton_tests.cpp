@@ -0,0 +1,202 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "morton.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <unsigned int Dim>
+unsigned int manhattan(const Vec<unsigned int, Dim> &a,
+                       const Vec<unsigned int, Dim> &b) {
+    unsigned int sum = 0;
+    for (auto d = 0u; d < Dim; d++) {
+        sum += a[d] > b[d] ? a[d] - b[d] : b[d] - a[d];
+    }
+    return sum;
+}
+
+// Cells of a side^Dim grid in Hilbert order.
+template <unsigned int Dim>
+std::vector<Vec<unsigned int, Dim>> hilbert_walk(unsigned int bits) {
+    const auto side = 1u << bits;
+    std::vector<std::pair<std::uint64_t, Vec<unsigned int, Dim>>> cells;
+    Vec<unsigned int, Dim> p;
+    for (auto i = 0u; i < (1u << (bits * Dim)); i++) {
+        auto rest = i;
+        for (auto d = 0u; d < Dim; d++) {
+            p[d] = rest % side;
+            rest /= side;
+        }
+        cells.push_back({hilbert_encode(p, bits), p});
+    }
+    std::sort(cells.begin(), cells.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::vector<Vec<unsigned int, Dim>> walk;
+    for (auto i = 0u; i < cells.size(); i++) {
+        CHECK(cells[i].first == i);
+        walk.push_back(cells[i].second);
+    }
+    return walk;
+}
+
+} // namespace
+
+TEST_CASE("Morton keys interleave the coordinate bits") {
+    static_assert(morton_encode(Vec2u(1, 0)) == 1);
+    static_assert(morton_encode(Vec2u(0, 1)) == 2);
+    static_assert(morton_encode(Vec3u(0, 0, 1)) == 4);
+    CHECK(morton_encode(Vec2u(3, 0)) == 5);
+    CHECK(morton_encode(Vec3u(3, 0, 0)) == 9);
+    CHECK(morton_encode(Vec3u(1, 1, 1)) == 7);
+    CHECK(morton_encode(Vec2u(0xFFFFFFFFu, 0xFFFFFFFFu)) == ~0ull);
+    CHECK(morton_encode(Vec3u(0x1FFFFF, 0x1FFFFF, 0x1FFFFF)) ==
+          (1ull << 63) - 1);
+    // Bits above curve_bits<3> are dropped.
+    CHECK(morton_encode(Vec3u(1u << 21, 0, 0)) == 0);
+}
+
+TEST_CASE("Morton decode inverts encode") {
+    std::mt19937_64 rng(1);
+    for (auto i = 0; i < 10000; i++) {
+        const auto bits = rng();
+        const Vec2u p2(static_cast<unsigned int>(bits),
+                       static_cast<unsigned int>(bits >> 32));
+        CHECK(morton_decode_2d(morton_encode(p2)) == p2);
+        const Vec3u p3(static_cast<unsigned int>(bits & 0x1FFFFF),
+                       static_cast<unsigned int>((bits >> 21) & 0x1FFFFF),
+                       static_cast<unsigned int>((bits >> 42) & 0x1FFFFF));
+        CHECK(morton_decode_3d(morton_encode(p3)) == p3);
+        CHECK(morton_encode(morton_decode_3d(bits >> 1)) == bits >> 1);
+        // The portable path agrees with pdep/pext when those are in use.
+        CHECK((detail::spread_bits<2>(p2.x()) |
+               detail::spread_bits<2>(p2.y()) << 1) == morton_encode(p2));
+        CHECK(detail::compact_bits<3>(bits >> 3) ==
+              morton_decode_3d(bits >> 1).z());
+    }
+}
+
+TEST_CASE("Hilbert keys walk the grid one face step at a time") {
+    for (const auto bits : {1u, 2u, 4u}) {
+        const auto walk = hilbert_walk<2>(bits);
+        for (auto i = 1u; i < walk.size(); i++) {
+            CHECK(manhattan(walk[i - 1], walk[i]) == 1);
+        }
+    }
+    for (const auto bits : {1u, 3u}) {
+        const auto walk = hilbert_walk<3>(bits);
+        for (auto i = 1u; i < walk.size(); i++) {
+            CHECK(manhattan(walk[i - 1], walk[i]) == 1);
+        }
+    }
+    // Full-resolution keys keep the prefix property: the cells of a
+    // coarse key form one aligned block.
+    const Vec3u p(0x12345, 0x0ABCD, 0x1F00F);
+    const Vec3u q(0x12345 | 0xFF, 0x0ABCD & ~0xFFu, 0x1F00F | 0x80);
+    CHECK(hilbert_encode(p) >> 24 == hilbert_encode(q) >> 24);
+
+    // 1 to curve_bits<Dim> bits per coordinate.
+    const Vec2u r(0xFFFFFFFFu, 0x80000001u);
+    CHECK(hilbert_encode(r, curve_bits<2>) == hilbert_encode(r));
+    CHECK(hilbert_encode(p, curve_bits<3>) == hilbert_encode(p));
+    CHECK(hilbert_encode(r, 1) < 4);
+    CHECK_THROWS_AS(hilbert_encode(r, 0), std::invalid_argument);
+    CHECK_THROWS_AS(hilbert_encode(r, curve_bits<2> + 1),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(hilbert_encode(p, curve_bits<3> + 1),
+                    std::invalid_argument);
+}
+
+TEST_CASE("quantize maps the bounds onto the grid and clamps") {
+    const Aabb<float> bounds(Vec3f(-1.f, 0.f, 2.f), Vec3f(1.f, 4.f, 2.f));
+    CHECK(quantize(Vec3f(-1.f, 0.f, 2.f), bounds) == Vec3u(0, 0, 0));
+    CHECK(quantize(Vec3f(1.f, 4.f, 2.f), bounds) ==
+          Vec3u(0x1FFFFF, 0x1FFFFF, 0));
+    CHECK(quantize(Vec3f(-5.f, 9.f, 3.f), bounds, 4) == Vec3u(0, 15, 0));
+    CHECK(quantize(Vec3f(0.f, 2.f, 2.f), bounds, 4) == Vec3u(7, 7, 0));
+    CHECK(morton_encode(Vec3f(1.f, 0.f, 2.f), bounds) ==
+          morton_encode(Vec3u(0x1FFFFF, 0, 0)));
+}
+
+TEST_CASE("radix_sort_pairs sorts stably and independently of threads") {
+    std::mt19937_64 rng(2);
+    for (const std::size_t n : {0u, 1u, 1000u, 300000u}) {
+        std::vector<std::uint64_t> keys(n);
+        for (auto &key : keys) {
+            // Few distinct low keys exercise stability, wide keys every pass.
+            key = rng() % 3 == 0 ? rng() % 64 : rng();
+        }
+        std::vector<std::uint32_t> values(n);
+        std::iota(values.begin(), values.end(), 0u);
+
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> expected;
+        for (auto i = 0u; i < n; i++) {
+            expected.push_back({keys[i], values[i]});
+        }
+        std::stable_sort(
+            expected.begin(), expected.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+        for (const auto threads : {1u, 4u}) {
+            ThreadPool pool(threads);
+            auto sorted_keys = keys;
+            auto sorted_values = values;
+            radix_sort_pairs(sorted_keys, sorted_values, pool);
+            for (auto i = 0u; i < n; i++) {
+                CHECK(sorted_keys[i] == expected[i].first);
+                CHECK(sorted_values[i] == expected[i].second);
+            }
+        }
+    }
+
+    std::vector<std::uint64_t> keys(4);
+    std::vector<std::uint32_t> values(3);
+    CHECK_THROWS_AS(radix_sort_pairs(keys, values), std::invalid_argument);
+}
+
+TEST_CASE("curve orders and reorder") {
+    std::vector<Vec3f> points(50000);
+    fill_uniform_box(std::span<Vec3f>(points), Vec3f(0.f, 0.f, 0.f),
+                     Vec3f(10.f, 20.f, 30.f), 3);
+    ThreadPool pool(4);
+    Aabb<float> bounds;
+    for (const auto &p : points) {
+        bounds.expand(p);
+    }
+
+    const auto morton = morton_order(std::span<const Vec3f>(points), pool);
+    const auto hilbert = hilbert_order(std::span<const Vec3f>(points), pool);
+    for (const auto &order : {morton, hilbert}) {
+        REQUIRE(order.size() == points.size());
+        auto seen = order;
+        std::sort(seen.begin(), seen.end());
+        for (auto i = 0u; i < seen.size(); i++) {
+            CHECK(seen[i] == i);
+        }
+    }
+    for (auto i = 1u; i < points.size(); i++) {
+        CHECK(morton_encode(points[morton[i - 1]], bounds) <=
+              morton_encode(points[morton[i]], bounds));
+        CHECK(hilbert_encode(points[hilbert[i - 1]], bounds) <=
+              hilbert_encode(points[hilbert[i]], bounds));
+    }
+
+    auto reordered = points;
+    reorder(std::span<Vec3f>(reordered), morton, pool);
+    VecBatch<float, 3> batch(points);
+    reorder(batch, morton, pool);
+    for (auto i = 0u; i < points.size(); i++) {
+        CHECK(reordered[i] == points[morton[i]]);
+        CHECK(batch[i] == points[morton[i]]);
+    }
+}
@@ -0,0 +1,353 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "predicates.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+__extension__ typedef __int128 Wide;
+
+int sign(double x) { return (x > 0) - (x < 0); }
+int sign(Wide x) { return (x > 0) - (x < 0); }
+
+// Exact references on integer coordinates (scaled doubles), small enough
+// for the determinants to fit 128 bits.
+Wide orient2d_reference(const std::array<Wide, 2> &a,
+                        const std::array<Wide, 2> &b,
+                        const std::array<Wide, 2> &c) {
+    return (a[0] - c[0]) * (b[1] - c[1]) - (a[1] - c[1]) * (b[0] - c[0]);
+}
+
+Wide det3(const std::array<std::array<Wide, 3>, 3> &m) {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+Wide orient3d_reference(const std::array<std::array<Wide, 3>, 4> &p) {
+    std::array<std::array<Wide, 3>, 3> m;
+    for (auto r = 0u; r < 3; r++) {
+        for (auto c = 0u; c < 3; c++) {
+            m[r][c] = p[r][c] - p[3][c];
+        }
+    }
+    return det3(m);
+}
+
+Wide incircle_reference(const std::array<std::array<Wide, 2>, 4> &p) {
+    std::array<std::array<Wide, 3>, 3> m;
+    for (auto r = 0u; r < 3; r++) {
+        const auto x = p[r][0] - p[3][0];
+        const auto y = p[r][1] - p[3][1];
+        m[r] = {x, y, x * x + y * y};
+    }
+    return det3(m);
+}
+
+// Cofactor expansion along the last column.
+Wide det4(const std::array<std::array<Wide, 4>, 4> &m) {
+    Wide det = 0;
+    for (auto r = 0u; r < 4; r++) {
+        std::array<std::array<Wide, 3>, 3> minor;
+        for (auto i = 0u, k = 0u; i < 4; i++) {
+            if (i != r) {
+                minor[k++] = {m[i][0], m[i][1], m[i][2]};
+            }
+        }
+        det += (r % 2 == 0 ? -1 : 1) * m[r][3] * det3(minor);
+    }
+    return det;
+}
+
+Wide insphere_reference(const std::array<std::array<Wide, 3>, 5> &p) {
+    std::array<std::array<Wide, 4>, 4> m;
+    for (auto r = 0u; r < 4; r++) {
+        const auto x = p[r][0] - p[4][0];
+        const auto y = p[r][1] - p[4][1];
+        const auto z = p[r][2] - p[4][2];
+        m[r] = {x, y, z, x * x + y * y + z * z};
+    }
+    return det4(m);
+}
+
+} // namespace
+
+TEST_CASE("predicates: signs of simple configurations") {
+    const Vec2d a{0.0, 0.0}, b{1.0, 0.0}, c{0.0, 1.0};
+    CHECK(orient2d(a, b, c) > 0);
+    CHECK(orient2d(a, c, b) < 0);
+    CHECK(orient2d(a, b, Vec2d{2.0, 0.0}) == 0);
+
+    CHECK(incircle(a, b, c, Vec2d{0.25, 0.25}) > 0);
+    CHECK(incircle(a, b, c, Vec2d{2.0, 2.0}) < 0);
+    CHECK(incircle(a, b, c, Vec2d{1.0, 1.0}) == 0);
+
+    const Vec3d p{0.0, 0.0, 0.0}, q{1.0, 0.0, 0.0}, r{0.0, 1.0, 0.0};
+    CHECK(orient3d(p, q, r, Vec3d{0.0, 0.0, -1.0}) > 0);
+    CHECK(orient3d(p, q, r, Vec3d{0.0, 0.0, 1.0}) < 0);
+    CHECK(orient3d(p, q, r, Vec3d{5.0, -3.0, 0.0}) == 0);
+
+    const Vec3d s{0.0, 0.0, -1.0};
+    REQUIRE(orient3d(p, q, r, s) > 0);
+    CHECK(insphere(p, q, r, s, Vec3d{0.2, 0.2, -0.2}) > 0);
+    CHECK(insphere(p, q, r, s, Vec3d{3.0, 3.0, 3.0}) < 0);
+    CHECK(insphere(p, q, r, s, Vec3d{1.0, 1.0, -1.0}) == 0);
+}
+
+TEST_CASE("predicates: orient2d near a line") {
+    // Shewchuk's example: a grid of points a spaced one ulp apart near 0.5
+    // against b and c on the diagonal. Naive evaluation gets many of these
+    // wrong; scaled by 2^53 all coordinates are integers.
+    const Vec2d b{12.0, 12.0}, c{24.0, 24.0};
+    const auto ulp = 0x1p-53;
+    const auto scale = 0x1p53;
+    const auto wide = [&](double x) { return Wide(x * scale); };
+    std::size_t zeros = 0;
+    for (auto i = 0; i < 64; i++) {
+        for (auto j = 0; j < 64; j++) {
+            const Vec2d a{0.5 + i * ulp, 0.5 + j * ulp};
+            const auto expected = orient2d_reference(
+                {wide(a[0]), wide(a[1])}, {wide(b[0]), wide(b[1])},
+                {wide(c[0]), wide(c[1])});
+            CHECK_EQ(sign(orient2d(a, b, c)), sign(expected));
+            CHECK_EQ(sign(orient2d(b, c, a)), sign(expected));
+            CHECK_EQ(sign(orient2d(c, a, b)), sign(expected));
+            zeros += expected == 0;
+        }
+    }
+    CHECK_EQ(zeros, 64u);
+}
+
+TEST_CASE("predicates: near-degenerate integer configurations") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> offset(-1 << 20, 1 << 20);
+    std::uniform_int_distribution<int> nudge(-2, 2);
+
+    SUBCASE("orient3d on a plane") {
+        // Points s * u + t * v + o near a plane, the last one nudged.
+        for (auto n = 0; n < 500; n++) {
+            std::array<std::array<Wide, 3>, 4> p;
+            const std::array<Wide, 3> u{3, 1 << 20, -5}, v{1 << 18, 7, 9};
+            const std::array<Wide, 3> o{offset(rng), offset(rng), offset(rng)};
+            for (auto &x : p) {
+                const Wide s = offset(rng), t = offset(rng);
+                for (auto d = 0u; d < 3; d++) {
+                    x[d] = o[d] + s * u[d] / 64 + t * v[d] / 64;
+                }
+            }
+            p[3][n % 3] += nudge(rng);
+            std::array<Vec3d, 4> v3;
+            for (auto k = 0u; k < 4; k++) {
+                v3[k] = Vec3d{double(p[k][0]), double(p[k][1]),
+                              double(p[k][2])};
+            }
+            CHECK_EQ(sign(orient3d(v3[0], v3[1], v3[2], v3[3])),
+                     sign(orient3d_reference(p)));
+        }
+    }
+
+    SUBCASE("incircle on a circle") {
+        // (3, 4) r, (5, 0) r, (4, -3) r and (0, -5) r lie on one circle.
+        const std::array<std::array<Wide, 2>, 4> base{
+            {{3, 4}, {5, 0}, {4, -3}, {0, -5}}};
+        for (auto n = 0; n < 500; n++) {
+            const Wide r = Wide(1 + n) << 8;
+            const std::array<Wide, 2> o{offset(rng), offset(rng)};
+            std::array<std::array<Wide, 2>, 4> p;
+            for (auto k = 0u; k < 4; k++) {
+                p[k] = {o[0] + base[k][0] * r, o[1] + base[k][1] * r};
+            }
+            p[3][n % 2] += nudge(rng);
+            std::array<Vec2d, 4> v2;
+            for (auto k = 0u; k < 4; k++) {
+                v2[k] = Vec2d{double(p[k][0]), double(p[k][1])};
+            }
+            CHECK_EQ(sign(incircle(v2[0], v2[1], v2[2], v2[3])),
+                     sign(incircle_reference(p)));
+        }
+    }
+
+    SUBCASE("insphere on a sphere") {
+        // Points (+-2, +-1, +-2) r and permutations lie on a sphere of
+        // radius 3 r.
+        const std::array<std::array<Wide, 3>, 5> base{
+            {{2, 1, 2}, {-2, 2, 1}, {1, -2, 2}, {2, 2, -1}, {-1, -2, -2}}};
+        for (auto n = 0; n < 500; n++) {
+            const Wide r = Wide(1 + n % 64) << 12;
+            const std::array<Wide, 3> o{offset(rng) >> 4, offset(rng) >> 4,
+                                        offset(rng) >> 4};
+            std::array<std::array<Wide, 3>, 5> p;
+            for (auto k = 0u; k < 5; k++) {
+                for (auto d = 0u; d < 3; d++) {
+                    p[k][d] = o[d] + base[k][d] * r;
+                }
+            }
+            p[4][n % 3] += nudge(rng);
+            std::array<Vec3d, 5> v3;
+            for (auto k = 0u; k < 5; k++) {
+                v3[k] = Vec3d{double(p[k][0]), double(p[k][1]),
+                              double(p[k][2])};
+            }
+            CHECK_EQ(sign(insphere(v3[0], v3[1], v3[2], v3[3], v3[4])),
+                     sign(insphere_reference(p)));
+        }
+    }
+}
+
+TEST_CASE("predicates: roundoff in the differences decides") {
+    // Points in degenerate position, all but the last on integer
+    // coordinates and the last tiny, so that no difference is
+    // representable. The last point is then nudged off by far less than
+    // that roundoff: only the stages past the rounded differences see it.
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> offset(-1 << 20, 1 << 20);
+    std::uniform_int_distribution<int> small(1, 1 << 10);
+    const double nudges[] = {0.0, 0x1p-75, -0x1p-75, 0x1p-100, -0x1p-100};
+    const auto tiny = [&] { return small(rng) * 0x1p-60; };
+
+    SUBCASE("orient3d off the plane z = x") {
+        // The determinant is -nudge orient2d(a, b, c).
+        for (auto n = 0; n < 500; n++) {
+            const auto nudge = nudges[n % 5];
+            std::array<std::array<Wide, 2>, 3> p;
+            std::array<Vec3d, 3> v;
+            for (auto k = 0u; k < 3; k++) {
+                p[k] = {offset(rng), offset(rng)};
+                v[k] = Vec3d{double(p[k][0]), double(p[k][1]),
+                             double(p[k][0])};
+            }
+            const auto dx = tiny();
+            const Vec3d d{dx, tiny(), dx + nudge};
+            CHECK_EQ(sign(orient3d(v[0], v[1], v[2], d)),
+                     -sign(nudge) * sign(orient2d_reference(p[0], p[1],
+                                                            p[2])));
+        }
+    }
+
+    SUBCASE("incircle off the line y = x") {
+        // The determinant is 2 nudge (xb - xa) (xc - xa) (xc - xb).
+        for (auto n = 0; n < 500; n++) {
+            const auto nudge = nudges[n % 5];
+            const std::array<Wide, 3> x{offset(rng), offset(rng),
+                                        offset(rng)};
+            std::array<Vec2d, 3> v;
+            for (auto k = 0u; k < 3; k++) {
+                v[k] = Vec2d{double(x[k]), double(x[k])};
+            }
+            const auto dx = tiny();
+            const Vec2d d{dx, dx + nudge};
+            CHECK_EQ(sign(incircle(v[0], v[1], v[2], d)),
+                     sign(nudge) *
+                         sign((x[1] - x[0]) * (x[2] - x[0]) * (x[2] - x[1])));
+        }
+    }
+
+    SUBCASE("insphere off the plane z = x") {
+        // The determinant is -nudge times that of the rows
+        // (x, y, 1, 2 x^2 + y^2) of a, b, c, d.
+        for (auto n = 0; n < 500; n++) {
+            const auto nudge = nudges[n % 5];
+            std::array<std::array<Wide, 4>, 4> m;
+            std::array<Vec3d, 4> v;
+            for (auto k = 0u; k < 4; k++) {
+                const Wide x = offset(rng), y = offset(rng);
+                m[k] = {x, y, 1, 2 * x * x + y * y};
+                v[k] = Vec3d{double(x), double(y), double(x)};
+            }
+            const auto ex = tiny();
+            const Vec3d e{ex, tiny(), ex + nudge};
+            CHECK_EQ(sign(insphere(v[0], v[1], v[2], v[3], e)),
+                     -sign(nudge) * sign(det4(m)));
+        }
+    }
+}
+
+TEST_CASE("predicates: batched versions match scalar ones") {
+    // Half of the elements are random, half lie on a small grid, where
+    // many are degenerate and take the exact path.
+    constexpr std::size_t size = 2000;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::uniform_int_distribution<int> grid(0, 3);
+    const auto value = [&](std::size_t i) {
+        return i % 2 == 0 ? dist(rng) : 0.1 * grid(rng);
+    };
+    std::array<VecBatch<double, 2>, 4> p2;
+    std::array<VecBatch<double, 3>, 5> p3;
+    for (auto &b : p2) {
+        b.resize(size);
+    }
+    for (auto &b : p3) {
+        b.resize(size);
+    }
+    for (std::size_t i = 0; i < size; i++) {
+        for (auto &b : p2) {
+            b.get(0, i) = value(i);
+            b.get(1, i) = value(i);
+        }
+        for (auto &b : p3) {
+            for (auto d = 0u; d < 3; d++) {
+                b.get(d, i) = value(i);
+            }
+        }
+    }
+    const auto v2 = [&](std::size_t k, std::size_t i) {
+        return Vec2d{p2[k].get(0, i), p2[k].get(1, i)};
+    };
+    const auto v3 = [&](std::size_t k, std::size_t i) {
+        return Vec3d{p3[k].get(0, i), p3[k].get(1, i), p3[k].get(2, i)};
+    };
+
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        std::vector<double> out(size);
+
+        auto exact = orient2d(p2[0], p2[1], p2[2], out, pool);
+        CHECK(exact > 0);
+        for (std::size_t i = 0; i < size; i++) {
+            CHECK_EQ(out[i], orient2d(v2(0, i), v2(1, i), v2(2, i)));
+        }
+
+        exact = incircle(p2[0], p2[1], p2[2], p2[3], out, pool);
+        CHECK(exact > 0);
+        for (std::size_t i = 0; i < size; i++) {
+            CHECK_EQ(out[i],
+                     incircle(v2(0, i), v2(1, i), v2(2, i), v2(3, i)));
+        }
+
+        exact = orient3d(p3[0], p3[1], p3[2], p3[3], out, pool);
+        CHECK(exact > 0);
+        for (std::size_t i = 0; i < size; i++) {
+            CHECK_EQ(out[i],
+                     orient3d(v3(0, i), v3(1, i), v3(2, i), v3(3, i)));
+        }
+
+        exact = insphere(p3[0], p3[1], p3[2], p3[3], p3[4], out, pool);
+        CHECK(exact > 0);
+        for (std::size_t i = 0; i < size; i++) {
+            CHECK_EQ(out[i], insphere(v3(0, i), v3(1, i), v3(2, i),
+                                      v3(3, i), v3(4, i)));
+        }
+    });
+}
+
+TEST_CASE("predicates: batched size mismatches throw") {
+    VecBatch<double, 2> a(4), b(4), c(3);
+    std::vector<double> out(4);
+    CHECK_THROWS_AS(orient2d(a, b, c, out), std::invalid_argument);
+    std::vector<double> short_out(3);
+    CHECK_THROWS_AS(orient2d(a, b, a, short_out), std::invalid_argument);
+    CHECK_NOTHROW(orient2d(a, b, a, out));
+}
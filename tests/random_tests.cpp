@@ -0,0 +1,128 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "random.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <vector>
+
+using namespace cml;
+
+#define FLOATING_TYPES float, double
+
+TEST_CASE("Random: Philox4x32-10 known answers") {
+    const Philox4x32 zero(Philox4x32::Key{0, 0});
+    CHECK(zero({0, 0, 0, 0}) ==
+          Philox4x32::Counter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+
+    const Philox4x32 ones(Philox4x32::Key{0xffffffff, 0xffffffff});
+    CHECK(ones({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}) ==
+          Philox4x32::Counter{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+
+    std::array<std::uint32_t, 4> lanes[4] = {};
+    Philox4x32::generate(lanes, zero.key());
+    CHECK(lanes[0][3] == 0x6627e8d5);
+    CHECK(lanes[3][2] == 0x9b00dbd8);
+}
+
+TEST_CASE("Random: xoshiro256** streams") {
+    Xoshiro256 a(42);
+    Xoshiro256 b(42);
+    CHECK(a() == b());
+
+    auto jumped = Xoshiro256::stream(42, 1);
+    Xoshiro256 c(42);
+    c.jump();
+    CHECK(jumped == c);
+    CHECK(jumped() != Xoshiro256(42)());
+}
+
+TEST_CASE_TEMPLATE("Random: uniform box is reproducible across pools", T,
+                   FLOATING_TYPES) {
+    const Vec3<T> lo(T(-1), T(0), T(2));
+    const Vec3<T> hi(T(1), T(5), T(3));
+
+    std::vector<Vec3<T>> serial(50000);
+    ThreadPool one(1);
+    fill_uniform_box(std::span<Vec3<T>>(serial), lo, hi, 7, 0, one);
+
+    std::vector<Vec3<T>> parallel(50000);
+    ThreadPool four(4);
+    fill_uniform_box(std::span<Vec3<T>>(parallel), lo, hi, 7, 0, four);
+    CHECK(serial == parallel);
+
+    std::vector<Vec3<T>> tail(100);
+    fill_uniform_box(std::span<Vec3<T>>(tail), lo, hi, 7, 1000, four);
+    CHECK(tail[0] == serial[1000]);
+
+    Vec3<T> mean;
+    for (const auto &v : serial) {
+        for (auto d = 0u; d < 3; d++) {
+            CHECK(v[d] >= lo[d]);
+            CHECK(v[d] < hi[d]);
+        }
+        mean += v / T(serial.size());
+    }
+    CHECK(mean.x() == doctest::Approx(0).epsilon(0.02));
+    CHECK(mean.y() == doctest::Approx(2.5).epsilon(0.02));
+    CHECK(mean.z() == doctest::Approx(2.5).epsilon(0.02));
+
+    VecBatch<T, 3> batch(50000);
+    fill_uniform_box(batch, lo, hi, 7, 0, four);
+    CHECK(batch.template operator[]<double>(123) == serial[123]);
+}
+
+TEST_CASE_TEMPLATE("Random: directions", T, FLOATING_TYPES) {
+    std::vector<Vec3<T>> dirs(20000);
+    fill_uniform_sphere(std::span<Vec3<T>>(dirs), 1);
+    Vec3<T> mean;
+    for (const auto &d : dirs) {
+        CHECK(d.length() == doctest::Approx(1).epsilon(1e-5));
+        mean += d / T(dirs.size());
+    }
+    CHECK(mean.length() < 0.03);
+
+    std::vector<Vec3<T>> hemi(20000);
+    fill_cosine_hemisphere(std::span<Vec3<T>>(hemi), 2);
+    double mean_cos = 0;
+    for (const auto &d : hemi) {
+        CHECK(d.length() == doctest::Approx(1).epsilon(1e-5));
+        CHECK(d.z() >= 0);
+        mean_cos += double(d.z()) / double(hemi.size());
+    }
+    // E[cos(theta)] = 2/3 for a cosine-weighted hemisphere.
+    CHECK(mean_cos == doctest::Approx(2. / 3.).epsilon(0.02));
+
+    std::vector<Vec<T, 5>> dirs5(1000);
+    fill_uniform_sphere(std::span<Vec<T, 5>>(dirs5), 3);
+    for (const auto &d : dirs5) {
+        CHECK(d.length() == doctest::Approx(1).epsilon(1e-5));
+    }
+
+    std::vector<Vec2<T>> disk(20000);
+    fill_uniform_disk(std::span<Vec2<T>>(disk), 4);
+    double mean_r2 = 0;
+    for (const auto &p : disk) {
+        CHECK(p.length_sq() <= 1);
+        mean_r2 += double(p.length_sq()) / double(disk.size());
+    }
+    CHECK(mean_r2 == doctest::Approx(0.5).epsilon(0.02));
+}
+
+TEST_CASE_TEMPLATE("Random: gaussian moments", T, FLOATING_TYPES) {
+    VecBatch<T, 3> samples(100000);
+    fill_gaussian(samples, Vec3<T>(T(1), T(-2), T(0)), T(2), 9);
+    for (auto d = 0u; d < 3; d++) {
+        double mean = 0;
+        double sq = 0;
+        for (const auto x : samples.component(d)) {
+            mean += double(x);
+            sq += double(x) * double(x);
+        }
+        mean /= double(samples.size());
+        const auto var = sq / double(samples.size()) - mean * mean;
+        CHECK(std::abs(mean - (d == 0 ? 1. : d == 1 ? -2. : 0.)) < 0.03);
+        CHECK(var == doctest::Approx(4).epsilon(0.03));
+    }
+}
@@ -0,0 +1,266 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "aabb.hpp"
+#include "doctest/doctest.h"
+#include "random.hpp"
+#include "ray.hpp"
+#include "vector.hpp"
+#include <array>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+using Triangle = std::array<Vec3f, 3>;
+
+template <unsigned int W> using Width = std::integral_constant<unsigned int, W>;
+
+struct Scene {
+    std::vector<Triangle> triangles;
+    std::vector<Ray<float>> rays;
+};
+
+// Small random triangles in a unit-ish cube and rays aimed through it, so
+// that a good fraction of the rays hit something.
+Scene random_scene(std::size_t triangles, std::size_t rays) {
+    Scene scene;
+    std::vector<Vec3f> centers(triangles);
+    std::vector<Vec3f> offsets(3 * triangles);
+    fill_uniform_box(std::span<Vec3f>(centers), Vec3f(-1.f, -1.f, -1.f),
+                     Vec3f(1.f, 1.f, 1.f), 1);
+    fill_uniform_box(std::span<Vec3f>(offsets), Vec3f(-.4f, -.4f, -.4f),
+                     Vec3f(.4f, .4f, .4f), 2);
+    for (auto i = 0u; i < triangles; i++) {
+        scene.triangles.push_back({centers[i] + offsets[3 * i],
+                                   centers[i] + offsets[3 * i + 1],
+                                   centers[i] + offsets[3 * i + 2]});
+    }
+    std::vector<Vec3f> origins(rays);
+    std::vector<Vec3f> targets(rays);
+    fill_uniform_sphere(std::span<Vec3f>(origins), 3);
+    fill_uniform_box(std::span<Vec3f>(targets), Vec3f(-1.f, -1.f, -1.f),
+                     Vec3f(1.f, 1.f, 1.f), 4);
+    for (auto i = 0u; i < rays; i++) {
+        const auto origin = origins[i] * 4.f;
+        scene.rays.emplace_back(origin, targets[i] - origin, 0.f, 10.f);
+    }
+    // Axis-aligned directions exercise the infinite inverse directions.
+    scene.rays.emplace_back(Vec3f(0.1f, 0.2f, -5.f), Vec3f(0.f, 0.f, 1.f));
+    scene.rays.emplace_back(Vec3f(-5.f, 0.1f, 0.2f), Vec3f(1.f, 0.f, 0.f));
+    return scene;
+}
+
+template <typename Intersect>
+std::optional<std::pair<std::uint32_t, TriangleHit<float>>>
+closest(const Scene &scene, Intersect &&intersect) {
+    std::optional<std::pair<std::uint32_t, TriangleHit<float>>> best;
+    for (auto i = 0u; i < scene.triangles.size(); i++) {
+        const auto hit = intersect(scene.triangles[i]);
+        if (hit && (!best || hit->t < best->second.t)) {
+            best = {i, *hit};
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+TEST_CASE("Scalar ray-triangle intersection") {
+    const Vec3f a(0.f, 0.f, 0.f);
+    const Vec3f b(1.f, 0.f, 0.f);
+    const Vec3f c(0.f, 1.f, 0.f);
+    const Ray<float> ray(Vec3f(0.25f, 0.5f, 2.f), Vec3f(0.f, 0.f, -1.f));
+    CHECK(ray.at(2.f) == Vec3f(0.25f, 0.5f, 0.f));
+
+    const auto mt = intersect_moller_trumbore(ray, a, b, c);
+    const auto wt = intersect_watertight(WatertightRay<float>(ray), a, b, c);
+    REQUIRE(mt);
+    REQUIRE(wt);
+    for (const auto &hit : {*mt, *wt}) {
+        CHECK(hit.t == doctest::Approx(2.f));
+        CHECK(hit.u == doctest::Approx(0.25f));
+        CHECK(hit.v == doctest::Approx(0.5f));
+    }
+    // Either winding, and back faces.
+    CHECK(intersect_moller_trumbore(ray, a, c, b));
+    CHECK(intersect_watertight(WatertightRay<float>(ray), a, c, b));
+    const Ray<float> up(Vec3f(0.25f, 0.5f, -2.f), Vec3f(0.f, 0.f, 1.f));
+    CHECK(intersect_watertight(WatertightRay<float>(up), a, b, c));
+
+    const Ray<float> past(Vec3f(0.25f, 0.5f, 2.f), Vec3f(0.f, 0.f, -1.f), 0.f,
+                          1.f);
+    CHECK_FALSE(intersect_moller_trumbore(past, a, b, c));
+    CHECK_FALSE(intersect_watertight(WatertightRay<float>(past), a, b, c));
+    const Ray<float> miss(Vec3f(0.75f, 0.5f, 2.f), Vec3f(0.f, 0.f, -1.f));
+    CHECK_FALSE(intersect_moller_trumbore(miss, a, b, c));
+    CHECK_FALSE(intersect_watertight(WatertightRay<float>(miss), a, b, c));
+}
+
+TEST_CASE("Watertight test has no cracks along a shared edge") {
+    // Two triangles sharing the diagonal of a planar quad; every ray aimed
+    // at a point of the diagonal must hit at least one of them.
+    const Vec3f p0(0.1f, 0.3f, 0.7f);
+    const Vec3f p1(1.3f, 0.2f, 0.7f);
+    const Vec3f p2(1.1f, 1.7f, 0.7f);
+    const Vec3f p3(0.2f, 1.1f, 0.7f);
+    std::vector<Vec3f> origins(20000);
+    fill_uniform_sphere(std::span<Vec3f>(origins), 7);
+    for (auto i = 0u; i < origins.size(); i++) {
+        const auto s = float(i) / float(origins.size());
+        const auto target = p0 + (p2 - p0) * s;
+        const auto origin = target + origins[i] * 3.f;
+        const WatertightRay<float> ray(Ray<float>(origin, target - origin));
+        const auto first = intersect_watertight(ray, p0, p1, p2);
+        const auto second = intersect_watertight(ray, p0, p2, p3);
+        CHECK((first || second));
+    }
+}
+
+TEST_CASE_TEMPLATE("Ray packets match scalar closest hits", WidthT, Width<4>,
+                   Width<8>, Width<16>) {
+    constexpr auto W = WidthT::value;
+    const auto scene = random_scene(200, 5 * W + 3);
+    for (auto first = 0u; first < scene.rays.size(); first += W) {
+        RayPacket<float, W> packet;
+        const auto lanes = std::min<std::size_t>(W, scene.rays.size() - first);
+        for (auto l = 0u; l < lanes; l++) {
+            packet.set(l, scene.rays[first + l]);
+        }
+        const WatertightRayPacket<float, W> watertight(packet);
+        PacketHits<float, W> mt_hits(packet);
+        PacketHits<float, W> wt_hits(packet);
+        for (auto i = 0u; i < scene.triangles.size(); i++) {
+            const auto &tri = scene.triangles[i];
+            intersect_moller_trumbore(packet, tri[0], tri[1], tri[2], i,
+                                      mt_hits);
+            intersect_watertight(watertight, tri[0], tri[1], tri[2], i,
+                                 wt_hits);
+        }
+        for (auto l = 0u; l < lanes; l++) {
+            const auto &ray = scene.rays[first + l];
+            const auto mt = closest(scene, [&](const Triangle &tri) {
+                return intersect_moller_trumbore(ray, tri[0], tri[1], tri[2]);
+            });
+            const WatertightRay<float> wray(ray);
+            const auto wt = closest(scene, [&](const Triangle &tri) {
+                return intersect_watertight(wray, tri[0], tri[1], tri[2]);
+            });
+            REQUIRE(mt.has_value() ==
+                    (mt_hits.primitive[l] != PacketHits<float, W>::no_hit));
+            REQUIRE(wt.has_value() ==
+                    (wt_hits.primitive[l] != PacketHits<float, W>::no_hit));
+            if (mt) {
+                CHECK(mt_hits.primitive[l] == mt->first);
+                CHECK(mt_hits.t[l] == doctest::Approx(mt->second.t));
+                CHECK(mt_hits.u[l] == doctest::Approx(mt->second.u));
+                CHECK(mt_hits.v[l] == doctest::Approx(mt->second.v));
+            }
+            if (wt) {
+                CHECK(wt_hits.primitive[l] == wt->first);
+                CHECK(wt_hits.t[l] == doctest::Approx(wt->second.t));
+            }
+        }
+        for (auto l = lanes; l < W; l++) {
+            CHECK(mt_hits.primitive[l] == PacketHits<float, W>::no_hit);
+        }
+    }
+}
+
+TEST_CASE_TEMPLATE("Triangle packets match scalar closest hits", WidthT,
+                   Width<4>, Width<8>, Width<16>) {
+    constexpr auto W = WidthT::value;
+    const auto scene = random_scene(3 * W - 1, 300);
+    std::vector<TrianglePacket<float, W>> packets(
+        (scene.triangles.size() + W - 1) / W);
+    for (auto i = 0u; i < scene.triangles.size(); i++) {
+        const auto &tri = scene.triangles[i];
+        packets[i / W].set(i % W, tri[0], tri[1], tri[2]);
+    }
+    std::size_t hits = 0;
+    for (const auto &ray : scene.rays) {
+        const WatertightRay<float> wray(ray);
+        std::optional<std::pair<std::uint32_t, TriangleHit<float>>> mt, wt;
+        for (auto p = 0u; p < packets.size(); p++) {
+            const auto a = intersect_moller_trumbore(ray, packets[p]);
+            if (a && (!mt || a->hit.t < mt->second.t)) {
+                mt = {p * W + a->lane, a->hit};
+            }
+            const auto b = intersect_watertight(wray, packets[p]);
+            if (b && (!wt || b->hit.t < wt->second.t)) {
+                wt = {p * W + b->lane, b->hit};
+            }
+        }
+        const auto mt_ref = closest(scene, [&](const Triangle &tri) {
+            return intersect_moller_trumbore(ray, tri[0], tri[1], tri[2]);
+        });
+        const auto wt_ref = closest(scene, [&](const Triangle &tri) {
+            return intersect_watertight(wray, tri[0], tri[1], tri[2]);
+        });
+        REQUIRE(mt.has_value() == mt_ref.has_value());
+        REQUIRE(wt.has_value() == wt_ref.has_value());
+        if (mt) {
+            hits++;
+            CHECK(mt->first == mt_ref->first);
+            CHECK(mt->second.t == doctest::Approx(mt_ref->second.t));
+        }
+        if (wt) {
+            CHECK(wt->first == wt_ref->first);
+            CHECK(wt->second.u == doctest::Approx(wt_ref->second.u));
+        }
+    }
+    CHECK(hits > 0);
+}
+
+TEST_CASE_TEMPLATE("AABB packet slab tests match Aabb::intersect_ray", WidthT,
+                   Width<4>, Width<8>, Width<16>) {
+    constexpr auto W = WidthT::value;
+    const auto scene = random_scene(W, 4 * W);
+    std::vector<Aabbf> boxes;
+    AabbPacket<float, W> box_packet;
+    for (auto i = 0u; i < W - 1; i++) {
+        Aabbf box;
+        for (const auto &v : scene.triangles[i]) {
+            box.expand(v);
+        }
+        boxes.push_back(box);
+        box_packet.set(i, box);
+    }
+    // Lane W - 1 stays empty.
+    for (auto first = 0u; first + W <= scene.rays.size(); first += W) {
+        RayPacket<float, W> packet;
+        for (auto l = 0u; l < W; l++) {
+            packet.set(l, scene.rays[first + l]);
+        }
+        for (const auto &box : boxes) {
+            std::array<float, W> t_entry;
+            const auto mask =
+                intersect_aabb(packet, box, packet.t_max, t_entry);
+            for (auto l = 0u; l < W; l++) {
+                const auto &ray = scene.rays[first + l];
+                const Vec3f inv(1.f / ray.dir.x(), 1.f / ray.dir.y(),
+                                1.f / ray.dir.z());
+                float t = ray.t_min;
+                const bool hit = box.intersect_ray(ray.origin, inv, t,
+                                                   ray.t_max);
+                CHECK(bool(mask >> l & 1) == hit);
+                if (hit) {
+                    CHECK(t_entry[l] == t);
+                }
+            }
+        }
+    }
+    for (const auto &ray : scene.rays) {
+        const Vec3f inv(1.f / ray.dir.x(), 1.f / ray.dir.y(),
+                        1.f / ray.dir.z());
+        std::array<float, W> t_entry;
+        const auto mask = intersect_aabbs(ray, inv, box_packet, t_entry);
+        CHECK((mask >> (W - 1) & 1) == 0);
+        for (auto i = 0u; i + 1 < W; i++) {
+            float t = ray.t_min;
+            CHECK(bool(mask >> i & 1) ==
+                  boxes[i].intersect_ray(ray.origin, inv, t, ray.t_max));
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "reductions.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <span>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <typename T>
+std::vector<Vec3<T>> random_points(std::size_t count, T offset,
+                                   unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<T> dist(T(0), T(1));
+    std::vector<Vec3<T>> points(count);
+    for (auto &p : points) {
+        const auto a = dist(rng);
+        // Correlated components with different scales.
+        p = Vec3<T>{offset + a, offset + a * T(0.5) + dist(rng) * T(0.1),
+                    offset - dist(rng) * T(3)};
+    }
+    return points;
+}
+
+// Two-pass reference in long double.
+struct Reference {
+    std::array<long double, 3> min, max, sum{}, mean{};
+    std::array<std::array<long double, 3>, 3> covariance{};
+    long double length_sq = 0;
+
+    template <typename T> explicit Reference(const std::vector<Vec3<T>> &p) {
+        min.fill(std::numeric_limits<long double>::max());
+        max.fill(std::numeric_limits<long double>::lowest());
+        for (const auto &v : p) {
+            for (auto d = 0u; d < 3; d++) {
+                min[d] = std::min<long double>(min[d], v[d]);
+                max[d] = std::max<long double>(max[d], v[d]);
+                sum[d] += v[d];
+                length_sq += (long double)v[d] * v[d];
+            }
+        }
+        for (auto d = 0u; d < 3; d++) {
+            mean[d] = sum[d] / p.size();
+        }
+        for (const auto &v : p) {
+            for (auto d = 0u; d < 3; d++) {
+                for (auto e = 0u; e < 3; e++) {
+                    covariance[d][e] += (v[d] - mean[d]) * (v[e] - mean[e]);
+                }
+            }
+        }
+        for (auto &row : covariance) {
+            for (auto &c : row) {
+                c /= p.size();
+            }
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE_TEMPLATE("reduce_points matches a two-pass reference", T, float,
+                   double) {
+    // Not a multiple of the block or task size.
+    const auto points = random_points<T>(100'003, T(0), 1);
+    const Reference ref(points);
+    const double epsilon = sizeof(T) == 4 ? 1e-4 : 1e-10;
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        const auto stats = reduce_points(points, PointReduction::all(), pool);
+        CHECK(stats.count == points.size());
+        for (auto d = 0u; d < 3; d++) {
+            CHECK(stats.min[d] == T(ref.min[d]));
+            CHECK(stats.max[d] == T(ref.max[d]));
+            CHECK(stats.sum[d] ==
+                  doctest::Approx(double(ref.sum[d])).epsilon(epsilon));
+            CHECK(stats.mean[d] ==
+                  doctest::Approx(double(ref.mean[d])).epsilon(epsilon));
+            for (auto e = 0u; e < 3; e++) {
+                CHECK(stats.covariance.get(d, e) ==
+                      doctest::Approx(double(ref.covariance[d][e]))
+                          .epsilon(epsilon));
+            }
+        }
+        CHECK(stats.length_sq_sum ==
+              doctest::Approx(double(ref.length_sq)).epsilon(epsilon));
+    });
+}
+
+TEST_CASE("the result does not depend on the pool size") {
+    const auto points = random_points<float>(200'000, 10.0f, 2);
+    ThreadPool one(1), four(4);
+    const auto a = reduce_points(points, PointReduction::all(), one);
+    const auto b = reduce_points(points, PointReduction::all(), four);
+    for (auto d = 0u; d < 3; d++) {
+        CHECK(a.sum[d] == b.sum[d]);
+        CHECK(a.mean[d] == b.mean[d]);
+        for (auto e = 0u; e < 3; e++) {
+            CHECK(a.covariance.get(d, e) == b.covariance.get(d, e));
+        }
+    }
+    CHECK(a.length_sq_sum == b.length_sq_sum);
+}
+
+TEST_CASE("covariance survives a large offset") {
+    // In float, E[x^2] - E[x]^2 would lose every digit of the variance.
+    const auto points = random_points<float>(100'000, 1e4f, 3);
+    const Reference ref(points);
+    const auto stats = reduce_points(points, {.covariance = true});
+    for (auto d = 0u; d < 3; d++) {
+        CHECK(stats.mean[d] ==
+              doctest::Approx(double(ref.mean[d])).epsilon(1e-6));
+        CHECK(stats.covariance.get(d, d) ==
+              doctest::Approx(double(ref.covariance[d][d])).epsilon(1e-2));
+    }
+}
+
+TEST_CASE("only the requested statistics are computed") {
+    const auto points = random_points<double>(1000, 1.0, 4);
+    const auto stats = reduce_points(points, {.min = true, .max = true});
+    CHECK(stats.count == 1000);
+    CHECK(stats.min[0] < stats.max[0]);
+    CHECK(stats.sum == Vec3d{});
+    CHECK(stats.mean == Vec3d{});
+    CHECK(stats.covariance.get(1, 1) == 0);
+    CHECK(stats.length_sq_sum == 0);
+
+    const auto empty =
+        reduce_points(std::span<const Vec3d>(), PointReduction::all());
+    CHECK(empty.count == 0);
+    CHECK(empty.min[0] == std::numeric_limits<double>::max());
+    CHECK(empty.mean == Vec3d{});
+}
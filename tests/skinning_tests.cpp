@@ -0,0 +1,119 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "skinning.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vec_mat_operations.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+TEST_CASE_TEMPLATE("linear_blend_skin matches blended matrices", T, float,
+                   double) {
+    constexpr std::size_t vertices = 1000;
+    constexpr std::uint32_t bones = 7;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+    std::uniform_int_distribution<std::uint32_t> bone(0, bones - 1);
+
+    std::vector<Mat4<T>> palette(bones);
+    for (auto &m : palette) {
+        m = Mat4<T>::identity();
+        for (auto row = 0u; row < 3; row++) {
+            for (auto col = 0u; col < 4; col++) {
+                m.get(row, col) += dist(rng);
+            }
+        }
+    }
+    SkinInfluences<T, 3> influences(vertices);
+    VecBatch<T, 3> positions(vertices), normals(vertices);
+    for (std::size_t i = 0; i < vertices; i++) {
+        T total = 0;
+        for (auto k = 0u; k < 3; k++) {
+            influences.bones.get(k, i) = bone(rng);
+            // Every fifth vertex has a single influence.
+            influences.weights.get(k, i) =
+                i % 5 == 0 && k > 0 ? T(0) : dist(rng) + T(1.5);
+            total += influences.weights.get(k, i);
+        }
+        for (auto k = 0u; k < 3; k++) {
+            influences.weights.get(k, i) /= total;
+        }
+        for (auto d = 0u; d < 3; d++) {
+            positions.get(d, i) = dist(rng) * 10;
+            normals.get(d, i) = dist(rng);
+        }
+    }
+
+    ThreadPool pool(3);
+    for_each_isa([&] {
+        VecBatch<T, 3> out, out_positions, out_normals;
+        linear_blend_skin<T>(palette, influences, positions, out, pool);
+        linear_blend_skin<T>(palette, influences, positions, normals,
+                             out_positions, out_normals, pool);
+        REQUIRE(out.size() == vertices);
+        for (std::size_t i = 0; i < vertices; i++) {
+            Mat4<T> m;
+            for (auto k = 0u; k < 3; k++) {
+                m = m + palette[influences.bones.get(k, i)] *
+                            influences.weights.get(k, i);
+            }
+            const auto p = positions[i];
+            const auto n = normals[i];
+            for (auto row = 0u; row < 3; row++) {
+                const auto expected = m.get(row, 0) * p[0] +
+                                      m.get(row, 1) * p[1] +
+                                      m.get(row, 2) * p[2] + m.get(row, 3);
+                const auto expected_normal = m.get(row, 0) * n[0] +
+                                             m.get(row, 1) * n[1] +
+                                             m.get(row, 2) * n[2];
+                CHECK(out.get(row, i) ==
+                      doctest::Approx(expected).epsilon(1e-5));
+                CHECK(out_positions.get(row, i) ==
+                      doctest::Approx(expected).epsilon(1e-5));
+                CHECK(out_normals.get(row, i) ==
+                      doctest::Approx(expected_normal).epsilon(1e-5));
+            }
+        }
+    });
+}
+
+TEST_CASE("a single full-weight bone is a plain transform") {
+    const std::vector<Mat4d> palette{
+        Mat4d::identity(), translate(Mat4d::identity(), Vec3d{1.0, 2.0, 3.0})};
+    SkinInfluences<double, 1> influences(2);
+    influences.bones.get(0, 0) = 1;
+    influences.bones.get(0, 1) = 0;
+    influences.weights.get(0, 0) = 1;
+    influences.weights.get(0, 1) = 1;
+    VecBatch<double, 3> positions(2), out;
+    positions.get(0, 0) = 5;
+    positions.get(0, 1) = 5;
+    linear_blend_skin<double>(palette, influences, positions, out);
+    CHECK(out.get(0, 0) == 6);
+    CHECK(out.get(1, 0) == 2);
+    CHECK(out.get(2, 0) == 3);
+    CHECK(out.get(0, 1) == 5);
+    CHECK(out.get(2, 1) == 0);
+}
+
+TEST_CASE("linear_blend_skin checks its inputs") {
+    const std::vector<Mat4f> palette(2, Mat4f::identity());
+    SkinInfluences<float> influences(3);
+    VecBatch<float, 3> positions(4), out;
+    CHECK_THROWS_AS(
+        linear_blend_skin<float>(palette, influences, positions, out),
+        std::invalid_argument);
+    positions.resize(3);
+    CHECK_THROWS_AS(linear_blend_skin<float>({}, influences, positions, out),
+                    std::invalid_argument);
+    CHECK_NOTHROW(
+        linear_blend_skin<float>(palette, influences, positions, out));
+}
@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "random.hpp"
+#include "spatial_hash.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <unsigned int Dim>
+std::vector<Vec<float, Dim>> random_points(std::size_t count, float extent,
+                                           std::uint64_t seed) {
+    Vec<float, Dim> lo;
+    Vec<float, Dim> hi;
+    for (auto d = 0u; d < Dim; d++) {
+        lo[d] = -extent;
+        hi[d] = extent;
+    }
+    std::vector<Vec<float, Dim>> points(count);
+    fill_uniform_box(std::span<Vec<float, Dim>>(points), lo, hi, seed);
+    return points;
+}
+
+template <unsigned int Dim>
+float distance_sq(const Vec<float, Dim> &a, const Vec<float, Dim> &b) {
+    float sum = 0;
+    for (auto d = 0u; d < Dim; d++) {
+        sum += (a[d] - b[d]) * (a[d] - b[d]);
+    }
+    return sum;
+}
+
+} // namespace
+
+TEST_CASE("SpatialHashGrid sorted layout is a stable permutation") {
+    const auto points = random_points<3>(300000, 50.f, 1);
+    ThreadPool pool(4);
+    const SpatialHashGrid<float, 3> grid(1.f,
+                                         std::span<const Vec3f>(points), pool);
+    REQUIRE(grid.size() == points.size());
+    std::vector<bool> seen(points.size(), false);
+    for (auto pos = 0u; pos < grid.size(); pos++) {
+        const auto index = grid.sorted_indices()[pos];
+        CHECK_FALSE(seen[index]);
+        seen[index] = true;
+        CHECK(grid.sorted_points()[pos] == points[index]);
+    }
+
+    ThreadPool single(1);
+    const SpatialHashGrid<float, 3> serial(
+        1.f, std::span<const Vec3f>(points), single);
+    CHECK(std::equal(grid.sorted_indices().begin(),
+                     grid.sorted_indices().end(),
+                     serial.sorted_indices().begin()));
+}
+
+TEST_CASE("SpatialHashGrid neighbor queries match brute force") {
+    const auto points = random_points<2>(3000, 10.f, 2);
+    const auto queries = random_points<2>(100, 11.f, 3);
+    SpatialHashGrid<float, 2> grid(0.5f);
+    grid.build(std::span<const Vec2f>(points));
+    // Smaller, equal and larger than the cell size.
+    for (const float radius : {0.3f, 0.5f, 1.7f}) {
+        for (const auto &q : queries) {
+            std::vector<std::uint32_t> found;
+            grid.for_each_neighbor(q, radius, [&](std::uint32_t i, float d) {
+                CHECK(d == doctest::Approx(distance_sq(points[i], q)));
+                found.push_back(i);
+            });
+            std::vector<std::uint32_t> expected;
+            for (auto i = 0u; i < points.size(); i++) {
+                if (distance_sq(points[i], q) <= radius * radius) {
+                    expected.push_back(i);
+                }
+            }
+            std::sort(found.begin(), found.end());
+            CHECK(found == expected);
+        }
+    }
+}
+
+TEST_CASE("SpatialHashGrid reports every close pair once") {
+    const auto points = random_points<3>(2000, 5.f, 4);
+    ThreadPool pool(3);
+    SpatialHashGrid<float, 3> grid(0.6f);
+    grid.build(std::span<const Vec3f>(points), pool);
+
+    std::mutex mutex;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pairs;
+    grid.for_each_pair(
+        0.6f,
+        [&](std::uint32_t i, std::uint32_t j, float) {
+            std::lock_guard lock(mutex);
+            pairs.emplace_back(std::min(i, j), std::max(i, j));
+        },
+        pool);
+    std::sort(pairs.begin(), pairs.end());
+    CHECK(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> expected;
+    for (auto i = 0u; i < points.size(); i++) {
+        for (auto j = i + 1; j < points.size(); j++) {
+            if (distance_sq(points[i], points[j]) <= 0.36f) {
+                expected.emplace_back(i, j);
+            }
+        }
+    }
+    CHECK(pairs == expected);
+}
+
+TEST_CASE("SpatialHashGrid rebuilds and handles empty input") {
+    SpatialHashGrid<float, 3> grid(1.f);
+    grid.build(std::span<const Vec3f>());
+    CHECK(grid.empty());
+    std::atomic<int> calls = 0;
+    grid.for_each_neighbor(Vec3f(0.f, 0.f, 0.f), 1.f,
+                           [&](std::uint32_t, float) { calls++; });
+    grid.for_each_pair(1.f,
+                       [&](std::uint32_t, std::uint32_t, float) { calls++; });
+    CHECK(calls == 0);
+
+    auto points = random_points<3>(500, 3.f, 5);
+    grid.build(std::span<const Vec3f>(points));
+    for (auto &p : points) {
+        p = p + Vec3f(0.25f, 0.f, -0.25f);
+    }
+    points.resize(400);
+    grid.build(std::span<const Vec3f>(points));
+    REQUIRE(grid.size() == 400);
+    std::size_t found = 0;
+    grid.for_each_neighbor(points[7], 0.f, [&](std::uint32_t i, float d) {
+        CHECK(d == 0.f);
+        found += i == 7;
+    });
+    CHECK(found == 1);
+}
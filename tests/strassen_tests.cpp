@@ -0,0 +1,82 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "dynamic_matrix.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "strassen.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <stdexcept>
+
+using namespace cml;
+
+TEST_CASE_TEMPLATE("strassen_multiply matches gemm", T, float, double) {
+    const double epsilon = sizeof(T) == 4 ? 1e-4 : 1e-13;
+    // Recursing down to 1 x 1 blocks grows the error with every level.
+    const double deep_epsilon = sizeof(T) == 4 ? 1e-2 : 1e-11;
+    for (const unsigned int threads : {1u, 4u}) {
+        ThreadPool pool(threads);
+        for (const std::size_t n : {1, 16, 17, 64, 67, 130}) {
+            const auto a = random_matrix<T>(n, n, 1);
+            const auto b = random_matrix<T>(n, n, 2);
+            const auto expected = a * b;
+            check_close(strassen_multiply(a, b, pool, 16), expected,
+                        epsilon);
+            check_close(strassen_multiply(a, b, pool, 1), expected,
+                        deep_epsilon);
+        }
+    }
+}
+
+TEST_CASE("strassen_multiply below the cutoff is gemm") {
+    const auto a = random_matrix<double>(40, 40, 3);
+    const auto b = random_matrix<double>(40, 40, 4);
+    CHECK(strassen_multiply(a, b) == a * b);
+}
+
+TEST_CASE("StrassenWorkspace is reused across products") {
+    ThreadPool pool(1);
+    StrassenWorkspace<double> workspace;
+    const auto a = random_matrix<double>(96, 96, 5);
+    const auto b = random_matrix<double>(96, 96, 6);
+    DynamicMatrixd c(96, 96);
+
+    strassen_multiply<double>(a, b, c, workspace, pool, 16);
+    const auto capacity = workspace.capacity();
+    CHECK(capacity == StrassenWorkspace<double>::required(96, 16, false));
+    check_close(c, a * b, 1e-11);
+
+    const auto small_a = random_matrix<double>(48, 48, 7);
+    const auto small_b = random_matrix<double>(48, 48, 8);
+    DynamicMatrixd small_c(48, 48);
+    strassen_multiply<double>(small_a, small_b, small_c, workspace, pool, 16);
+    CHECK(workspace.capacity() == capacity);
+    check_close(small_c, small_a * small_b, 1e-11);
+
+    CHECK(StrassenWorkspace<double>::required(96, 16, true) > capacity);
+    CHECK(StrassenWorkspace<double>::required(16, 16, false) == 0);
+}
+
+TEST_CASE("strassen_multiply on Matrix") {
+    Matrix<8, 8, double> a, b, c;
+    for (auto i = 0u; i < 8; i++) {
+        for (auto j = 0u; j < 8; j++) {
+            a.get(i, j) = double(i + 2 * j);
+            b.get(i, j) = double(3 * i) - double(j);
+        }
+    }
+    strassen_multiply(a, b, c, ThreadPool::global(), 2);
+    const auto expected = a * b;
+    for (auto i = 0u; i < 8; i++) {
+        for (auto j = 0u; j < 8; j++) {
+            CHECK(c.get(i, j) == doctest::Approx(expected.get(i, j)));
+        }
+    }
+}
+
+TEST_CASE("strassen_multiply rejects non-square operands") {
+    DynamicMatrixd a(4, 5), b(5, 4), c(4, 4);
+    CHECK_THROWS_AS(strassen_multiply<double>(a, b, c), std::invalid_argument);
+    CHECK_THROWS_AS(strassen_multiply(a, b), std::invalid_argument);
+}
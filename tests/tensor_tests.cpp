@@ -0,0 +1,228 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "tensor.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+
+using namespace cml;
+
+namespace {
+
+template <typename T>
+Tensor<T> random_tensor(const TensorShape &shape, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Tensor<T> t(shape);
+    for (std::size_t i = 0; i < t.size(); i++) {
+        t.data()[i] = T(dist(rng) * 8);
+    }
+    return t;
+}
+
+// a(i, j, k) == b(i, j, k) for every index of a rank 3 shape.
+template <typename T, typename U>
+void check_equal3(ConstTensorView<T> a, ConstTensorView<U> b) {
+    REQUIRE(a.shape() == b.shape());
+    for (std::size_t i = 0; i < a.extent(0); i++) {
+        for (std::size_t j = 0; j < a.extent(1); j++) {
+            for (std::size_t k = 0; k < a.extent(2); k++) {
+                CHECK(a(i, j, k) == b(i, j, k));
+            }
+        }
+    }
+}
+
+// The product of one batch, in long double.
+template <typename T>
+void check_product(ConstTensorView<T> a, ConstTensorView<T> b,
+                   ConstTensorView<T> c) {
+    for (std::size_t i = 0; i < c.extent(0); i++) {
+        for (std::size_t j = 0; j < c.extent(1); j++) {
+            long double sum = 0;
+            for (std::size_t p = 0; p < a.extent(1); p++) {
+                sum += (long double)a(i, p) * b(p, j);
+            }
+            CHECK(c(i, j) == doctest::Approx(double(sum)).epsilon(1e-4));
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("Tensor: shapes and views") {
+    Tensor<int> t({2, 3, 4});
+    for (std::size_t i = 0; i < t.size(); i++) {
+        t.data()[i] = int(i);
+    }
+    CHECK(t.rank() == 3);
+    CHECK(t.size() == 24);
+    CHECK(t(1, 2, 3) == 23);
+    CHECK(t.view().is_contiguous());
+    CHECK(t.view().stride(0) == 12);
+    CHECK(Tensor<int>({2, 0, 3}).empty());
+    CHECK(TensorShape{}.size() == 1);
+    CHECK_THROWS_AS(TensorShape({1, 1, 1, 1, 1, 1, 1, 1, 1}),
+                    std::invalid_argument);
+
+    // reshape() and select() share the elements.
+    const auto flat = t.reshape({6, 4});
+    CHECK(flat(5, 1) == 21);
+    flat(5, 1) = -1;
+    CHECK(t(1, 2, 1) == -1);
+    t(1, 2, 1) = 21;
+    CHECK(t.select(1, 2)(1, 3) == 23);
+    CHECK(t.select(0, 1).shape() == TensorShape{3, 4});
+    CHECK_THROWS_AS(t.reshape({5, 5}), std::invalid_argument);
+    CHECK_THROWS_AS(t.select(2, 4), std::out_of_range);
+
+    // slice() with a step, permute() and transpose().
+    const auto s = t.slice(2, 1, 4, 2);
+    CHECK(s.shape() == TensorShape{2, 3, 2});
+    CHECK(s(1, 1, 1) == 19);
+    CHECK_FALSE(s.is_contiguous());
+    CHECK_THROWS_AS(s.reshape({12}), std::invalid_argument);
+    CHECK_THROWS_AS(t.slice(0, 1, 3), std::out_of_range);
+    const auto p = t.permute({2, 0, 1});
+    CHECK(p.shape() == TensorShape{4, 2, 3});
+    CHECK(p(3, 1, 2) == t(1, 2, 3));
+    CHECK(t.transpose(0, 2)(3, 2, 1) == t(1, 2, 3));
+    CHECK_THROWS_AS(t.permute({0, 0, 1}), std::invalid_argument);
+    CHECK_THROWS_AS(t.permute({0, 1}), std::invalid_argument);
+
+    // broadcast_to() repeats with stride 0.
+    Tensor<int> bias({4}, {10, 20, 30, 40});
+    CHECK_THROWS_AS(Tensor<int>({4}, {10, 20, 30}), std::invalid_argument);
+    CHECK_THROWS_AS(Tensor<int>({2}, {10, 20, 30}), std::invalid_argument);
+    const auto b = bias.broadcast_to({2, 3, 4});
+    CHECK(b.stride(0) == 0);
+    CHECK(b.stride(2) == 1);
+    CHECK(b(1, 2, 3) == 40);
+    CHECK_THROWS_AS(bias.broadcast_to({2, 3}), std::invalid_argument);
+    CHECK(broadcast_shapes({3, 1, 5}, {4, 1}) == TensorShape{3, 4, 5});
+    CHECK_THROWS_AS(broadcast_shapes({3, 2}, {3}), std::invalid_argument);
+
+    // A contiguous copy of a strided view.
+    const Tensor<int> copy(p);
+    CHECK(copy.view().is_contiguous());
+    check_equal3<int, int>(copy, p);
+}
+
+TEST_CASE_TEMPLATE("Tensor: broadcasting elementwise kernels", T, float,
+                   double, int) {
+    ThreadPool pool(4);
+    const auto x = random_tensor<T>({3, 5, 7, 19}, 1);
+    const auto bias = random_tensor<T>({19}, 2);
+    const auto y = random_tensor<T>({3, 5, 7, 19}, 3);
+
+    for_each_isa([&] {
+        // A [C] bias added to [N, H, W, C].
+        const auto sum = x + bias;
+        REQUIRE(sum.shape() == x.shape());
+        for (std::size_t i = 0; i < sum.size(); i++) {
+            CHECK(sum.data()[i] == T(x.data()[i] + bias.data()[i % 19]));
+        }
+        // Both operands broadcast: [5, 1, 1] * [7, 19].
+        Tensor<T> scale({5, 1, 1}, {1, 2, 3, 4, 5});
+        const auto product = scale * Tensor<T>(y.select(0, 0).select(0, 0));
+        CHECK(product.shape() == TensorShape{5, 7, 19});
+        for (std::size_t h = 0; h < 5; h++) {
+            for (std::size_t w = 0; w < 7; w++) {
+                for (std::size_t c = 0; c < 19; c++) {
+                    CHECK(product(h, w, c) == T(T(h + 1) * y(0, 0, w, c)));
+                }
+            }
+        }
+        CHECK((x - x) == Tensor<T>(x.shape()));
+        CHECK((x * T(2)) == (x + x));
+
+        // Strided inputs and outputs, on one and on four threads.
+        const auto a = x.select(0, 1).permute({2, 0, 1});
+        const auto b = y.select(0, 2).slice(1, 1, 7, 3).permute({2, 0, 1});
+        Tensor<T> serial({19, 5, 2}), parallel({19, 5, 2});
+        ThreadPool one(1);
+        subtract<T>(a.slice(2, 0, 4, 2), b, serial, one);
+        subtract<T>(a.slice(2, 0, 4, 2), b, parallel, pool);
+        CHECK(serial == parallel);
+        for (std::size_t c = 0; c < 19; c++) {
+            for (std::size_t h = 0; h < 5; h++) {
+                for (std::size_t w = 0; w < 2; w++) {
+                    CHECK(serial(c, h, w) ==
+                          T(x(1, h, 2 * w, c) - y(2, h, 1 + 3 * w, c)));
+                }
+            }
+        }
+        // In place, into a transposed view.
+        Tensor<T> out(x);
+        const auto t = out.transpose(1, 3);
+        add<T>(t, t, t, pool);
+        CHECK(out == x + x);
+        transform<T>(
+            x, bias, out, [](T u, T v) { return u > v ? u : v; }, pool);
+        CHECK(out(2, 4, 6, 18) == std::max(x(2, 4, 6, 18), bias(18)));
+    });
+
+    Tensor<T> wrong({3, 5, 7, 18});
+    CHECK_THROWS_AS(add<T>(x, bias, wrong), std::invalid_argument);
+    CHECK_THROWS_AS(x + wrong, std::invalid_argument);
+    if constexpr (std::is_floating_point_v<T>) {
+        CHECK((y / y)(1, 1, 1, 1) == T(1));
+    }
+}
+
+TEST_CASE_TEMPLATE("Tensor: batched matmul", T, float, double) {
+    ThreadPool pool(4);
+    for_each_isa([&] {
+        // Batches of both operands.
+        const auto a = random_tensor<T>({2, 3, 5, 4}, 4);
+        const auto b = random_tensor<T>({2, 3, 4, 6}, 5);
+        const auto c = matmul(a, b, pool);
+        REQUIRE(c.shape() == TensorShape{2, 3, 5, 6});
+        for (std::size_t i = 0; i < 2; i++) {
+            for (std::size_t j = 0; j < 3; j++) {
+                check_product<T>(a.select(0, i).select(0, j),
+                                 b.select(0, i).select(0, j),
+                                 c.select(0, i).select(0, j));
+            }
+        }
+
+        // One matrix shared by all batches: a single gemm.
+        const auto w = random_tensor<T>({4, 7}, 6);
+        const auto shared = matmul(a, w, pool);
+        CHECK(shared.shape() == TensorShape{2, 3, 5, 7});
+        check_product<T>(a.select(0, 1).select(0, 2), w,
+                         shared.select(0, 1).select(0, 2));
+
+        // Leading dimensions that broadcast, and transposed operands.
+        const auto lhs = random_tensor<T>({3, 1, 5, 4}, 7);
+        const auto rhs = random_tensor<T>({2, 6, 4}, 8);
+        Tensor<T> out({3, 2, 5, 6});
+        matmul<T>(lhs, rhs.transpose(1, 2), out, pool);
+        for (std::size_t i = 0; i < 3; i++) {
+            for (std::size_t j = 0; j < 2; j++) {
+                check_product<T>(lhs.select(0, i).select(0, 0),
+                                 rhs.select(0, j).transpose(0, 1),
+                                 out.select(0, i).select(0, j));
+            }
+        }
+        // Into a strided output, and large enough for gemm on the pool.
+        const auto big_a = random_tensor<T>({2, 96, 80}, 9);
+        const auto big_b = random_tensor<T>({2, 80, 72}, 10);
+        Tensor<T> big({2, 72, 96});
+        matmul<T>(big_a, big_b, big.transpose(1, 2), pool);
+        check_product<T>(big_a.select(0, 1), big_b.select(0, 1),
+                         big.select(0, 1).transpose(0, 1));
+    });
+
+    const auto a = random_tensor<T>({2, 3, 4}, 11);
+    CHECK_THROWS_AS(matmul(a, a), std::invalid_argument);
+    CHECK_THROWS_AS(matmul(a, Tensor<T>({3, 4, 2})), std::invalid_argument);
+    Tensor<T> wrong({2, 3, 4});
+    CHECK_THROWS_AS(matmul<T>(a, a.transpose(1, 2), wrong),
+                    std::invalid_argument);
+    CHECK(matmul(Tensor<T>({0, 3, 4}), Tensor<T>({4, 2})).shape() ==
+          TensorShape{0, 3, 2});
+}
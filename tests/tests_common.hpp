@@ -1,4 +1,13 @@
 #pragma once
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "dynamic_matrix.hpp"
+#include "matrix.hpp"
+#include "vector.hpp"
+#include <concepts>
+#include <cstddef>
+#include <random>
+#include <vector>
 
 #define ARITHMETIC_TYPES int, double, float, long double
 
@@ -34,3 +43,88 @@ template <typename T, unsigned int Dim> struct TypeDimPair {
     TypeDimPair<long double, 10>,\
     TypeDimPair<long double, 20>
 // clang-format on
+
+// Restores the ISA that was active at construction when it goes out of
+// scope, so a forced ISA does not leak into later tests when a REQUIRE
+// fails.
+class IsaGuard {
+  public:
+    IsaGuard() : m_initial(cml::active_isa()) {}
+    IsaGuard(const IsaGuard &) = delete;
+    IsaGuard &operator=(const IsaGuard &) = delete;
+    ~IsaGuard() { cml::set_active_isa(m_initial); }
+
+  private:
+    cml::Isa m_initial;
+};
+
+// Calls f() once for every ISA this machine supports.
+template <typename F> void for_each_isa(F &&f) {
+    const IsaGuard guard;
+    for (const auto isa : cml::all_isas) {
+        if (isa > cml::supported_isa()) {
+            continue;
+        }
+        cml::set_active_isa(isa);
+        f();
+    }
+}
+
+// Entries uniform in [-scale, scale).
+template <std::floating_point T>
+cml::DynamicMatrix<T> random_matrix(std::size_t rows, std::size_t cols,
+                                    unsigned int seed, T scale = T(1)) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<T> dist(-scale, scale);
+    cml::DynamicMatrix<T> m(rows, cols);
+    for (std::size_t i = 0; i < m.size(); i++) {
+        m.data()[i] = dist(rng);
+    }
+    return m;
+}
+
+// Entries uniform in [-1, 1).
+template <unsigned int Rows, unsigned int Cols, std::floating_point T>
+std::vector<cml::Matrix<Rows, Cols, T>> random_matrices(std::size_t count,
+                                                        unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<T> dist(T(-1), T(1));
+    std::vector<cml::Matrix<Rows, Cols, T>> matrices(count);
+    for (auto &m : matrices) {
+        for (auto &v : m) {
+            v = dist(rng);
+        }
+    }
+    return matrices;
+}
+
+// Element-wise comparisons within a relative epsilon.
+template <typename T>
+void check_close(const cml::DynamicMatrix<T> &actual,
+                 const cml::DynamicMatrix<T> &expected, double epsilon) {
+    REQUIRE(actual.rows() == expected.rows());
+    REQUIRE(actual.cols() == expected.cols());
+    for (std::size_t i = 0; i < actual.size(); i++) {
+        CHECK(actual.data()[i] ==
+              doctest::Approx(expected.data()[i]).epsilon(epsilon));
+    }
+}
+
+template <unsigned int Rows, unsigned int Cols, typename T>
+void check_close(const cml::Matrix<Rows, Cols, T> &actual,
+                 const cml::Matrix<Rows, Cols, T> &expected, double epsilon) {
+    for (auto row = 0u; row < Rows; row++) {
+        for (auto col = 0u; col < Cols; col++) {
+            CHECK(actual.get(row, col) ==
+                  doctest::Approx(expected.get(row, col)).epsilon(epsilon));
+        }
+    }
+}
+
+template <typename T, unsigned int Dim, typename LenT>
+void check_close(const cml::Vec<T, Dim, LenT> &actual,
+                 const cml::Vec<T, Dim, LenT> &expected, double epsilon) {
+    for (auto d = 0u; d < Dim; d++) {
+        CHECK(actual[d] == doctest::Approx(expected[d]).epsilon(epsilon));
+    }
+}
@@ -0,0 +1,142 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "text_io.hpp"
+#include "thread_pool.hpp"
+#include "vector.hpp"
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace cml;
+
+#define TT typename T::Type
+
+TEST_CASE_TEMPLATE("Text IO: format and parse round trip", T,
+                   ARITHMETIC_TYPES_AND_DIMS) {
+    Vec<TT, T::dim> a;
+    std::iota(a.begin(), a.end(), TT(-3));
+    if constexpr (std::is_floating_point_v<TT>) {
+        a[0] = TT(0.1);
+    }
+
+    std::string text;
+    format_to(text, a);
+    CHECK(text.size() <= formatted_size_bound<Vec<TT, T::dim>>());
+
+    const auto parsed = parse<Vec<TT, T::dim>>(text);
+    REQUIRE(parsed.has_value());
+    CHECK(*parsed == a);
+}
+
+TEST_CASE("Text IO: format_to into a fixed buffer") {
+    char buffer[64];
+    const auto result =
+        format_to(buffer, buffer + sizeof(buffer), Vec3f(1.5f, -2.f, 3.f), ',');
+    CHECK(result.ec == std::errc());
+    CHECK(std::string(buffer, result.ptr) == "1.5,-2,3");
+
+    char small[4];
+    CHECK(format_to(small, small + sizeof(small), Vec3f(1.5f, -2.f, 3.f)).ec ==
+          std::errc::value_too_large);
+}
+
+TEST_CASE("Text IO: parse accepts commas, tabs and signs") {
+    CHECK(parse<Vec3f>("1,2,3") == Vec3f(1.f, 2.f, 3.f));
+    CHECK(parse<Vec3f>("  +1\t-2 ,\n3  \n") == Vec3f(1.f, -2.f, 3.f));
+    CHECK(parse<Vec3d>("1e3 2.5E-1 -0") == Vec3d(1000., 0.25, 0.));
+    CHECK_FALSE(parse<Vec3f>("1 2").has_value());
+    CHECK_FALSE(parse<Vec3f>("1 2 3 4").has_value());
+    CHECK_FALSE(parse<Vec3i>("1 2 x").has_value());
+}
+
+TEST_CASE_TEMPLATE("Text IO: Matrix round trip", T, ARITHMETIC_TYPES) {
+    Matrix<2, 3, T> m;
+    std::iota(m.begin(), m.end(), T(1));
+    std::string text;
+    format_to(text, m);
+    const auto parsed = parse<Matrix<2, 3, T>>(text);
+    REQUIRE(parsed.has_value());
+    for (auto i = 0u; i < 2; i++) {
+        for (auto j = 0u; j < 3; j++) {
+            CHECK(parsed->get(i, j) == m.get(i, j));
+        }
+    }
+}
+
+TEST_CASE("Text IO: bulk parse keeps order across chunks") {
+    ThreadPool pool(4);
+    std::vector<Vec3f> points(5000);
+    for (auto i = 0u; i < points.size(); i++) {
+        points[i] = Vec3f(float(i), float(i) * 0.5f, -float(i));
+    }
+    const auto text = format_lines(std::span<const Vec3f>(points), ',', {},
+                                   pool);
+
+    TextReadOptions options;
+    options.chunk_bytes = 1000;
+    const auto parsed = parse_lines<Vec3f>(text, options, pool);
+    REQUIRE(parsed.size() == points.size());
+    CHECK(parsed == points);
+}
+
+TEST_CASE("Text IO: bulk parse reports the first malformed chunk") {
+    ThreadPool pool(4);
+    std::string text;
+    for (auto i = 0; i < 2000; i++) {
+        text += "1 2 3\n";
+    }
+    const auto first_bad = 700 * 6, second_bad = 1500 * 6;
+    text[first_bad + 2] = 'x';
+    text[second_bad + 2] = 'x';
+
+    TextReadOptions options;
+    options.chunk_bytes = 64;
+    for (auto run = 0; run < 20; run++) {
+        std::string message;
+        try {
+            parse_lines<Vec3f>(text, options, pool);
+        } catch (const TextParseError &error) {
+            message = error.what();
+        }
+        CHECK(message == "cml: malformed element at byte offset " +
+                             std::to_string(first_bad));
+    }
+    // The pool is still usable, and still runs on all its threads.
+    text[first_bad + 2] = text[second_bad + 2] = '2';
+    CHECK(parse_lines<Vec3f>(text, options, pool).size() == 2000);
+}
+
+TEST_CASE("Text IO: OBJ style vertices with comments") {
+    const std::string obj = "# comment\n"
+                            "o mesh\n"
+                            "v 1 2 3\n"
+                            "vn 0 0 1\n"
+                            "\n"
+                            "v 4 5 6\r\n"
+                            "f 1 2 3\n";
+    TextReadOptions options;
+    options.line_prefix = "v ";
+    const auto vertices = parse_lines<Vec3d>(obj, options);
+    REQUIRE(vertices.size() == 2);
+    CHECK(vertices[0] == Vec3d(1., 2., 3.));
+    CHECK(vertices[1] == Vec3d(4., 5., 6.));
+
+    CHECK_THROWS_AS(parse_lines<Vec3d>("1 2 3\n4 5\n"), TextParseError);
+}
+
+TEST_CASE("Text IO: read_lines from a file") {
+    const auto path =
+        std::filesystem::temp_directory_path() / "cml_text_io_tests.txt";
+    {
+        std::ofstream out(path);
+        out << "1 2\n3 4\n5 6";
+    }
+    const auto vecs = read_lines<Vec2i>(path);
+    REQUIRE(vecs.size() == 3);
+    CHECK(vecs[2] == Vec2i(5, 6));
+    std::filesystem::remove(path);
+}
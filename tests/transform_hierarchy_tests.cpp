@@ -0,0 +1,137 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "matrix.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "transform_hierarchy.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+Mat4d random_transform(std::mt19937 &rng) {
+    std::uniform_real_distribution<double> u(-1., 1.);
+    const auto axis = Vec3d(u(rng), u(rng), u(rng) + 2.).normalized();
+    return translate(rotate(Mat4d::identity(), u(rng), axis),
+                     Vec3d(u(rng), u(rng), u(rng)));
+}
+
+// World matrix by walking up to the root.
+Mat4d naive_world(const TransformHierarchy<double> &h, std::uint32_t id) {
+    auto world = h.local(id);
+    for (auto p = h.parent(id); p != h.no_parent; p = h.parent(p)) {
+        world = h.local(p) * world;
+    }
+    return world;
+}
+
+// Random forest; parents always precede their children.
+TransformHierarchy<double> random_hierarchy(std::size_t n,
+                                            std::mt19937 &rng) {
+    TransformHierarchy<double> h;
+    for (auto i = 0u; i < n; i++) {
+        const auto parent =
+            i < 3 ? h.no_parent
+                  : std::uniform_int_distribution<std::uint32_t>(0, i - 1)(rng);
+        h.add(parent, random_transform(rng));
+    }
+    return h;
+}
+
+} // namespace
+
+TEST_CASE("affine_multiply matches the full product") {
+    std::mt19937 rng(1);
+    const auto a = random_transform(rng);
+    const auto b = random_transform(rng);
+    CHECK(is_affine(a));
+    check_close(affine_multiply(a, b), a * b, 1e-9);
+    auto projective = a;
+    projective.get(3, 2) = 0.5;
+    CHECK_FALSE(is_affine(projective));
+}
+
+TEST_CASE("TransformHierarchy world matrices match the naive walk") {
+    std::mt19937 rng(2);
+    auto h = random_hierarchy(5000, rng);
+    ThreadPool pool(4);
+    const auto stats = h.update(pool);
+    CHECK(stats.dirty == 5000);
+    CHECK(stats.recomputed == 5000);
+    for (auto id = 0u; id < h.size(); id++) {
+        check_close(h.world(id), naive_world(h, id), 1e-9);
+    }
+
+    // A projective local switches the subtree to the full product.
+    auto projective = h.local(4);
+    projective.get(3, 0) = 0.25;
+    h.set_local(4, projective);
+    h.update(pool);
+    for (auto id = 0u; id < h.size(); id++) {
+        check_close(h.world(id), naive_world(h, id), 1e-9);
+    }
+}
+
+TEST_CASE("TransformHierarchy only recomputes changed subtrees") {
+    // Chain 0 -> 1 -> 2 and a sibling branch 0 -> 3 -> 4, 5; root 6.
+    TransformHierarchy<double> h;
+    std::mt19937 rng(3);
+    const auto r = h.add(h.no_parent, random_transform(rng));
+    const auto a = h.add(r, random_transform(rng));
+    h.add(a, random_transform(rng));
+    const auto b = h.add(r, random_transform(rng));
+    h.add(b, random_transform(rng));
+    h.add(b, random_transform(rng));
+    const auto other = h.add(h.no_parent, random_transform(rng));
+    CHECK(h.update().levels == 3);
+
+    CHECK(h.update().recomputed == 0);
+    h.set_local(b, random_transform(rng));
+    h.set_local(b, random_transform(rng));
+    auto stats = h.update();
+    CHECK(stats.dirty == 1);
+    CHECK(stats.recomputed == 3);
+    CHECK(h.last_update_stats().recomputed == 3);
+
+    h.set_local(other, random_transform(rng));
+    h.set_local(a, random_transform(rng));
+    stats = h.update();
+    CHECK(stats.dirty == 2);
+    CHECK(stats.recomputed == 3);
+
+    h.set_local(r, random_transform(rng));
+    CHECK(h.update().recomputed == 6);
+    for (auto id = 0u; id < h.size(); id++) {
+        check_close(h.world(id), naive_world(h, id), 1e-9);
+    }
+}
+
+TEST_CASE("TransformHierarchy keeps ids when nodes are added later") {
+    std::mt19937 rng(4);
+    auto h = random_hierarchy(300, rng);
+    h.update();
+    // Deep nodes added after the first update land in new levels.
+    auto last = h.add(17, random_transform(rng));
+    for (auto i = 0; i < 20; i++) {
+        last = h.add(last, random_transform(rng));
+    }
+    CHECK(h.parent(last) == last - 1);
+    const auto stats = h.update();
+    CHECK(stats.recomputed == 21);
+    for (auto id = 0u; id < h.size(); id++) {
+        check_close(h.world(id), naive_world(h, id), 1e-9);
+    }
+
+    ThreadPool single(1);
+    auto serial = random_hierarchy(300, rng);
+    serial.update(single);
+    for (auto id = 0u; id < serial.size(); id++) {
+        check_close(serial.world(id), naive_world(serial, id), 1e-9);
+    }
+}
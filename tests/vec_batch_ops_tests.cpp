@@ -0,0 +1,135 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "cpu_dispatch.hpp"
+#include "matrix.hpp"
+#include "random.hpp"
+#include "tests_common.hpp"
+#include "thread_pool.hpp"
+#include "vec_batch.hpp"
+#include "vec_batch_ops.hpp"
+#include "vec_mat_operations.hpp"
+#include "vector.hpp"
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace cml;
+
+namespace {
+
+template <typename T, unsigned int Dim>
+VecBatch<T, Dim> random_batch(std::size_t size, std::uint64_t seed) {
+    Vec<T, Dim> lo, hi;
+    for (auto d = 0u; d < Dim; d++) {
+        lo[d] = T(-2);
+        hi[d] = T(2);
+    }
+    VecBatch<T, Dim> batch(size);
+    fill_uniform_box(batch, lo, hi, seed);
+    return batch;
+}
+
+template <typename T, unsigned int Dim>
+void check_near(const Vec<T, Dim> &a, const Vec<T, Dim> &b) {
+    for (auto d = 0u; d < Dim; d++) {
+        CHECK(a[d] == doctest::Approx(b[d]).epsilon(1e-5));
+    }
+}
+
+} // namespace
+
+TEST_CASE_TEMPLATE("Elementwise batch ops match Vec ops", T, float, double) {
+    ThreadPool pool(3);
+    // Not a multiple of the padding, and several tasks.
+    const std::size_t n = 40000 + 7;
+    const auto a = random_batch<T, 4>(n, 1);
+    const auto b = random_batch<T, 4>(n, 2);
+    for_each_isa([&] {
+        VecBatch<T, 4> sum, diff, scaled, fma;
+        add(a, b, sum, pool);
+        subtract(a, b, diff, pool);
+        scale(a, T(3), scaled, pool);
+        multiply_add(a, T(-0.5), b, fma, pool);
+        REQUIRE(sum.size() == n);
+        for (std::size_t i = 0; i < n; i += 997) {
+            const auto va = a[i];
+            const auto vb = b[i];
+            check_near(sum[i], va + vb);
+            check_near(diff[i], va - vb);
+            check_near(scaled[i], T(3) * va);
+            check_near(fma[i], va * T(-0.5) + vb);
+        }
+        check_near(sum[n - 1], a[n - 1] + b[n - 1]);
+    });
+}
+
+TEST_CASE("Scalar batch ops stop at size()") {
+    const std::size_t n = 37;
+    const auto a = random_batch<double, 3>(n, 3);
+    const auto b = random_batch<double, 3>(n, 4);
+    for_each_isa([&] {
+        // One extra slot which must stay untouched.
+        std::vector<double> dots(n + 1, -7.), lengths(n + 1, -7.);
+        dot(a, b, std::span<double>(dots).first(n));
+        length(a, std::span<double>(lengths).first(n));
+        for (std::size_t i = 0; i < n; i++) {
+            CHECK(dots[i] == doctest::Approx(a[i].dot(b[i])));
+            CHECK(lengths[i] == doctest::Approx(a[i].length()));
+        }
+        CHECK(dots[n] == -7.);
+        CHECK(lengths[n] == -7.);
+    });
+}
+
+TEST_CASE("Batch ops reject mismatched sizes") {
+    const auto a = random_batch<double, 3>(37, 3);
+    const auto b = random_batch<double, 3>(36, 4);
+    VecBatch<double, 3> out;
+    std::vector<double> scalars(37);
+    CHECK_THROWS_AS(add(a, b, out), std::invalid_argument);
+    CHECK_THROWS_AS(subtract(a, b, out), std::invalid_argument);
+    CHECK_THROWS_AS(multiply_add(a, 2.0, b, out), std::invalid_argument);
+    CHECK_THROWS_AS(dot(a, b, std::span<double>(scalars)),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(length(a, std::span<double>(scalars).first(36)),
+                    std::invalid_argument);
+    CHECK_NOTHROW(dot(a, a, std::span<double>(scalars)));
+}
+
+TEST_CASE("normalize works in place") {
+    auto a = random_batch<float, 3>(100, 5);
+    const auto expected = a.to_vecs();
+    for_each_isa([&] {
+        auto v = a;
+        normalize(v, v);
+        for (std::size_t i = 0; i < v.size(); i++) {
+            check_near(v[i], expected[i] / float(expected[i].length()));
+        }
+    });
+}
+
+TEST_CASE("transform_points and transform_directions match Mat4 * Vec") {
+    const auto m = translate(rotate(Mat4d::identity(), 0.7,
+                                    Vec3d(1., 2., 3.).normalized()),
+                             Vec3d(1., -2., 0.5));
+    const auto in = random_batch<double, 3>(1000, 6);
+    for_each_isa([&] {
+        VecBatch<double, 3> points, directions;
+        transform_points(m, in, points);
+        transform_directions(m, in, directions);
+        REQUIRE(points.size() == in.size());
+        for (std::size_t i = 0; i < in.size(); i += 7) {
+            const auto p = in[i];
+            const auto hp = m * Vec<double, 4>{p.x(), p.y(), p.z(), 1.};
+            const auto hd = m * Vec<double, 4>{p.x(), p.y(), p.z(), 0.};
+            check_near(points[i], Vec3d(hp[0], hp[1], hp[2]));
+            check_near(directions[i], Vec3d(hd[0], hd[1], hd[2]));
+        }
+        // In place.
+        auto copy = in;
+        transform_points(m, copy, copy);
+        check_near(copy[999], points[999]);
+    });
+}
@@ -0,0 +1,38 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest/doctest.h"
+#include "tests_common.hpp"
+#include "vec_batch.hpp"
+#include "vector.hpp"
+#include <numeric>
+#include <vector>
+
+using namespace cml;
+
+#define TT typename T::Type
+
+TEST_CASE_TEMPLATE("VecBatch: AoS round trip", T, ARITHMETIC_TYPES_AND_DIMS) {
+    std::vector<Vec<TT, T::dim>> vecs(21);
+    for (auto i = 0u; i < vecs.size(); i++) {
+        std::iota(vecs[i].begin(), vecs[i].end(), TT(i));
+    }
+
+    VecBatch<TT, T::dim> batch(vecs);
+    REQUIRE(batch.size() == vecs.size());
+    for (auto d = 0u; d < T::dim; d++) {
+        const auto component = batch.component(d);
+        CHECK(component.size() == vecs.size());
+        for (auto i = 0u; i < vecs.size(); i++) {
+            CHECK(component[i] == vecs[i][d]);
+        }
+    }
+    CHECK(batch.to_vecs() == vecs);
+}
+
+TEST_CASE("VecBatch: set and component views") {
+    VecBatch<float, 3> batch(3);
+    batch.set(1, Vec3f(1.f, 2.f, 3.f));
+    batch.component(2)[0] = 5.f;
+    CHECK(batch[1] == Vec3f(1.f, 2.f, 3.f));
+    CHECK(batch[0] == Vec3f(0.f, 0.f, 5.f));
+    CHECK(batch.get(1, 1) == 2.f);
+}
@@ -346,6 +346,18 @@ TEST_CASE_TEMPLATE("Vec: Interpolated", T, ARITHMETIC_TYPES_AND_DIMS) {
     }
 }
 
+TEST_CASE_TEMPLATE("Vec: lerp", T, double, float) {
+    const Vec3<T> a{T(1), T(-2), T(0.1)};
+    const Vec3<T> b{T(5), T(2), T(0.7)};
+    CHECK(lerp(a, b, T(0)) == a);
+    CHECK(lerp(a, b, T(1)) == b);
+    const auto mid = lerp(a, b, T(0.5));
+    CHECK(mid[0] == doctest::Approx(3));
+    CHECK(mid[1] == doctest::Approx(0));
+    CHECK(mid[2] == doctest::Approx(0.4));
+    CHECK(lerp(a, b, T(2))[0] == doctest::Approx(9));
+}
+
 TEST_CASE_TEMPLATE("Vec: Multiplication", T, ARITHMETIC_TYPES_AND_DIMS) {
     SUBCASE("Zero vector * Zero scalar") {
         Vec<TT, T::dim> a;